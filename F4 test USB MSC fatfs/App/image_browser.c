@@ -0,0 +1,731 @@
+/**
+  ******************************************************************************
+  * @file    LTDC_AnimatedPictureFromUSB/image_browser.c
+  * @author  MCD Application Team
+  * @version V1.0.1
+  * @date    11-November-2013
+  * @brief   BMP pictures browser: directory index, thumbnails cache and
+  *          prefetch of the next picture
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2013 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "image_browser.h"
+#include "usbh_core.h"
+
+/** @addtogroup USBH_USER
+* @{
+*/
+
+/** @defgroup IMAGE_BROWSER
+* @brief    BMP pictures browser
+* @{
+*/
+
+/** @defgroup IMAGE_BROWSER_Private_Defines
+* @{
+*/
+#define IMAGE_PREFETCH_IDLE      0
+#define IMAGE_PREFETCH_READING   1
+#define IMAGE_PREFETCH_DONE      2
+
+#define IMAGE_THUMB_BACKCOLOR    LCD_COLOR_BLACK
+/**
+* @}
+*/
+
+
+/** @defgroup IMAGE_BROWSER_Private_Macros
+* @{
+*/
+#define IMAGE_LE16(p)            ((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8))
+#define IMAGE_LE32(p)            (IMAGE_LE16(p) | (IMAGE_LE16((p) + 2) << 16))
+
+#define IMAGE_RECORD(n)          (((IMAGE_Record_TypeDef *)IMAGE_INDEX_ADDR) + (n))
+#define IMAGE_THUMB(n)           (IMAGE_THUMB_ADDR + (n) * IMAGE_THUMB_SIZE)
+#define IMAGE_CHUNK_ADDR(n)      (IMAGE_STAGING_ADDR + IMAGE_CARRY_SIZE + \
+                                  ((n) & 1) * (IMAGE_CARRY_SIZE + IMAGE_CHUNK_SIZE))
+
+extern USB_OTG_CORE_HANDLE          USB_OTG_Core;
+/**
+* @}
+*/
+
+
+/** @defgroup IMAGE_BROWSER_Private_Variables
+* @{
+*/
+static char     IMAGE_Dir[16];
+static char     IMAGE_PathName[32];
+static uint32_t IMAGE_Count = 0;
+static uint8_t  IMAGE_IndexDirty = 0;
+
+/* Picture file being prefetched, or streamed */
+static FIL      IMAGE_File;
+static uint8_t  IMAGE_PrefetchState = IMAGE_PREFETCH_IDLE;
+static uint32_t IMAGE_PrefetchIndex = 0;
+static uint32_t IMAGE_PrefetchRead = 0;
+static uint32_t IMAGE_PrefetchData = 0;
+
+static FIL      IMAGE_ThumbFile;
+static uint8_t  IMAGE_ThumbFileOpen = 0;
+/**
+* @}
+*/
+
+
+/** @defgroup IMAGE_BROWSER_Private_FunctionPrototypes
+* @{
+*/
+static char    *IMAGE_FileName(const char *name);
+static uint8_t  IMAGE_IsBMP(const char *name);
+static void     IMAGE_ReadHeader(IMAGE_Record_TypeDef *rec, FILINFO *fno);
+static uint8_t  IMAGE_IsShowable(const IMAGE_Record_TypeDef *rec);
+static void     IMAGE_IndexSave(void);
+static void     IMAGE_PrefetchCancel(void);
+static void     IMAGE_LoadThumbnail(uint32_t Index);
+static void     IMAGE_MakeThumbnail(uint32_t Index);
+#ifdef LCD_USE_DMA2D
+static void     IMAGE_Stream(IMAGE_Record_TypeDef *rec);
+#endif /* LCD_USE_DMA2D */
+/**
+* @}
+*/
+
+
+/** @defgroup IMAGE_BROWSER_Private_Functions
+* @{
+*/
+
+/**
+* @brief  IMAGE_IndexLoad
+*         Indexes the BMP pictures of a directory
+* @note   The index of the previous mount is read from IMAGE_INDEX_FILE and
+*         checked against the directory: the pictures are only opened from
+*         the first one added, removed or modified on. The index is saved
+*         back when it changed, if the medium is writable.
+* @param  path: directory of the pictures, "0:/" for the root
+* @retval Number of pictures indexed
+*/
+uint32_t IMAGE_IndexLoad(const char *path)
+{
+  IMAGE_IndexHeader_TypeDef header;
+  IMAGE_Record_TypeDef *rec;
+  FILINFO fno;
+  DIR dir;
+  uint32_t count = 0, loaded = 0, valid = 0;
+  UINT n;
+
+  IMAGE_PrefetchCancel();
+  strncpy(IMAGE_Dir, path, sizeof(IMAGE_Dir) - 1);
+  IMAGE_Count = 0;
+  IMAGE_IndexDirty = 0;
+
+  if (f_open(&IMAGE_File, IMAGE_FileName(IMAGE_INDEX_FILE), FA_OPEN_EXISTING | FA_READ) == FR_OK)
+  {
+    if ((f_read(&IMAGE_File, &header, sizeof(header), &n) == FR_OK) && (n == sizeof(header)) &&
+        (header.Magic == IMAGE_INDEX_MAGIC) && (header.Count <= IMAGE_INDEX_MAX) &&
+        (f_read(&IMAGE_File, IMAGE_RECORD(0), header.Count * sizeof(IMAGE_Record_TypeDef), &n) == FR_OK) &&
+        (n == header.Count * sizeof(IMAGE_Record_TypeDef)))
+    {
+      loaded = header.Count;
+    }
+    f_close(&IMAGE_File);
+  }
+
+  for (valid = 0; valid < loaded; valid++)
+  {
+    IMAGE_RECORD(valid)->Flags &= ~IMAGE_FLAG_CACHED;
+  }
+
+  if (f_opendir(&dir, path) != FR_OK)
+  {
+    return 0;
+  }
+
+  /* The directory order is stable on FAT: the records are compared in step */
+  valid = loaded;
+  while ((count < IMAGE_INDEX_MAX) && HCD_IsDeviceConnected(&USB_OTG_Core))
+  {
+    if ((f_readdir(&dir, &fno) != FR_OK) || (fno.fname[0] == 0))
+    {
+      break;
+    }
+    if ((fno.fattrib & AM_DIR) || !IMAGE_IsBMP(fno.fname))
+    {
+      continue;
+    }
+
+    rec = IMAGE_RECORD(count);
+    if ((count >= valid) || (strcmp(rec->Name, fno.fname) != 0) || (rec->Size != fno.fsize) ||
+        (rec->Date != fno.fdate) || (rec->Time != fno.ftime) ||
+        ((rec->BitPixel != 0) && !IMAGE_IsShowable(rec)))
+    {
+      /* The thumbnails are stored by record number: all the following
+         records are redone as well */
+      valid = count;
+      IMAGE_ReadHeader(rec, &fno);
+      IMAGE_IndexDirty = 1;
+    }
+    count++;
+  }
+
+  if (count != loaded)
+  {
+    IMAGE_IndexDirty = 1;
+  }
+  IMAGE_Count = count;
+  IMAGE_IndexSave();
+
+  return count;
+}
+
+/**
+* @brief  IMAGE_ShowThumbnails
+*         Displays a page of thumbnails
+* @note   A thumbnail is taken from the SDRAM, else from IMAGE_THUMB_FILE,
+*         else made from the picture and stored in both.
+* @param  First: index of the first picture of the page
+* @retval None
+*/
+void IMAGE_ShowThumbnails(uint32_t First)
+{
+  uint32_t index;
+
+  /* Back to a full screen RGB565 layer after a picture */
+  LCD_SetLayerSize(LCD_PIXEL_WIDTH, LCD_PIXEL_HEIGHT);
+  LCD_Clear(IMAGE_THUMB_BACKCOLOR);
+
+  IMAGE_ThumbFileOpen = 0;
+  if ((f_open(&IMAGE_ThumbFile, IMAGE_FileName(IMAGE_THUMB_FILE), FA_OPEN_ALWAYS | FA_READ | FA_WRITE) == FR_OK) ||
+      (f_open(&IMAGE_ThumbFile, IMAGE_FileName(IMAGE_THUMB_FILE), FA_OPEN_EXISTING | FA_READ) == FR_OK))
+  {
+    IMAGE_ThumbFileOpen = 1;
+  }
+
+  for (index = First; (index < First + IMAGE_THUMBS_PER_PAGE) && (index < IMAGE_Count); index++)
+  {
+    if ((IMAGE_RECORD(index)->Flags & IMAGE_FLAG_CACHED) == 0)
+    {
+      /* Slow to make: the page is shown as it fills */
+      LCD_FrameQueue(LCD_FRAME_PRESERVE);
+      IMAGE_LoadThumbnail(index);
+    }
+    if ((IMAGE_RECORD(index)->Flags & IMAGE_FLAG_CACHED) != 0)
+    {
+      LCD_DrawRGB565(((index - First) % (LCD_PIXEL_WIDTH / IMAGE_THUMB_WIDTH)) * IMAGE_THUMB_WIDTH,
+                     ((index - First) / (LCD_PIXEL_WIDTH / IMAGE_THUMB_WIDTH)) * IMAGE_THUMB_HEIGHT,
+                     IMAGE_THUMB_WIDTH, IMAGE_THUMB_HEIGHT, IMAGE_THUMB(index));
+    }
+  }
+  LCD_FrameQueue(LCD_FRAME_DISCARD);
+
+  if (IMAGE_ThumbFileOpen)
+  {
+    f_close(&IMAGE_ThumbFile);
+    IMAGE_ThumbFileOpen = 0;
+  }
+  IMAGE_IndexSave();
+}
+
+/**
+* @brief  IMAGE_Show
+*         Displays a picture full size
+* @note   A prefetched picture is converted from the SDRAM, an other one is
+*         streamed from the file.
+* @param  Index: picture index
+* @retval 1 if the picture was shown
+*/
+uint8_t IMAGE_Show(uint32_t Index)
+{
+  IMAGE_Record_TypeDef *rec = IMAGE_RECORD(Index);
+
+  if ((Index >= IMAGE_Count) || (rec->BitPixel == 0))
+  {
+    return 0;
+  }
+
+  if ((IMAGE_PrefetchState == IMAGE_PREFETCH_IDLE) || (IMAGE_PrefetchIndex != Index))
+  {
+#ifdef LCD_USE_DMA2D
+    IMAGE_PrefetchCancel();
+    if (f_open(&IMAGE_File, IMAGE_FileName(rec->Name), FA_OPEN_EXISTING | FA_READ) != FR_OK)
+    {
+      return 0;
+    }
+    IMAGE_Stream(rec);
+    f_close(&IMAGE_File);
+    LCD_FrameQueue(LCD_FRAME_DISCARD);
+    return 1;
+#else
+    IMAGE_Prefetch(Index);
+#endif /* LCD_USE_DMA2D */
+  }
+
+  while (IMAGE_PrefetchState == IMAGE_PREFETCH_READING)
+  {
+    IMAGE_Process();
+  }
+  if (IMAGE_PrefetchState != IMAGE_PREFETCH_DONE)
+  {
+    return 0;
+  }
+
+#ifdef LCD_USE_DMA2D
+  LCD_BMPStreamInit(rec->Width, rec->Height, rec->BitPixel);
+  LCD_BMPStreamRows(IMAGE_PrefetchData, (rec->Height < 0) ? -rec->Height : rec->Height);
+  LCD_BMPStreamWait();
+#else
+  LCD_WriteBMP(IMAGE_PREFETCH_ADDR);
+#endif /* LCD_USE_DMA2D */
+  LCD_FrameQueue(LCD_FRAME_DISCARD);
+  return 1;
+}
+
+/**
+* @brief  IMAGE_Prefetch
+*         Starts reading a picture in the SDRAM, IMAGE_Process goes on with it
+* @param  Index: picture index, nothing is done past the last picture
+* @retval None
+*/
+void IMAGE_Prefetch(uint32_t Index)
+{
+  if ((IMAGE_PrefetchState != IMAGE_PREFETCH_IDLE) && (IMAGE_PrefetchIndex == Index))
+  {
+    return;
+  }
+
+  IMAGE_PrefetchCancel();
+  if ((Index >= IMAGE_Count) || (IMAGE_RECORD(Index)->BitPixel == 0))
+  {
+    return;
+  }
+
+  if (f_open(&IMAGE_File, IMAGE_FileName(IMAGE_RECORD(Index)->Name), FA_OPEN_EXISTING | FA_READ) == FR_OK)
+  {
+    IMAGE_PrefetchIndex = Index;
+    IMAGE_PrefetchRead = 0;
+    IMAGE_PrefetchState = IMAGE_PREFETCH_READING;
+  }
+}
+
+/**
+* @brief  IMAGE_Process
+*         Reads the next chunk of the picture prefetched, to be called while
+*         waiting for the user
+* @param  None
+* @retval None
+*/
+void IMAGE_Process(void)
+{
+  IMAGE_Record_TypeDef *rec = IMAGE_RECORD(IMAGE_PrefetchIndex);
+  uint32_t len;
+#ifdef LCD_USE_DMA2D
+  uint32_t align;
+#endif /* LCD_USE_DMA2D */
+  UINT n;
+
+  if (IMAGE_PrefetchState != IMAGE_PREFETCH_READING)
+  {
+    return;
+  }
+
+  /* Chunks at sector aligned offsets, read by FatFs straight in the SDRAM */
+  len = rec->Size - IMAGE_PrefetchRead;
+  if (len > IMAGE_CHUNK_SIZE)
+  {
+    len = IMAGE_CHUNK_SIZE;
+  }
+  if ((f_read(&IMAGE_File, (void *)(IMAGE_PREFETCH_ADDR + IMAGE_PrefetchRead), len, &n) != FR_OK) ||
+      (n != len) || !HCD_IsDeviceConnected(&USB_OTG_Core))
+  {
+    IMAGE_PrefetchCancel();
+    return;
+  }
+
+  IMAGE_PrefetchRead += n;
+  if (IMAGE_PrefetchRead >= rec->Size)
+  {
+    f_close(&IMAGE_File);
+    IMAGE_PrefetchData = IMAGE_PREFETCH_ADDR + rec->Offset;
+#ifdef LCD_USE_DMA2D
+    /* The DMA2D reads pixels at their natural alignment */
+    align = (rec->BitPixel == 32) ? 3 : ((rec->BitPixel == 16) ? 1 : 0);
+    if ((IMAGE_PrefetchData & align) != 0)
+    {
+      memmove((void *)(IMAGE_PrefetchData & ~align), (void *)IMAGE_PrefetchData, rec->Size - rec->Offset);
+      IMAGE_PrefetchData &= ~align;
+    }
+#endif /* LCD_USE_DMA2D */
+    IMAGE_PrefetchState = IMAGE_PREFETCH_DONE;
+  }
+}
+
+/**
+* @brief  IMAGE_FileName
+*         Builds the path of a file of the browsed directory
+* @param  name: file name
+* @retval Path, valid until the next call
+*/
+static char *IMAGE_FileName(const char *name)
+{
+  strcpy(IMAGE_PathName, IMAGE_Dir);
+  strcat(IMAGE_PathName, name);
+  return IMAGE_PathName;
+}
+
+/**
+* @brief  IMAGE_IsBMP
+*         Checks the extension of a 8.3 file name
+* @param  name: file name
+* @retval 1 for a .BMP file
+*/
+static uint8_t IMAGE_IsBMP(const char *name)
+{
+  const char *ext = strrchr(name, '.');
+
+  return (ext != 0) && ((strcmp(ext, ".BMP") == 0) || (strcmp(ext, ".bmp") == 0));
+}
+
+/**
+* @brief  IMAGE_ReadHeader
+*         Fills a record from the directory entry and the BMP header
+* @param  rec: record
+* @param  fno: directory entry of the picture
+* @retval None
+*/
+static void IMAGE_ReadHeader(IMAGE_Record_TypeDef *rec, FILINFO *fno)
+{
+  uint8_t header[30];
+  uint32_t width, bit_pixel;
+  int32_t height;
+  UINT n;
+
+  memset(rec, 0, sizeof(*rec));
+  strncpy(rec->Name, fno->fname, sizeof(rec->Name) - 1);
+  rec->Size = fno->fsize;
+  rec->Date = fno->fdate;
+  rec->Time = fno->ftime;
+
+  if (f_open(&IMAGE_File, IMAGE_FileName(rec->Name), FA_OPEN_EXISTING | FA_READ) != FR_OK)
+  {
+    return;
+  }
+  if ((f_read(&IMAGE_File, header, sizeof(header), &n) == FR_OK) && (n == sizeof(header)) &&
+      (header[0] == 'B') && (header[1] == 'M'))
+  {
+    width = IMAGE_LE32(&header[18]);
+    height = (int32_t)IMAGE_LE32(&header[22]);
+    bit_pixel = IMAGE_LE16(&header[28]);
+
+    /* Checked before they are narrowed to the record fields */
+    if ((width <= LCD_PIXEL_WIDTH) && (height <= (int32_t)LCD_PIXEL_HEIGHT) &&
+        (height >= -(int32_t)LCD_PIXEL_HEIGHT) && (bit_pixel <= 32))
+    {
+      rec->Offset = IMAGE_LE32(&header[10]);
+      rec->Width = width;
+      rec->Height = height;
+      rec->BitPixel = bit_pixel;
+      if (!IMAGE_IsShowable(rec))
+      {
+        rec->BitPixel = 0;
+      }
+    }
+  }
+  f_close(&IMAGE_File);
+}
+
+/**
+* @brief  IMAGE_IsShowable
+*         Checks the geometry of a record against the layer and the file
+* @note   Only what the layer can show, and fits in the prefetch buffer. The
+*         pixels must lie within the file: the prefetch, the thumbnail and the
+*         stream all read Height rows of linesize bytes from Offset.
+* @param  rec: record
+* @retval 1 when the picture can be shown
+*/
+static uint8_t IMAGE_IsShowable(const IMAGE_Record_TypeDef *rec)
+{
+  uint32_t height, linesize;
+
+  if ((rec->Width > LCD_PIXEL_WIDTH) || (rec->Height > (int32_t)LCD_PIXEL_HEIGHT) ||
+      (rec->Height < -(int32_t)LCD_PIXEL_HEIGHT) || (rec->Height == 0) ||
+      ((rec->BitPixel != 16) && (rec->BitPixel != 24) && (rec->BitPixel != 32)) ||
+      (rec->Size > IMAGE_PREFETCH_SIZE))
+  {
+    return 0;
+  }
+
+  height = (rec->Height < 0) ? -rec->Height : rec->Height;
+  linesize = ((rec->Width * (rec->BitPixel / 8)) + 3) & ~3;
+
+  return (rec->Offset >= 30) && (rec->Offset <= rec->Size) &&
+         (height * linesize <= rec->Size - rec->Offset);
+}
+
+/**
+* @brief  IMAGE_IndexSave
+*         Writes the index back to the medium if it changed
+* @param  None
+* @retval None
+*/
+static void IMAGE_IndexSave(void)
+{
+  IMAGE_IndexHeader_TypeDef header;
+  FIL index;
+  UINT n;
+
+  if (!IMAGE_IndexDirty)
+  {
+    return;
+  }
+
+  /* Kept in the SDRAM only on a write protected medium */
+  if (f_open(&index, IMAGE_FileName(IMAGE_INDEX_FILE), FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+  {
+    return;
+  }
+  memset(&header, 0, sizeof(header));
+  header.Magic = IMAGE_INDEX_MAGIC;
+  header.Count = IMAGE_Count;
+  if ((f_write(&index, &header, sizeof(header), &n) == FR_OK) &&
+      (f_write(&index, IMAGE_RECORD(0), IMAGE_Count * sizeof(IMAGE_Record_TypeDef), &n) == FR_OK))
+  {
+    IMAGE_IndexDirty = 0;
+  }
+  f_close(&index);
+}
+
+/**
+* @brief  IMAGE_PrefetchCancel
+*         Drops the picture prefetched
+* @param  None
+* @retval None
+*/
+static void IMAGE_PrefetchCancel(void)
+{
+  if (IMAGE_PrefetchState == IMAGE_PREFETCH_READING)
+  {
+    f_close(&IMAGE_File);
+  }
+  IMAGE_PrefetchState = IMAGE_PREFETCH_IDLE;
+}
+
+/**
+* @brief  IMAGE_LoadThumbnail
+*         Brings the thumbnail of a picture in the SDRAM
+* @param  Index: picture index
+* @retval None
+*/
+static void IMAGE_LoadThumbnail(uint32_t Index)
+{
+  IMAGE_Record_TypeDef *rec = IMAGE_RECORD(Index);
+  UINT n;
+
+  if (rec->BitPixel == 0)
+  {
+    return;
+  }
+
+  if ((rec->Flags & IMAGE_FLAG_THUMB) && IMAGE_ThumbFileOpen &&
+      (f_lseek(&IMAGE_ThumbFile, Index * IMAGE_THUMB_SIZE) == FR_OK) &&
+      (f_read(&IMAGE_ThumbFile, (void *)IMAGE_THUMB(Index), IMAGE_THUMB_SIZE, &n) == FR_OK) &&
+      (n == IMAGE_THUMB_SIZE))
+  {
+    rec->Flags |= IMAGE_FLAG_CACHED;
+    return;
+  }
+
+  /* Made once from the picture, then kept in the thumbnails file */
+  IMAGE_Prefetch(Index);
+  while (IMAGE_PrefetchState == IMAGE_PREFETCH_READING)
+  {
+    IMAGE_Process();
+  }
+  if (IMAGE_PrefetchState != IMAGE_PREFETCH_DONE)
+  {
+    return;
+  }
+  IMAGE_MakeThumbnail(Index);
+
+  if (IMAGE_ThumbFileOpen &&
+      (f_lseek(&IMAGE_ThumbFile, Index * IMAGE_THUMB_SIZE) == FR_OK) &&
+      (f_write(&IMAGE_ThumbFile, (void *)IMAGE_THUMB(Index), IMAGE_THUMB_SIZE, &n) == FR_OK) &&
+      (n == IMAGE_THUMB_SIZE))
+  {
+    rec->Flags |= IMAGE_FLAG_THUMB;
+    IMAGE_IndexDirty = 1;
+  }
+}
+
+/**
+* @brief  IMAGE_MakeThumbnail
+*         Scales down the prefetched picture to its thumbnail
+* @note   Nearest pixel, by the integer factor that fits the picture in the
+*         thumbnail, centered on IMAGE_THUMB_BACKCOLOR.
+* @param  Index: picture index, the one prefetched
+* @retval None
+*/
+static void IMAGE_MakeThumbnail(uint32_t Index)
+{
+  IMAGE_Record_TypeDef *rec = IMAGE_RECORD(Index);
+  uint16_t *thumb = (uint16_t *)IMAGE_THUMB(Index);
+  uint16_t *dst;
+  uint8_t *pixel;
+  uint32_t height, bpp, linesize, scale, width_t, height_t, x, y, row;
+
+  height = (rec->Height < 0) ? -rec->Height : rec->Height;
+  bpp = rec->BitPixel / 8;
+  linesize = ((rec->Width * bpp) + 3) & ~3;
+
+  scale = (rec->Width + IMAGE_THUMB_WIDTH - 1) / IMAGE_THUMB_WIDTH;
+  if (scale < (height + IMAGE_THUMB_HEIGHT - 1) / IMAGE_THUMB_HEIGHT)
+  {
+    scale = (height + IMAGE_THUMB_HEIGHT - 1) / IMAGE_THUMB_HEIGHT;
+  }
+  if (scale == 0)
+  {
+    scale = 1;
+  }
+  width_t = rec->Width / scale;
+  height_t = height / scale;
+
+  for (x = 0; x < IMAGE_THUMB_WIDTH * IMAGE_THUMB_HEIGHT; x++)
+  {
+    thumb[x] = IMAGE_THUMB_BACKCOLOR;
+  }
+
+  for (y = 0; y < height_t; y++)
+  {
+    /* Rows are stored bottom up unless the height is negative */
+    row = (rec->Height > 0) ? (height - 1 - y * scale) : (y * scale);
+    pixel = (uint8_t *)(IMAGE_PrefetchData + row * linesize);
+    dst = thumb + ((IMAGE_THUMB_HEIGHT - height_t) / 2 + y) * IMAGE_THUMB_WIDTH +
+          (IMAGE_THUMB_WIDTH - width_t) / 2;
+
+    for (x = 0; x < width_t; x++, pixel += scale * bpp)
+    {
+      if (bpp == 2)
+      {
+        dst[x] = IMAGE_LE16(pixel);
+      }
+      else
+      {
+        dst[x] = ((pixel[2] & 0xF8) << 8) | ((pixel[1] & 0xFC) << 3) | (pixel[0] >> 3);
+      }
+    }
+  }
+
+  rec->Flags |= IMAGE_FLAG_CACHED;
+}
+
+#ifdef LCD_USE_DMA2D
+/**
+* @brief  IMAGE_Stream
+*         Displays the picture of IMAGE_File while reading it
+* @note   The file is read in chunks at sector aligned offsets, each with one
+*         multi-sector f_read, alternately in two SDRAM staging buffers. A
+*         row split by the end of a chunk is carried in front of the next
+*         one. The DMA2D converts the rows of a chunk while the next one is
+*         read.
+* @param  rec: record of the picture
+* @retval None
+*/
+static void IMAGE_Stream(IMAGE_Record_TypeDef *rec)
+{
+  uint32_t chunk = 0, linesize, nbrows, rows, left, align;
+  uint32_t start, end, next;
+  UINT n;
+
+  if (f_read(&IMAGE_File, (void *)IMAGE_CHUNK_ADDR(0), IMAGE_CHUNK_SIZE, &n) != FR_OK)
+  {
+    return;
+  }
+
+  nbrows = (rec->Height < 0) ? -rec->Height : rec->Height;
+  linesize = ((rec->Width * (rec->BitPixel/8)) + 3) & ~3;
+  align = (rec->BitPixel == 32) ? 3 : ((rec->BitPixel == 16) ? 1 : 0);
+  LCD_BMPStreamInit(rec->Width, rec->Height, rec->BitPixel);
+  start = IMAGE_CHUNK_ADDR(0) + rec->Offset;
+
+  while (start < IMAGE_CHUNK_ADDR(chunk) + n)
+  {
+    end = IMAGE_CHUNK_ADDR(chunk) + n;
+    rows = (end - start) / linesize;
+    if (rows > nbrows)
+    {
+      rows = nbrows;
+    }
+    nbrows -= rows;
+    left = (end - start) - rows * linesize;
+    next = IMAGE_CHUNK_ADDR(chunk + 1);
+
+    /* The other buffer is free once the rows of the previous chunk are done:
+       the partial row goes in front of the next chunk */
+    LCD_BMPStreamWait();
+    if ((nbrows != 0) && (left <= IMAGE_CARRY_SIZE))
+    {
+      memcpy((void *)(next - left), (void *)(end - left), left);
+    }
+
+    /* The DMA2D reads pixels at their natural alignment, which the header
+       size does not always give: the few bytes move is cheap next to the
+       USB transfer */
+    if ((start & align) != 0)
+    {
+      memmove((void *)(start & ~align), (void *)start, rows * linesize);
+      start &= ~align;
+    }
+
+    /* Converted by the DMA2D while the next chunk is read */
+    LCD_BMPStreamRows(start, rows);
+
+    if ((nbrows == 0) || (left > IMAGE_CARRY_SIZE) || (n < IMAGE_CHUNK_SIZE) ||
+        !HCD_IsDeviceConnected(&USB_OTG_Core))
+    {
+      break;
+    }
+
+    chunk++;
+    if (f_read(&IMAGE_File, (void *)next, IMAGE_CHUNK_SIZE, &n) != FR_OK)
+    {
+      break;
+    }
+    start = next - left;
+  }
+
+  LCD_BMPStreamWait();
+}
+#endif /* LCD_USE_DMA2D */
+
+/**
+* @}
+*/
+
+/**
+* @}
+*/
+
+/**
+* @}
+*/
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,136 @@
+/**
+  ******************************************************************************
+  * @file    LTDC_AnimatedPictureFromUSB/image_browser.h
+  * @author  MCD Application Team
+  * @version V1.0.1
+  * @date    11-November-2013
+  * @brief   Header file for image_browser.c
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2013 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __IMAGE_BROWSER_H__
+#define __IMAGE_BROWSER_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include "ff.h"
+#include "stm32f429i_discovery_lcd.h"
+
+/** @addtogroup USBH_USER
+  * @{
+  */
+
+/** @defgroup IMAGE_BROWSER
+  * @brief This file is the Header file for image_browser.c
+  * @{
+  */
+
+
+/** @defgroup IMAGE_BROWSER_Exported_Types
+  * @{
+  */
+/* One BMP picture of the browsed directory, as kept in IMAGE_INDEX_FILE */
+typedef struct
+{
+  uint32_t Size;       /* File size          \  checked against the directory  */
+  uint16_t Date;       /* Last modified date  > at each mount, the record is   */
+  uint16_t Time;       /* Last modified time /  rebuilt when one differs       */
+  uint32_t Offset;     /* Pixel data offset in the file */
+  uint16_t Width;
+  int16_t  Height;     /* Negative for a top-down picture */
+  uint8_t  BitPixel;   /* 16, 24 or 32, 0 for a picture that cannot be shown */
+  uint8_t  Flags;      /* IMAGE_FLAG_xxx */
+  char     Name[14];   /* 8.3 name as returned by f_readdir */
+} IMAGE_Record_TypeDef;
+
+/* First record of IMAGE_INDEX_FILE, of the size of a record so that the
+   records read and written in place stay 32-bit aligned for the USB DMA */
+typedef struct
+{
+  uint32_t Magic;      /* IMAGE_INDEX_MAGIC */
+  uint32_t Count;      /* Records following */
+  uint32_t Reserved[6];
+} IMAGE_IndexHeader_TypeDef;
+/**
+  * @}
+  */
+
+
+/** @defgroup IMAGE_BROWSER_Exported_Defines
+  * @{
+  */
+/* Files kept next to the pictures: the index, and the thumbnails stored at
+   the position of their record */
+#define IMAGE_INDEX_FILE         "IMAGES.IDX"
+#define IMAGE_THUMB_FILE         "IMAGES.THM"
+#define IMAGE_INDEX_MAGIC        0x58444E49  /* "INDX" */
+#define IMAGE_INDEX_MAX          512
+
+#define IMAGE_FLAG_THUMB         0x01  /* Thumbnail stored in IMAGE_THUMB_FILE */
+#define IMAGE_FLAG_CACHED        0x02  /* Thumbnail in the SDRAM, this mount only */
+
+/* Thumbnails, 4 x 4 per screen */
+#define IMAGE_THUMB_WIDTH        60
+#define IMAGE_THUMB_HEIGHT       80
+#define IMAGE_THUMB_SIZE         (IMAGE_THUMB_WIDTH * IMAGE_THUMB_HEIGHT * 2)
+#define IMAGE_THUMBS_PER_PAGE    ((LCD_PIXEL_WIDTH / IMAGE_THUMB_WIDTH) * \
+                                  (LCD_PIXEL_HEIGHT / IMAGE_THUMB_HEIGHT))
+
+/* Frames of the foreground layer while browsing: a picture is drawn while
+   the previous one is still shown, and shown at a vertical blanking */
+#define IMAGE_FRAMES             LCD_FRAMES_MAX
+
+/* SDRAM used by the browser, between the frame buffers and the font atlas:
+   - streaming buffers, each a chunk preceded by the carry of a partial row,
+   - one whole picture file, prefetched while the previous one is shown,
+   - the index,
+   - the thumbnails of the pictures seen during this mount. */
+#define IMAGE_CHUNK_SIZE         (32*1024)
+#define IMAGE_CARRY_SIZE         1024   /* More than one 240 pixel row at 32 bpp */
+#define IMAGE_STAGING_ADDR       (SDRAM_BANK_ADDR + 0x00100000)
+#define IMAGE_PREFETCH_ADDR      (SDRAM_BANK_ADDR + 0x00120000)
+#define IMAGE_PREFETCH_SIZE      0x00060000
+#define IMAGE_INDEX_ADDR         (SDRAM_BANK_ADDR + 0x00180000)
+#define IMAGE_THUMB_ADDR         (SDRAM_BANK_ADDR + 0x00200000)
+/**
+  * @}
+  */
+
+/** @defgroup IMAGE_BROWSER_Exported_FunctionsPrototype
+  * @{
+  */
+uint32_t IMAGE_IndexLoad(const char *path);
+void     IMAGE_ShowThumbnails(uint32_t First);
+uint8_t  IMAGE_Show(uint32_t Index);
+void     IMAGE_Prefetch(uint32_t Index);
+void     IMAGE_Process(void);
+/**
+  * @}
+  */
+
+#endif /* __IMAGE_BROWSER_H__ */
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -51,6 +51,10 @@
 
 /* Comment the line below to disable the scroll back and forward features */
 //#define     LCD_SCROLL_ENABLED
+
+/* Comment the line below to repaint the whole text zone at each new line
+   instead of the characters that changed */
+#define     LCD_LOG_INCREMENTAL
             
 /* Define the LCD default text color */
 #define     LCD_LOG_DEFAULT_COLOR    White
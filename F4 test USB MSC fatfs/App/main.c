@@ -128,6 +128,9 @@ int main(void)
     /* Host Task handler */
     USBH_Process(&USB_OTG_Core, &USB_Host);
     
+    /* Lines logged during the last frame */
+    LCD_LOG_Flush();
+    
     if (i++ == 0x10000)
     {
       STM_EVAL_LEDToggle(LED3);
@@ -30,6 +30,7 @@
 #include "usb_hcd_int.h"
 #include "usbh_core.h"
 #include "stm32fxxx_it.h"
+#include "stm32f429i_discovery_lcd.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -183,4 +184,30 @@ void OTG_HS_IRQHandler(void)
   USBH_OTG_ISR_Handler(&USB_OTG_Core);
 }
 
+#ifdef LCD_USE_DMA2D
+/**
+  * @brief  DMA2D_IRQHandler
+  *         This function handles DMA2D global interrupt request: chains the
+  *         rows of the picture being displayed.
+  * @param  None
+  * @retval None
+  */
+void DMA2D_IRQHandler(void)
+{
+  LCD_BMPStreamIRQHandler();
+}
+#endif /* LCD_USE_DMA2D */
+
+/**
+  * @brief  LTDC_IRQHandler
+  *         This function handles LTDC global interrupt request: moves to the
+  *         frames latched at the vertical blanking.
+  * @param  None
+  * @retval None
+  */
+void LTDC_IRQHandler(void)
+{
+  LCD_FrameIRQHandler();
+}
+
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -34,6 +34,7 @@
 #include "usbh_msc_scsi.h"
 #include "usbh_msc_bot.h"
 #include "PDF_Create.h"
+#include "image_browser.h"
 /** @addtogroup USBH_USER
 * @{
 */
@@ -58,7 +59,7 @@
 /** @defgroup USBH_USR_Private_Defines
 * @{
 */ 
-#define IMAGE_BUFFER_SIZE    512
+
 /**
 * @}
 */ 
@@ -81,9 +82,7 @@ uint8_t filenameString[15]  = {0};
 
 FATFS fatfs;
 FIL file;
-uint8_t Image_Buf[IMAGE_BUFFER_SIZE];
 uint8_t line_idx = 0;   
-uint32_t BytesRead = 0;
 
 /*  Points to the DEVICE_PROP structure of current device */
 /*  The purpose of this register is to speed up the execution */
@@ -147,7 +146,6 @@ const uint8_t MSG_UNREC_ERROR[]      = "> UNRECOVERED ERROR STATE\n";
 */
 static uint8_t Explore_Disk (char* path , uint8_t recu_level);
 static uint8_t Image_Browser (char* path);
-static void     Show_Image(void);
 static void     Toggle_Leds(void);
 /**
 * @}
@@ -663,47 +661,52 @@ static uint8_t Explore_Disk (char* path , uint8_t recu_level)
   return res;
 }
 
+/**
+* @brief  Image_Browser 
+*         Displays the BMP pictures of a directory: a page of thumbnails,
+*         then each picture of the page, the Key moving to the next one
+* @param  path: pointer to root path
+* @retval 0 if a picture was shown
+*/
 static uint8_t Image_Browser (char* path)
 {
-  FRESULT res;
   uint8_t ret = 1;
-  FILINFO fno;
-  DIR dir;
-  char *fn;
+  uint32_t count, page, index;
   
-  res = f_opendir(&dir, path);
-  if (res == FR_OK) {
+  count = IMAGE_IndexLoad(path);
+  LCD_FrameConfig(IMAGE_FRAMES);
+  
+  for (page = 0; (page < count) && HCD_IsDeviceConnected(&USB_OTG_Core); page += IMAGE_THUMBS_PER_PAGE)
+  {
+    IMAGE_ShowThumbnails(page);
+    IMAGE_Prefetch(page);
+    USB_OTG_BSP_mDelay(100);
+    while((HCD_IsDeviceConnected(&USB_OTG_Core)) && \
+      (STM_EVAL_PBGetState (BUTTON_USER) != SET))
+    {
+      Toggle_Leds();
+      IMAGE_Process();
+    }
     
-    for (;;) {
-      res = f_readdir(&dir, &fno);
-      if (res != FR_OK || fno.fname[0] == 0) break;
-      if (fno.fname[0] == '.') continue;
-
-      fn = fno.fname;
- 
-      if (fno.fattrib & AM_DIR) 
+    for (index = page; (index < page + IMAGE_THUMBS_PER_PAGE) && (index < count); index++)
+    {
+      if (!IMAGE_Show(index))
       {
         continue;
-      } 
-      else 
+      }
+      /* The next picture is read while this one is looked at */
+      IMAGE_Prefetch(index + 1);
+      USB_OTG_BSP_mDelay(100);
+      ret = 0;
+      while((HCD_IsDeviceConnected(&USB_OTG_Core)) && \
+        (STM_EVAL_PBGetState (BUTTON_USER) != SET))
       {
-        if((strstr(fn, "bmp")) || (strstr(fn, "BMP")))
-        {
-          res = f_open(&file, fn, FA_OPEN_EXISTING | FA_READ);
-          Show_Image();
-          USB_OTG_BSP_mDelay(100);
-          ret = 0;
-          while((HCD_IsDeviceConnected(&USB_OTG_Core)) && \
-            (STM_EVAL_PBGetState (BUTTON_USER) != SET))
-          {
-            Toggle_Leds();
-          }
-          f_close(&file);
-          
-        }
+        Toggle_Leds();
+        IMAGE_Process();
       }
-    }  
+    }
   }
+  LCD_FrameConfig(1);
   
 #ifdef USE_USB_OTG_HS  
   LCD_LOG_SetHeader("PDF Creat");
@@ -718,72 +721,6 @@ static uint8_t Image_Browser (char* path)
 }
 
 
-/**
-  * @brief  Open a file and copy its content to a buffer
-  * @param  DirName: the Directory name to open
-  * @param  FileName: the file name to open
-  * @param  BufferAddress: A pointer to a buffer to copy the file to
-  * @param  FileLen: the File lenght
-  * @retval err: Error status (0=> success, 1=> fail)
-  */
-uint32_t Storage_OpenReadFile(uint32_t Address)
-{
-  uint32_t index = 0, size = 0, i1 = 0;
-  uint32_t BmpAddress;
-
-  f_read(&file, &Image_Buf, 30, 0);
-  BmpAddress = (uint32_t)Image_Buf;
-
-  /* Read bitmap size */
-  size = *(uint16_t *) (BmpAddress + 2);
-  size |= (*(uint16_t *) (BmpAddress + 4)) << 16;  
- 
-  /* Get bitmap data address offset */
-  index = *(uint16_t *) (BmpAddress + 10);
-  index |= (*(uint16_t *) (BmpAddress + 12)) << 16;  
-  
-  f_lseek (&file, 0);
-
-  do
-  {
-    if (size < 256*2)
-    {
-      i1 = size;
-    }
-    else
-    {
-      i1 = 256*2;
-    }
-    size -= i1;
-    f_read(&file, &Image_Buf, i1, (UINT *)&BytesRead);
-
-    for (index = 0; index < i1; index++)
-    {
-      *(__IO uint8_t*) (Address) = *(__IO uint8_t *)BmpAddress;
-      
-      BmpAddress++;  
-      Address++;
-    }  
-    
-    BmpAddress = (uint32_t)Image_Buf;
-  }
-  while (size > 0);
-  
-  return 1;
-}
-
-/**
-* @brief  Show_Image 
-*         Displays BMP image
-* @param  None
-* @retval None
-*/
-static void Show_Image(void)
-{
-  Storage_OpenReadFile(SDRAM_BANK_ADDR);
-  LCD_WriteBMP(SDRAM_BANK_ADDR);
-}
-
 /**
 * @brief  Toggle_Leds
 *         Toggle leds to shows user input state
@@ -793,6 +730,9 @@ static void Show_Image(void)
 static void Toggle_Leds(void)
 {
   static uint32_t i;
+  
+  /* Every wait loop comes here: draw the lines still pending */
+  LCD_LOG_Flush();
   if (i++ == 0x10000)
   {
     STM_EVAL_LEDToggle(LED3);
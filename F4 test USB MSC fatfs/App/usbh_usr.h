@@ -121,7 +121,6 @@ int USBH_USR_MSC_Application(void);
 
 
 
-uint32_t Storage_OpenReadFile(uint32_t Address);
 /**
   * @}
   */ 
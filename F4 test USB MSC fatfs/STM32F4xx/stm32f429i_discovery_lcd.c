@@ -69,6 +69,11 @@
   * @{
   */
 #define ABS(X)  ((X) > 0 ? (X) : -(X))    
+
+/* RGB565 color split in 8-bit components for the DMA2D color registers */
+#define RGB565_RED8(C)     (((C) >> 8) & 0xF8)
+#define RGB565_GREEN8(C)   (((C) >> 3) & 0xFC)
+#define RGB565_BLUE8(C)    (((C) << 3) & 0xF8)
 /**
   * @}
   */ 
@@ -83,6 +88,27 @@ static uint16_t CurrentBackColor   = 0xFFFF;
 /* Default LCD configuration with LCD Layer 1 */
 static uint32_t CurrentFrameBuffer = LCD_FRAME_BUFFER;
 static uint32_t CurrentLayer = LCD_BACKGROUND_LAYER;
+#ifdef LCD_USE_DMA2D
+/* Fonts already expanded in the glyph atlas, and where */
+static sFONT   *AtlasFont[LCD_FONT_ATLAS_SLOTS];
+static uint32_t AtlasAddress[LCD_FONT_ATLAS_SLOTS];
+static uint32_t AtlasFree = LCD_FONT_ATLAS;
+/* BMP rows converted by the DMA2D interrupt, see LCD_BMPStreamRows */
+static __IO uint32_t StreamRows = 0;
+static uint32_t StreamSrc = 0, StreamDst = 0;
+static uint32_t StreamLineSize = 0, StreamWidth = 0, StreamCM = 0;
+static int32_t  StreamPitch = 0;
+#endif /* LCD_USE_DMA2D */
+/* Frames of each layer, see LCD_FrameConfig */
+static uint32_t FrameAddress[2][LCD_FRAMES_MAX];
+static uint8_t  FrameCount[2] = {1, 1};
+static uint8_t  FrameBack[2];                 /* Frame drawn */
+static __IO uint8_t FrameFront[2];            /* Frame scanned out */
+static __IO uint8_t FrameLatch[2] = {LCD_FRAMES_MAX, LCD_FRAMES_MAX};
+                                              /* Frame waiting for the reload */
+static __IO uint8_t FrameQueue[2][LCD_FRAMES_MAX]; /* Frames queued, oldest first */
+static __IO uint8_t FrameQueued[2];
+static uint8_t  FramePoolOwner[LCD_FRAME_POOL_NBR]; /* Layer + 1, 0 if free */
 /**
   * @}
   */ 
@@ -97,6 +123,17 @@ static void delay(__IO uint32_t nCount);
 static void PutPixel(int16_t x, int16_t y);
 static void LCD_PolyLineRelativeClosed(pPoint Points, uint16_t PointCount, uint16_t Closed);
 static void LCD_AF_GPIOConfig(void);
+static uint32_t LCD_GlyphPixel(uint16_t Row, uint32_t Column);
+static void LCD_FrameLatch(uint32_t Layerx);
+static uint32_t LCD_FrameFree(uint32_t Layerx);
+static void LCD_FrameCopy(uint32_t Src, uint32_t Dst);
+#ifdef LCD_USE_DMA2D
+static void LCD_DMA2D_Copy(uint32_t Src, uint32_t Dst, uint16_t NbLines);
+static void LCD_DMA2D_Fill(uint32_t Address, uint16_t Width, uint16_t Height, uint16_t Color);
+static void LCD_DMA2D_Glyph(uint32_t Glyph, uint32_t Address, uint16_t Width, uint16_t Height);
+static void LCD_DMA2D_Wait(void);
+static uint32_t LCD_GetFontAtlas(void);
+#endif /* LCD_USE_DMA2D */
 
 /**
   * @}
@@ -423,8 +460,228 @@ void LCD_SetLayer(uint32_t Layerx)
     CurrentFrameBuffer = LCD_FRAME_BUFFER + BUFFER_OFFSET;
     CurrentLayer = LCD_FOREGROUND_LAYER;
   }
+  
+  /* A page flipped layer is drawn in its back frame */
+  if (FrameCount[CurrentLayer] > 1)
+  {
+    CurrentFrameBuffer = FrameAddress[CurrentLayer][FrameBack[CurrentLayer]];
+  }
 }  
 
+/**
+  * @brief  Sets the current layer to RGB565 and to the given size.
+  * @note   A page flipped layer takes the new size with the next frame queued.
+  * @param  Width: layer width in pixels.
+  * @param  Height: layer height in pixels.
+  * @retval None
+  */
+void LCD_SetLayerSize(uint16_t Width, uint16_t Height)
+{
+  LTDC_Layer_TypeDef *LTDC_Layerx;
+  
+  /* Nothing left to latch with the previous size */
+  LCD_FrameWait();
+  
+  LTDC_Layerx = (CurrentLayer == LCD_BACKGROUND_LAYER) ? LTDC_Layer1 : LTDC_Layer2;
+  LTDC_LayerPixelFormat(LTDC_Layerx, LTDC_Pixelformat_RGB565);
+  LTDC_LayerSize(LTDC_Layerx, Width, Height);
+  if (FrameCount[CurrentLayer] < 2)
+  {
+    LTDC_ReloadConfig(LTDC_VBReload);
+  }
+}
+
+/**
+  * @brief  Sets the number of frames of the current layer.
+  * @note   With one frame, the drawing is visible at once. With more, it goes
+  *         to a back frame shown by LCD_FrameQueue at a vertical blanking,
+  *         the frames other than the layer frame buffer being taken from the
+  *         pool. The picture shown is kept and the drawing starts from it.
+  * @param  NbFrames: 1 to LCD_FRAMES_MAX.
+  * @retval Number of frames set, less than asked when the pool is short.
+  */
+uint32_t LCD_FrameConfig(uint32_t NbFrames)
+{
+  NVIC_InitTypeDef    NVIC_InitStructure;
+  LTDC_Layer_TypeDef *LTDC_Layerx;
+  uint32_t base, slot, count = 1;
+  
+  LTDC_Layerx = (CurrentLayer == LCD_BACKGROUND_LAYER) ? LTDC_Layer1 : LTDC_Layer2;
+  base = (CurrentLayer == LCD_BACKGROUND_LAYER) ? LCD_FRAME_BUFFER : (LCD_FRAME_BUFFER + BUFFER_OFFSET);
+  
+  /* Back to the layer frame buffer, showing the last frame queued */
+  LCD_FrameWait();
+  if ((FrameCount[CurrentLayer] > 1) && (FrameFront[CurrentLayer] != 0))
+  {
+    LCD_FrameCopy(FrameAddress[CurrentLayer][FrameFront[CurrentLayer]], base);
+    LTDC_LayerAddress(LTDC_Layerx, base);
+    LTDC_ReloadConfig(LTDC_VBReload);
+    while ((LTDC->SRCR & LTDC_SRCR_VBR) != 0)
+    {
+    }
+  }
+  
+  for (slot = 0; slot < LCD_FRAME_POOL_NBR; slot++)
+  {
+    if (FramePoolOwner[slot] == CurrentLayer + 1)
+    {
+      FramePoolOwner[slot] = 0;
+    }
+  }
+  
+  FrameAddress[CurrentLayer][0] = base;
+  for (slot = 0; (slot < LCD_FRAME_POOL_NBR) && (count < NbFrames) && (count < LCD_FRAMES_MAX); slot++)
+  {
+    if (FramePoolOwner[slot] == 0)
+    {
+      FramePoolOwner[slot] = CurrentLayer + 1;
+      FrameAddress[CurrentLayer][count++] = LCD_FRAME_POOL + (slot * LCD_FRAME_SIZE);
+    }
+  }
+  
+  FrameCount[CurrentLayer] = count;
+  FrameFront[CurrentLayer] = 0;
+  FrameLatch[CurrentLayer] = LCD_FRAMES_MAX;
+  FrameQueued[CurrentLayer] = 0;
+  FrameBack[CurrentLayer] = (count > 1) ? 1 : 0;
+  CurrentFrameBuffer = FrameAddress[CurrentLayer][FrameBack[CurrentLayer]];
+  
+  if (count > 1)
+  {
+    LCD_FrameCopy(base, CurrentFrameBuffer);
+    
+    /* A frame is on the screen once the shadow registers are reloaded */
+    LTDC_ClearITPendingBit(LTDC_IT_RR);
+    LTDC_ITConfig(LTDC_IT_RR, ENABLE);
+    
+    NVIC_InitStructure.NVIC_IRQChannel = LTDC_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+  }
+  
+  return count;
+}
+
+/**
+  * @brief  Queues the frame drawn on the current layer and takes the next one.
+  * @note   The frame is shown from the next vertical blanking, or after the
+  *         frames queued before it. This waits only when no frame is free,
+  *         which LCD_FrameReady tells beforehand.
+  * @param  Preserve: LCD_FRAME_PRESERVE to go on drawing over the frame
+  *         queued, LCD_FRAME_DISCARD when the next frame is drawn entirely.
+  * @retval None
+  */
+void LCD_FrameQueue(uint32_t Preserve)
+{
+  uint32_t layer = CurrentLayer, queued;
+  
+  if (FrameCount[layer] < 2)
+  {
+    /* Already on the screen */
+    return;
+  }
+  
+#ifdef LCD_USE_DMA2D
+  LCD_DMA2D_Wait();
+#endif /* LCD_USE_DMA2D */
+  
+  queued = FrameBack[layer];
+  NVIC_DisableIRQ(LTDC_IRQn);
+  FrameQueue[layer][FrameQueued[layer]++] = queued;
+  if (FrameLatch[layer] == LCD_FRAMES_MAX)
+  {
+    LCD_FrameLatch(layer);
+  }
+  NVIC_EnableIRQ(LTDC_IRQn);
+  
+  while (LCD_FrameFree(layer) == LCD_FRAMES_MAX)
+  {
+  }
+  FrameBack[layer] = LCD_FrameFree(layer);
+  CurrentFrameBuffer = FrameAddress[layer][FrameBack[layer]];
+  
+  if (Preserve == LCD_FRAME_PRESERVE)
+  {
+    LCD_FrameCopy(FrameAddress[layer][queued], CurrentFrameBuffer);
+  }
+}
+
+/**
+  * @brief  Tells whether LCD_FrameQueue can return at once.
+  * @param  None
+  * @retval 1 if a frame is free or the layer is not page flipped, else 0.
+  */
+uint32_t LCD_FrameReady(void)
+{
+  uint32_t free;
+  
+  if (FrameCount[CurrentLayer] < 2)
+  {
+    return 1;
+  }
+  
+  /* The frame drawn is the next one queued */
+  NVIC_DisableIRQ(LTDC_IRQn);
+  free = 0;
+  if (FrameCount[CurrentLayer] > (uint32_t)(FrameQueued[CurrentLayer] + 2 +
+                                            ((FrameLatch[CurrentLayer] != LCD_FRAMES_MAX) ? 1 : 0)))
+  {
+    free = 1;
+  }
+  NVIC_EnableIRQ(LTDC_IRQn);
+  
+  return free;
+}
+
+/**
+  * @brief  Waits until the frames queued on the current layer are shown.
+  * @param  None
+  * @retval None
+  */
+void LCD_FrameWait(void)
+{
+  while ((FrameQueued[CurrentLayer] != 0) || (FrameLatch[CurrentLayer] != LCD_FRAMES_MAX))
+  {
+  }
+}
+
+/**
+  * @brief  Moves to the frames latched at the vertical blanking, to be
+  *         called from the LTDC interrupt handler.
+  * @param  None
+  * @retval None
+  */
+void LCD_FrameIRQHandler(void)
+{
+  uint32_t layer;
+  
+  if (LTDC_GetITStatus(LTDC_IT_RR) != RESET)
+  {
+    LTDC_ClearITPendingBit(LTDC_IT_RR);
+    
+    /* An immediate reload asked elsewhere may come first */
+    if ((LTDC->SRCR & LTDC_SRCR_VBR) != 0)
+    {
+      return;
+    }
+    
+    for (layer = 0; layer < 2; layer++)
+    {
+      if (FrameLatch[layer] != LCD_FRAMES_MAX)
+      {
+        FrameFront[layer] = FrameLatch[layer];
+        FrameLatch[layer] = LCD_FRAMES_MAX;
+        if (FrameQueued[layer] != 0)
+        {
+          LCD_FrameLatch(layer);
+        }
+      }
+    }
+  }
+}
+
 /**
   * @brief  Sets the LCD Text and Background colors.
   * @param  TextColor: specifies the Text Color.
@@ -521,6 +778,11 @@ sFONT *LCD_GetFont(void)
   */
 void LCD_ClearLine(uint16_t Line)
 {
+#ifdef LCD_USE_DMA2D
+  /* One fill with the background color instead of a line of spaces */
+  LCD_DMA2D_Fill(CurrentFrameBuffer + 2*(LCD_PIXEL_WIDTH*Line), LCD_PIXEL_WIDTH,
+                 LCD_Currentfonts->Height, CurrentBackColor);
+#else
   uint16_t refcolumn = 0;
   /* Send the string character by character on lCD */
   while ((refcolumn < LCD_PIXEL_WIDTH) && (((refcolumn + LCD_Currentfonts->Width)& 0xFFFF) >= LCD_Currentfonts->Width))
@@ -530,6 +792,7 @@ void LCD_ClearLine(uint16_t Line)
     /* Decrement the column position by 16 */
     refcolumn += LCD_Currentfonts->Width;
   }
+#endif /* LCD_USE_DMA2D */
 }
 
 /**
@@ -539,6 +802,9 @@ void LCD_ClearLine(uint16_t Line)
   */
 void LCD_Clear(uint16_t Color)
 {
+#ifdef LCD_USE_DMA2D
+  LCD_DMA2D_Fill(CurrentFrameBuffer, LCD_PIXEL_WIDTH, LCD_PIXEL_HEIGHT, Color);
+#else
   uint32_t index = 0;
   
   /* erase memory */
@@ -546,6 +812,7 @@ void LCD_Clear(uint16_t Color)
   {
     *(__IO uint16_t*)(CurrentFrameBuffer + (2*index)) = Color;
   } 
+#endif /* LCD_USE_DMA2D */
 }
 
 /**
@@ -622,6 +889,24 @@ void LCD_DrawChar(uint16_t Xpos, uint16_t Ypos, const uint16_t *c)
   uint32_t index = 0, counter = 0, xpos =0;
   uint32_t  Xaddress = 0;
   
+#ifdef LCD_USE_DMA2D
+  /* Glyphs of the font table are blended from the atlas */
+  index = c - LCD_Currentfonts->table;
+  if ((c >= LCD_Currentfonts->table) && ((index % LCD_Currentfonts->Height) == 0) &&
+      ((index / LCD_Currentfonts->Height) < LCD_FONT_GLYPHS))
+  {
+    Xaddress = LCD_GetFontAtlas();
+    if (Xaddress != 0)
+    {
+      LCD_DMA2D_Glyph(Xaddress + index * LCD_Currentfonts->Width,
+                      CurrentFrameBuffer + 2*(Xpos*LCD_PIXEL_WIDTH + Ypos),
+                      LCD_Currentfonts->Width, LCD_Currentfonts->Height);
+      return;
+    }
+    Xaddress = 0;
+  }
+#endif /* LCD_USE_DMA2D */
+
   xpos = Xpos*LCD_PIXEL_WIDTH*2;
   Xaddress += Ypos;
   
@@ -631,8 +916,7 @@ void LCD_DrawChar(uint16_t Xpos, uint16_t Ypos, const uint16_t *c)
     for(counter = 0; counter < LCD_Currentfonts->Width; counter++)
     {
           
-      if((((c[index] & ((0x80 << ((LCD_Currentfonts->Width / 12 ) * 8 ) ) >> counter)) == 0x00) &&(LCD_Currentfonts->Width <= 12))||
-        (((c[index] & (0x1 << counter)) == 0x00)&&(LCD_Currentfonts->Width > 12 )))
+      if(LCD_GlyphPixel(c[index], counter) == 0x00)
       {
           /* Write data value to all SDRAM memory */
          *(__IO uint16_t*) (CurrentFrameBuffer + (2*Xaddress) + xpos) = CurrentBackColor;
@@ -1001,6 +1285,14 @@ void LCD_WriteBMP(uint32_t BmpAddress)
   /* Read bit/pixel */
   bit_pixel = *(uint16_t *) (BmpAddress + 28);  
  
+#ifdef LCD_USE_DMA2D
+  /* Rows are converted to RGB565 by the DMA2D while copied */
+  LCD_BMPStreamInit(width, (int32_t)height, bit_pixel);
+  LCD_BMPStreamRows(BmpAddress + index, ((int32_t)height < 0) ? (uint32_t)-(int32_t)height : height);
+  LCD_BMPStreamWait();
+  return;
+#endif /* LCD_USE_DMA2D */
+  
   if (CurrentLayer == LCD_BACKGROUND_LAYER)
   {
     /* reconfigure layer size in accordance with the picture */
@@ -1079,49 +1371,293 @@ void LCD_WriteBMP(uint32_t BmpAddress)
 }
 
 /**
-  * @brief  Displays a full rectangle.
-  * @param  Xpos: specifies the X position, can be a value from 0 to 240.
-  * @param  Ypos: specifies the Y position, can be a value from 0 to 320.
-  * @param  Height: rectangle height.
-  * @param  Width: rectangle width.
+  * @brief  Displays a RGB565 picture stored line after line.
+  * @param  Xpos: picture X position (column).
+  * @param  Ypos: picture Y position (line).
+  * @param  Width: picture width.
+  * @param  Height: picture height.
+  * @param  Address: picture address.
   * @retval None
   */
-void LCD_DrawFullRect(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height)
+void LCD_DrawRGB565(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height, uint32_t Address)
 {
+  uint32_t  Xaddress = 0;
+#ifdef LCD_USE_DMA2D
   DMA2D_InitTypeDef      DMA2D_InitStruct;
-  
-  uint32_t  Xaddress = 0; 
-  uint16_t Red_Value = 0, Green_Value = 0, Blue_Value = 0;
- 
-  Red_Value = (0xF800 & CurrentTextColor) >> 11;
-  Blue_Value = 0x001F & CurrentTextColor;
-  Green_Value = (0x07E0 & CurrentTextColor) >> 5;
+  DMA2D_FG_InitTypeDef   DMA2D_FG_InitStruct;
+#else
+  uint32_t index = 0, counter = 0;
+#endif /* LCD_USE_DMA2D */
   
   Xaddress = CurrentFrameBuffer + 2*(LCD_PIXEL_WIDTH*Ypos + Xpos);
   
-  /* configure DMA2D */
+#ifdef LCD_USE_DMA2D
+  LCD_DMA2D_Wait();
   DMA2D_DeInit();
-  DMA2D_InitStruct.DMA2D_Mode = DMA2D_R2M;       
-  DMA2D_InitStruct.DMA2D_CMode = DMA2D_RGB565;      
-  DMA2D_InitStruct.DMA2D_OutputGreen = Green_Value;      
-  DMA2D_InitStruct.DMA2D_OutputBlue = Blue_Value;     
-  DMA2D_InitStruct.DMA2D_OutputRed = Red_Value;                
-  DMA2D_InitStruct.DMA2D_OutputAlpha = 0x0F;                  
-  DMA2D_InitStruct.DMA2D_OutputMemoryAdd = Xaddress;                
-  DMA2D_InitStruct.DMA2D_OutputOffset = (LCD_PIXEL_WIDTH - Width);                
-  DMA2D_InitStruct.DMA2D_NumberOfLine = Height;            
+  DMA2D_StructInit(&DMA2D_InitStruct);
+  DMA2D_InitStruct.DMA2D_Mode = DMA2D_M2M;
+  DMA2D_InitStruct.DMA2D_CMode = DMA2D_RGB565;
+  DMA2D_InitStruct.DMA2D_OutputMemoryAdd = Xaddress;
+  DMA2D_InitStruct.DMA2D_OutputOffset = (LCD_PIXEL_WIDTH - Width);
+  DMA2D_InitStruct.DMA2D_NumberOfLine = Height;
   DMA2D_InitStruct.DMA2D_PixelPerLine = Width;
-  DMA2D_Init(&DMA2D_InitStruct); 
+  DMA2D_Init(&DMA2D_InitStruct);
+  
+  DMA2D_FG_StructInit(&DMA2D_FG_InitStruct);
+  DMA2D_FG_InitStruct.DMA2D_FGMA = Address;
+  DMA2D_FG_InitStruct.DMA2D_FGCM = CM_RGB565;
+  DMA2D_FGConfig(&DMA2D_FG_InitStruct);
   
-  /* Start Transfer */ 
   DMA2D_StartTransfer();
+  LCD_DMA2D_Wait();
+#else
+  for (index = 0; index < Height; index++)
+  {
+    for (counter = 0; counter < Width; counter++)
+    {
+      *(__IO uint16_t*)(Xaddress + 2*counter) = *(__IO uint16_t*)Address;
+      Address += 2;
+    }
+    Xaddress += 2*LCD_PIXEL_WIDTH;
+  }
+#endif /* LCD_USE_DMA2D */
+}
+
+/**
+  * @brief  Copies full width lines of the screen to other lines.
+  * @note   The DMA2D reads ahead of its writes: it only moves lines up, the
+  *         CPU copies the others.
+  * @param  SrcLine: first line copied.
+  * @param  DstLine: where it goes.
+  * @param  NbLines: number of lines.
+  * @retval None
+  */
+void LCD_CopyLines(uint16_t SrcLine, uint16_t DstLine, uint16_t NbLines)
+{
+  uint32_t index = 0, size = 0;
+  uint32_t src = 0, dst = 0;
   
-  /* Wait for CTC Flag activation */
-  while(DMA2D_GetFlagStatus(DMA2D_FLAG_TC) == RESET)
+  if ((NbLines == 0) || (SrcLine == DstLine))
   {
-  } 
+    return;
+  }
+  src = CurrentFrameBuffer + 2*LCD_PIXEL_WIDTH*SrcLine;
+  dst = CurrentFrameBuffer + 2*LCD_PIXEL_WIDTH*DstLine;
+  size = 2*LCD_PIXEL_WIDTH*NbLines;
+  
+#ifdef LCD_USE_DMA2D
+  if (DstLine < SrcLine)
+  {
+    LCD_DMA2D_Copy(src, dst, NbLines);
+    return;
+  }
+  LCD_DMA2D_Wait();
+#endif /* LCD_USE_DMA2D */
+  
+  if (DstLine < SrcLine)
+  {
+    for (index = 0; index < size; index += 4)
+    {
+      *(__IO uint32_t*)(dst + index) = *(__IO uint32_t*)(src + index);
+    }
+  }
+  else
+  {
+    for (index = size; index > 0; index -= 4)
+    {
+      *(__IO uint32_t*)(dst + index - 4) = *(__IO uint32_t*)(src + index - 4);
+    }
+  }
+}
+
+#ifdef LCD_USE_DMA2D
+/**
+  * @brief  Prepares the current layer for a BMP picture written row by row
+  *         with LCD_BMPStreamRows.
+  * @note   The layer is resized to the picture and stays in RGB565: the rows
+  *         are converted while copied, so that text and fills can still be
+  *         drawn over the picture.
+  * @param  Width: picture width in pixels.
+  * @param  Height: picture height, negative for a top-down BMP.
+  * @param  BitPixel: 16, 24 or 32 bits per pixel.
+  * @retval None
+  */
+void LCD_BMPStreamInit(uint32_t Width, int32_t Height, uint32_t BitPixel)
+{
+  NVIC_InitTypeDef    NVIC_InitStructure;
+  uint32_t height;
+  
+  LCD_DMA2D_Wait();
+  
+  height = (Height < 0) ? -Height : Height;
+  LCD_SetLayerSize(Width, height);
+  
+  /* Rows are padded to a 32-bit boundary, and stored bottom up unless the
+     height is negative */
+  StreamWidth = Width;
+  StreamLineSize = ((Width * (BitPixel/8)) + 3) & ~3;
+  if (Height > 0)
+  {
+    StreamDst = CurrentFrameBuffer + 2*Width*(height - 1);
+    StreamPitch = -(int32_t)(2*Width);
+  }
+  else
+  {
+    StreamDst = CurrentFrameBuffer;
+    StreamPitch = 2*Width;
+  }
+  
+  if ((BitPixel/8) == 4)
+  {
+    StreamCM = CM_ARGB8888;
+  }
+  else if ((BitPixel/8) == 2)
+  {
+    StreamCM = CM_RGB565;
+  }
+  else
+  {
+    StreamCM = CM_RGB888;
+  }
+  
+  NVIC_InitStructure.NVIC_IRQChannel = DMA2D_IRQn;
+  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+  NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+  NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+  NVIC_Init(&NVIC_InitStructure);
+}
 
-  LCD_SetTextColor(CurrentTextColor);
+/**
+  * @brief  Starts the conversion of the next rows of the picture.
+  * @note   The DMA2D cannot walk the output upwards: each row is one pixel
+  *         format converting copy, the next one being started from the
+  *         transfer complete interrupt. The function returns at once, the
+  *         source must be kept until LCD_BMPStreamWait returns.
+  *         A 32 bpp source that is not 32-bit aligned is converted by the CPU.
+  * @param  Address: first row, in file order.
+  * @param  NbRows: number of rows.
+  * @retval None
+  */
+void LCD_BMPStreamRows(uint32_t Address, uint32_t NbRows)
+{
+  DMA2D_InitTypeDef      DMA2D_InitStruct;
+  DMA2D_FG_InitTypeDef   DMA2D_FG_InitStruct;
+  uint32_t counter;
+  uint8_t *pixel;
+  
+  LCD_DMA2D_Wait();
+  
+  if (NbRows == 0)
+  {
+    return;
+  }
+  
+  if ((StreamCM == CM_ARGB8888) && ((Address & 3) != 0))
+  {
+    while (NbRows-- > 0)
+    {
+      pixel = (uint8_t *)Address;
+      for (counter = 0; counter < StreamWidth; counter++, pixel += 4)
+      {
+        *(__IO uint16_t*)(StreamDst + 2*counter) = ((pixel[2] & 0xF8) << 8) |
+                                                    ((pixel[1] & 0xFC) << 3) |
+                                                    (pixel[0] >> 3);
+      }
+      Address += StreamLineSize;
+      StreamDst += StreamPitch;
+    }
+    return;
+  }
+  
+  StreamSrc = Address;
+  StreamRows = NbRows;
+  
+  DMA2D_DeInit();
+  DMA2D_StructInit(&DMA2D_InitStruct);
+  DMA2D_InitStruct.DMA2D_Mode = DMA2D_M2M_PFC;
+  DMA2D_InitStruct.DMA2D_CMode = DMA2D_RGB565;
+  DMA2D_InitStruct.DMA2D_OutputMemoryAdd = StreamDst;
+  DMA2D_InitStruct.DMA2D_OutputOffset = 0;
+  DMA2D_InitStruct.DMA2D_NumberOfLine = 1;
+  DMA2D_InitStruct.DMA2D_PixelPerLine = StreamWidth;
+  DMA2D_Init(&DMA2D_InitStruct);
+  
+  DMA2D_FG_StructInit(&DMA2D_FG_InitStruct);
+  DMA2D_FG_InitStruct.DMA2D_FGMA = StreamSrc;
+  DMA2D_FG_InitStruct.DMA2D_FGCM = StreamCM;
+  DMA2D_FGConfig(&DMA2D_FG_InitStruct);
+  
+  DMA2D_ITConfig(DMA2D_IT_TC, ENABLE);
+  DMA2D_StartTransfer();
+}
+
+/**
+  * @brief  Waits for the end of the rows started by LCD_BMPStreamRows.
+  * @param  None
+  * @retval None
+  */
+void LCD_BMPStreamWait(void)
+{
+  LCD_DMA2D_Wait();
+}
+
+/**
+  * @brief  Starts the next row of the picture, to be called from the DMA2D
+  *         interrupt handler.
+  * @param  None
+  * @retval None
+  */
+void LCD_BMPStreamIRQHandler(void)
+{
+  if (DMA2D_GetITStatus(DMA2D_IT_TC) != RESET)
+  {
+    DMA2D_ClearITPendingBit(DMA2D_IT_TC);
+    
+    if (StreamRows != 0)
+    {
+      StreamSrc += StreamLineSize;
+      StreamDst += StreamPitch;
+      if (--StreamRows != 0)
+      {
+        DMA2D->FGMAR = StreamSrc;
+        DMA2D->OMAR = StreamDst;
+        DMA2D->CR |= DMA2D_CR_START;
+      }
+    }
+  }
+}
+#endif /* LCD_USE_DMA2D */
+
+/**
+  * @brief  Displays a full rectangle.
+  * @param  Xpos: specifies the X position, can be a value from 0 to 240.
+  * @param  Ypos: specifies the Y position, can be a value from 0 to 320.
+  * @param  Height: rectangle height.
+  * @param  Width: rectangle width.
+  * @retval None
+  */
+void LCD_DrawFullRect(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height)
+{
+  uint32_t  Xaddress = 0; 
+  
+  Xaddress = CurrentFrameBuffer + 2*(LCD_PIXEL_WIDTH*Ypos + Xpos);
+  
+#ifdef LCD_USE_DMA2D
+  LCD_DMA2D_Fill(Xaddress, Width, Height, CurrentTextColor);
+#else
+  {
+    uint32_t index = 0, counter = 0;
+    
+    for (index = 0; index < Height; index++)
+    {
+      for (counter = 0; counter < Width; counter++)
+      {
+        *(__IO uint16_t*)(Xaddress + 2*counter) = CurrentTextColor;
+      }
+      Xaddress += 2*LCD_PIXEL_WIDTH;
+    }
+  }
+#endif /* LCD_USE_DMA2D */
 }
 
 /**
@@ -1914,6 +2450,271 @@ static void LCD_AF_GPIOConfig(void)
  
 }
 
+/**
+  * @brief  Tests one pixel of a glyph row of the current font.
+  * @param  Row: glyph row from the font table.
+  * @param  Column: pixel column in the glyph.
+  * @retval 0 for a background pixel.
+  */
+static uint32_t LCD_GlyphPixel(uint16_t Row, uint32_t Column)
+{
+  if (LCD_Currentfonts->Width <= 12)
+  {
+    /* Left aligned on 8 or 16 bits, MSB first */
+    return Row & ((0x80 << ((LCD_Currentfonts->Width / 12) * 8)) >> Column);
+  }
+  return Row & (0x1 << Column);
+}
+
+#ifdef LCD_USE_DMA2D
+/**
+  * @brief  Fills a rectangle of the frame buffer with a color.
+  * @param  Address: frame buffer address of the top left pixel.
+  * @param  Width: rectangle width.
+  * @param  Height: rectangle height.
+  * @param  Color: RGB565 color.
+  * @retval None
+  */
+static void LCD_DMA2D_Fill(uint32_t Address, uint16_t Width, uint16_t Height, uint16_t Color)
+{
+  DMA2D_InitTypeDef      DMA2D_InitStruct;
+  
+  LCD_DMA2D_Wait();
+  DMA2D_DeInit();
+  DMA2D_InitStruct.DMA2D_Mode = DMA2D_R2M;       
+  DMA2D_InitStruct.DMA2D_CMode = DMA2D_RGB565;      
+  DMA2D_InitStruct.DMA2D_OutputGreen = (0x07E0 & Color) >> 5;      
+  DMA2D_InitStruct.DMA2D_OutputBlue = 0x001F & Color;     
+  DMA2D_InitStruct.DMA2D_OutputRed = (0xF800 & Color) >> 11;                
+  DMA2D_InitStruct.DMA2D_OutputAlpha = 0x0F;                  
+  DMA2D_InitStruct.DMA2D_OutputMemoryAdd = Address;                
+  DMA2D_InitStruct.DMA2D_OutputOffset = (LCD_PIXEL_WIDTH - Width);                
+  DMA2D_InitStruct.DMA2D_NumberOfLine = Height;            
+  DMA2D_InitStruct.DMA2D_PixelPerLine = Width;
+  DMA2D_Init(&DMA2D_InitStruct); 
+  
+  DMA2D_StartTransfer();
+  LCD_DMA2D_Wait();
+}
+
+/**
+  * @brief  Draws a glyph of the atlas with the text color over the back color.
+  * @note   The glyph alpha blends the text color, given as the foreground
+  *         A8 color, with the back color. The background reads the same
+  *         glyph with its alpha replaced by 0xFF: the cell is opaque and no
+  *         frame buffer read is needed.
+  * @param  Glyph: atlas address of the glyph.
+  * @param  Address: frame buffer address of the top left pixel.
+  * @param  Width: glyph width.
+  * @param  Height: glyph height.
+  * @retval None
+  */
+static void LCD_DMA2D_Glyph(uint32_t Glyph, uint32_t Address, uint16_t Width, uint16_t Height)
+{
+  DMA2D_InitTypeDef      DMA2D_InitStruct;
+  DMA2D_FG_InitTypeDef   DMA2D_FG_InitStruct;
+  DMA2D_BG_InitTypeDef   DMA2D_BG_InitStruct;
+  
+  LCD_DMA2D_Wait();
+  DMA2D_DeInit();
+  DMA2D_StructInit(&DMA2D_InitStruct);
+  DMA2D_InitStruct.DMA2D_Mode = DMA2D_M2M_BLEND;
+  DMA2D_InitStruct.DMA2D_CMode = DMA2D_RGB565;
+  DMA2D_InitStruct.DMA2D_OutputMemoryAdd = Address;
+  DMA2D_InitStruct.DMA2D_OutputOffset = (LCD_PIXEL_WIDTH - Width);
+  DMA2D_InitStruct.DMA2D_NumberOfLine = Height;
+  DMA2D_InitStruct.DMA2D_PixelPerLine = Width;
+  DMA2D_Init(&DMA2D_InitStruct);
+  
+  DMA2D_FG_StructInit(&DMA2D_FG_InitStruct);
+  DMA2D_FG_InitStruct.DMA2D_FGMA = Glyph;
+  DMA2D_FG_InitStruct.DMA2D_FGCM = CM_A8;
+  DMA2D_FG_InitStruct.DMA2D_FGPFC_ALPHA_MODE = NO_MODIF_ALPHA_VALUE;
+  DMA2D_FG_InitStruct.DMA2D_FGC_RED = RGB565_RED8(CurrentTextColor);
+  DMA2D_FG_InitStruct.DMA2D_FGC_GREEN = RGB565_GREEN8(CurrentTextColor);
+  DMA2D_FG_InitStruct.DMA2D_FGC_BLUE = RGB565_BLUE8(CurrentTextColor);
+  DMA2D_FGConfig(&DMA2D_FG_InitStruct);
+  
+  DMA2D_BG_StructInit(&DMA2D_BG_InitStruct);
+  DMA2D_BG_InitStruct.DMA2D_BGMA = Glyph;
+  DMA2D_BG_InitStruct.DMA2D_BGCM = CM_A8;
+  DMA2D_BG_InitStruct.DMA2D_BGPFC_ALPHA_MODE = REPLACE_ALPHA_VALUE;
+  DMA2D_BG_InitStruct.DMA2D_BGPFC_ALPHA_VALUE = 0xFF;
+  DMA2D_BG_InitStruct.DMA2D_BGC_RED = RGB565_RED8(CurrentBackColor);
+  DMA2D_BG_InitStruct.DMA2D_BGC_GREEN = RGB565_GREEN8(CurrentBackColor);
+  DMA2D_BG_InitStruct.DMA2D_BGC_BLUE = RGB565_BLUE8(CurrentBackColor);
+  DMA2D_BGConfig(&DMA2D_BG_InitStruct);
+  
+  DMA2D_StartTransfer();
+  LCD_DMA2D_Wait();
+}
+
+/**
+  * @brief  Copies lines of RGB565 pixels with the DMA2D, the destination
+  *         being before the source when they overlap.
+  * @param  Src: first pixel copied.
+  * @param  Dst: where it goes.
+  * @param  NbLines: number of LCD_PIXEL_WIDTH pixel lines.
+  * @retval None
+  */
+static void LCD_DMA2D_Copy(uint32_t Src, uint32_t Dst, uint16_t NbLines)
+{
+  DMA2D_InitTypeDef      DMA2D_InitStruct;
+  DMA2D_FG_InitTypeDef   DMA2D_FG_InitStruct;
+  
+  LCD_DMA2D_Wait();
+  DMA2D_DeInit();
+  DMA2D_StructInit(&DMA2D_InitStruct);
+  DMA2D_InitStruct.DMA2D_Mode = DMA2D_M2M;
+  DMA2D_InitStruct.DMA2D_CMode = DMA2D_RGB565;
+  DMA2D_InitStruct.DMA2D_OutputMemoryAdd = Dst;
+  DMA2D_InitStruct.DMA2D_OutputOffset = 0;
+  DMA2D_InitStruct.DMA2D_NumberOfLine = NbLines;
+  DMA2D_InitStruct.DMA2D_PixelPerLine = LCD_PIXEL_WIDTH;
+  DMA2D_Init(&DMA2D_InitStruct);
+  
+  DMA2D_FG_StructInit(&DMA2D_FG_InitStruct);
+  DMA2D_FG_InitStruct.DMA2D_FGMA = Src;
+  DMA2D_FG_InitStruct.DMA2D_FGCM = CM_RGB565;
+  DMA2D_FGConfig(&DMA2D_FG_InitStruct);
+  
+  DMA2D_StartTransfer();
+  LCD_DMA2D_Wait();
+}
+
+/**
+  * @brief  Waits for the end of the DMA2D transfers in progress, if any.
+  * @param  None
+  * @retval None
+  */
+static void LCD_DMA2D_Wait(void)
+{
+  /* Rows of a picture may still be chained by the interrupt */
+  while ((StreamRows != 0) || ((DMA2D->CR & DMA2D_CR_START) != 0))
+  {
+  }
+}
+
+/**
+  * @brief  Returns the atlas of the current font, expanding it to A8 on its
+  *         first use.
+  * @param  None
+  * @retval Atlas address of the ' ' glyph, 0 if the atlas is full.
+  */
+static uint32_t LCD_GetFontAtlas(void)
+{
+  uint8_t *atlas;
+  uint32_t slot, index, counter, size;
+  
+  for (slot = 0; slot < LCD_FONT_ATLAS_SLOTS; slot++)
+  {
+    if (AtlasFont[slot] == LCD_Currentfonts)
+    {
+      return AtlasAddress[slot];
+    }
+    if (AtlasFont[slot] == 0)
+    {
+      break;
+    }
+  }
+  
+  size = LCD_FONT_GLYPHS * LCD_Currentfonts->Height * LCD_Currentfonts->Width;
+  if ((slot == LCD_FONT_ATLAS_SLOTS) || (AtlasFree + size > LCD_FONT_ATLAS + LCD_FONT_ATLAS_SIZE))
+  {
+    return 0;
+  }
+  
+  /* Glyph rows one after the other: a glyph is a Width x Height A8 block */
+  atlas = (uint8_t *)AtlasFree;
+  for (index = 0; index < LCD_FONT_GLYPHS * LCD_Currentfonts->Height; index++)
+  {
+    for (counter = 0; counter < LCD_Currentfonts->Width; counter++)
+    {
+      *atlas++ = (LCD_GlyphPixel(LCD_Currentfonts->table[index], counter) != 0) ? 0xFF : 0x00;
+    }
+  }
+  
+  AtlasFont[slot] = LCD_Currentfonts;
+  AtlasAddress[slot] = AtlasFree;
+  AtlasFree += size;
+  
+  return AtlasAddress[slot];
+}
+#endif /* LCD_USE_DMA2D */
+
+/**
+  * @brief  Programs the oldest frame queued on a layer, to be shown from the
+  *         next vertical blanking.
+  * @note   Called with the LTDC interrupt masked, or from its handler.
+  * @param  Layerx: LCD_BACKGROUND_LAYER or LCD_FOREGROUND_LAYER.
+  * @retval None
+  */
+static void LCD_FrameLatch(uint32_t Layerx)
+{
+  uint32_t index;
+  
+  FrameLatch[Layerx] = FrameQueue[Layerx][0];
+  FrameQueued[Layerx]--;
+  for (index = 0; index < FrameQueued[Layerx]; index++)
+  {
+    FrameQueue[Layerx][index] = FrameQueue[Layerx][index + 1];
+  }
+  
+  LTDC_LayerAddress((Layerx == LCD_BACKGROUND_LAYER) ? LTDC_Layer1 : LTDC_Layer2,
+                    FrameAddress[Layerx][FrameLatch[Layerx]]);
+  LTDC_ReloadConfig(LTDC_VBReload);
+}
+
+/**
+  * @brief  Looks for a frame neither shown, latched nor queued.
+  * @param  Layerx: LCD_BACKGROUND_LAYER or LCD_FOREGROUND_LAYER.
+  * @retval Frame index, LCD_FRAMES_MAX if none.
+  */
+static uint32_t LCD_FrameFree(uint32_t Layerx)
+{
+  uint32_t frame, index, free = LCD_FRAMES_MAX;
+  
+  NVIC_DisableIRQ(LTDC_IRQn);
+  for (frame = 0; (frame < FrameCount[Layerx]) && (free == LCD_FRAMES_MAX); frame++)
+  {
+    free = frame;
+    if ((frame == FrameFront[Layerx]) || (frame == FrameLatch[Layerx]))
+    {
+      free = LCD_FRAMES_MAX;
+    }
+    for (index = 0; index < FrameQueued[Layerx]; index++)
+    {
+      if (frame == FrameQueue[Layerx][index])
+      {
+        free = LCD_FRAMES_MAX;
+      }
+    }
+  }
+  NVIC_EnableIRQ(LTDC_IRQn);
+  
+  return free;
+}
+
+/**
+  * @brief  Copies a whole frame.
+  * @param  Src: frame copied.
+  * @param  Dst: frame written.
+  * @retval None
+  */
+static void LCD_FrameCopy(uint32_t Src, uint32_t Dst)
+{
+#ifdef LCD_USE_DMA2D
+  LCD_DMA2D_Copy(Src, Dst, LCD_PIXEL_HEIGHT);
+#else
+  uint32_t index;
+  
+  for (index = 0; index < LCD_FRAME_SIZE; index += 4)
+  {
+    *(__IO uint32_t*)(Dst + index) = *(__IO uint32_t*)(Src + index);
+  }
+#endif /* LCD_USE_DMA2D */
+}
+
 /**
   * @brief  Displays a pixel.
   * @param  x: pixel x.
@@ -242,6 +242,38 @@ typedef struct
 #define LCD_BACKGROUND_LAYER     0x0000
 #define LCD_FOREGROUND_LAYER     0x0001
 
+/**
+  * @}
+  */ 
+
+/** 
+  * @brief  LCD rendering backend: comment the line below to draw the text,
+  *         the fills and the bitmaps with the CPU instead of the DMA2D
+  */ 
+#define LCD_USE_DMA2D
+
+/** 
+  * @brief  Glyphs of the fonts used, expanded to one alpha byte (A8) per pixel
+  *         for the DMA2D blending, in the last MB of the SDRAM
+  */ 
+#define LCD_FONT_ATLAS           ((uint32_t)0xD0700000)
+#define LCD_FONT_ATLAS_SIZE      ((uint32_t)0x00100000)
+#define LCD_FONT_ATLAS_SLOTS     4
+#define LCD_FONT_GLYPHS          95   /* ' ' to '~' */
+
+/** 
+  * @brief  Page flipping, see LCD_FrameConfig: the frames of a layer are its
+  *         frame buffer and frames of the pool, placed after the foreground
+  *         frame buffer
+  */ 
+#define LCD_FRAME_SIZE           ((uint32_t)(LCD_PIXEL_WIDTH * LCD_PIXEL_HEIGHT * 2))
+#define LCD_FRAME_POOL           (LCD_FRAME_BUFFER + 2 * BUFFER_OFFSET)
+#define LCD_FRAME_POOL_NBR       2
+#define LCD_FRAMES_MAX           3   /* Frames of one layer */
+
+#define LCD_FRAME_DISCARD        0   /* The next frame is drawn entirely */
+#define LCD_FRAME_PRESERVE       1   /* The next frame is drawn over the one queued */
+
 /**
   * @}
   */ 
@@ -263,6 +295,12 @@ void     LCD_Init(void);
 void     LCD_LayerInit(void);
 void     LCD_ChipSelect(FunctionalState NewState);
 void     LCD_SetLayer(uint32_t Layerx);
+void     LCD_SetLayerSize(uint16_t Width, uint16_t Height);
+uint32_t LCD_FrameConfig(uint32_t NbFrames);
+void     LCD_FrameQueue(uint32_t Preserve);
+uint32_t LCD_FrameReady(void);
+void     LCD_FrameWait(void);
+void     LCD_FrameIRQHandler(void);
 void     LCD_SetColors(uint16_t _TextColor, uint16_t _BackColor); 
 void     LCD_GetColors(uint16_t *_TextColor, uint16_t *_BackColor);
 void     LCD_SetTextColor(uint16_t Color);
@@ -287,6 +325,14 @@ void     LCD_DrawEllipse(int Xpos, int Ypos, int Radius, int Radius2);
 void     LCD_DrawFullEllipse(int Xpos, int Ypos, int Radius, int Radius2);
 void     LCD_DrawMonoPict(const uint32_t *Pict);
 void     LCD_WriteBMP(uint32_t BmpAddress);
+void     LCD_DrawRGB565(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height, uint32_t Address);
+void     LCD_CopyLines(uint16_t SrcLine, uint16_t DstLine, uint16_t NbLines);
+#ifdef LCD_USE_DMA2D
+void     LCD_BMPStreamInit(uint32_t Width, int32_t Height, uint32_t BitPixel);
+void     LCD_BMPStreamRows(uint32_t Address, uint32_t NbRows);
+void     LCD_BMPStreamWait(void);
+void     LCD_BMPStreamIRQHandler(void);
+#endif /* LCD_USE_DMA2D */
 void     LCD_DrawUniLine(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2);
 void     LCD_DrawFullRect(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height);
 void     LCD_DrawFullCircle(uint16_t Xpos, uint16_t Ypos, uint16_t Radius);
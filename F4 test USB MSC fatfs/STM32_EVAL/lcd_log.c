@@ -38,6 +38,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include  "lcd_log.h"
+#include  <string.h>
 
 /** @addtogroup Utilities
   * @{
@@ -100,6 +101,14 @@ FunctionalState LCD_Lock;
 FunctionalState LCD_Scrolled;
 uint16_t LCD_ScrollBackStep;
 
+#ifdef LCD_LOG_INCREMENTAL
+/* What the text zone shows, and the view waiting to be drawn */
+static LCD_LOG_line LCD_ScreenBuffer [YWINDOW_SIZE];
+static FunctionalState LCD_Pending;
+static uint16_t LCD_PendingBottom;
+static uint16_t LCD_PendingTop;
+#endif
+
 /**
 * @}
 */ 
@@ -109,6 +118,11 @@ uint16_t LCD_ScrollBackStep;
 * @{
 */ 
 static void LCD_LOG_UpdateDisplay (void);
+static void LCD_LOG_DrawWindow (uint16_t bottom, uint16_t top);
+#ifdef LCD_LOG_INCREMENTAL
+static void LCD_LOG_DrawView (LCD_LOG_line **view);
+static void LCD_LOG_ResetScreen (void);
+#endif
 /**
 * @}
 */ 
@@ -131,6 +145,10 @@ void LCD_LOG_Init ( void)
   LCD_LOG_DeInit();
   /* Clear the LCD */
   LCD_Clear(Black);  
+#ifdef LCD_LOG_INCREMENTAL
+  /* Line flag raised once per frame, see LCD_LOG_UpdateDisplay */
+  LTDC_LIPConfig(LCD_PIXEL_HEIGHT);
+#endif
 }
 
 /**
@@ -153,6 +171,10 @@ void LCD_LOG_DeInit(void)
   LCD_Lock = DISABLE;
   LCD_Scrolled = DISABLE;
   LCD_ScrollBackStep = 0;
+#ifdef LCD_LOG_INCREMENTAL
+  LCD_Pending = DISABLE;
+  LCD_LOG_ResetScreen();
+#endif
 }
 
 /**
@@ -188,6 +210,9 @@ void LCD_LOG_SetHeader (uint8_t *Title)
   
   /* Clear the LCD */
   LCD_Clear(Black);
+#ifdef LCD_LOG_INCREMENTAL
+  LCD_LOG_ResetScreen();
+#endif
     
   /* Set the LCD Font */
   LCD_SetFont (&Font12x12);
@@ -322,37 +347,89 @@ PUTCHAR_PROTOTYPE
   return ch;
 }
   
+/**
+* @brief  Draws the lines logged since the last frame, if any 
+* @param  None
+* @retval None
+*/
+void LCD_LOG_Flush(void)
+{
+#ifdef LCD_LOG_INCREMENTAL
+  if(LCD_Pending == ENABLE)
+  {
+    LCD_Pending = DISABLE;
+    LTDC_ClearFlag(LTDC_FLAG_LI);
+    LCD_LOG_DrawWindow(LCD_PendingBottom, LCD_PendingTop);
+  }
+#endif
+}
+
 /**
 * @brief  Update the text area display
 * @param  None
 * @retval None
 */
 static void LCD_LOG_UpdateDisplay (void)
+{
+#ifdef LCD_LOG_INCREMENTAL
+  /* At most one drawing per frame: the lines logged in between are drawn
+     together at the next frame, or by LCD_LOG_Flush */
+  LCD_PendingBottom = LCD_CacheBuffer_yptr_bottom;
+  LCD_PendingTop = LCD_CacheBuffer_yptr_top;
+  LCD_Pending = ENABLE;
+  
+  if(LTDC_GetFlagStatus(LTDC_FLAG_LI) != RESET)
+  {
+    LCD_LOG_Flush();
+  }
+#else
+  LCD_LOG_DrawWindow(LCD_CacheBuffer_yptr_bottom, LCD_CacheBuffer_yptr_top);
+#endif
+}
+
+/**
+* @brief  Draw the text area
+* @param  bottom: cache line shown at the bottom
+* @param  top: oldest cache line
+* @retval None
+*/
+static void LCD_LOG_DrawWindow (uint16_t bottom, uint16_t top)
 {
   uint8_t cnt = 0 ;
   uint16_t length = 0 ;
   uint16_t ptr = 0, index = 0;
+#ifdef LCD_LOG_INCREMENTAL
+  LCD_LOG_line *view[YWINDOW_SIZE];
+#endif
   
   sFONT *cFont = LCD_GetFont();
   
-  if((LCD_CacheBuffer_yptr_bottom  < (YWINDOW_SIZE -1)) && 
-     (LCD_CacheBuffer_yptr_bottom  >= LCD_CacheBuffer_yptr_top))
+  if((bottom  < (YWINDOW_SIZE -1)) && 
+     (bottom  >= top))
   {
-    LCD_SetTextColor(LCD_CacheBuffer[cnt + LCD_CacheBuffer_yptr_bottom].color);
-    LCD_DisplayStringLine ((YWINDOW_MIN + LCD_CacheBuffer_yptr_bottom) * cFont->Height,
-                           (uint8_t *)(LCD_CacheBuffer[cnt + LCD_CacheBuffer_yptr_bottom].line));
+#ifdef LCD_LOG_INCREMENTAL
+    /* Window not full yet: the lines are shown from the top */
+    for  (cnt = 0 ; cnt < YWINDOW_SIZE ; cnt ++)
+    {
+      view[cnt] = (cnt <= bottom) ? &LCD_CacheBuffer[cnt] : 0;
+    }
+#else
+    LCD_SetTextColor(LCD_CacheBuffer[cnt + bottom].color);
+    LCD_DisplayStringLine ((YWINDOW_MIN + bottom) * cFont->Height,
+                           (uint8_t *)(LCD_CacheBuffer[cnt + bottom].line));
+#endif
   }
   else
   {
     
-    if(LCD_CacheBuffer_yptr_bottom < LCD_CacheBuffer_yptr_top)
+    if(bottom < top)
     {
       /* Virtual length for rolling */
-      length = LCD_CACHE_DEPTH + LCD_CacheBuffer_yptr_bottom ;
+      length = LCD_CACHE_DEPTH + bottom ;
     }
     else
     {
-      length = LCD_CacheBuffer_yptr_bottom;
+      length = bottom;
     }
     
     ptr = length - YWINDOW_SIZE + 1;
@@ -362,14 +439,135 @@ static void LCD_LOG_UpdateDisplay (void)
       
       index = (cnt + ptr )% LCD_CACHE_DEPTH ;
       
+#ifdef LCD_LOG_INCREMENTAL
+      view[cnt] = &LCD_CacheBuffer[index];
+#else
       LCD_SetTextColor(LCD_CacheBuffer[index].color);
       LCD_DisplayStringLine ((cnt + YWINDOW_MIN) * cFont->Height, 
                              (uint8_t *)(LCD_CacheBuffer[index].line));
+#endif
+      
+    }
+  }
+  
+#ifdef LCD_LOG_INCREMENTAL
+  (void)cFont;
+  LCD_LOG_DrawView(view);
+#endif
+}
+
+#ifdef LCD_LOG_INCREMENTAL
+/**
+* @brief  Draw the characters of the text area that changed
+* @note   A view scrolled up is first moved on the screen as a whole, then
+*         only the characters that differ from the screen are drawn.
+* @param  view: cache line of each text area line, 0 to keep a line
+* @retval None
+*/
+static void LCD_LOG_DrawView (LCD_LOG_line **view)
+{
+  sFONT *cFont = LCD_GetFont();
+  uint16_t cols = LCD_PIXEL_WIDTH / cFont->Width;
+  uint16_t line;
+  uint8_t row, col, shift, changed = 0, ch;
+  FunctionalState recolor;
+  
+  if(cols > XWINDOW_MAX)
+  {
+    cols = XWINDOW_MAX;
+  }
+  
+  for (row = 0 ; row < YWINDOW_SIZE ; row ++)
+  {
+    if((view[row] != 0) && 
+       ((view[row]->color != LCD_ScreenBuffer[row].color) ||
+        (memcmp(view[row]->line, LCD_ScreenBuffer[row].line, cols) != 0)))
+    {
+      changed++;
+    }
+  }
+  
+  /* Look for the smallest scroll that explains the view */
+  for (shift = 1 ; (changed > 1) && (shift < YWINDOW_SIZE) ; shift ++)
+  {
+    for (row = 0 ; row + shift < YWINDOW_SIZE ; row ++)
+    {
+      if((view[row] == 0) ||
+         (view[row]->color != LCD_ScreenBuffer[row + shift].color) ||
+         (memcmp(view[row]->line, LCD_ScreenBuffer[row + shift].line, cols) != 0))
+      {
+        break;
+      }
+    }
+    
+    if(row + shift == YWINDOW_SIZE)
+    {
+      LCD_CopyLines((YWINDOW_MIN + shift) * cFont->Height, YWINDOW_MIN * cFont->Height,
+                    (YWINDOW_SIZE - shift) * cFont->Height);
+      for (row = 0 ; row + shift < YWINDOW_SIZE ; row ++)
+      {
+        LCD_ScreenBuffer[row] = LCD_ScreenBuffer[row + shift];
+      }
+      break;
+    }
+  }
+  
+  for (row = 0 ; row < YWINDOW_SIZE ; row ++)
+  {
+    if(view[row] == 0)
+    {
+      continue;
+    }
+    
+    line = (YWINDOW_MIN + row) * cFont->Height;
+    recolor = (view[row]->color != LCD_ScreenBuffer[row].color) ? ENABLE : DISABLE;
+    LCD_SetTextColor(view[row]->color);
+    
+    for (col = 0 ; col < cols ; col ++)
+    {
+      ch = view[row]->line[col];
+      if(ch == 0)
+      {
+        /* End of a line never completed, not drawn as LCD_DisplayStringLine */
+        break;
+      }
       
+      /* A space is drawn in the back color only */
+      if((ch != LCD_ScreenBuffer[row].line[col]) || ((recolor == ENABLE) && (ch != ' ')))
+      {
+        LCD_DisplayChar(line, col * cFont->Width, ch);
+        LCD_ScreenBuffer[row].line[col] = ch;
+      }
+    }
+    
+    /* Characters left in the previous color are unknown from now on */
+    for (; (recolor == ENABLE) && (col < cols) ; col ++)
+    {
+      if(LCD_ScreenBuffer[row].line[col] != ' ')
+      {
+        LCD_ScreenBuffer[row].line[col] = 0xFF;
+      }
     }
+    LCD_ScreenBuffer[row].color = view[row]->color;
   }
+}
+
+/**
+* @brief  Mark the text area as blank
+* @param  None
+* @retval None
+*/
+static void LCD_LOG_ResetScreen (void)
+{
+  uint8_t row;
   
+  for (row = 0 ; row < YWINDOW_SIZE ; row ++)
+  {
+    memset(LCD_ScreenBuffer[row].line, ' ', XWINDOW_MAX);
+    LCD_ScreenBuffer[row].color = LCD_LOG_DEFAULT_COLOR;
+  }
 }
+#endif /* LCD_LOG_INCREMENTAL */
 
 #ifdef LCD_SCROLL_ENABLED
 /**
@@ -70,6 +70,10 @@
 
 #ifdef LCD_SCROLL_ENABLED
  #define     LCD_CACHE_DEPTH     (YWINDOW_SIZE + CACHE_SIZE)
+#elif defined(LCD_LOG_INCREMENTAL)
+ /* One more line: the line being written does not overwrite a line still
+    to be drawn */
+ #define     LCD_CACHE_DEPTH     (YWINDOW_SIZE + 1)
 #else
  #define     LCD_CACHE_DEPTH     YWINDOW_SIZE
 #endif
@@ -126,6 +130,7 @@ void LCD_LOG_DeInit(void);
 void LCD_LOG_SetHeader(uint8_t *Title);
 void LCD_LOG_SetFooter(uint8_t *Status);
 void LCD_LOG_ClearTextZone(void);
+void LCD_LOG_Flush(void);
 #ifdef LCD_SCROLL_ENABLED
  ErrorStatus LCD_LOG_ScrollBack(void);
  ErrorStatus LCD_LOG_ScrollForward(void);
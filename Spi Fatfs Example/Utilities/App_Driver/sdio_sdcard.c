@@ -1,10 +1,16 @@
 /* Includes ------------------------------------------------------------------*/ 
+#include "ffconf.h"
+
+/* Built only when the SD card is configured as a FatFs drive (ffconf.h): the
+   driver is for devices with an SDIO peripheral */
+#ifdef USE_SDIO_SD
+
 #include "sdio_sdcard.h"
+#include <string.h>
  
 /** 
   * @brief  SDIO Static flags, TimeOut, FIFO Address  
   */
-#define NULL 0
 #define SDIO_STATIC_FLAGS               ((uint32_t)0x000005FF)
 #define SDIO_CMD0TIMEOUT                ((uint32_t)0x00010000)
 
@@ -88,6 +94,13 @@
 
 #define SDIO_SEND_IF_COND               ((uint32_t)0x00000008)
 
+/** 
+  * @brief  Request states, see SD_StartRead, SD_StartWrite and SD_CheckRequest
+  */
+#define SD_REQ_IDLE                     ((uint32_t)0x00000000)
+#define SD_REQ_TRANSFER                 ((uint32_t)0x00000001)
+#define SD_REQ_PROGRAMMING              ((uint32_t)0x00000002)
+
 static uint32_t CardType =  SDIO_STD_CAPACITY_SD_CARD_V1_1;
 static uint32_t CSD_Tab[4], CID_Tab[4], RCA = 0;
 static uint32_t DeviceMode = SD_POLLING_MODE;
@@ -96,6 +109,9 @@ uint32_t *SrcBuffer, *DestBuffer;
 __IO SD_Error TransferError = SD_OK;
 __IO uint32_t TransferEnd = 0;
 __IO uint32_t NumberOfBytes = 0;
+static __IO uint32_t RequestState = SD_REQ_IDLE;
+static uint32_t RequestDir = SDIO_TransferDir_ToSDIO;
+static SD_Error RequestError = SD_OK;
 extern SD_CardInfo SDCardInfo;
 SDIO_InitTypeDef SDIO_InitStructure;
 SDIO_CmdInitTypeDef SDIO_CmdInitStructure;
@@ -111,6 +127,16 @@ static SD_Error SDEnWideBus(FunctionalState NewState);
 static SD_Error IsCardProgramming(uint8_t *pstatus);
 static SD_Error FindSCR(uint16_t rca, uint32_t *pscr);
 static uint8_t convert_from_bytes_to_power_of_two(uint16_t NumberOfBytes);
+static SD_Error SD_StartTransfer(uint32_t *buff, uint32_t BlockAddr, uint32_t NumberOfBlocks, uint32_t TransferDir);
+static SD_Error SD_StartFlush(void);
+
+/*!< Write aggregation: consecutive blocks are gathered in SD_WrBuffer and
+     written with one pre-erased multi-block write. One buffer is filled while
+     the other one is being written. */
+static uint32_t SD_WrBuffer[2][SD_WRBUF_BLOCKS * 512 / 4];
+static uint32_t SD_WrBufIdx = 0;
+static uint32_t SD_WrBlockAddr = 0;
+static uint32_t SD_WrBlockNbr = 0;
   
 /**
   * @}
@@ -353,6 +379,12 @@ SDTransferState SD_GetStatus(void)
 {
   SDCardState cardstate =  SD_CARD_TRANSFER;
 
+  /*!< No command while a started request moves data */
+  if (RequestState == SD_REQ_TRANSFER)
+  {
+    return(SD_TRANSFER_BUSY);
+  }
+
   cardstate = SD_GetState();
   
   if (cardstate == SD_CARD_TRANSFER)
@@ -986,7 +1018,7 @@ SD_Error SD_SelectDeselect(uint32_t addr)
   * @param  BlockSize: the SD card Data block size.
   * @retval SD_Error: SD Card Error code.
   */
-SD_Error SD_ReadBlock(uint32_t *readbuff, uint32_t ReadAddr, uint16_t BlockSize)
+SD_Error SD_ReadBlock(uint32_t *readbuff, uint64_t ReadAddr, uint16_t BlockSize)
 {
   SD_Error errorstatus = SD_OK;
   uint32_t count = 0, *tempbuff = (uint32_t *)readbuff;
@@ -998,6 +1030,13 @@ SD_Error SD_ReadBlock(uint32_t *readbuff, uint32_t ReadAddr, uint16_t BlockSize)
     return(errorstatus);
   }
 
+  /*!< A started request or the programming of the last write must be over */
+  errorstatus = SD_WaitRequest();
+  if (errorstatus != SD_OK)
+  {
+    return(errorstatus);
+  }
+
   TransferError = SD_OK;
   TransferEnd = 0;
   TotalNumberOfBytes = 0;
@@ -1138,7 +1177,8 @@ SD_Error SD_ReadBlock(uint32_t *readbuff, uint32_t ReadAddr, uint16_t BlockSize)
     SDIO_ITConfig(SDIO_IT_DCRCFAIL | SDIO_IT_DTIMEOUT | SDIO_IT_DATAEND | SDIO_IT_RXOVERR | SDIO_IT_STBITERR, ENABLE);
     SDIO_DMACmd(ENABLE);
     SD_LowLevel_DMA_RxConfig((uint32_t *)readbuff, BlockSize);
-    while ((SD_DMAEndOfTransferStatus() == RESET) && (TransferEnd == 0) && (TransferError == SD_OK))
+    /*!< The DMA is done before the SDIO interrupt has ended the transfer */
+    while (((SD_DMAEndOfTransferStatus() == RESET) || (TransferEnd == 0)) && (TransferError == SD_OK))
     {}
     if (TransferError != SD_OK)
     {
@@ -1156,7 +1196,7 @@ SD_Error SD_ReadBlock(uint32_t *readbuff, uint32_t ReadAddr, uint16_t BlockSize)
   * @param  NumberOfBlocks: number of blocks to be read.
   * @retval SD_Error: SD Card Error code.
   */
-SD_Error SD_ReadMultiBlocks(uint8_t *readbuff, uint32_t ReadAddr, uint16_t BlockSize, uint32_t NumberOfBlocks)
+SD_Error SD_ReadMultiBlocks(uint8_t *readbuff, uint64_t ReadAddr, uint16_t BlockSize, uint32_t NumberOfBlocks)
 {
   SD_Error errorstatus = SD_OK;
   uint32_t count = 0, *tempbuff = (uint32_t *)readbuff;
@@ -1168,6 +1208,13 @@ SD_Error SD_ReadMultiBlocks(uint8_t *readbuff, uint32_t ReadAddr, uint16_t Block
     return(errorstatus);
   }
 
+  /*!< A started request or the programming of the last write must be over */
+  errorstatus = SD_WaitRequest();
+  if (errorstatus != SD_OK)
+  {
+    return(errorstatus);
+  }
+
   TransferError = SD_OK;
   TransferEnd = 0;
   TotalNumberOfBytes = 0;
@@ -1339,7 +1386,8 @@ SD_Error SD_ReadMultiBlocks(uint8_t *readbuff, uint32_t ReadAddr, uint16_t Block
       SDIO_ITConfig(SDIO_IT_DCRCFAIL | SDIO_IT_DTIMEOUT | SDIO_IT_DATAEND | SDIO_IT_RXOVERR | SDIO_IT_STBITERR, ENABLE);
       SDIO_DMACmd(ENABLE);
       SD_LowLevel_DMA_RxConfig((uint32_t *)readbuff, (NumberOfBlocks * BlockSize));
-      while ((SD_DMAEndOfTransferStatus() == RESET) && (TransferEnd == 0) && (TransferError == SD_OK))
+      /*!< The DMA is done before the SDIO interrupt has ended the transfer */
+      while (((SD_DMAEndOfTransferStatus() == RESET) || (TransferEnd == 0)) && (TransferError == SD_OK))
       {}
       if (TransferError != SD_OK)
       {
@@ -1357,10 +1405,10 @@ SD_Error SD_ReadMultiBlocks(uint8_t *readbuff, uint32_t ReadAddr, uint16_t Block
   * @param  BlockSize: the SD card Data block size.
   * @retval SD_Error: SD Card Error code.
   */
-SD_Error SD_WriteBlock(uint32_t *writebuff, uint32_t WriteAddr, uint16_t BlockSize)
+SD_Error SD_WriteBlock(uint32_t *writebuff, uint64_t WriteAddr, uint16_t BlockSize)
 {
   SD_Error errorstatus = SD_OK;
-  uint8_t  power = 0, cardstate = 0;
+  uint8_t  power = 0;
   uint32_t timeout = 0, bytestransferred = 0;
   uint32_t cardstatus = 0, count = 0, restwords = 0;
   uint32_t *tempbuff = (uint32_t *)writebuff;
@@ -1371,6 +1419,13 @@ SD_Error SD_WriteBlock(uint32_t *writebuff, uint32_t WriteAddr, uint16_t BlockSi
     return(errorstatus);
   }
 
+  /*!< A started request or the programming of the last write must be over */
+  errorstatus = SD_WaitRequest();
+  if (errorstatus != SD_OK)
+  {
+    return(errorstatus);
+  }
+
   TransferError = SD_OK;
   TransferEnd = 0;
   TotalNumberOfBytes = 0;
@@ -1465,7 +1520,7 @@ SD_Error SD_WriteBlock(uint32_t *writebuff, uint32_t WriteAddr, uint16_t BlockSi
   }
 
   /*!< Send CMD24 WRITE_SINGLE_BLOCK */
-  SDIO_CmdInitStructure.SDIO_Argument = WriteAddr;
+  SDIO_CmdInitStructure.SDIO_Argument = (uint32_t)WriteAddr;
   SDIO_CmdInitStructure.SDIO_CmdIndex = SD_CMD_WRITE_SINGLE_BLOCK;
   SDIO_CmdInitStructure.SDIO_Response = SDIO_Response_Short;
   SDIO_CmdInitStructure.SDIO_Wait = SDIO_Wait_No;
@@ -1558,7 +1613,8 @@ SD_Error SD_WriteBlock(uint32_t *writebuff, uint32_t WriteAddr, uint16_t BlockSi
     SDIO_ITConfig(SDIO_IT_DCRCFAIL | SDIO_IT_DTIMEOUT | SDIO_IT_DATAEND | SDIO_IT_TXUNDERR | SDIO_IT_STBITERR, ENABLE);
     SD_LowLevel_DMA_TxConfig((uint32_t *)writebuff, BlockSize);
     SDIO_DMACmd(ENABLE);
-    while ((SD_DMAEndOfTransferStatus() == RESET) && (TransferEnd == 0) && (TransferError == SD_OK))
+    /*!< The DMA is done before the SDIO interrupt has ended the transfer */
+    while (((SD_DMAEndOfTransferStatus() == RESET) || (TransferEnd == 0)) && (TransferError == SD_OK))
     {}
     if (TransferError != SD_OK)
     {
@@ -1569,13 +1625,11 @@ SD_Error SD_WriteBlock(uint32_t *writebuff, uint32_t WriteAddr, uint16_t BlockSi
   /*!< Clear all the static flags */
   SDIO_ClearFlag(SDIO_STATIC_FLAGS);
 
-  /*!< Wait till the card is in programming state */
-  errorstatus = IsCardProgramming(&cardstate);
-
-  while ((errorstatus == SD_OK) && ((cardstate == SD_CARD_PROGRAMMING) || (cardstate == SD_CARD_RECEIVING)))
-  {
-    errorstatus = IsCardProgramming(&cardstate);
-  }
+  /*!< The card programs the data on its own: the next command or
+       SD_CheckRequest waits for it */
+  RequestDir = SDIO_TransferDir_ToCard;
+  RequestError = SD_OK;
+  RequestState = SD_REQ_PROGRAMMING;
 
   return(errorstatus);
 }
@@ -1588,10 +1642,10 @@ SD_Error SD_WriteBlock(uint32_t *writebuff, uint32_t WriteAddr, uint16_t BlockSi
   * @param  NumberOfBlocks: number of blocks to be written.
   * @retval SD_Error: SD Card Error code.
   */
-SD_Error SD_WriteMultiBlocks(uint8_t *writebuff, uint32_t WriteAddr, uint16_t BlockSize, uint32_t NumberOfBlocks)
+SD_Error SD_WriteMultiBlocks(uint8_t *writebuff, uint64_t WriteAddr, uint16_t BlockSize, uint32_t NumberOfBlocks)
 {
   SD_Error errorstatus = SD_OK;
-  uint8_t  power = 0, cardstate = 0;
+  uint8_t  power = 0;
   uint32_t bytestransferred = 0;
   uint32_t restwords = 0;
   uint32_t *tempbuff = (uint32_t *)writebuff;
@@ -1603,6 +1657,13 @@ SD_Error SD_WriteMultiBlocks(uint8_t *writebuff, uint32_t WriteAddr, uint16_t Bl
     return(errorstatus);
   }
 
+  /*!< A started request or the programming of the last write must be over */
+  errorstatus = SD_WaitRequest();
+  if (errorstatus != SD_OK)
+  {
+    return(errorstatus);
+  }
+
   TransferError = SD_OK;
   TransferEnd = 0;
   TotalNumberOfBytes = 0;
@@ -1827,7 +1888,8 @@ SD_Error SD_WriteMultiBlocks(uint8_t *writebuff, uint32_t WriteAddr, uint16_t Bl
       SDIO_ITConfig(SDIO_IT_DCRCFAIL | SDIO_IT_DTIMEOUT | SDIO_IT_DATAEND | SDIO_IT_TXUNDERR | SDIO_IT_STBITERR, ENABLE);
       SDIO_DMACmd(ENABLE);
       SD_LowLevel_DMA_TxConfig((uint32_t *)writebuff, (NumberOfBlocks * BlockSize));
-      while ((SD_DMAEndOfTransferStatus() == RESET) && (TransferEnd == 0) && (TransferError == SD_OK))
+      /*!< The DMA is done before the SDIO interrupt has ended the transfer */
+      while (((SD_DMAEndOfTransferStatus() == RESET) || (TransferEnd == 0)) && (TransferError == SD_OK))
       {}
       if (TransferError != SD_OK)
       {
@@ -1837,18 +1899,12 @@ SD_Error SD_WriteMultiBlocks(uint8_t *writebuff, uint32_t WriteAddr, uint16_t Bl
   }
   /*!< Clear all the static flags */
   SDIO_ClearFlag(SDIO_STATIC_FLAGS);
-  
-  /*!< Add some delay before checking the Card Status */
-  for(count = 0; count < 0xFFFF; count++)
-  {
-  }
-  /*!< Wait till the card is in programming state */
-  errorstatus = IsCardProgramming(&cardstate);
 
-  while ((errorstatus == SD_OK) && ((cardstate == SD_CARD_PROGRAMMING) || (cardstate == SD_CARD_RECEIVING)))
-  {
-    errorstatus = IsCardProgramming(&cardstate);
-  }
+  /*!< The card programs the data on its own: the next command or
+       SD_CheckRequest waits for it */
+  RequestDir = SDIO_TransferDir_ToCard;
+  RequestError = SD_OK;
+  RequestState = SD_REQ_PROGRAMMING;
 
   return(errorstatus);
 }
@@ -1901,13 +1957,20 @@ SD_Error SD_StopTransfer(void)
   * @param  endaddr: the end address.
   * @retval SD_Error: SD Card Error code.
   */
-SD_Error SD_Erase(uint32_t startaddr, uint32_t endaddr)
+SD_Error SD_Erase(uint64_t startaddr, uint64_t endaddr)
 {
   SD_Error errorstatus = SD_OK;
   uint32_t delay = 0;
   __IO uint32_t maxdelay = 0;
   uint8_t cardstate = 0;
 
+  /*!< A started request or the programming of the last write must be over */
+  errorstatus = SD_WaitRequest();
+  if (errorstatus != SD_OK)
+  {
+    return(errorstatus);
+  }
+
   /*!< Check if the card coomnd class supports erase command */
   if (((CSD_Tab[1] >> 20) & SD_CCCC_ERASE) == 0)
   {
@@ -1933,7 +1996,7 @@ SD_Error SD_Erase(uint32_t startaddr, uint32_t endaddr)
   if ((SDIO_STD_CAPACITY_SD_CARD_V1_1 == CardType) || (SDIO_STD_CAPACITY_SD_CARD_V2_0 == CardType) || (SDIO_HIGH_CAPACITY_SD_CARD == CardType))
   {
     /*!< Send CMD32 SD_ERASE_GRP_START with argument as addr  */
-    SDIO_CmdInitStructure.SDIO_Argument = startaddr;
+    SDIO_CmdInitStructure.SDIO_Argument = (uint32_t)startaddr;
     SDIO_CmdInitStructure.SDIO_CmdIndex = SD_CMD_SD_ERASE_GRP_START;
     SDIO_CmdInitStructure.SDIO_Response = SDIO_Response_Short;
     SDIO_CmdInitStructure.SDIO_Wait = SDIO_Wait_No;
@@ -1947,7 +2010,7 @@ SD_Error SD_Erase(uint32_t startaddr, uint32_t endaddr)
     }
 
     /*!< Send CMD33 SD_ERASE_GRP_END with argument as addr  */
-    SDIO_CmdInitStructure.SDIO_Argument = endaddr;
+    SDIO_CmdInitStructure.SDIO_Argument = (uint32_t)endaddr;
     SDIO_CmdInitStructure.SDIO_CmdIndex = SD_CMD_SD_ERASE_GRP_END;
     SDIO_CmdInitStructure.SDIO_Response = SDIO_Response_Short;
     SDIO_CmdInitStructure.SDIO_Wait = SDIO_Wait_No;
@@ -2148,6 +2211,247 @@ SD_Error SD_SendSDStatus(uint32_t *psdstatus)
   return(errorstatus);
 }
 
+/**
+  * @brief  Starts reading blocks without waiting for them: the data moves by
+  *         DMA, SD_ProcessIRQSrc ends the transfer and SD_CheckRequest tells
+  *         when the buffer can be used. Needs the DMA mode.
+  * @param  readbuff: word aligned buffer that will receive the data.
+  * @param  BlockAddr: number of the first 512 bytes block.
+  * @param  NumberOfBlocks: number of blocks to read.
+  * @retval SD_Error: SD Card Error code, SD_OK if the request is started.
+  */
+SD_Error SD_StartRead(uint8_t *readbuff, uint32_t BlockAddr, uint32_t NumberOfBlocks)
+{
+  return(SD_StartTransfer((uint32_t *)readbuff, BlockAddr, NumberOfBlocks, SDIO_TransferDir_ToSDIO));
+}
+
+/**
+  * @brief  Starts writing blocks without waiting for them, see SD_StartRead.
+  *         The request is over once the card has programmed the data, the 
+  *         buffer can be reused as soon as SD_CheckRequest no longer returns 
+  *         SD_REQUEST_PENDING.
+  * @param  writebuff: word aligned buffer holding the data.
+  * @param  BlockAddr: number of the first 512 bytes block.
+  * @param  NumberOfBlocks: number of blocks to write.
+  * @retval SD_Error: SD Card Error code, SD_OK if the request is started.
+  */
+SD_Error SD_StartWrite(const uint8_t *writebuff, uint32_t BlockAddr, uint32_t NumberOfBlocks)
+{
+  return(SD_StartTransfer((uint32_t *)writebuff, BlockAddr, NumberOfBlocks, SDIO_TransferDir_ToCard));
+}
+
+/**
+  * @brief  Moves the current request forward and never waits: the end of the
+  *         data transfer is signalled by SD_ProcessIRQSrc and the DMA, the 
+  *         end of programming is asked to the card with one CMD13 per call.
+  *         Call it from the main loop or a periodic task.
+  * @param  None
+  * @retval SD_Error: SD_REQUEST_PENDING while the request runs, then the 
+  *         request result, given once. SD_OK when there is no request.
+  */
+SD_Error SD_CheckRequest(void)
+{
+  SD_Error errorstatus = SD_OK;
+  uint8_t cardstate = 0;
+
+  if (RequestState == SD_REQ_TRANSFER)
+  {
+    if (TransferError != SD_OK)
+    {
+      /*!< Stop the DMA and bring the card back to the transfer state */
+      DMA_Cmd(DMA2_Channel4, DISABLE);
+      SDIO_DMACmd(DISABLE);
+      if (StopCondition == 1)
+      {
+        SD_StopTransfer();
+      }
+      SDIO_ClearFlag(SDIO_STATIC_FLAGS);
+      RequestError = TransferError;
+      RequestState = SD_REQ_IDLE;
+    }
+    else if ((TransferEnd == 0) || (SD_DMAEndOfTransferStatus() == RESET))
+    {
+      return(SD_REQUEST_PENDING);
+    }
+    else
+    {
+      SDIO_ClearFlag(SDIO_STATIC_FLAGS);
+      RequestState = (RequestDir == SDIO_TransferDir_ToCard) ? SD_REQ_PROGRAMMING : SD_REQ_IDLE;
+    }
+  }
+
+  if (RequestState == SD_REQ_PROGRAMMING)
+  {
+    errorstatus = IsCardProgramming(&cardstate);
+
+    if ((errorstatus == SD_OK) && ((cardstate == SD_CARD_PROGRAMMING) || (cardstate == SD_CARD_RECEIVING)))
+    {
+      return(SD_REQUEST_PENDING);
+    }
+    RequestError = errorstatus;
+    RequestState = SD_REQ_IDLE;
+  }
+
+  errorstatus = RequestError;
+  RequestError = SD_OK;
+
+  return(errorstatus);
+}
+
+/**
+  * @brief  Waits for the end of the current request.
+  * @param  None
+  * @retval SD_Error: request result, SD_OK when there is no request.
+  */
+SD_Error SD_WaitRequest(void)
+{
+  SD_Error errorstatus = SD_OK;
+
+  do
+  {
+    errorstatus = SD_CheckRequest();
+  }
+  while (errorstatus == SD_REQUEST_PENDING);
+
+  return(errorstatus);
+}
+
+/**
+  * @brief  Reads the allocation unit size from the SD Status register.
+  * @param  pausize: number of 512 bytes blocks in an AU, rounded down to a 
+  *         power of two, 1 if the card does not report it.
+  * @retval SD_Error: SD Card Error code.
+  */
+SD_Error SD_GetAUSize(uint32_t *pausize)
+{
+  /*!< AU sizes in blocks for the AU_SIZE values 1 to 15, 12 MB and 24 MB
+       rounded down to 8 MB and 16 MB */
+  static const uint32_t AUBlocks[15] =
+  {
+    32, 64, 128, 256, 512, 1024, 2048, 4096, 8192,
+    16384, 16384, 32768, 32768, 65536, 131072
+  };
+  SD_Error errorstatus = SD_OK;
+  uint32_t sdstatus[16];
+  uint32_t ausize;
+
+  *pausize = 1;
+
+  errorstatus = SD_SendSDStatus(sdstatus);
+  if (errorstatus != SD_OK)
+  {
+    return(errorstatus);
+  }
+
+  /*!< AU_SIZE is bits [431:428] of the 512 bits SD Status */
+  ausize = (sdstatus[2] >> 12) & 0x0F;
+  if (ausize != 0)
+  {
+    *pausize = AUBlocks[ausize - 1];
+  }
+
+  return(errorstatus);
+}
+
+/**
+  * @brief  Writes blocks through the write aggregation buffer. Sequential 
+  *         blocks are gathered and written SD_WRBUF_BLOCKS at a time, at 
+  *         addresses aligned on SD_WRBUF_BLOCKS, so that the card programs
+  *         its allocation units in order instead of merging small writes.
+  * @param  writebuff: data to write, no alignment needed.
+  * @param  BlockAddr: number of the first 512 bytes block.
+  * @param  NumberOfBlocks: number of blocks to write.
+  * @retval SD_Error: SD Card Error code.
+  */
+SD_Error SD_WriteBuffered(const uint8_t *writebuff, uint32_t BlockAddr, uint32_t NumberOfBlocks)
+{
+  SD_Error errorstatus = SD_OK;
+  uint32_t nbr;
+
+  /*!< Not the continuation of the buffered blocks */
+  if ((SD_WrBlockNbr != 0) && (BlockAddr != (SD_WrBlockAddr + SD_WrBlockNbr)))
+  {
+    errorstatus = SD_StartFlush();
+  }
+
+  while ((errorstatus == SD_OK) && (NumberOfBlocks != 0))
+  {
+    if (SD_WrBlockNbr == 0)
+    {
+      SD_WrBlockAddr = BlockAddr;
+
+      /*!< Whole aligned chunks from an aligned buffer need no copy */
+      nbr = NumberOfBlocks - (NumberOfBlocks % SD_WRBUF_BLOCKS);
+      if (((BlockAddr % SD_WRBUF_BLOCKS) == 0) && (nbr != 0) && (((uint32_t)writebuff & 3) == 0))
+      {
+        errorstatus = SD_WriteMultiBlocks((uint8_t *)writebuff, (uint64_t)BlockAddr * 512, 512, nbr);
+        writebuff += nbr * 512;
+        BlockAddr += nbr;
+        NumberOfBlocks -= nbr;
+        continue;
+      }
+    }
+
+    /*!< Fill the buffer up to the next SD_WRBUF_BLOCKS boundary */
+    nbr = SD_WRBUF_BLOCKS - ((SD_WrBlockAddr + SD_WrBlockNbr) % SD_WRBUF_BLOCKS);
+    if (nbr > (SD_WRBUF_BLOCKS - SD_WrBlockNbr))
+    {
+      nbr = SD_WRBUF_BLOCKS - SD_WrBlockNbr;
+    }
+    if (nbr > NumberOfBlocks)
+    {
+      nbr = NumberOfBlocks;
+    }
+
+    memcpy((uint8_t *)SD_WrBuffer[SD_WrBufIdx] + (SD_WrBlockNbr * 512), writebuff, nbr * 512);
+    SD_WrBlockNbr += nbr;
+    writebuff += nbr * 512;
+    BlockAddr += nbr;
+    NumberOfBlocks -= nbr;
+
+    /*!< Full chunk: written while the other buffer is filled */
+    if (((SD_WrBlockAddr + SD_WrBlockNbr) % SD_WRBUF_BLOCKS) == 0)
+    {
+      errorstatus = SD_StartFlush();
+    }
+  }
+
+  return(errorstatus);
+}
+
+/**
+  * @brief  Writes the blocks gathered by SD_WriteBuffered to the card and
+  *         waits until they are programmed.
+  * @param  None
+  * @retval SD_Error: SD Card Error code.
+  */
+SD_Error SD_FlushWrite(void)
+{
+  SD_Error errorstatus = SD_OK;
+
+  errorstatus = SD_StartFlush();
+
+  if (errorstatus == SD_OK)
+  {
+    errorstatus = SD_WaitRequest();
+  }
+
+  return(errorstatus);
+}
+
+/**
+  * @brief  Tells whether blocks are waiting in the write aggregation buffer.
+  * @param  BlockAddr: number of the first 512 bytes block.
+  * @param  NumberOfBlocks: number of blocks.
+  * @retval 1 if one of the blocks is buffered, 0 else.
+  */
+uint8_t SD_IsWriteBuffered(uint32_t BlockAddr, uint32_t NumberOfBlocks)
+{
+  return ((SD_WrBlockNbr != 0) &&
+          (BlockAddr < (SD_WrBlockAddr + SD_WrBlockNbr)) &&
+          ((BlockAddr + NumberOfBlocks) > SD_WrBlockAddr));
+}
+
 /**
   * @brief  Allows to process all the interrupts that are high.
   * @param  None
@@ -3010,6 +3314,198 @@ static SD_Error FindSCR(uint16_t rca, uint32_t *pscr)
   return(errorstatus);
 }
 
+/**
+  * @brief  Starts writing the blocks gathered by SD_WriteBuffered and 
+  *         switches to the other buffer. The error of the previous write, if
+  *         any, is returned here.
+  * @param  None
+  * @retval SD_Error: SD Card Error code.
+  */
+static SD_Error SD_StartFlush(void)
+{
+  SD_Error errorstatus = SD_OK;
+
+  if (SD_WrBlockNbr != 0)
+  {
+    errorstatus = SD_StartWrite((uint8_t *)SD_WrBuffer[SD_WrBufIdx], SD_WrBlockAddr, SD_WrBlockNbr);
+
+    /*!< No DMA: blocking write */
+    if ((errorstatus == SD_REQUEST_NOT_APPLICABLE) && (SD_WrBlockNbr == 1))
+    {
+      errorstatus = SD_WriteBlock(SD_WrBuffer[SD_WrBufIdx], (uint64_t)SD_WrBlockAddr * 512, 512);
+    }
+    else if (errorstatus == SD_REQUEST_NOT_APPLICABLE)
+    {
+      errorstatus = SD_WriteMultiBlocks((uint8_t *)SD_WrBuffer[SD_WrBufIdx], (uint64_t)SD_WrBlockAddr * 512, 512, SD_WrBlockNbr);
+    }
+    SD_WrBufIdx ^= 1;
+    SD_WrBlockNbr = 0;
+  }
+
+  return(errorstatus);
+}
+
+/**
+  * @brief  Sends the commands of a read or write request and hands the data 
+  *         over to the DMA, see SD_StartRead and SD_StartWrite.
+  * @param  buff: word aligned data buffer.
+  * @param  BlockAddr: number of the first 512 bytes block.
+  * @param  NumberOfBlocks: number of blocks.
+  * @param  TransferDir: SDIO_TransferDir_ToCard or SDIO_TransferDir_ToSDIO.
+  * @retval SD_Error: SD Card Error code.
+  */
+static SD_Error SD_StartTransfer(uint32_t *buff, uint32_t BlockAddr, uint32_t NumberOfBlocks, uint32_t TransferDir)
+{
+  SD_Error errorstatus = SD_OK;
+  uint8_t cmd = 0;
+
+  if ((buff == NULL) || (((uint32_t)buff & 3) != 0) || (NumberOfBlocks == 0) ||
+      (NumberOfBlocks > (SD_MAX_DATA_LENGTH / 512)))
+  {
+    errorstatus = SD_INVALID_PARAMETER;
+    return(errorstatus);
+  }
+
+  if (DeviceMode != SD_DMA_MODE)
+  {
+    errorstatus = SD_REQUEST_NOT_APPLICABLE;
+    return(errorstatus);
+  }
+
+  /*!< One request at a time */
+  errorstatus = SD_WaitRequest();
+  if (errorstatus != SD_OK)
+  {
+    return(errorstatus);
+  }
+
+  TransferError = SD_OK;
+  TransferEnd = 0;
+  TotalNumberOfBytes = NumberOfBlocks * 512;
+  StopCondition = (NumberOfBlocks > 1) ? 1 : 0;
+
+  /*!< Clear all DPSM configuration */
+  SDIO_DataInitStructure.SDIO_DataTimeOut = SD_DATATIMEOUT;
+  SDIO_DataInitStructure.SDIO_DataLength = 0;
+  SDIO_DataInitStructure.SDIO_DataBlockSize = SDIO_DataBlockSize_1b;
+  SDIO_DataInitStructure.SDIO_TransferDir = TransferDir;
+  SDIO_DataInitStructure.SDIO_TransferMode = SDIO_TransferMode_Block;
+  SDIO_DataInitStructure.SDIO_DPSM = SDIO_DPSM_Disable;
+  SDIO_DataConfig(&SDIO_DataInitStructure);
+  SDIO_DMACmd(DISABLE);
+
+  if (SDIO_GetResponse(SDIO_RESP1) & SD_CARD_LOCKED)
+  {
+    errorstatus = SD_LOCK_UNLOCK_FAILED;
+    return(errorstatus);
+  }
+
+  /*!< Standard capacity cards are byte addressed */
+  if (CardType != SDIO_HIGH_CAPACITY_SD_CARD)
+  {
+    BlockAddr *= 512;
+  }
+
+  /*!< Set the block size, both on controller and card */
+  SDIO_CmdInitStructure.SDIO_Argument = (uint32_t) 512;
+  SDIO_CmdInitStructure.SDIO_CmdIndex = SD_CMD_SET_BLOCKLEN;
+  SDIO_CmdInitStructure.SDIO_Response = SDIO_Response_Short;
+  SDIO_CmdInitStructure.SDIO_Wait = SDIO_Wait_No;
+  SDIO_CmdInitStructure.SDIO_CPSM = SDIO_CPSM_Enable;
+  SDIO_SendCommand(&SDIO_CmdInitStructure);
+
+  errorstatus = CmdResp1Error(SD_CMD_SET_BLOCKLEN);
+
+  if (errorstatus != SD_OK)
+  {
+    return(errorstatus);
+  }
+
+  if ((TransferDir == SDIO_TransferDir_ToCard) && (NumberOfBlocks > 1))
+  {
+    /*!< Send ACMD23 SET_WR_BLK_ERASE_COUNT: the card pre-erases the blocks */
+    SDIO_CmdInitStructure.SDIO_Argument = (uint32_t) (RCA << 16);
+    SDIO_CmdInitStructure.SDIO_CmdIndex = SD_CMD_APP_CMD;
+    SDIO_CmdInitStructure.SDIO_Response = SDIO_Response_Short;
+    SDIO_CmdInitStructure.SDIO_Wait = SDIO_Wait_No;
+    SDIO_CmdInitStructure.SDIO_CPSM = SDIO_CPSM_Enable;
+    SDIO_SendCommand(&SDIO_CmdInitStructure);
+
+    errorstatus = CmdResp1Error(SD_CMD_APP_CMD);
+
+    if (errorstatus != SD_OK)
+    {
+      return(errorstatus);
+    }
+
+    SDIO_CmdInitStructure.SDIO_Argument = (uint32_t) NumberOfBlocks;
+    SDIO_CmdInitStructure.SDIO_CmdIndex = SD_CMD_SET_BLOCK_COUNT;
+    SDIO_CmdInitStructure.SDIO_Response = SDIO_Response_Short;
+    SDIO_CmdInitStructure.SDIO_Wait = SDIO_Wait_No;
+    SDIO_CmdInitStructure.SDIO_CPSM = SDIO_CPSM_Enable;
+    SDIO_SendCommand(&SDIO_CmdInitStructure);
+
+    errorstatus = CmdResp1Error(SD_CMD_SET_BLOCK_COUNT);
+
+    if (errorstatus != SD_OK)
+    {
+      return(errorstatus);
+    }
+  }
+
+  SDIO_DataInitStructure.SDIO_DataTimeOut = SD_DATATIMEOUT;
+  SDIO_DataInitStructure.SDIO_DataLength = TotalNumberOfBytes;
+  SDIO_DataInitStructure.SDIO_DataBlockSize = SDIO_DataBlockSize_512b;
+  SDIO_DataInitStructure.SDIO_TransferDir = TransferDir;
+  SDIO_DataInitStructure.SDIO_TransferMode = SDIO_TransferMode_Block;
+  SDIO_DataInitStructure.SDIO_DPSM = SDIO_DPSM_Enable;
+
+  if (TransferDir == SDIO_TransferDir_ToCard)
+  {
+    cmd = (NumberOfBlocks > 1) ? SD_CMD_WRITE_MULT_BLOCK : SD_CMD_WRITE_SINGLE_BLOCK;
+  }
+  else
+  {
+    /*!< The data path must be ready before the card sends the first block */
+    SDIO_DataConfig(&SDIO_DataInitStructure);
+    cmd = (NumberOfBlocks > 1) ? SD_CMD_READ_MULT_BLOCK : SD_CMD_READ_SINGLE_BLOCK;
+  }
+
+  SDIO_CmdInitStructure.SDIO_Argument = BlockAddr;
+  SDIO_CmdInitStructure.SDIO_CmdIndex = cmd;
+  SDIO_CmdInitStructure.SDIO_Response = SDIO_Response_Short;
+  SDIO_CmdInitStructure.SDIO_Wait = SDIO_Wait_No;
+  SDIO_CmdInitStructure.SDIO_CPSM = SDIO_CPSM_Enable;
+  SDIO_SendCommand(&SDIO_CmdInitStructure);
+
+  errorstatus = CmdResp1Error(cmd);
+
+  if (errorstatus != SD_OK)
+  {
+    return(errorstatus);
+  }
+
+  RequestDir = TransferDir;
+  RequestError = SD_OK;
+  RequestState = SD_REQ_TRANSFER;
+
+  if (TransferDir == SDIO_TransferDir_ToCard)
+  {
+    SDIO_DataConfig(&SDIO_DataInitStructure);
+    SDIO_ITConfig(SDIO_IT_DCRCFAIL | SDIO_IT_DTIMEOUT | SDIO_IT_DATAEND | SDIO_IT_TXUNDERR | SDIO_IT_STBITERR, ENABLE);
+    SDIO_DMACmd(ENABLE);
+    SD_LowLevel_DMA_TxConfig(buff, TotalNumberOfBytes);
+  }
+  else
+  {
+    SDIO_ITConfig(SDIO_IT_DCRCFAIL | SDIO_IT_DTIMEOUT | SDIO_IT_DATAEND | SDIO_IT_RXOVERR | SDIO_IT_STBITERR, ENABLE);
+    SDIO_DMACmd(ENABLE);
+    SD_LowLevel_DMA_RxConfig(buff, TotalNumberOfBytes);
+  }
+
+  return(errorstatus);
+}
+
 /**
   * @brief  Converts the number of bytes in power of two and returns the power.
   * @param  NumberOfBytes: number of bytes.
@@ -3027,3 +3523,4 @@ static uint8_t convert_from_bytes_to_power_of_two(uint16_t NumberOfBytes)
   return(count);
 }
 
+#endif /* USE_SDIO_SD */
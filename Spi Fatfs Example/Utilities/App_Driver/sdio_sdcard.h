@@ -244,6 +244,13 @@ typedef struct
 #define SD_PRESENT                                 ((uint8_t)0x01)
 #define SD_NOT_PRESENT                             ((uint8_t)0x00)
 
+/** 
+  * @brief  Number of 512 bytes blocks gathered by SD_WriteBuffered before they
+  *         are written, a power of two dividing the card allocation unit.
+  *         Two buffers of that size are used.
+  */
+#define SD_WRBUF_BLOCKS                            ((uint32_t)16)
+
 /** 
   * @brief Supported SD Memory Cards 
   */
@@ -271,14 +278,22 @@ SD_Error SD_GetCardInfo(SD_CardInfo *cardinfo);
 SD_Error SD_EnableWideBusOperation(uint32_t WideMode);
 SD_Error SD_SetDeviceMode(uint32_t Mode);
 SD_Error SD_SelectDeselect(uint32_t addr);
-SD_Error SD_ReadBlock(uint32_t *readbuff, uint32_t ReadAddr, uint16_t BlockSize);
-SD_Error SD_ReadMultiBlocks(uint8_t *readbuff, uint32_t ReadAddr, uint16_t BlockSize, uint32_t NumberOfBlocks);
-SD_Error SD_WriteBlock(uint32_t *writebuff, uint32_t WriteAddr, uint16_t BlockSize);
-SD_Error SD_WriteMultiBlocks(uint8_t *writebuff, uint32_t WriteAddr, uint16_t BlockSize, uint32_t NumberOfBlocks);
+SD_Error SD_ReadBlock(uint32_t *readbuff, uint64_t ReadAddr, uint16_t BlockSize);
+SD_Error SD_ReadMultiBlocks(uint8_t *readbuff, uint64_t ReadAddr, uint16_t BlockSize, uint32_t NumberOfBlocks);
+SD_Error SD_WriteBlock(uint32_t *writebuff, uint64_t WriteAddr, uint16_t BlockSize);
+SD_Error SD_WriteMultiBlocks(uint8_t *writebuff, uint64_t WriteAddr, uint16_t BlockSize, uint32_t NumberOfBlocks);
 SDTransferState SD_GetTransferState(void);
 SD_Error SD_StopTransfer(void);
-SD_Error SD_Erase(uint32_t startaddr, uint32_t endaddr);
+SD_Error SD_Erase(uint64_t startaddr, uint64_t endaddr);
 SD_Error SD_SendStatus(uint32_t *pcardstatus);
 SD_Error SD_SendSDStatus(uint32_t *psdstatus);
 SD_Error SD_ProcessIRQSrc(void);
+SD_Error SD_StartRead(uint8_t *readbuff, uint32_t BlockAddr, uint32_t NumberOfBlocks);
+SD_Error SD_StartWrite(const uint8_t *writebuff, uint32_t BlockAddr, uint32_t NumberOfBlocks);
+SD_Error SD_CheckRequest(void);
+SD_Error SD_WaitRequest(void);
+SD_Error SD_GetAUSize(uint32_t *pausize);
+SD_Error SD_WriteBuffered(const uint8_t *writebuff, uint32_t BlockAddr, uint32_t NumberOfBlocks);
+SD_Error SD_FlushWrite(void);
+uint8_t SD_IsWriteBuffered(uint32_t BlockAddr, uint32_t NumberOfBlocks);
 
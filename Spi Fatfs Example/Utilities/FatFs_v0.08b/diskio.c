@@ -7,6 +7,7 @@
 /*-----------------------------------------------------------------------*/
 #include <string.h>
 #include "diskio.h"
+#include "ffconf.h"		/* Drive configuration */
 #include "spi_flash.h"
 /*-----------------------------------------------------------------------*/
 /* Correspondence between physical drive number and physical drive.      */
@@ -15,6 +16,26 @@
 
 #define SECTOR_SIZE 512U
 
+#ifdef USE_SDIO_SD
+#include "sdio_sdcard.h"
+
+/* Drive 1: SD card on the SDIO interface. Each disk_read is one CMD17 or
+   CMD18 DMA transfer. Writes are gathered by SD_WriteBuffered into aligned
+   CMD25 transfers, announced to the card with ACMD23. */
+#define SD_DRIVE	1
+
+SD_CardInfo SDCardInfo;							/* Used by sdio_sdcard.c */
+static volatile DSTATUS SD_Stat = STA_NOINIT;
+static uint32_t SD_Buffer[SECTOR_SIZE / 4];	/* DMA needs word aligned buffers */
+static uint32_t SD_AUBlocks = 1;				/* Allocation unit in sectors */
+
+static DSTATUS SD_disk_initialize (void);
+static DSTATUS SD_disk_status (void);
+static DRESULT SD_disk_read (BYTE *buff, DWORD sector, BYTE count);
+static DRESULT SD_disk_write (const BYTE *buff, DWORD sector, BYTE count);
+static DRESULT SD_disk_ioctl (BYTE ctrl, void *buff);
+#endif /* USE_SDIO_SD */
+
 /*-----------------------------------------------------------------------*/
 /* Inidialize a Drive                                                    */
 
@@ -22,6 +43,9 @@ DSTATUS disk_initialize (
 	BYTE drv				/* Physical drive nmuber (0..) */
 )
 {
+#ifdef USE_SDIO_SD
+	if (drv == SD_DRIVE) return SD_disk_initialize();
+#endif
 	return 0;
 }
 
@@ -34,6 +58,9 @@ DSTATUS disk_status (
 	BYTE drv		/* Physical drive nmuber (0..) */
 )
 {	
+#ifdef USE_SDIO_SD
+	if (drv == SD_DRIVE) return SD_disk_status();
+#endif
 	return 0;
 }
 
@@ -49,6 +76,9 @@ DRESULT disk_read (
 	BYTE count		/* Number of sectors to read (1..255) */
 )
 {	 
+#ifdef USE_SDIO_SD
+	if (drv == SD_DRIVE) return SD_disk_read(buff, sector, count);
+#endif
   sFLASH_sector_read((uint8_t *)buff,sector,count);
 	return RES_OK;
 }
@@ -66,6 +96,9 @@ DRESULT disk_write (
 	BYTE count			/* Number of sectors to write (1..255) */
 )
 {
+#ifdef USE_SDIO_SD
+	if (drv == SD_DRIVE) return SD_disk_write(buff, sector, count);
+#endif
 	  sFLASH_sector_write((uint8_t *)(buff),sector,count);  
 	
   	return RES_OK;
@@ -87,6 +120,9 @@ DRESULT disk_ioctl (
 	DWORD nFrom,nTo;
 	int i;
 	
+#ifdef USE_SDIO_SD
+	if (drv == SD_DRIVE) return SD_disk_ioctl(ctrl, buff);
+#endif
 	switch(ctrl)
 	{
 		case CTRL_SYNC :
@@ -125,23 +161,116 @@ DWORD get_fattime(void){
 
 
 
+#ifdef USE_SDIO_SD
+/*-----------------------------------------------------------------------*/
+/* SD card on SDIO                                                       */
 
+static DSTATUS SD_disk_initialize (void)
+{
+	if (SD_Detect() != SD_PRESENT) {
+		SD_Stat = STA_NOINIT | STA_NODISK;
+	} else if (SD_Init() == SD_OK) {
+		SD_Stat = 0;
+		if (SD_GetAUSize(&SD_AUBlocks) != SD_OK) SD_AUBlocks = 1;
+	} else {
+		SD_Stat = STA_NOINIT;
+	}
+	return SD_Stat;
+}
 
+static DSTATUS SD_disk_status (void)
+{
+	/* A removed or failing card must be initialized again */
+	if (SD_Detect() != SD_PRESENT) {
+		SD_Stat = STA_NOINIT | STA_NODISK;
+	} else if (!(SD_Stat & STA_NOINIT) && (SD_GetStatus() == SD_TRANSFER_ERROR)) {
+		SD_Stat = STA_NOINIT;
+	}
+	return SD_Stat;
+}
 
+static DRESULT SD_disk_read (BYTE *buff, DWORD sector, BYTE count)
+{
+	SD_Error err;
+
+	if (SD_Stat & STA_NOINIT) return RES_NOTRDY;
+
+	/* Read back what is still in the write buffer */
+	if (SD_IsWriteBuffered(sector, count) && (SD_FlushWrite() != SD_OK))
+		return RES_ERROR;
+
+	if ((DWORD)buff & 3) {
+		/* Unaligned buffer: one block at a time through SD_Buffer */
+		for (; count; count--, sector++, buff += SECTOR_SIZE) {
+			if (SD_ReadBlock(SD_Buffer, (uint64_t)sector * SECTOR_SIZE, SECTOR_SIZE) != SD_OK)
+				return RES_ERROR;
+			memcpy(buff, SD_Buffer, SECTOR_SIZE);
+		}
+		return RES_OK;
+	}
 
+	if (count == 1) {
+		err = SD_ReadBlock((uint32_t *)buff, (uint64_t)sector * SECTOR_SIZE, SECTOR_SIZE);
+	} else {
+		err = SD_ReadMultiBlocks(buff, (uint64_t)sector * SECTOR_SIZE, SECTOR_SIZE, count);
+	}
+	return (err == SD_OK) ? RES_OK : RES_ERROR;
+}
 
+#if _READONLY == 0
+static DRESULT SD_disk_write (const BYTE *buff, DWORD sector, BYTE count)
+{
+	if (SD_Stat & STA_NOINIT) return RES_NOTRDY;
 
+	return (SD_WriteBuffered(buff, sector, count) == SD_OK) ? RES_OK : RES_ERROR;
+}
+#endif /* _READONLY */
 
+static DRESULT SD_disk_ioctl (BYTE ctrl, void *buff)
+{
+	DWORD nFrom,nTo;
+	SD_Error err;
 
+	if (SD_Stat & STA_NOINIT) return RES_NOTRDY;
 
+	switch(ctrl)
+	{
+		case CTRL_SYNC :
+			if (SD_FlushWrite() != SD_OK) return RES_ERROR;
+			/* Wait for the end of the card programming */
+			while (SD_GetStatus() == SD_TRANSFER_BUSY);
+			return (SD_GetStatus() == SD_TRANSFER_OK) ? RES_OK : RES_ERROR;
 
+		case CTRL_ERASE_SECTOR:
+			nFrom = *((DWORD*)buff);
+			nTo = *(((DWORD*)buff)+1);
+			if (SD_IsWriteBuffered(nFrom, nTo - nFrom + 1) && (SD_FlushWrite() != SD_OK))
+				return RES_ERROR;
+			err = SD_Erase((uint64_t)nFrom * SECTOR_SIZE, (uint64_t)nTo * SECTOR_SIZE);
+			/* Not supported by the card: the sectors are simply not erased */
+			return ((err == SD_OK) || (err == SD_REQUEST_NOT_APPLICABLE)) ? RES_OK : RES_ERROR;
 
+		case GET_BLOCK_SIZE:
+			/* f_mkfs aligns the data area on the allocation unit, up to
+			   the 16 MB it supports */
+			*(DWORD*)buff = (SD_AUBlocks > 32768) ? 32768 : SD_AUBlocks;
+			return RES_OK;
 
+		case GET_SECTOR_SIZE:
+			*(WORD*)buff = SECTOR_SIZE;
+			return RES_OK;
 
+		case GET_SECTOR_COUNT:
+			if (SDCardInfo.CardType == SDIO_HIGH_CAPACITY_SD_CARD) {
+				/* C_SIZE is in 512 KB units, CardCapacity overflows above 4 GB */
+				*(DWORD*)buff = (SDCardInfo.SD_csd.DeviceSize + 1) * 1024;
+			} else {
+				*(DWORD*)buff = SDCardInfo.CardCapacity / SECTOR_SIZE;
+			}
+			return RES_OK;
 
-
-
-
-
-
-
+		default:
+			return RES_PARERR;
+	}
+}
+#endif /* USE_SDIO_SD */
@@ -125,7 +125,15 @@
 / Physical Drive Configurations
 /----------------------------------------------------------------------------*/
 
+/* Uncomment to add an SD card on the SDIO interface as drive 1, next to the
+/  SPI flash on drive 0. For devices with an SDIO peripheral only. */
+//#define USE_SDIO_SD
+
+#ifdef USE_SDIO_SD
+#define _VOLUMES	2
+#else
 #define _VOLUMES	1
+#endif
 /* Number of volumes (logical drives) to be used. */
 
 
@@ -143,7 +151,11 @@
 / is tied to the partitions listed in VolToPart[]. */
 
 
+#ifdef USE_SDIO_SD
+#define	_USE_ERASE	1	/* 0:Disable or 1:Enable */
+#else
 #define	_USE_ERASE	0	/* 0:Disable or 1:Enable */
+#endif
 /* To enable sector erase feature, set _USE_ERASE to 1. CTRL_ERASE_SECTOR command
 /  should be added to the disk_ioctl functio. */
 
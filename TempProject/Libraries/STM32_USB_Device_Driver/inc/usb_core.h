@@ -53,6 +53,13 @@ typedef enum {
   USB_FAIL
 }USB_STS;
 
+/* One part of a packet gathered into the PMA */
+typedef struct
+{
+  uint8_t  *pBuf;
+  uint16_t  wLen;
+}PMA_Segment_TypeDef;
+
 /* Exported macros -----------------------------------------------------------*/
 /* SetCNTR */
 #define _SetCNTR(wRegValue)  (*CNTR   = (uint16_t)wRegValue)
@@ -91,12 +98,14 @@ typedef enum {
 #define _GetLPMCSR() ((uint16_t) *LPMCSR)
 
 
+#ifndef _GetENDPOINT /* host builds may simulate the endpoint registers */
 /* SetENDPOINT */
 #define _SetENDPOINT(bEpNum,wRegValue)  (*(EP0REG + bEpNum)= \
     (uint16_t)wRegValue)
 
 /* GetENDPOINT */
 #define _GetENDPOINT(bEpNum)        ((uint16_t)(*(EP0REG + bEpNum)))
+#endif
 
 
 
@@ -489,6 +498,7 @@ uint16_t ByteSwap(uint16_t);
 void SetDeviceAddress(uint8_t);
 void UserToPMABufferCopy(uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes);
 void PMAToUserBufferCopy(uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes);
+uint16_t UserToPMABufferGather(PMA_Segment_TypeDef *pSeg, uint8_t bSegNbr, uint16_t wPMABufAddr);
 
 #endif /* __USB_CORE_H__ */
 
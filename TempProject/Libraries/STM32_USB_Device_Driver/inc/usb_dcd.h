@@ -42,6 +42,11 @@
 #define USB_SNG_BUF                          0
 #define USB_DBL_BUF                          1
 
+/*  Buffering of the class bulk endpoints, see usb_conf.h */
+#ifndef BULK_EP_KIND
+#define BULK_EP_KIND                         USB_SNG_BUF
+#endif
+
 /*  Device Status */
 #define USB_UNCONNECTED                      0
 #define USB_DEFAULT                          1
@@ -80,10 +85,16 @@ typedef struct USB_ep
   uint8_t        *xfer_buff;
   uint32_t       xfer_len ;
   uint32_t       xfer_count;
+  /* IN: ring buffer xfer_buff wraps around in, xfer_ring is 0 if none */
+  uint8_t        *xfer_ring;
+  uint32_t       xfer_ring_size;
   /* control transfer variables*/  
   uint32_t       rem_data_len;
   uint32_t       total_data_len;
   uint32_t       ctl_data_len;  
+  /* double buffer variables */
+  uint8_t        dbuf_filled;   /* IN: the firmware buffer holds the next packet */
+  uint8_t        dbuf_armed;    /* OUT: a transfer waits for the received packets */
 }
 USB_EP;
 
@@ -207,6 +218,16 @@ uint32_t    DCD_EP_Tx (USB_CORE_HANDLE *pdev,
                                uint8_t  ep_addr,
                                uint8_t  *pbuf,
                                uint32_t   buf_len);
+uint32_t    DCD_EP_TxRing (USB_CORE_HANDLE *pdev,
+                               uint8_t  ep_addr,
+                               uint8_t  *pbuf,
+                               uint32_t   buf_len,
+                               uint8_t  *ring,
+                               uint32_t   ring_size);
+void        DCD_EP_TxAdvance (USB_EP *ep,
+                              uint32_t len);
+void        DCD_EP_DblBufWrite (USB_EP *ep,
+                                uint8_t buf);
 uint32_t    DCD_EP_Stall (USB_CORE_HANDLE *pdev,
                               uint8_t   epnum);
 uint32_t    DCD_EP_ClrStall (USB_CORE_HANDLE *pdev,
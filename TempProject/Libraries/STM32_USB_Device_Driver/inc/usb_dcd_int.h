@@ -63,6 +63,7 @@ extern USBD_DCD_INT_cb_TypeDef *USBD_DCD_INT_fops;
 /* Exported variables --------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */ 
 void CTR(void);
+void DCD_EP_DblBufRx(USB_CORE_HANDLE *pdev, USB_EP *ep);
 void USB_Istr(void);
 
 #endif /* USB_DCD_INT_H__ */
@@ -47,8 +47,12 @@ enum EP_BUF_NUM
 };
 
 /* Exported defines ----------------------------------------------------------*/
+#ifndef RegBase /* may point to simulated registers for host builds */
 #define RegBase  (0x40005C00L)  /* USB_IP Peripheral Registers base address */
+#endif
+#ifndef PMAAddr /* may point to a simulated PMA for host builds */
 #define PMAAddr  (0x40006000L)  /* USB_IP Packet Memory Area base address   */
+#endif
 
 /******************************************************************************/
 /*                         General registers                                  */
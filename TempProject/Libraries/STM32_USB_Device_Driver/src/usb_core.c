@@ -664,6 +664,84 @@ void FreeUserBuffer(uint8_t bEpNum, uint8_t bDir)
   }
 }
 
+/**
+  * @brief Write whole halfwords from user memory to the PMA. Word aligned
+  *        buffers are read one word per two PMA halfwords, halfword aligned
+  *        ones one halfword at a time, other ones byte by byte; the loops
+  *        move 16 bytes per iteration.
+  * @param   pdwVal: PMA pointer.
+  * @param   pbUsrBuf: pointer to user memory area.
+  * @param   n: no. of halfwords to be copied.
+  * @retval PMA pointer past the last halfword written
+  */
+static uint16_t *PMA_WriteHalfwords(uint16_t *pdwVal, uint8_t *pbUsrBuf, uint32_t n)
+{
+  if (((uint32_t)pbUsrBuf & 3) == 0)
+  {
+    uint32_t *pwUsr = (uint32_t *)pbUsrBuf;
+    uint32_t w0, w1, w2, w3;
+    
+    for (; n >= 8; n -= 8)
+    {
+      w0 = pwUsr[0];
+      w1 = pwUsr[1];
+      w2 = pwUsr[2];
+      w3 = pwUsr[3];
+      pdwVal[0] = (uint16_t)w0;
+      pdwVal[1] = (uint16_t)(w0 >> 16);
+      pdwVal[2] = (uint16_t)w1;
+      pdwVal[3] = (uint16_t)(w1 >> 16);
+      pdwVal[4] = (uint16_t)w2;
+      pdwVal[5] = (uint16_t)(w2 >> 16);
+      pdwVal[6] = (uint16_t)w3;
+      pdwVal[7] = (uint16_t)(w3 >> 16);
+      pdwVal += 8;
+      pwUsr += 4;
+    }
+    pbUsrBuf = (uint8_t *)pwUsr;
+  }
+  
+  if (((uint32_t)pbUsrBuf & 1) == 0)
+  {
+    uint16_t *phUsr = (uint16_t *)pbUsrBuf;
+    
+    for (; n >= 8; n -= 8)
+    {
+      pdwVal[0] = phUsr[0];
+      pdwVal[1] = phUsr[1];
+      pdwVal[2] = phUsr[2];
+      pdwVal[3] = phUsr[3];
+      pdwVal[4] = phUsr[4];
+      pdwVal[5] = phUsr[5];
+      pdwVal[6] = phUsr[6];
+      pdwVal[7] = phUsr[7];
+      pdwVal += 8;
+      phUsr += 8;
+    }
+    for (; n != 0; n--)
+    {
+      *pdwVal++ = *phUsr++;
+    }
+    return pdwVal;
+  }
+  
+  for (; n >= 4; n -= 4)
+  {
+    pdwVal[0] = (uint16_t)(pbUsrBuf[0] | (pbUsrBuf[1] << 8));
+    pdwVal[1] = (uint16_t)(pbUsrBuf[2] | (pbUsrBuf[3] << 8));
+    pdwVal[2] = (uint16_t)(pbUsrBuf[4] | (pbUsrBuf[5] << 8));
+    pdwVal[3] = (uint16_t)(pbUsrBuf[6] | (pbUsrBuf[7] << 8));
+    pdwVal += 4;
+    pbUsrBuf += 8;
+  }
+  for (; n != 0; n--)
+  {
+    *pdwVal++ = (uint16_t)(pbUsrBuf[0] | (pbUsrBuf[1] << 8));
+    pbUsrBuf += 2;
+  }
+  return pdwVal;
+}
+
 /**
   * @brief Copy a buffer from user memory area to packet memory area (PMA)
   * @param   pbUsrBuf: pointer to user memory area.
@@ -673,24 +751,68 @@ void FreeUserBuffer(uint8_t bEpNum, uint8_t bDir)
   */
 void UserToPMABufferCopy(uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
 {
-  uint32_t n = (wNBytes + 1) >> 1; 
-  uint32_t i;
-  uint16_t temp1, temp2;
   uint16_t *pdwVal;
   pdwVal = (uint16_t *)(wPMABufAddr + PMAAddr);
   
-  for (i = n; i != 0; i--)
+  pdwVal = PMA_WriteHalfwords(pdwVal, pbUsrBuf, wNBytes >> 1);
+  
+  /* The last byte of an odd length is not read past */
+  if (wNBytes & 1)
   {
-    temp1 = (uint16_t) * pbUsrBuf;
-    pbUsrBuf++;
-    temp2 = temp1 | (uint16_t) * pbUsrBuf << 8;
-    *pdwVal++ = temp2;
-    pbUsrBuf++;
+    *pdwVal = pbUsrBuf[wNBytes - 1];
   }
 }
 
 /**
-  * @brief Copy a buffer from user memory area to packet memory area (PMA)
+  * @brief Gather a list of user memory segments into one PMA buffer, so a
+  *        packet can be sent straight from the buffers holding its parts.
+  * @param   pSeg: segment list.
+  * @param   bSegNbr: no. of segments.
+  * @param   wPMABufAddr: address into PMA.
+  * @retval no. of bytes copied
+  */
+uint16_t UserToPMABufferGather(PMA_Segment_TypeDef *pSeg, uint8_t bSegNbr, uint16_t wPMABufAddr)
+{
+  uint16_t *pdwVal;
+  uint8_t *pbUsrBuf;
+  uint16_t wLen;
+  uint16_t wTotal = 0;
+  uint16_t wOdd = 0;
+  uint8_t bHasOdd = 0;
+  pdwVal = (uint16_t *)(wPMABufAddr + PMAAddr);
+  
+  for (; bSegNbr != 0; bSegNbr--, pSeg++)
+  {
+    pbUsrBuf = pSeg->pBuf;
+    wLen = pSeg->wLen;
+    wTotal += wLen;
+    
+    /* Complete the halfword left open by the previous segment */
+    if (bHasOdd && (wLen != 0))
+    {
+      *pdwVal++ = (uint16_t)(wOdd | (*pbUsrBuf++ << 8));
+      wLen--;
+      bHasOdd = 0;
+    }
+    
+    pdwVal = PMA_WriteHalfwords(pdwVal, pbUsrBuf, wLen >> 1);
+    
+    if (wLen & 1)
+    {
+      wOdd = pbUsrBuf[wLen - 1];
+      bHasOdd = 1;
+    }
+  }
+  
+  if (bHasOdd)
+  {
+    *pdwVal = wOdd;
+  }
+  return wTotal;
+}
+
+/**
+  * @brief Copy a buffer from packet memory area (PMA) to user memory area
   * @param   pbUsrBuf    = pointer to user memory area.
   * @param   wPMABufAddr: address into PMA.
   * @param   wNBytes: no. of bytes to be copied.
@@ -698,14 +820,68 @@ void UserToPMABufferCopy(uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNByt
   */
 void PMAToUserBufferCopy(uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
 {
-  uint32_t n = (wNBytes + 1) >> 1;
-  uint32_t i;
+  uint32_t n = wNBytes >> 1;
   uint16_t *pdwVal;
   pdwVal = (uint16_t *)(wPMABufAddr + PMAAddr);
-  for (i = n; i != 0; i--)
+  
+  if (((uint32_t)pbUsrBuf & 3) == 0)
+  {
+    /* Two PMA halfwords per user word, 16 bytes per iteration */
+    uint32_t *pwUsr = (uint32_t *)pbUsrBuf;
+    
+    for (; n >= 8; n -= 8)
+    {
+      pwUsr[0] = pdwVal[0] | ((uint32_t)pdwVal[1] << 16);
+      pwUsr[1] = pdwVal[2] | ((uint32_t)pdwVal[3] << 16);
+      pwUsr[2] = pdwVal[4] | ((uint32_t)pdwVal[5] << 16);
+      pwUsr[3] = pdwVal[6] | ((uint32_t)pdwVal[7] << 16);
+      pdwVal += 8;
+      pwUsr += 4;
+    }
+    pbUsrBuf = (uint8_t *)pwUsr;
+  }
+  
+  if (((uint32_t)pbUsrBuf & 1) == 0)
+  {
+    uint16_t *phUsr = (uint16_t *)pbUsrBuf;
+    
+    for (; n >= 8; n -= 8)
+    {
+      phUsr[0] = pdwVal[0];
+      phUsr[1] = pdwVal[1];
+      phUsr[2] = pdwVal[2];
+      phUsr[3] = pdwVal[3];
+      phUsr[4] = pdwVal[4];
+      phUsr[5] = pdwVal[5];
+      phUsr[6] = pdwVal[6];
+      phUsr[7] = pdwVal[7];
+      pdwVal += 8;
+      phUsr += 8;
+    }
+    for (; n != 0; n--)
+    {
+      *phUsr++ = *pdwVal++;
+    }
+    pbUsrBuf = (uint8_t *)phUsr;
+  }
+  else
+  {
+    /* The Cortex-M0 faults on unaligned halfword stores */
+    uint16_t temp;
+    
+    for (; n != 0; n--)
+    {
+      temp = *pdwVal++;
+      pbUsrBuf[0] = (uint8_t)temp;
+      pbUsrBuf[1] = (uint8_t)(temp >> 8);
+      pbUsrBuf += 2;
+    }
+  }
+  
+  /* Do not write past the user buffer on an odd length */
+  if (wNBytes & 1)
   {
-    *(uint16_t*)pbUsrBuf++ = *pdwVal++;
-    pbUsrBuf++;
+    *pbUsrBuf = (uint8_t)*pdwVal;
   }
 }
 
@@ -27,6 +27,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "usb_dcd.h"
+#include "usb_dcd_int.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -35,6 +36,7 @@
 uint32_t wInterrupt_Mask=0;
 
 /* Private function prototypes -----------------------------------------------*/
+static void DCD_EP_WritePacket(USB_EP *ep, uint16_t pmaaddr, uint32_t len);
 /* Private functions ---------------------------------------------------------*/
 
 /**
@@ -199,6 +201,8 @@ uint32_t DCD_EP_Open(USB_CORE_HANDLE *pdev ,
   ep->xfer_len = 0;
   ep->xfer_count = 0;
   ep->is_stall = 0;
+  ep->dbuf_filled = 0;
+  ep->dbuf_armed = 0;
   
   /* initialize HW */
   switch (ep->type)
@@ -223,6 +227,12 @@ uint32_t DCD_EP_Open(USB_CORE_HANDLE *pdev ,
     {
       /*Set the endpoint Transmit buffer address */
       SetEPTxAddr(ep->num, ep->pmaadress);
+      if (ep->type == USB_EP_ISOC)
+      {
+        /* An isochronous endpoint sends from the buffer DTOG_TX selects,
+           which toggles each frame: both point to the same PMA area */
+        SetEPRxAddr(ep->num, ep->pmaadress);
+      }
       ClearDTOG_TX(ep->num);
       /* Configure NAK status for the Endpoint*/
       SetEPTxStatus(ep->num, EP_TX_NAK); 
@@ -255,15 +265,18 @@ uint32_t DCD_EP_Open(USB_CORE_HANDLE *pdev ,
       /* Reset value of the data toggle bits for the endpoint out*/
       ToggleDTOG_TX(ep->num);
       
+      /* Both buffers receive up to one max packet */
+      SetEPDblBuffCount(ep->num, EP_DBUF_OUT, ep->maxpacket);
+      
       SetEPRxStatus(ep->num, EP_RX_VALID);
       SetEPTxStatus(ep->num, EP_TX_DIS);
     }
     else
     {
-      /* Clear the data toggle bits for the endpoint IN/OUT*/
+      /* Clear the data toggle bits for the endpoint IN/OUT: with DTOG_TX
+         equal to SW_BUF (DTOG_RX) the SIE holds no buffer and NAKs */
       ClearDTOG_RX(ep->num);
       ClearDTOG_TX(ep->num);
-      ToggleDTOG_RX(ep->num);
       /* Configure DISABLE status for the Endpoint*/
       SetEPTxStatus(ep->num, EP_TX_DIS);
       SetEPRxStatus(ep->num, EP_RX_DIS);
@@ -322,10 +335,10 @@ uint32_t DCD_EP_Close(USB_CORE_HANDLE *pdev , uint8_t  ep_addr)
     }
     else
     {
-      /* Clear the data toggle bits for the endpoint IN/OUT*/
+      /* Clear the data toggle bits for the endpoint IN/OUT: with DTOG_TX
+         equal to SW_BUF (DTOG_RX) the SIE holds no buffer and NAKs */
       ClearDTOG_RX(ep->num);
       ClearDTOG_TX(ep->num);
-      ToggleDTOG_RX(ep->num);
       /* Configure DISABLE status for the Endpoint*/
       SetEPTxStatus(ep->num, EP_TX_DIS);
       SetEPRxStatus(ep->num, EP_RX_DIS);
@@ -353,6 +366,23 @@ uint32_t DCD_EP_PrepareRx( USB_CORE_HANDLE *pdev,
   
   ep = &pdev->dev.out_ep[ep_addr & 0x7F];
   
+  /* Double buffered endpoint: the SIE keeps receiving in the background and
+     may already hold the first packet of this transfer */
+  if (ep->doublebuffer != 0)
+  {
+    uint32_t primask = __get_PRIMASK();
+    
+    __disable_irq();
+    ep->xfer_buff = pbuf;  
+    ep->xfer_len = buf_len;
+    ep->xfer_count = 0; 
+    ep->dbuf_armed = 1;
+    DCD_EP_DblBufRx(pdev, ep);
+    __set_PRIMASK(primask);
+    
+    return USB_OK;
+  }
+  
   /*setup and start the Xfer */
   ep->xfer_buff = pbuf;  
   ep->xfer_len = buf_len;
@@ -371,17 +401,7 @@ uint32_t DCD_EP_PrepareRx( USB_CORE_HANDLE *pdev,
   }
   
   /* configure and validate Rx endpoint */
-  if (ep->doublebuffer == 0) 
-  {
-    /*Set RX buffer count*/
-    SetEPRxCount(ep->num, len);
-  }
-  else
-  {
-    /*Set the Double buffer counter*/
-    SetEPDblBuffCount(ep->num, ep->is_in, len);
-  } 
-  
+  SetEPRxCount(ep->num, len);
   SetEPRxStatus(ep->num, EP_RX_VALID);
   
   return USB_OK;
@@ -399,6 +419,28 @@ uint32_t  DCD_EP_Tx ( USB_CORE_HANDLE *pdev,
                      uint8_t   ep_addr,
                      uint8_t   *pbuf,
                      uint32_t   buf_len)
+{
+  return DCD_EP_TxRing(pdev, ep_addr, pbuf, buf_len, 0, 0);
+}
+
+/**
+  * @brief Transmit data from a ring buffer, the transfer may wrap from the 
+  *        end of the ring back to its start. The packet across the wrap is
+  *        gathered into the PMA from both parts.
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address
+  * @param  pbuf: pointer to Tx data, inside the ring
+  * @param  buf_len: data length, up to ring_size
+  * @param  ring: start of the ring buffer, 0 for a linear buffer
+  * @param  ring_size: size of the ring buffer
+  * @retval : status
+  */
+uint32_t  DCD_EP_TxRing ( USB_CORE_HANDLE *pdev,
+                         uint8_t   ep_addr,
+                         uint8_t   *pbuf,
+                         uint32_t   buf_len,
+                         uint8_t   *ring,
+                         uint32_t   ring_size)
 {
   __IO uint32_t len = 0; 
   USB_EP *ep;
@@ -410,6 +452,28 @@ uint32_t  DCD_EP_Tx ( USB_CORE_HANDLE *pdev,
   ep->xfer_buff = pbuf;  
   ep->xfer_len = buf_len;
   ep->xfer_count = 0; 
+  ep->xfer_ring = ring;
+  ep->xfer_ring_size = ring_size;
+  
+  /* Double buffered endpoint, idle with DTOG_TX equal to SW_BUF (DTOG_RX):
+     fill the buffer the SIE sends first and, for a multi packet transfer,
+     the other one too, so that the second packet follows without a NAK */
+  if (ep->doublebuffer != 0)
+  {
+    uint8_t sw_buf = (GetENDPOINT(ep->num) & EP_DTOG_RX) ? 1 : 0;
+    
+    DCD_EP_DblBufWrite(ep, sw_buf);
+    if (ep->xfer_len != 0)
+    {
+      DCD_EP_DblBufWrite(ep, sw_buf ^ 1);
+      ep->dbuf_filled = 1;
+    }
+    /* Hand the first buffer over to the SIE */
+    FreeUserBuffer(ep->num, EP_DBUF_IN);
+    SetEPTxStatus(ep->num, EP_TX_VALID);
+    
+    return USB_OK; 
+  }
   
   /*Multi packet transfer*/
   if (ep->xfer_len > ep->maxpacket)
@@ -424,33 +488,98 @@ uint32_t  DCD_EP_Tx ( USB_CORE_HANDLE *pdev,
   }
   
   /* configure and validate Tx endpoint */
-  if (ep->doublebuffer == 0) 
+  DCD_EP_WritePacket(ep, ep->pmaadress, len);
+  SetEPTxCount(ep->num, len);
+  if (ep->type == USB_EP_ISOC)
   {
-    UserToPMABufferCopy(ep->xfer_buff, ep->pmaadress, len);
-    SetEPTxCount(ep->num, len);
+    SetEPDblBuf1Count(ep->num, EP_DBUF_IN, len);
+  }
+  
+  SetEPTxStatus(ep->num, EP_TX_VALID);
+  
+  return USB_OK; 
+}
+
+/**
+  * @brief Copy the next packet of the current IN transfer to one buffer of a
+  *        double buffered endpoint. The buffer is not handed over to the SIE.
+  * @param  ep: IN endpoint
+  * @param  buf: buffer to fill, 0 or 1
+  * @retval : None
+  */
+void DCD_EP_DblBufWrite(USB_EP *ep, uint8_t buf)
+{
+  uint32_t len = ep->xfer_len;
+  
+  if (len > ep->maxpacket)
+  {
+    len = ep->maxpacket;
+  }
+  
+  if (buf == 0)
+  {
+    DCD_EP_WritePacket(ep, ep->pmaaddr0, len);
+    SetEPDblBuf0Count(ep->num, EP_DBUF_IN, len);
   }
   else
   {
-    uint16_t pmabuffer=0;
-    /*Set the Double buffer counter*/
-    SetEPDblBuffCount(ep->num, ep->is_in, len);
+    DCD_EP_WritePacket(ep, ep->pmaaddr1, len);
+    SetEPDblBuf1Count(ep->num, EP_DBUF_IN, len);
+  }
+  
+  DCD_EP_TxAdvance(ep, len);
+  ep->xfer_len -= len;
+  ep->xfer_count += len;
+}
+
+/**
+  * @brief Move the IN transfer pointer past the bytes sent, wrapping back to
+  *        the start of the ring buffer if any.
+  * @param  ep: IN endpoint
+  * @param  len: no. of bytes sent
+  * @retval : None
+  */
+void DCD_EP_TxAdvance(USB_EP *ep, uint32_t len)
+{
+  ep->xfer_buff += len;
+  
+  if ((ep->xfer_ring != 0) && 
+      (ep->xfer_buff >= ep->xfer_ring + ep->xfer_ring_size))
+  {
+    ep->xfer_buff -= ep->xfer_ring_size;
+  }
+}
+
+/**
+  * @brief Copy the next packet of the current IN transfer to the PMA. A
+  *        packet across the end of the ring buffer is gathered from the 
+  *        tail and the head of the ring.
+  * @param  ep: IN endpoint
+  * @param  pmaaddr: PMA buffer address
+  * @param  len: packet length
+  * @retval : None
+  */
+static void DCD_EP_WritePacket(USB_EP *ep, uint16_t pmaaddr, uint32_t len)
+{
+  PMA_Segment_TypeDef seg[2];
+  uint32_t tail;
+  
+  if (ep->xfer_ring != 0)
+  {
+    tail = (ep->xfer_ring + ep->xfer_ring_size) - ep->xfer_buff;
     
-    /*Write the data to the USB endpoint*/
-    if (GetENDPOINT(ep->num)&EP_DTOG_TX)
-    {
-      pmabuffer = ep->pmaaddr1;
-    }
-    else
+    if (len > tail)
     {
-      pmabuffer = ep->pmaaddr0;
+      seg[0].pBuf = ep->xfer_buff;
+      seg[0].wLen = (uint16_t)tail;
+      seg[1].pBuf = ep->xfer_ring;
+      seg[1].wLen = (uint16_t)(len - tail);
+      UserToPMABufferGather(seg, 2, pmaaddr);
+      return;
     }
-    UserToPMABufferCopy(ep->xfer_buff, pmabuffer, len);
-    FreeUserBuffer(ep->num, ep->is_in);
   }
   
-  SetEPTxStatus(ep->num, EP_TX_VALID);
-  
-  return USB_OK; 
+  UserToPMABufferCopy(ep->xfer_buff, pmaaddr, len);
 }
 
 
@@ -519,12 +648,24 @@ uint32_t  DCD_EP_ClrStall (USB_CORE_HANDLE *pdev, uint8_t epnum)
   if (ep->is_in)
   {
     ClearDTOG_TX(ep->num);
+    if (ep->doublebuffer != 0)
+    {
+      /* Drop the packet prepared for the SIE */
+      ClearDTOG_RX(ep->num);
+      ep->dbuf_filled = 0;
+    }
     SetEPTxStatus(ep->num, EP_TX_VALID);
     ep->is_stall = 0;  
   }
   else
   {
     ClearDTOG_RX(ep->num);
+    if (ep->doublebuffer != 0)
+    {
+      /* Drop a pending packet, both buffers go back to the SIE */
+      ClearDTOG_TX(ep->num);
+      ToggleDTOG_TX(ep->num);
+    }
     SetEPRxStatus(ep->num, EP_RX_VALID);
     ep->is_stall = 0;  
   }
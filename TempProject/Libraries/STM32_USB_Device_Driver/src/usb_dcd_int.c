@@ -42,6 +42,66 @@ __IO uint32_t BESL = 0;
 /* Private function prototypes -----------------------------------------------*/
 /* Private functions ---------------------------------------------------------*/
 
+/**
+  * @brief  Collect the packet a double buffered OUT endpoint holds for the
+  *         current transfer. The buffer is given back to the SIE before the
+  *         copy, so the next packet is received meanwhile.
+  * @param  pdev: device instance
+  * @param  ep: OUT endpoint
+  * @retval None
+  */
+void DCD_EP_DblBufRx(USB_CORE_HANDLE *pdev, USB_EP *ep)
+{
+  uint16_t wEPVal;
+  uint16_t count;
+  uint16_t pmabuffer;
+  
+  wEPVal = _GetENDPOINT(ep->num);
+  
+  /* A packet is pending once the SIE NAKs: DTOG_RX equals SW_BUF (DTOG_TX).
+     Without a transfer it stays in the PMA until DCD_EP_PrepareRx */
+  if ((ep->dbuf_armed == 0) ||
+      (((wEPVal & EP_DTOG_RX) != 0) != ((wEPVal & EP_DTOG_TX) != 0)))
+  {
+    return;
+  }
+  
+  if (wEPVal & EP_DTOG_RX)
+  {
+    /*read from endpoint BUF0Addr buffer*/
+    count = GetEPDblBuf0Count(ep->num);
+    pmabuffer = ep->pmaaddr0;
+  }
+  else
+  {
+    /*read from endpoint BUF1Addr buffer*/
+    count = GetEPDblBuf1Count(ep->num);
+    pmabuffer = ep->pmaaddr1;
+  }
+  FreeUserBuffer(ep->num, EP_DBUF_OUT);
+  
+  if (count > ep->xfer_len)
+  {
+    count = ep->xfer_len;
+  }
+  if (count != 0)
+  {
+    PMAToUserBufferCopy(ep->xfer_buff, pmabuffer, count);
+  }
+  
+  /*multi-packet on the NON control OUT endpoint*/
+  ep->xfer_count += count;
+  ep->xfer_buff += count;
+  ep->xfer_len -= count;
+  
+  if ((ep->xfer_len == 0) || (count < ep->maxpacket))
+  {
+    ep->dbuf_armed = 0;
+    /* RX COMPLETE */
+    USBD_DCD_INT_fops->DataOutStage(pdev, ep->num);
+  }
+}
+
 /**
   * @brief  Correct Transfer interrupt's service
   * @param  None
@@ -142,41 +202,24 @@ void CTR(void)
           {
             PMAToUserBufferCopy(ep->xfer_buff, ep->pmaadress, count);
           }
-        }
-        else
-        {
-          if (GetENDPOINT(ep->num) & EP_DTOG_RX)
+          
+          /*multi-packet on the NON control OUT endpoint*/
+          ep->xfer_count+=count;
+          ep->xfer_buff+=count;
+          
+          if ((ep->xfer_len == 0) || (count < ep->maxpacket))
           {
-            /*read from endpoint BUF0Addr buffer*/
-            count = GetEPDblBuf0Count(ep->num);
-            if (count != 0)
-            {
-              PMAToUserBufferCopy(ep->xfer_buff, ep->pmaaddr0, count);
-            }
+            /* RX COMPLETE */
+            USBD_DCD_INT_fops->DataOutStage(&USB_Device_dev, ep->num);
           }
           else
           {
-            /*read from endpoint BUF1Addr buffer*/
-            count = GetEPDblBuf1Count(ep->num);
-            if (count != 0)
-            {
-              PMAToUserBufferCopy(ep->xfer_buff, ep->pmaaddr1, count);
-            }
+            DCD_EP_PrepareRx (&USB_Device_dev,ep->num, ep->xfer_buff, ep->xfer_len);
           }
-          FreeUserBuffer(ep->num, EP_DBUF_OUT);  
-        }
-        /*multi-packet on the NON control OUT endpoint*/
-        ep->xfer_count+=count;
-        ep->xfer_buff+=count;
-       
-        if ((ep->xfer_len == 0) || (count < ep->maxpacket))
-        {
-          /* RX COMPLETE */
-          USBD_DCD_INT_fops->DataOutStage(&USB_Device_dev, ep->num);
         }
         else
         {
-          DCD_EP_PrepareRx (&USB_Device_dev,ep->num, ep->xfer_buff, ep->xfer_len);
+          DCD_EP_DblBufRx(&USB_Device_dev, ep);
         }
         
       } /* if((wEPVal & EP_CTR_RX) */
@@ -191,47 +234,53 @@ void CTR(void)
         /* IN double Buffering*/
         if (ep->doublebuffer == 0)
         {
-          ep->xfer_count = GetEPTxCount(ep->num);
-          if (ep->xfer_count != 0)
+          /*multi-packet on the NON control IN endpoint*/
+          ep->xfer_count =GetEPTxCount(ep->num);
+          DCD_EP_TxAdvance(ep, ep->xfer_count);
+          
+          /* Zero Length Packet? */
+          if (ep->xfer_len == 0)
           {
-            UserToPMABufferCopy(ep->xfer_buff, ep->pmaadress, ep->xfer_count);
+            /* TX COMPLETE */
+            USBD_DCD_INT_fops->DataInStage(&USB_Device_dev, ep->num);
+          }
+          else
+          {
+            DCD_EP_TxRing(&USB_Device_dev, ep->num, ep->xfer_buff, ep->xfer_len,
+                          ep->xfer_ring, ep->xfer_ring_size);
           }
         }
         else
         {
-          if (GetENDPOINT(ep->num) & EP_DTOG_TX)
+          wEPVal = _GetENDPOINT(EPindex);
+          
+          /* The SIE has sent its buffer and NAKs once DTOG_TX equals SW_BUF */
+          if (((wEPVal & EP_DTOG_TX) != 0) == ((wEPVal & EP_DTOG_RX) != 0))
           {
-            /*read from endpoint BUF0Addr buffer*/
-            ep->xfer_count = GetEPDblBuf0Count(ep->num);
-            if (ep->xfer_count != 0)
+            if (ep->dbuf_filled != 0)
             {
-              UserToPMABufferCopy(ep->xfer_buff, ep->pmaaddr0, ep->xfer_count);
+              /* Hand over the packet prepared meanwhile, then prepare the
+                 next one in the buffer just sent */
+              FreeUserBuffer(ep->num, EP_DBUF_IN);
+              ep->dbuf_filled = 0;
+              
+              if (_GetEPTxStatus(ep->num) == EP_TX_NAK)
+              {
+                SetEPTxStatus(ep->num, EP_TX_VALID);
+              }
+              
+              if (ep->xfer_len != 0)
+              {
+                DCD_EP_DblBufWrite(ep, (wEPVal & EP_DTOG_RX) ? 0 : 1);
+                ep->dbuf_filled = 1;
+              }
             }
-          }
-          else
-          {
-            /*read from endpoint BUF1Addr buffer*/
-            ep->xfer_count = GetEPDblBuf1Count(ep->num);
-            if (ep->xfer_count != 0)
+            else
             {
-              UserToPMABufferCopy(ep->xfer_buff, ep->pmaaddr1, ep->xfer_count);
+              /* TX COMPLETE */
+              USBD_DCD_INT_fops->DataInStage(&USB_Device_dev, ep->num);
             }
           }
-          FreeUserBuffer(ep->num, EP_DBUF_IN);  
-        }
-        /*multi-packet on the NON control IN endpoint*/
-        ep->xfer_count =GetEPTxCount(ep->num);
-        ep->xfer_buff+=ep->xfer_count;
-       
-        /* Zero Length Packet? */
-        if (ep->xfer_len == 0)
-        {
-          /* TX COMPLETE */
-          USBD_DCD_INT_fops->DataInStage(&USB_Device_dev, ep->num);
-        }
-        else
-        {
-          DCD_EP_Tx  (&USB_Device_dev,ep->num, ep->xfer_buff, ep->xfer_len);
         }
         
       } /* if((wEPVal & EP_CTR_TX) != 0) */
@@ -55,7 +55,38 @@
    in order to tolerate the fluctuations of out packets size) */
 #define AUDIO_OUT_MPS                                 384
 
-#define AUDIO_CONFIG_DESC_SIZE                        109
+/* Bytes of one sample of all channels, the unit of the DAC DMA */
+#define AUDIO_OUT_FRAME_SIZE                          ((DEFAULT_OUT_BIT_RESOLUTION/8) * DEFAULT_OUT_CHANNEL_NBR)
+
+/* Feedback endpoint of the asynchronous OUT endpoint: the host is sent the
+   number of samples per frame the DAC consumes, in 10.14 format, and adjusts
+   the size of the packets to it. AUDIO_FB_EP and the PMA addresses of the
+   two AUDIO_OUT_MPS buffers of the OUT endpoint (Audio_IN_TX_ADRESS) and of
+   the feedback (Audio_FB_TX_ADRESS) are set in audio_app_conf.h. The OUT
+   endpoint is double buffered, which takes both directions of its endpoint
+   number: the feedback needs another one. */
+#if !defined(AUDIO_FB_EP) || !defined(Audio_FB_TX_ADRESS)
+ #error "AUDIO_FB_EP and Audio_FB_TX_ADRESS must be defined"
+#endif
+#if ((AUDIO_FB_EP & 0x7F) == (AUDIO_OUT_EP & 0x7F))
+ #error "AUDIO_FB_EP must not share the endpoint number of AUDIO_OUT_EP"
+#endif
+#define AUDIO_FB_PACKET                               3
+/* The buffers follow those of EP0, in this order, within the 1 KB PMA */
+#if ((Audio_IN_TX_ADRESS & 0xFFFF) < (ENDP0_TX_ADDRESS + USB_MAX_EP0_SIZE)) || \
+    (((Audio_IN_TX_ADRESS >> 16) - (Audio_IN_TX_ADRESS & 0xFFFF)) < AUDIO_OUT_MPS) || \
+    ((Audio_FB_TX_ADRESS - (Audio_IN_TX_ADRESS >> 16)) < AUDIO_OUT_MPS) || \
+    ((Audio_FB_TX_ADRESS + AUDIO_FB_PACKET) > 0x400)
+ #error "The audio buffers of Audio_IN_TX_ADRESS and Audio_FB_TX_ADRESS overlap"
+#endif
+#define AUDIO_FB_REFRESH                              5   /* Sent every 2^5 = 32 frames */
+#define AUDIO_FB_NOMINAL                              ((DEFAULT_OUT_AUDIO_FREQ << 14) / 1000)
+/* The rate asked differs from the nominal one by 1 sample per frame at most */
+#define AUDIO_FB_RANGE                                (1 << 14)
+/* Fill level error, in samples, corrected by 1 sample per frame */
+#define AUDIO_FB_FILL_SHIFT                           6
+
+#define AUDIO_CONFIG_DESC_SIZE                        118
 #define AUDIO_INTERFACE_DESC_SIZE                     0x09
 #define USB_AUDIO_DESC_SIZ                            0x09
 #define AUDIO_STANDARD_ENDPOINT_DESC_SIZE             0x09
@@ -89,6 +120,7 @@
 #define AUDIO_FORMAT_TYPE_III                         0x03
 
 #define USB_ENDPOINT_TYPE_ISOCHRONOUS                 0x01
+#define USB_ENDPOINT_SYNC_ASYNCHRONOUS                0x04
 #define AUDIO_ENDPOINT_GENERAL                        0x01
 
 #define AUDIO_REQ_GET_CUR                             0x81
@@ -30,7 +30,7 @@
   *             - Audio Class-Specific AS Interfaces
   *             - AudioControl Requests: only SET_CUR and GET_CUR requests are supported (for Mute)
   *             - Audio Feature Unit (limited to Mute control)
-  *             - Audio Synchronization type: Asynchronous
+  *             - Audio Synchronization type: Asynchronous, with a feedback endpoint
   *             - Single fixed audio sampling rate (configurable in usbd_conf.h file)
   *          
   *           @note
@@ -112,10 +112,17 @@ static uint8_t  *USBD_audio_GetCfgDesc (uint8_t speed, uint16_t *length);
 static void AUDIO_Req_GetCurrent(void *pdev, USB_SETUP_REQ *req);
 static void AUDIO_Req_SetCurrent(void *pdev, USB_SETUP_REQ *req);
 
+/*********************************************
+   AUDIO synchronization functions
+ *********************************************/
+static void AUDIO_Fb_Reset(void);
+static void AUDIO_Fb_Update(void);
+
 /* Private variables ---------------------------------------------------------*/
  /* Main Buffer for Audio Data Out transfers and its related pointers */
-/* This is the main buffer where all out audio data are stored */
-uint8_t  IsocOutBuff [TOTAL_OUT_BUF_SIZE];
+/* This is the main buffer where all out audio data are stored, with room for
+   packets a little longer than AUDIO_OUT_PACKET as asked by the feedback */
+uint8_t  IsocOutBuff [TOTAL_OUT_BUF_SIZE + AUDIO_OUT_MPS];
 /* This is the pointer used by the write process (from host to device) */
 uint8_t* IsocOutWrPtr         = IsocOutBuff; 
 /* This is the pointer used by the read process (from buffers to I2S) */
@@ -129,6 +136,18 @@ uint32_t IsocOutRdBufDescIdx  = 0;
 uint8_t  IsocOutWrState       = STATE_IDLE;
 uint8_t  IsocOutRdState       = STATE_IDLE;
 
+/* Bytes received, bytes of the packets played and size of the one playing */
+uint32_t IsocOutWrTotal       = 0;
+uint32_t IsocOutRdTotal       = 0;
+uint32_t IsocOutRdSize        = 0;
+
+/* Feedback endpoint, see usbd_audio_SOF */
+uint8_t  AudioFbBuff[AUDIO_FB_PACKET];
+uint32_t AudioFbRate          = AUDIO_FB_NOMINAL; /* Measured, 10.14 samples per frame */
+uint32_t AudioFbFrame         = 0;                /* Frames of the measure */
+uint32_t AudioFbPlayed        = 0;                /* Samples played when it started */
+int32_t  AudioFbTrim          = 0;                /* Timer cycles trimmed, see usbd_audio_BuffXferCplt */
+
 /* Main Buffer for Audio Control Requests transfers and its related variables */
 uint8_t  AudioCtl[64];
 uint8_t  AudioCtlCmd          = 0;
@@ -233,7 +252,7 @@ const uint8_t usbd_audio_CfgDesc[AUDIO_CONFIG_DESC_SIZE] =
   USB_INTERFACE_DESCRIPTOR_TYPE,        /* bDescriptorType */
   0x01,                                 /* bInterfaceNumber */
   0x01,                                 /* bAlternateSetting */
-  0x01,                                 /* bNumEndpoints */
+  0x02,                                 /* bNumEndpoints */
   USB_DEVICE_CLASS_AUDIO,               /* bInterfaceClass */
   AUDIO_SUBCLASS_AUDIOSTREAMING,        /* bInterfaceSubClass */
   AUDIO_PROTOCOL_UNDEFINED,             /* bInterfaceProtocol */
@@ -279,12 +298,12 @@ const uint8_t usbd_audio_CfgDesc[AUDIO_CONFIG_DESC_SIZE] =
   AUDIO_STANDARD_ENDPOINT_DESC_SIZE,    /* bLength */
   USB_ENDPOINT_DESCRIPTOR_TYPE,         /* bDescriptorType */
   AUDIO_OUT_EP,                         /* bEndpointAddress 1 out endpoint*/
-  USB_ENDPOINT_TYPE_ISOCHRONOUS,        /* bmAttributes */
+  USB_ENDPOINT_TYPE_ISOCHRONOUS | USB_ENDPOINT_SYNC_ASYNCHRONOUS, /* bmAttributes */
   LOBYTE(AUDIO_OUT_MPS),                /* wMaxPacketSize */
   HIBYTE(AUDIO_OUT_MPS),
   0x01,                                 /* bInterval */
   0x00,                                 /* bRefresh */
-  0x00,                                 /* bSynchAddress */
+  AUDIO_FB_EP,                          /* bSynchAddress */
   /* 09 byte*/
 
   /* Endpoint - Audio Streaming Descriptor*/
@@ -300,6 +319,18 @@ const uint8_t usbd_audio_CfgDesc[AUDIO_CONFIG_DESC_SIZE] =
   0x00,                                 /* wLockDelay */
   0x00,
   /* 07 byte*/
+
+  /* USB Speaker Feedback Standard Endpoint Descriptor */
+  AUDIO_STANDARD_ENDPOINT_DESC_SIZE,    /* bLength */
+  USB_ENDPOINT_DESCRIPTOR_TYPE,         /* bDescriptorType */
+  AUDIO_FB_EP,                          /* bEndpointAddress 1 in endpoint*/
+  USB_ENDPOINT_TYPE_ISOCHRONOUS,        /* bmAttributes */
+  AUDIO_FB_PACKET,                      /* wMaxPacketSize: 10.14 format */
+  0x00,
+  0x01,                                 /* bInterval */
+  AUDIO_FB_REFRESH,                     /* bRefresh */
+  0x00,                                 /* bSynchAddress */
+  /* 09 byte*/
 };
 
 /* AUDIO interface class callbacks structure */
@@ -331,7 +362,12 @@ static uint8_t  usbd_audio_Init (void  *pdev,
   /* Open EP OUT */
   DCD_PMA_Config(pdev, AUDIO_OUT_EP, USB_DBL_BUF, Audio_IN_TX_ADRESS);
 
-  DCD_EP_Open(pdev, AUDIO_OUT_EP, AUDIO_OUT_PACKET, USB_EP_ISOC);
+  DCD_EP_Open(pdev, AUDIO_OUT_EP, AUDIO_OUT_MPS, USB_EP_ISOC);
+
+  /* Open EP IN of the feedback, sent each time the host asks for it */
+  DCD_PMA_Config(pdev, AUDIO_FB_EP, USB_SNG_BUF, Audio_FB_TX_ADRESS);
+
+  DCD_EP_Open(pdev, AUDIO_FB_EP, AUDIO_FB_PACKET, USB_EP_ISOC);
 
   /* Initialize the Audio output Hardware layer */ 
   if (AUDIO_OUT_fops.Init(DEFAULT_OUT_AUDIO_FREQ, DEFAULT_VOLUME, (DEFAULT_OUT_CHANNEL_NBR << 6 | DEFAULT_OUT_BIT_RESOLUTION)) != USBD_OK)
@@ -347,7 +383,10 @@ static uint8_t  usbd_audio_Init (void  *pdev,
   DCD_EP_PrepareRx(pdev,
                    AUDIO_OUT_EP,
                    (uint8_t*)IsocOutBuff,
-                   AUDIO_OUT_PACKET);  
+                   AUDIO_OUT_MPS);  
+
+  AUDIO_Fb_Reset();
+  DCD_EP_Tx(pdev, AUDIO_FB_EP, AudioFbBuff, AUDIO_FB_PACKET);
 
   return USBD_OK;
 }
@@ -363,6 +402,7 @@ static uint8_t  usbd_audio_DeInit (void  *pdev,
                                    uint8_t cfgidx)
 {
   DCD_EP_Close (pdev , AUDIO_OUT_EP);
+  DCD_EP_Close (pdev , AUDIO_FB_EP);
 
   /* DeInitialize the Audio output Hardware layer */
   if (AUDIO_OUT_fops.DeInit() != USBD_OK)
@@ -483,6 +523,11 @@ static uint8_t  usbd_audio_EP0_RxReady (void  *pdev)
   */
 static uint8_t  usbd_audio_DataIn (void *pdev, uint8_t epnum)
 {
+  if (epnum == (AUDIO_FB_EP & 0x7F))
+  {
+    /* Feedback sent: the next IN token gets the latest value */
+    DCD_EP_Tx(pdev, AUDIO_FB_EP, AudioFbBuff, AUDIO_FB_PACKET);
+  }
   return USBD_OK;
 }
 
@@ -495,12 +540,13 @@ static uint8_t  usbd_audio_DataIn (void *pdev, uint8_t epnum)
   */
 static uint8_t  usbd_audio_DataOut (void *pdev, uint8_t epnum)
 {
-  uint32_t IsocOutPacketSze = AUDIO_OUT_PACKET;
+  uint32_t IsocOutPacketSze = AUDIO_OUT_MPS;
   if (epnum == AUDIO_OUT_EP)
   {
     /* Set the Isochronous Buffer Out linked chain parameters */
     IsocOutBufDesc[IsocOutWrBufDescIdx].Size = ((USB_CORE_HANDLE*)pdev)->dev.out_ep[epnum].xfer_count;
     IsocOutBufDesc[IsocOutWrBufDescIdx].Next = (uint8_t*)(IsocOutWrPtr + IsocOutBufDesc[IsocOutWrBufDescIdx].Size);
+    IsocOutWrTotal += IsocOutBufDesc[IsocOutWrBufDescIdx].Size;
 
 #if (DEFAULT_OUT_BIT_RESOLUTION == 16)
     WAVADDON_AudioProcessing(IsocOutWrPtr, IsocOutBufDesc[IsocOutWrBufDescIdx].Size);
@@ -584,6 +630,7 @@ static uint8_t  usbd_audio_SOF (void *pdev)
     if (IsocOutRdState == STATE_IDLE)
     {
       /* Start playing received packet */
+      IsocOutRdSize = IsocOutBufDesc[IsocOutRdBufDescIdx].Size;
       AUDIO_OUT_fops.AudioCmd(IsocOutBuff,                               /* Samples buffer pointer */
                               IsocOutBufDesc[IsocOutRdBufDescIdx].Size,  /* Number of samples in Bytes */
                               AUDIO_CMD_PLAY);                           /* Command to be processed */   
@@ -625,8 +672,11 @@ static uint8_t  usbd_audio_SOF (void *pdev)
     IsocOutWrPtr = IsocOutBuff;
     IsocOutRdBufDescIdx = 0;
     IsocOutWrBufDescIdx = 0;
+    AUDIO_Fb_Reset();
   }
 
+  AUDIO_Fb_Update();
+
   return USBD_OK;
 }
 
@@ -642,11 +692,16 @@ void usbd_audio_BuffXferCplt (uint8_t** pbuf, uint32_t* pSize)
 {
   uint8_t* pRdPtr = IsocOutRdPtr;
   uint32_t currDistanceOut = 0;
+  int32_t  trim = 0;
   
   if (IsocOutRdState & STATE_RUN)
   {
     STM_EVAL_LEDToggle(LED2);
     
+    /* The packet just played, and the one starting */
+    IsocOutRdTotal += IsocOutRdSize;
+    IsocOutRdSize = IsocOutBufDesc[IsocOutRdBufDescIdx].Size;
+    
     if (IsocOutRdBufDescIdx == 0)
     {
       /* Start playing received packet */
@@ -681,22 +736,30 @@ void usbd_audio_BuffXferCplt (uint8_t** pbuf, uint32_t* pSize)
             (uint32_t)(IsocOutBufDesc[OUT_PACKET_NUM-1].Next));    
     }
     
-    /* Speed-up the timer (trigger of DAC) when the distance between write buffer
-    and read buffer pointers is higher than 3/4 buffer size */
-    if(currDistanceOut > 1176)/* 3/4 buffer size = 1568 * 3/4 = 1176 */
+    /* The feedback keeps the distance between write buffer and read buffer
+    pointers around half the buffer size. The DAC trigger is only trimmed by
+    one timer cycle near an end of the buffer, for a host ignoring the feedback */
+    if(currDistanceOut > (TOTAL_OUT_BUF_SIZE * 7) / 8)
     {
-      TIM6->ARR = 998;/* This value is hard-coded for 48KHz: 48MHz/48KHz - 2 */
+      trim = 1;
     }
-    /* Slow-down the timer (trigger of DAC) when the distance between write buffer
-    and read buffer pointers is lower than 1/4 buffer size */
-    else if(currDistanceOut < 392)/* 1/4 buffer size = 1568 * 1/4 = 392 */
+    else if(currDistanceOut < TOTAL_OUT_BUF_SIZE / 8)
     {
-      TIM6->ARR = 1000;/* This value is hard-coded for 48KHz: 48MHz/48KHz */
+      trim = -1;
+    }
+    else if ((currDistanceOut > (TOTAL_OUT_BUF_SIZE * 3) / 8) &&
+             (currDistanceOut < (TOTAL_OUT_BUF_SIZE * 5) / 8))
+    {
+      trim = 0;
     }
-    /* Set the default timer frequency */
     else
     {
-      TIM6->ARR = 999;/* This value is hard-coded for 48KHz: 48MHz/48KHz - 1 */
+      trim = AudioFbTrim;
+    }
+    if (trim != AudioFbTrim)
+    {
+      EVAL_AUDIO_SamplingRateTrimm(trim - AudioFbTrim);
+      AudioFbTrim = trim;
     }
     /* Increment the read buffer descriptor index */
     IsocOutRdBufDescIdx++;  
@@ -710,6 +773,89 @@ void usbd_audio_BuffXferCplt (uint8_t** pbuf, uint32_t* pSize)
   }
 }
 
+/******************************************************************************
+     AUDIO synchronization
+******************************************************************************/
+/**
+  * @brief  AUDIO_Fb_Reset
+  *         Restarts the feedback from the nominal rate.
+  * @param  None
+  * @retval None
+  */
+static void AUDIO_Fb_Reset(void)
+{
+  if (AudioFbTrim != 0)
+  {
+    EVAL_AUDIO_SamplingRateTrimm(-AudioFbTrim);
+    AudioFbTrim = 0;
+  }
+  IsocOutWrTotal = 0;
+  IsocOutRdTotal = 0;
+  IsocOutRdSize = 0;
+  AudioFbRate = AUDIO_FB_NOMINAL;
+  AudioFbFrame = 0;
+  AudioFbPlayed = 0;
+  AudioFbBuff[0] = BYTE_0(AUDIO_FB_NOMINAL);
+  AudioFbBuff[1] = BYTE_1(AUDIO_FB_NOMINAL);
+  AudioFbBuff[2] = BYTE_2(AUDIO_FB_NOMINAL);
+}
+
+/**
+  * @brief  AUDIO_Fb_Update
+  *         Computes the feedback value at each SOF: the rate of the DAC
+  *         measured over 2^AUDIO_FB_REFRESH frames, corrected by the distance
+  *         of the buffer fill level to its half.
+  * @param  None
+  * @retval None
+  */
+static void AUDIO_Fb_Update(void)
+{
+  uint32_t played = 0, fill = 0, feedback = 0;
+  int32_t  error = 0;
+  
+  if ((IsocOutRdState & STATE_RUN) == 0)
+  {
+    return;
+  }
+  
+  /* Samples played: packets done, and the part of the current one the DMA
+     has sent to the DAC */
+  __disable_irq();
+  played = (IsocOutRdTotal + IsocOutRdSize - Audio_MAL_GetRemBytes()) / AUDIO_OUT_FRAME_SIZE;
+  fill = IsocOutWrTotal / AUDIO_OUT_FRAME_SIZE - played;
+  __enable_irq();
+  
+  if (AudioFbFrame == 0)
+  {
+    AudioFbPlayed = played;
+  }
+  if (++AudioFbFrame <= (1 << AUDIO_FB_REFRESH))
+  {
+    return;
+  }
+  
+  /* Samples of the period in 10.14 per frame, averaged with the former measures */
+  AudioFbRate += (int32_t)(((played - AudioFbPlayed) << (14 - AUDIO_FB_REFRESH)) - AudioFbRate) / 4;
+  AudioFbPlayed = played;
+  AudioFbFrame = 1;
+  
+  error = (int32_t)(TOTAL_OUT_BUF_SIZE / (2 * AUDIO_OUT_FRAME_SIZE)) - (int32_t)fill;
+  feedback = AudioFbRate + error * (1 << (14 - AUDIO_FB_FILL_SHIFT));
+  
+  if (feedback > AUDIO_FB_NOMINAL + AUDIO_FB_RANGE)
+  {
+    feedback = AUDIO_FB_NOMINAL + AUDIO_FB_RANGE;
+  }
+  else if (feedback < AUDIO_FB_NOMINAL - AUDIO_FB_RANGE)
+  {
+    feedback = AUDIO_FB_NOMINAL - AUDIO_FB_RANGE;
+  }
+  
+  AudioFbBuff[0] = BYTE_0(feedback);
+  AudioFbBuff[1] = BYTE_1(feedback);
+  AudioFbBuff[2] = BYTE_2(feedback);
+}
+
 /******************************************************************************
      AUDIO Class requests management
 ******************************************************************************/
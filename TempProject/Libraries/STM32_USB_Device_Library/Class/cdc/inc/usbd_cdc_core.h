@@ -55,6 +55,14 @@
         
 #define CDC_DATA_OUT_PACKET_SIZE               CDC_DATA_MAX_PACKET_SIZE
 
+/* Max size of one IN transfer started from Handle_USBAsynchXfer */
+#ifndef CDC_IN_BATCH_SIZE
+ #define CDC_IN_BATCH_SIZE                     CDC_DATA_IN_PACKET_SIZE
+#endif
+
+/* APP_RX_DATA_SIZE is a power of two */
+#define APP_RX_DATA_MASK                       (APP_RX_DATA_SIZE - 1)
+
 /*---------------------------------------------------------------------*/
 /*  CDC definitions                                                    */
 /*---------------------------------------------------------------------*/
@@ -84,11 +92,25 @@ typedef struct _CDC_IF_PROP
 }
 CDC_IF_Prop_TypeDef;
 
+/* Data path counters, the throughput is xxBytes / Frames in bytes per ms */
+typedef struct _CDC_STATS
+{
+  uint32_t Frames;      /* SOF count */
+  uint32_t TxBytes;     /* bytes sent on the IN pipe */
+  uint32_t TxOverrun;   /* bytes dropped by the application, buffer full */
+  uint32_t RxBytes;     /* bytes received on the OUT pipe */
+  uint32_t RxOverrun;   /* bytes refused by pIf_DataRx */
+}
+CDC_Stats_TypeDef;
+
 /* Exported macros -----------------------------------------------------------*/
 /* Exported variables --------------------------------------------------------*/
 extern USBD_Class_cb_TypeDef  USBD_CDC_cb;
+extern CDC_Stats_TypeDef      CDC_Stats;
 
 /* Exported functions ------------------------------------------------------- */ 
+uint8_t  usbd_cdc_PrepareRx (void *pdev, uint8_t *buf, uint32_t len);
+void     usbd_cdc_Kick      (void *pdev);
 
 #endif  /* __USB_CDC_CORE_H_ */
   
@@ -68,6 +68,15 @@
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+#if (APP_RX_DATA_SIZE & (APP_RX_DATA_SIZE - 1)) != 0
+ #error "APP_RX_DATA_SIZE must be a power of two"
+#endif
+
+/* OUT pipe states */
+#define CDC_RX_AUTO                    0  /* USB_Rx_Buffer, rearmed by the core */
+#define CDC_RX_USER                    1  /* receiving into the consumer buffer */
+#define CDC_RX_HOLD                    2  /* waiting for the next consumer buffer */
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 /* Private function prototypes -----------------------------------------------*/ 
@@ -102,11 +111,22 @@ uint8_t APP_Rx_Buffer   [APP_RX_DATA_SIZE] ;
 
 uint8_t CmdBuff[CDC_CMD_PACKET_SZE] ;
 __IO uint32_t last_packet = 0;
-uint32_t APP_Rx_ptr_in  = 0;
-uint32_t APP_Rx_ptr_out = 0;
-uint32_t APP_Rx_length  = 0;
+/* APP_Rx_Buffer is a single producer/single consumer ring: APP_Rx_ptr_in is
+   only written by the application, APP_Rx_ptr_out only by the IN pipe.
+   Both are free running, the buffer index is ptr & APP_RX_DATA_MASK and
+   the number of bytes pending is APP_Rx_ptr_in - APP_Rx_ptr_out. */
+__IO uint32_t APP_Rx_ptr_in  = 0;
+__IO uint32_t APP_Rx_ptr_out = 0;
+uint32_t APP_Rx_length  = 0; /* size of the IN transfer in progress */
+
+__IO uint8_t  USB_Tx_State = 0;
 
-uint8_t  USB_Tx_State = 0;
+/* Consumer buffer for the OUT pipe */
+__IO uint8_t  USB_Rx_State = CDC_RX_AUTO;
+uint8_t  *USB_Rx_pBuf;
+uint32_t USB_Rx_Len;
+
+CDC_Stats_TypeDef CDC_Stats;
 
 static uint32_t cdcCmd = 0xFF;
 static uint32_t cdcLen = 0;
@@ -232,9 +252,9 @@ const uint8_t usbd_cdc_CfgDesc[USB_CDC_CONFIG_DESC_SIZ] =
 uint8_t  usbd_cdc_Init (void  *pdev, 
                                uint8_t cfgidx)
 {
-  DCD_PMA_Config(pdev , CDC_IN_EP,USB_SNG_BUF,BULK_IN_TX_ADDRESS);
+  DCD_PMA_Config(pdev , CDC_IN_EP,BULK_EP_KIND,BULK_IN_TX_ADDRESS);
   DCD_PMA_Config(pdev , CDC_CMD_EP,USB_SNG_BUF,INT_IN_TX_ADDRESS);
-  DCD_PMA_Config(pdev , CDC_OUT_EP,USB_SNG_BUF,BULK_OUT_RX_ADDRESS);
+  DCD_PMA_Config(pdev , CDC_OUT_EP,BULK_EP_KIND,BULK_OUT_RX_ADDRESS);
 
   /* Open EP IN */
   DCD_EP_Open(pdev,
@@ -256,14 +276,30 @@ uint8_t  usbd_cdc_Init (void  *pdev,
   
 
   
+  /* Restart the IN pipe, an interrupted batch is sent again */
+  USB_Tx_State = 0;
+  APP_Rx_length = 0;
+  last_packet = 0;
+  
   /* Initialize the Interface physical components */
   APP_FOPS.pIf_Init();
 
-  /* Prepare Out endpoint to receive next packet */
-  DCD_EP_PrepareRx(pdev,
-                   CDC_OUT_EP,
-                   (uint8_t*)(USB_Rx_Buffer),
-                   CDC_DATA_OUT_PACKET_SIZE);
+  /* Prepare Out endpoint to receive next packet, into the consumer buffer
+     if one was given before the configuration */
+  if (USB_Rx_State == CDC_RX_AUTO)
+  {
+    DCD_EP_PrepareRx(pdev,
+                     CDC_OUT_EP,
+                     (uint8_t*)(USB_Rx_Buffer),
+                     CDC_DATA_OUT_PACKET_SIZE);
+  }
+  else if (USB_Rx_State == CDC_RX_USER)
+  {
+    DCD_EP_PrepareRx(pdev,
+                     CDC_OUT_EP,
+                     USB_Rx_pBuf,
+                     USB_Rx_Len);
+  }
   
   return USBD_OK;
 }
@@ -422,49 +458,34 @@ uint8_t  usbd_cdc_EP0_RxReady (void  *pdev)
   */
 uint8_t  usbd_cdc_DataIn (void *pdev, uint8_t epnum)
 {
-  uint16_t USB_Tx_ptr;
-  uint16_t USB_Tx_length;
-  
   if (USB_Tx_State == 1)
   {
-    if (APP_Rx_length == 0) 
+    /* The whole batch is sent: give its room back to the application */
+    if (APP_Rx_length != 0)
     {
-      if (last_packet ==1)
-      {
-        last_packet =0;
-        
-        /*Send zero-length packet*/
-        DCD_EP_Tx (pdev, CDC_IN_EP, 0, 0);
-      }
-      else
-      {
-        USB_Tx_State = 0;
-      }
+      APP_Rx_ptr_out += APP_Rx_length;
+      CDC_Stats.TxBytes += APP_Rx_length;
+      APP_Rx_length = 0;
     }
-    else 
+    
+    if (APP_Rx_ptr_out != APP_Rx_ptr_in)
     {
-      if (APP_Rx_length > CDC_DATA_IN_PACKET_SIZE){
-        USB_Tx_ptr = APP_Rx_ptr_out;
-        USB_Tx_length = CDC_DATA_IN_PACKET_SIZE;
-        
-        APP_Rx_ptr_out += CDC_DATA_IN_PACKET_SIZE;
-        APP_Rx_length -= CDC_DATA_IN_PACKET_SIZE;    
-      }
-      else 
-      {
-        USB_Tx_ptr = APP_Rx_ptr_out;
-        USB_Tx_length = APP_Rx_length;
-        
-        APP_Rx_ptr_out += APP_Rx_length;
-        APP_Rx_length = 0;
-        if (APP_Rx_length == CDC_DATA_IN_PACKET_SIZE) last_packet = 1;
-      }
+      /* More data: chain the next transfer without waiting for the SOF, 
+         the host transfer goes on so no zero-length packet is needed */
+      USB_Tx_State = 0;
+      Handle_USBAsynchXfer(pdev);
+    }
+    else if (last_packet == 1)
+    {
+      /* The data ended on a full packet: end the host transfer */
+      last_packet = 0;
       
-      /* Prepare the available data buffer to be sent on IN endpoint */
-      DCD_EP_Tx (pdev,
-                 CDC_IN_EP,
-                 (uint8_t*)&APP_Rx_Buffer[USB_Tx_ptr],
-                 USB_Tx_length);
+      /*Send zero-length packet*/
+      DCD_EP_Tx (pdev, CDC_IN_EP, 0, 0);
+    }
+    else
+    {
+      USB_Tx_State = 0;
     }
   }  
   
@@ -480,24 +501,95 @@ uint8_t  usbd_cdc_DataIn (void *pdev, uint8_t epnum)
   */
 uint8_t  usbd_cdc_DataOut (void *pdev, uint8_t epnum)
 {      
-  uint16_t USB_Rx_Cnt;
+  uint32_t USB_Rx_Cnt;
+  
+  if (USB_Rx_State == CDC_RX_USER)
+  {
+    /* The consumer buffer is complete (full or short packet). The endpoint
+       stays NAKed until the consumer gives the next one. */
+    USB_Rx_Cnt = ((USB_CORE_HANDLE*)pdev)->dev.out_ep[epnum].xfer_buff - USB_Rx_pBuf;
+    USB_Rx_State = CDC_RX_HOLD;
+    CDC_Stats.RxBytes += USB_Rx_Cnt;
+    
+    APP_FOPS.pIf_DataRx(USB_Rx_pBuf, USB_Rx_Cnt);
+    return USBD_OK;
+  }
   
   /* Get the received data buffer and update the counter */
   USB_Rx_Cnt = ((USB_CORE_HANDLE*)pdev)->dev.out_ep[epnum].xfer_count;
+  CDC_Stats.RxBytes += USB_Rx_Cnt;
   
   /* USB data will be immediately processed, this allow next USB traffic being 
      NAKed till the end of the application Xfer */
-  APP_FOPS.pIf_DataRx(USB_Rx_Buffer, USB_Rx_Cnt);
+  if (APP_FOPS.pIf_DataRx(USB_Rx_Buffer, USB_Rx_Cnt) != USBD_OK)
+  {
+    CDC_Stats.RxOverrun += USB_Rx_Cnt;
+  }
   
-  /* Prepare Out endpoint to receive next packet */
-  DCD_EP_PrepareRx(pdev,
-                   CDC_OUT_EP,
-                   (uint8_t*)(USB_Rx_Buffer),
-                   CDC_DATA_OUT_PACKET_SIZE);
+  /* Prepare Out endpoint to receive next packet, unless pIf_DataRx switched
+     to a consumer buffer */
+  if (USB_Rx_State == CDC_RX_AUTO)
+  {
+    DCD_EP_PrepareRx(pdev,
+                     CDC_OUT_EP,
+                     (uint8_t*)(USB_Rx_Buffer),
+                     CDC_DATA_OUT_PACKET_SIZE);
+  }
+
+  return USBD_OK;
+}
 
+/**
+  * @brief  usbd_cdc_PrepareRx
+  *         Give a consumer buffer to the OUT pipe: the data is received 
+  *         straight into it, without going through USB_Rx_Buffer. 
+  *         pIf_DataRx is called with this buffer once it is full or a short
+  *         packet is received, then the host is NAKed until the next call.
+  * @note   To be called from pIf_DataRx or with the USB interrupt disabled.
+  * @param  pdev: device instance
+  * @param  buf: consumer buffer
+  * @param  len: buffer size, a multiple of CDC_DATA_OUT_PACKET_SIZE
+  * @retval status
+  */
+uint8_t  usbd_cdc_PrepareRx (void *pdev, uint8_t *buf, uint32_t len)
+{
+  if ((USB_Rx_State == CDC_RX_USER) || (len < CDC_DATA_OUT_PACKET_SIZE) ||
+      (len % CDC_DATA_OUT_PACKET_SIZE))
+  {
+    return USBD_FAIL;
+  }
+  
+  USB_Rx_pBuf = buf;
+  USB_Rx_Len = len;
+  USB_Rx_State = CDC_RX_USER;
+  
+  /* Otherwise the endpoint is armed by usbd_cdc_Init */
+  if (((USB_CORE_HANDLE*)pdev)->dev.device_status == USB_CONFIGURED)
+  {
+    DCD_EP_PrepareRx(pdev,
+                     CDC_OUT_EP,
+                     buf,
+                     len);
+  }
   return USBD_OK;
 }
 
+/**
+  * @brief  usbd_cdc_Kick
+  *         Start sending the pending IN data now rather than at the next
+  *         SOF interval.
+  * @note   To be called with the USB interrupt disabled.
+  * @param  pdev: device instance
+  * @retval None
+  */
+void  usbd_cdc_Kick (void *pdev)
+{
+  if (((USB_CORE_HANDLE*)pdev)->dev.device_status == USB_CONFIGURED)
+  {
+    Handle_USBAsynchXfer(pdev);
+  }
+}
+
 /**
   * @brief  usbd_CDC_SOF
   *         Start Of Frame event management
@@ -509,6 +601,8 @@ uint8_t  usbd_cdc_SOF (void *pdev)
 {      
   static uint32_t FrameCount = 0;
   
+  CDC_Stats.Frames++;
+  
   if (FrameCount++ == CDC_IN_FRAME_INTERVAL)
   {
     /* Reset the frame counter */
@@ -529,57 +623,39 @@ uint8_t  usbd_cdc_SOF (void *pdev)
   */
 static void Handle_USBAsynchXfer (void *pdev)
 {
-  uint16_t USB_Tx_ptr;
-  uint16_t USB_Tx_length;
+  uint32_t ptr_out;
   
   if(USB_Tx_State != 1)
   {
-    if (APP_Rx_ptr_out == APP_RX_DATA_SIZE)
-    {
-      APP_Rx_ptr_out = 0;
-    }
+    ptr_out = APP_Rx_ptr_out & APP_RX_DATA_MASK;
     
-    if(APP_Rx_ptr_out == APP_Rx_ptr_in) 
+    /* Snapshot, the application may go on writing meanwhile */
+    APP_Rx_length = APP_Rx_ptr_in - APP_Rx_ptr_out;
+    
+    if(APP_Rx_length == 0) 
     {
       USB_Tx_State = 0; 
       return;
     }
     
-    if(APP_Rx_ptr_out > APP_Rx_ptr_in) /* rollback */
-    { 
-      APP_Rx_length = APP_RX_DATA_SIZE - APP_Rx_ptr_out;
-      
-    }
-    else 
+    /* Send everything pending in one multi-packet transfer, up to the
+       batch size. The transfer goes on across the end of the buffer, the 
+       packet on the wrap is gathered from both ends. APP_Rx_ptr_out only 
+       moves once the data is sent. */
+    if (APP_Rx_length > CDC_IN_BATCH_SIZE)
     {
-      APP_Rx_length = APP_Rx_ptr_in - APP_Rx_ptr_out;
-      
+      APP_Rx_length = CDC_IN_BATCH_SIZE;
     }
+    last_packet = ((APP_Rx_length % CDC_DATA_IN_PACKET_SIZE) == 0) ? 1 : 0;
     
-    if (APP_Rx_length > CDC_DATA_IN_PACKET_SIZE)
-    {
-      USB_Tx_ptr = APP_Rx_ptr_out;
-      USB_Tx_length = CDC_DATA_IN_PACKET_SIZE;
-      
-      APP_Rx_ptr_out += CDC_DATA_IN_PACKET_SIZE;	
-      APP_Rx_length -= CDC_DATA_IN_PACKET_SIZE;
-    }
-    else
-    {
-      USB_Tx_ptr = APP_Rx_ptr_out;
-      USB_Tx_length = APP_Rx_length;
-      
-      APP_Rx_ptr_out += APP_Rx_length;
-      APP_Rx_length = 0;
-      if (USB_Tx_length == CDC_DATA_IN_PACKET_SIZE) last_packet = 1; //IBA
-      if (APP_Rx_ptr_in == 64) APP_Rx_ptr_in=0;
-    }
     USB_Tx_State = 1; 
     
-    DCD_EP_Tx (pdev,
-               CDC_IN_EP,
-               (uint8_t*)&APP_Rx_Buffer[USB_Tx_ptr],
-               USB_Tx_length);
+    DCD_EP_TxRing (pdev,
+                   CDC_IN_EP,
+                   (uint8_t*)&APP_Rx_Buffer[ptr_out],
+                   APP_Rx_length,
+                   (uint8_t*)APP_Rx_Buffer,
+                   APP_RX_DATA_SIZE);
   }  
   
 }
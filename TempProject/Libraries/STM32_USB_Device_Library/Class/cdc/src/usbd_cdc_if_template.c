@@ -37,9 +37,9 @@
 extern uint8_t  APP_Rx_Buffer []; /* Write CDC received data in this buffer.
                                      These data will be sent over USB IN endpoint
                                      in the CDC core functions. */
-extern uint32_t APP_Rx_ptr_in;    /* Increment this pointer or roll it back to
-                                     start address when writing received data
-                                     in the buffer APP_Rx_Buffer. */
+extern __IO uint32_t APP_Rx_ptr_in;    /* Increment this free running pointer when 
+                                     writing received data in the buffer 
+                                     APP_Rx_Buffer, at APP_Rx_ptr_in & APP_RX_DATA_MASK. */
 
 /* Private function prototypes -----------------------------------------------*/
 static uint16_t TEMPLATE_Init     (void);
@@ -157,18 +157,12 @@ static uint16_t TEMPLATE_DataTx (uint8_t* Buf, uint32_t Len)
   /* Get the data to be sent */
   for (i = 0; i < Len; i++)
   {
-    /* APP_Rx_Buffer[APP_Rx_ptr_in] = XXX_ReceiveData(XXX); */
+    /* APP_Rx_Buffer[APP_Rx_ptr_in & APP_RX_DATA_MASK] = XXX_ReceiveData(XXX); */
   }
 
-  /* Increment the in pointer */
+  /* Increment the in pointer, it rolls back through the mask */
   APP_Rx_ptr_in++;
   
-  /* To avoid buffer overflow */
-  if(APP_Rx_ptr_in == APP_RX_DATA_SIZE)
-  {
-    APP_Rx_ptr_in = 0;
-  }  
-  
   return USBD_OK;
 }
 
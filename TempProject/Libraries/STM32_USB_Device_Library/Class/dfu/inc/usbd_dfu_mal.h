@@ -40,19 +40,54 @@ typedef struct _DFU_MAL_PROP
   uint16_t (*pMAL_Init)     (void);   
   uint16_t (*pMAL_DeInit)   (void);   
   uint16_t (*pMAL_Erase)    (uint32_t Add);
-  uint16_t (*pMAL_Write)    (uint32_t Add, uint32_t Len);
+  uint16_t (*pMAL_Write)    (uint32_t Add, uint8_t *Buf, uint32_t Len);
   uint8_t  *(*pMAL_Read)    (uint32_t Add, uint32_t Len);
   uint16_t (*pMAL_CheckAdd) (uint32_t Add);
-  const uint32_t EraseTiming;
-  const uint32_t WriteTiming;
+  const uint32_t EraseTiming;   /* ms per sector */
+  const uint32_t WriteTiming;   /* ms per 1024 bytes */
 }
 DFU_MAL_Prop_TypeDef;
 
+/* Erase or write waiting in the media queue */
+typedef struct _DFU_MAL_JOB
+{
+  uint8_t  Cmd;
+  uint32_t Add;
+  uint32_t Len;
+  uint32_t Done;
+}
+MAL_Job_TypeDef;
+
 
 /* Exported defines --------------------------------------------------------*/
 #define MAL_OK                          0
 #define MAL_FAIL                        1
 
+/* Media jobs */
+#define MAL_JOB_NONE                    0
+#define MAL_JOB_ERASE                   1
+#define MAL_JOB_WRITE                   2
+#define MAL_JOB_FLUSH                   3
+
+/* Download buffers: the host fills one while the other is programmed */
+#ifndef MAL_BUF_NBR
+#define MAL_BUF_NBR                     2
+#endif
+
+/* Bytes programmed by one MAL_Process() step */
+#ifndef MAL_WRITE_CHUNK
+#define MAL_WRITE_CHUNK                 256
+#endif
+
+/* MAL_Poll() erases the sector following the last block written while the
+   host sends the next one. The sector size is XFERSIZE unless given. */
+#ifndef MAL_ERASE_AHEAD
+#define MAL_ERASE_AHEAD                 0
+#endif
+#ifndef MAL_SECTOR_SIZE
+#define MAL_SECTOR_SIZE                 XFERSIZE
+#endif
+
 /* Exported macro ------------------------------------------------------------*/
 #define _1st_BYTE(x)  (uint8_t)((x)&0xFF)             /* 1st addressing cycle */
 #define _2nd_BYTE(x)  (uint8_t)(((x)&0xFF00)>>8)      /* 2nd addressing cycle */
@@ -69,9 +104,15 @@ uint16_t MAL_DeInit (void);
 uint16_t MAL_Erase (uint32_t SectorAddress);
 uint16_t MAL_Write (uint32_t SectorAddress, uint32_t DataLength);
 uint8_t *MAL_Read  (uint32_t SectorAddress, uint32_t DataLength);
-uint16_t MAL_GetStatus(uint32_t SectorAddress ,uint8_t Cmd, uint8_t *buffer);
+uint16_t MAL_GetStatus(uint32_t SectorAddress ,uint8_t Cmd, uint32_t DataLength, uint8_t *buffer);
+uint8_t *MAL_GetBuffer (void);
+uint8_t  MAL_Process (void);
+uint8_t  MAL_Poll (void);
+uint32_t MAL_Flush (void);
+uint8_t  MAL_GetError (void);
+void     MAL_ClearError (void);
 
-extern uint8_t  MAL_Buffer[XFERSIZE]; /* RAM Buffer for Downloaded Data */
+extern uint8_t  MAL_Buffer[MAL_BUF_NBR][XFERSIZE]; /* RAM Buffers for Downloaded Data */
 
 #endif /* __DFU_MAL_H */
 
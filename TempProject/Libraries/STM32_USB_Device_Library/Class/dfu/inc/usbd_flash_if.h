@@ -35,8 +35,12 @@
 /* Exported defines ----------------------------------------------------------*/
 #define FLASH_START_ADD                  0x08000000
 
+#ifndef FLASH_END_ADD
 #define FLASH_END_ADD                   0x08040000
+#endif
+#ifndef FLASH_IF_STRING
 #define FLASH_IF_STRING    (uint8_t*) "@Internal Flash   /0x08000000/12*001Ka,116*001Kg"  
+#endif
 
 /* Exported types ------------------------------------------------------------*/
 /* Exported macro ------------------------------------------------------------*/
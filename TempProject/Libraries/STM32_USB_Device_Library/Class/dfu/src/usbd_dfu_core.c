@@ -83,7 +83,8 @@ static uint32_t wBlockNum = 0, wlength = 0;
 static uint32_t Pointer = APP_DEFAULT_ADD;  /* Base Address to Erase, Program or Read */
 static __IO uint32_t  usbd_dfu_AltSet = 0;
 
-extern uint8_t MAL_Buffer[];
+/* Commands returned by a GETCOMMANDS upload */
+static const uint8_t usbd_dfu_Commands[] = {CMD_GETCOMMANDS, CMD_SETADDRESSPOINTER, CMD_ERASE};
 
 /*********************************************
    DFU Device library callbacks
@@ -185,7 +186,7 @@ const uint8_t usbd_dfu_CfgDesc[USB_DFU_CONFIG_DESC_SIZ] =
                 bitAcceleratedST         = 0      (bit 7)*/
   0xFF,   /*DetachTimeOut= 255 ms*/
   0x00,
-  TRANSFER_SIZE_BYTES(XFERSIZE),       /* TransferSize = 1024 Byte*/         
+  TRANSFER_SIZE_BYTES(XFERSIZE),       /* TransferSize = XFERSIZE Byte*/         
   0x1A,                                /* bcdDFUVersion*/
   0x01
   /***********************************************************/
@@ -361,28 +362,33 @@ static uint8_t  usbd_dfu_Setup (void  *pdev,
 static uint8_t  EP0_TxSent (void  *pdev)
 {
   uint32_t Addr;
+  uint8_t *pBuf = MAL_GetBuffer();
   USB_SETUP_REQ req;  
   
   if (DeviceState == STATE_dfuDNBUSY)
   {
+    /* No block received: only waiting for a free buffer */
+    if (wlength == 0)
+    {}
     /* Decode the Special Command*/
-    if (wBlockNum == 0)   
+    else if (wBlockNum == 0)   
     {
-      if ((MAL_Buffer[0] ==  CMD_GETCOMMANDS) && (wlength == 1))
+      if ((pBuf[0] ==  CMD_GETCOMMANDS) && (wlength == 1))
       {}
-      else if  (( MAL_Buffer[0] ==  CMD_SETADDRESSPOINTER ) && (wlength == 5))
+      else if  (( pBuf[0] ==  CMD_SETADDRESSPOINTER ) && (wlength == 5))
       {
-        Pointer  = MAL_Buffer[1];
-        Pointer += MAL_Buffer[2] << 8;
-        Pointer += MAL_Buffer[3] << 16;
-        Pointer += MAL_Buffer[4] << 24;
+        Pointer  = pBuf[1];
+        Pointer += pBuf[2] << 8;
+        Pointer += pBuf[3] << 16;
+        Pointer += pBuf[4] << 24;
       }
-      else if (( MAL_Buffer[0] ==  CMD_ERASE ) && (wlength == 5))
+      else if (( pBuf[0] ==  CMD_ERASE ) && (wlength == 5))
       {
-        Pointer  = MAL_Buffer[1];
-        Pointer += MAL_Buffer[2] << 8;
-        Pointer += MAL_Buffer[3] << 16;
-        Pointer += MAL_Buffer[4] << 24;
+        Pointer  = pBuf[1];
+        Pointer += pBuf[2] << 8;
+        Pointer += pBuf[3] << 16;
+        Pointer += pBuf[4] << 24;
+        /* Queued: the sector is erased while the next blocks are received */
         MAL_Erase(Pointer);
       }
       else
@@ -402,13 +408,19 @@ static uint8_t  EP0_TxSent (void  *pdev)
       /* Decode the required address */
       Addr = ((wBlockNum - 2) * XFERSIZE) + Pointer;
       
-      /* Preform the write operation */
+      /* Queue the write operation, the block stays in its buffer */
       MAL_Write(Addr, wlength);
     }
     /* Reset the global length and block number */
     wlength = 0;
     wBlockNum = 0;
     
+    /* The host polled for the time the oldest job takes: run it now if
+       the main loop did not, so that the next block has a buffer */
+    while ((MAL_GetBuffer() == NULL) && (MAL_Process() != 0))
+    {
+    }
+    
     /* Update the state machine */
     DeviceState =  STATE_dfuDNLOAD_SYNC;
     DeviceStatus[4] = DeviceState;
@@ -492,7 +504,8 @@ static void DFU_Req_DNLOAD(void *pdev, USB_SETUP_REQ *req)
   /* Data setup request */
   if (req->wLength > 0)
   {
-    if ((DeviceState == STATE_dfuIDLE) || (DeviceState == STATE_dfuDNLOAD_IDLE))
+    if (((DeviceState == STATE_dfuIDLE) || (DeviceState == STATE_dfuDNLOAD_IDLE)) && 
+        (MAL_GetBuffer() != NULL) && (req->wLength <= XFERSIZE))
     {
       /* Update the global length and block number */
       wBlockNum = req->wValue;
@@ -504,7 +517,7 @@ static void DFU_Req_DNLOAD(void *pdev, USB_SETUP_REQ *req)
       
       /* Prepare the reception of the buffer over EP0 */
       USBD_CtlPrepareRx (pdev,
-                         (uint8_t*)MAL_Buffer,                                  
+                         MAL_GetBuffer(),                                  
                          wlength);
     }
     /* Unsupported state */
@@ -566,15 +579,10 @@ static void DFU_Req_UPLOAD(void *pdev, USB_SETUP_REQ *req)
         DeviceStatus[2] = 0;
         DeviceStatus[3] = 0;
         
-        /* Store the values of all supported commands */
-        MAL_Buffer[0] = CMD_GETCOMMANDS;
-        MAL_Buffer[1] = CMD_SETADDRESSPOINTER;
-        MAL_Buffer[2] = CMD_ERASE;
-        
-        /* Send the status data over EP0 */
+        /* Send the values of all supported commands */
         USBD_CtlSendData (pdev,
-                          (uint8_t *)(&(MAL_Buffer[0])),
-                          3);
+                          (uint8_t *)usbd_dfu_Commands,
+                          sizeof(usbd_dfu_Commands));
       }
       else if (wBlockNum > 1)
       {
@@ -585,6 +593,9 @@ static void DFU_Req_UPLOAD(void *pdev, USB_SETUP_REQ *req)
         DeviceStatus[3] = 0;
         Addr = ((wBlockNum - 2) * XFERSIZE) + Pointer;  /* Change is Accelerated*/
         
+        /* Read back what was downloaded, not the old media content */
+        MAL_Flush();
+        
         /* Return the physical address where data are stored */
         Phy_Addr = MAL_Read(Addr, wlength);
         
@@ -640,15 +651,37 @@ static void DFU_Req_GETSTATUS(void *pdev)
     {
       DeviceState = STATE_dfuDNBUSY;
       DeviceStatus[4] = DeviceState;
-      if ((wBlockNum == 0) && (MAL_Buffer[0] == CMD_ERASE))
+      if ((wBlockNum == 0) && (MAL_GetBuffer()[0] == CMD_ERASE) && (wlength == 5))
       {
-        MAL_GetStatus(Pointer, 0, DeviceStatus);
+        MAL_GetStatus(Pointer, MAL_JOB_ERASE, 0, DeviceStatus);
+      }
+      else if (wBlockNum > 1)
+      {
+        MAL_GetStatus(((wBlockNum - 2) * XFERSIZE) + Pointer, MAL_JOB_WRITE,
+                      wlength, DeviceStatus);
       }
       else
       {
-        MAL_GetStatus(Pointer, 1, DeviceStatus);
+        MAL_GetStatus(Pointer, MAL_JOB_NONE, 0, DeviceStatus);
       }
     }
+    else if (MAL_GetError() != STATUS_OK)
+    {
+      /* A queued job failed */
+      DeviceState = STATE_dfuERROR;
+      DeviceStatus[0] = MAL_GetError();
+      DeviceStatus[4] = DeviceState;
+      DeviceStatus[1] = 0;
+      DeviceStatus[2] = 0;
+      DeviceStatus[3] = 0;
+    }
+    else if (MAL_GetBuffer() == NULL)
+    {
+      /* No buffer for the next block yet */
+      DeviceState = STATE_dfuDNBUSY;
+      DeviceStatus[4] = DeviceState;
+      MAL_GetStatus(Pointer, MAL_JOB_NONE, 0, DeviceStatus);
+    }
     else  /* (wlength==0)*/
     {
       DeviceState = STATE_dfuDNLOAD_IDLE;
@@ -660,7 +693,22 @@ static void DFU_Req_GETSTATUS(void *pdev)
     break;
     
   case   STATE_dfuMANIFEST_SYNC :
-    if (Manifest_State == Manifest_In_Progress)
+    if (MAL_Flush() != 0)
+    {
+      /* Queued jobs are still running in the main loop */
+      DeviceStatus[4] = DeviceState;
+      MAL_GetStatus(Pointer, MAL_JOB_FLUSH, 0, DeviceStatus);
+    }
+    else if (MAL_GetError() != STATUS_OK)
+    {
+      DeviceState = STATE_dfuERROR;
+      DeviceStatus[0] = MAL_GetError();
+      DeviceStatus[4] = DeviceState;
+      DeviceStatus[1] = 0;
+      DeviceStatus[2] = 0;
+      DeviceStatus[3] = 0;
+    }
+    else if (Manifest_State == Manifest_In_Progress)
     {
       DeviceState = STATE_dfuMANIFEST;
       DeviceStatus[4] = DeviceState;
@@ -699,6 +747,8 @@ static void DFU_Req_GETSTATUS(void *pdev)
   */
 static void DFU_Req_CLRSTATUS(void *pdev)
 {
+  MAL_ClearError();
+  
   if (DeviceState == STATE_dfuERROR)
   {
     DeviceState = STATE_dfuIDLE;
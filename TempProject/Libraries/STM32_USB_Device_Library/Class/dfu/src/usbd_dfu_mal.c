@@ -31,6 +31,11 @@
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+/* State of the sector erased ahead */
+#define MAL_AHEAD_NONE                  0
+#define MAL_AHEAD_PENDING               1   /* to be erased by MAL_Poll() */
+#define MAL_AHEAD_ERASED                2   /* erased, nothing written yet */
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 
@@ -47,11 +52,27 @@ const uint8_t* usbd_dfu_StringDesc[MAX_USED_MEDIA] = {
     FLASH_IF_STRING
 };
 
-/* RAM Buffer for Downloaded Data */
-uint8_t  MAL_Buffer[XFERSIZE] ; 
+/* RAM Buffers for Downloaded Data: the host sends the next block into one
+   buffer while MAL_Process() programs the other one */
+uint8_t  MAL_Buffer[MAL_BUF_NBR][XFERSIZE] ; 
+
+/* Jobs waiting for the media, one per buffer. The DFU core (USB interrupt)
+   queues them, MAL_Process() runs them in order */
+static MAL_Job_TypeDef MAL_Job[MAL_BUF_NBR];
+static __IO uint32_t MAL_JobIn = 0;
+static __IO uint32_t MAL_JobOut = 0;
+static __IO uint8_t  MAL_Busy = 0;
+static __IO uint8_t  MAL_Error = STATUS_OK;
+
+/* Sector erased ahead of the host, only touched with MAL_Busy set */
+static uint32_t MAL_AheadAdd = 0;
+static uint8_t  MAL_AheadState = MAL_AHEAD_NONE;
 
 /* Private function prototypes -----------------------------------------------*/
 static uint8_t  MAL_CheckAdd  (uint32_t Add);
+static uint16_t MAL_Queue     (uint8_t Cmd, uint32_t Add, uint32_t Len);
+static uint32_t MAL_JobTime   (MAL_Job_TypeDef *job);
+static uint8_t  MAL_IsErasedAhead (uint32_t Add);
 
 /* Private functions ---------------------------------------------------------*/
 
@@ -75,6 +96,10 @@ uint16_t MAL_Init(void)
     }
   }
 
+  MAL_JobIn = MAL_JobOut;
+  MAL_Error = STATUS_OK;
+  MAL_AheadState = MAL_AHEAD_NONE;
+  
   return MAL_OK;
 }
 
@@ -88,6 +113,9 @@ uint16_t MAL_DeInit(void)
 {
   uint32_t memIdx = 0;
   
+  /* Jobs not started yet are dropped with the session */
+  MAL_JobIn = MAL_JobOut + MAL_Busy;
+  
   /* Init all supported memories */
   for(memIdx = 0; memIdx < MAX_USED_MEDIA; memIdx++)
   {
@@ -103,131 +131,373 @@ uint16_t MAL_DeInit(void)
 
 /**
   * @brief  MAL_Erase
-  *         Erase a sector of memory.
+  *         Queue the erase of a sector of memory.
   * @param  Add: Sector address/code
-  * @retval Result of the operation: MAL_OK if all operations are OK else MAL_FAIL
+  * @retval Result of the operation: MAL_OK if the erase is queued else MAL_FAIL
   */
 uint16_t MAL_Erase(uint32_t Add)
+{
+  return MAL_Queue(MAL_JOB_ERASE, Add, 0);
+}
+
+/**
+  * @brief  MAL_Write
+  *         Queue the write of the buffer returned by MAL_GetBuffer().
+  * @param  Add: Sector address/code
+  * @param  Len: Number of data to be written (in bytes)
+  * @retval Result of the operation: MAL_OK if the write is queued else MAL_FAIL
+  */
+uint16_t MAL_Write (uint32_t Add, uint32_t Len)
+{
+  return MAL_Queue(MAL_JOB_WRITE, Add, Len);
+}
+
+/**
+  * @brief  MAL_Read
+  *         Read sectors of memory.
+  * @param  Add: Sector address/code
+  * @param  Len: Number of data to be written (in bytes)
+  * @retval Buffer pointer
+  */
+uint8_t *MAL_Read (uint32_t Add, uint32_t Len)
 {
   uint32_t memIdx = MAL_CheckAdd(Add);
- 
-  /* Check if the area is protected */
-  if (DFU_MAL_IS_PROTECTED_AREA(Add))
-  {
-    return MAL_FAIL;
-  }    
   
   if (memIdx < MAX_USED_MEDIA)
   {
     /* Check if the command is supported */
-    if (tMALTab[memIdx]->pMAL_Erase != NULL)
+    if (tMALTab[memIdx]->pMAL_Read != NULL)
     {
-      return tMALTab[memIdx]->pMAL_Erase(Add);
+      return tMALTab[memIdx]->pMAL_Read(Add, Len);
     }
     else
     {
-      return MAL_FAIL;
-    }
+      return MAL_Buffer[0];
+    }     
   }
   else
   {
-    return MAL_FAIL;
+    return MAL_Buffer[0];
   }
 }
 
 /**
-  * @brief  MAL_Write
-  *         Write sectors of memory.
-  * @param  Add: Sector address/code
-  * @param  Len: Number of data to be written (in bytes)
-  * @retval Result of the operation: MAL_OK if all operations are OK else MAL_FAIL
+  * @brief  MAL_GetBuffer
+  *         Buffer receiving the next download block.
+  * @param  None
+  * @retval Buffer pointer, NULL while all buffers wait for the media
   */
-uint16_t MAL_Write (uint32_t Add, uint32_t Len)
+uint8_t *MAL_GetBuffer(void)
 {
-  uint32_t memIdx = MAL_CheckAdd(Add);
- 
-  /* Check if the area is protected */
-  if (DFU_MAL_IS_PROTECTED_AREA(Add))
+  if ((MAL_JobIn - MAL_JobOut) >= MAL_BUF_NBR)
   {
-    return MAL_FAIL;
-  }   
+    return NULL;
+  }
+  return MAL_Buffer[MAL_JobIn % MAL_BUF_NBR];
+}
+
+/**
+  * @brief  MAL_Process
+  *         Run a step of the oldest queued job: a sector erase or up to
+  *         MAL_WRITE_CHUNK bytes of a write. The main loop runs it through
+  *         MAL_Poll(); the DFU core also calls it when no buffer is left for
+  *         the host.
+  * @param  None
+  * @retval 1 if a step was run, 0 if there is nothing to do or the media is
+  *         busy in an interrupted context
+  */
+uint8_t MAL_Process(void)
+{
+  MAL_Job_TypeDef *job;
+  uint32_t primask;
+  uint32_t memIdx;
+  uint32_t len;
+  uint16_t status = MAL_FAIL;
   
-  if (memIdx < MAX_USED_MEDIA)
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if (MAL_Busy || (MAL_JobIn == MAL_JobOut))
   {
-    /* Check if the command is supported */
-    if (tMALTab[memIdx]->pMAL_Write != NULL)
+    __set_PRIMASK(primask);
+    return 0;
+  }
+  MAL_Busy = 1;
+  __set_PRIMASK(primask);
+  
+  job = &MAL_Job[MAL_JobOut % MAL_BUF_NBR];
+  memIdx = MAL_CheckAdd(job->Add);
+  len = job->Len - job->Done;
+  
+  if (job->Cmd == MAL_JOB_ERASE)
+  {
+    if (MAL_IsErasedAhead(job->Add))
     {
-      return tMALTab[memIdx]->pMAL_Write(Add, Len);
+      /* Already blank: the host waits for nothing */
+      status = MAL_OK;
     }
-    else
+    else if (tMALTab[memIdx]->pMAL_Erase != NULL)
+    {
+      status = tMALTab[memIdx]->pMAL_Erase(job->Add);
+    }
+    if ((MAL_AheadState == MAL_AHEAD_PENDING) && 
+        ((job->Add & ~(MAL_SECTOR_SIZE - 1)) == MAL_AheadAdd))
     {
-      return MAL_FAIL;
-    }    
+      MAL_AheadState = MAL_AHEAD_NONE;
+    }
   }
   else
   {
-    return MAL_FAIL;
+    /* The sector erased ahead is being written */
+    if ((MAL_AheadState != MAL_AHEAD_NONE) && (MAL_AheadAdd >= job->Add) &&
+        (MAL_AheadAdd < job->Add + job->Len))
+    {
+      MAL_AheadState = MAL_AHEAD_NONE;
+    }
+    if (len > MAL_WRITE_CHUNK)
+    {
+      len = MAL_WRITE_CHUNK;
+    }
+    if (tMALTab[memIdx]->pMAL_Write != NULL)
+    {
+      status = tMALTab[memIdx]->pMAL_Write(job->Add + job->Done,
+                                           MAL_Buffer[MAL_JobOut % MAL_BUF_NBR] + job->Done,
+                                           len);
+    }
   }
+  job->Done += len;
+  
+  if (status != MAL_OK)
+  {
+    MAL_Error = (job->Cmd == MAL_JOB_ERASE) ? STATUS_ERRERASE : STATUS_ERRPROG;
+    job->Done = job->Len;
+  }
+  
+  if (job->Done >= job->Len)
+  {
+#if MAL_ERASE_AHEAD
+    /* A full block: the image goes on in the next sector */
+    if ((job->Cmd == MAL_JOB_WRITE) && (status == MAL_OK) && 
+        (job->Len == XFERSIZE))
+    {
+      MAL_AheadAdd = (job->Add + job->Len + MAL_SECTOR_SIZE - 1) & ~(MAL_SECTOR_SIZE - 1);
+      MAL_AheadState = MAL_AHEAD_PENDING;
+    }
+#endif /* MAL_ERASE_AHEAD */
+    MAL_JobOut++;
+  }
+  MAL_Busy = 0;
+  
+  return 1;
 }
 
 /**
-  * @brief  MAL_Read
-  *         Read sectors of memory.
-  * @param  Add: Sector address/code
-  * @param  Len: Number of data to be written (in bytes)
-  * @retval Buffer pointer
+  * @brief  MAL_Poll
+  *         Main loop poller: run a step of the queued jobs, so that the
+  *         flash is programmed while the host sends the next block. With
+  *         nothing queued, erase the sector after the last block written
+  *         before the host asks for it (MAL_ERASE_AHEAD).
+  * @param  None
+  * @retval 1 if a step was run, 0 if there is nothing to do
   */
-uint8_t *MAL_Read (uint32_t Add, uint32_t Len)
+uint8_t MAL_Poll(void)
 {
-  uint32_t memIdx = MAL_CheckAdd(Add);
+  uint32_t primask;
+  uint32_t memIdx;
   
-  if (memIdx < MAX_USED_MEDIA)
+  if (MAL_Process() != 0)
   {
-    /* Check if the command is supported */
-    if (tMALTab[memIdx]->pMAL_Read != NULL)
-    {
-      return tMALTab[memIdx]->pMAL_Read(Add, Len);
-    }
-    else
-    {
-      return MAL_Buffer;
-    }     
+    return 1;
   }
-  else
+  
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if (MAL_Busy || (MAL_JobIn != MAL_JobOut) || 
+      (MAL_AheadState != MAL_AHEAD_PENDING))
+  {
+    __set_PRIMASK(primask);
+    return 0;
+  }
+  MAL_Busy = 1;
+  __set_PRIMASK(primask);
+  
+  memIdx = MAL_CheckAdd(MAL_AheadAdd);
+  MAL_AheadState = MAL_AHEAD_NONE;
+  
+  /* A failure is not reported: the host erase command retries it */
+  if ((memIdx < MAX_USED_MEDIA) && !DFU_MAL_IS_PROTECTED_AREA(MAL_AheadAdd) &&
+      (tMALTab[memIdx]->pMAL_Erase != NULL) &&
+      (tMALTab[memIdx]->pMAL_Erase(MAL_AheadAdd) == MAL_OK))
+  {
+    MAL_AheadState = MAL_AHEAD_ERASED;
+  }
+  MAL_Busy = 0;
+  
+  return 1;
+}
+
+/**
+  * @brief  MAL_Flush
+  *         Run the queued jobs until none is left.
+  * @param  None
+  * @retval Number of jobs still queued: non zero if MAL_Process() was
+  *         interrupted in the main loop
+  */
+uint32_t MAL_Flush(void)
+{
+  while (MAL_Process() != 0)
   {
-    return MAL_Buffer;
   }
+  return (MAL_JobIn - MAL_JobOut);
+}
+
+/**
+  * @brief  MAL_GetError
+  *         Status of the queued jobs.
+  * @param  None
+  * @retval STATUS_OK or the DFU status code of the first failed job
+  */
+uint8_t MAL_GetError(void)
+{
+  return MAL_Error;
+}
+
+/**
+  * @brief  MAL_ClearError
+  *         Clear the error reported by MAL_GetError.
+  * @param  None
+  * @retval None
+  */
+void MAL_ClearError(void)
+{
+  MAL_Error = STATUS_OK;
 }
 
 /**
   * @brief  MAL_GetStatus
-  *         Get the status of a given memory.
+  *         Set the bwPollTimeout the host waits before the next request:
+  *         the time the queued jobs take before a buffer is free again once
+  *         the job described by Cmd is queued, or before all jobs are done
+  *         for MAL_JOB_FLUSH.
   * @param  Add: Sector address/code (allow to determine which memory will be addressed)
-  * @param  Cmd: 0 for erase and 1 for write
+  * @param  Cmd: job about to be queued, MAL_JOB_NONE or MAL_JOB_FLUSH
+  * @param  Len: Number of data to be written (in bytes) for MAL_JOB_WRITE
   * @param  buffer: pointer to the buffer where the status data will be stored.
-  * @retval Buffer pointer
+  * @retval Result of the operation: MAL_OK if the address is valid else MAL_FAIL
   */
-uint16_t MAL_GetStatus(uint32_t Add , uint8_t Cmd, uint8_t *buffer)
+uint16_t MAL_GetStatus(uint32_t Add, uint8_t Cmd, uint32_t Len, uint8_t *buffer)
 {
-  uint32_t memIdx = MAL_CheckAdd(Add);
+  MAL_Job_TypeDef newjob;
+  uint32_t pending = MAL_JobIn - MAL_JobOut;
+  uint32_t total = pending;
+  uint32_t keep = MAL_BUF_NBR - 1;
+  uint32_t timing = 0;
+  uint32_t idx;
   
-  if (memIdx < MAX_USED_MEDIA)
+  if (MAL_CheckAdd(Add) >= MAX_USED_MEDIA)
   {
-    if (Cmd & 0x01)
+    return MAL_FAIL;
+  }
+  
+  if (Cmd == MAL_JOB_FLUSH)
+  {
+    keep = 0;
+  }
+  else if ((Cmd == MAL_JOB_ERASE) || (Cmd == MAL_JOB_WRITE))
+  {
+    newjob.Cmd = Cmd;
+    newjob.Add = Add;
+    newjob.Len = (Cmd == MAL_JOB_ERASE) ? 1 : Len;
+    newjob.Done = 0;
+    total++;
+  }
+  
+  /* The oldest jobs run first, the new one last */
+  for (idx = 0; (idx + keep) < total; idx++)
+  {
+    if (idx < pending)
     {
-      SET_POLLING_TIMING(tMALTab[memIdx]->EraseTiming);
+      timing += MAL_JobTime(&MAL_Job[(MAL_JobOut + idx) % MAL_BUF_NBR]);
     }
     else
     {
-      SET_POLLING_TIMING(tMALTab[memIdx]->WriteTiming);
+      timing += MAL_JobTime(&newjob);
     }
-    
-    return MAL_OK;
   }
-  else
+  
+  SET_POLLING_TIMING(timing);
+  
+  return MAL_OK;
+}
+
+/**
+  * @brief  MAL_Queue
+  *         Queue a job for MAL_Process().
+  * @param  Cmd: MAL_JOB_ERASE or MAL_JOB_WRITE
+  * @param  Add: Sector address/code
+  * @param  Len: Number of data to be written (in bytes)
+  * @retval Result of the operation: MAL_OK if the job is queued else MAL_FAIL
+  */
+static uint16_t MAL_Queue(uint8_t Cmd, uint32_t Add, uint32_t Len)
+{
+  MAL_Job_TypeDef *job;
+  uint32_t memIdx = MAL_CheckAdd(Add);
+  
+  /* Check if the area is protected */
+  if (DFU_MAL_IS_PROTECTED_AREA(Add) || (memIdx >= MAX_USED_MEDIA) ||
+      ((MAL_JobIn - MAL_JobOut) >= MAL_BUF_NBR))
   {
+    MAL_Error = STATUS_ERRTARGET;
     return MAL_FAIL;
   }
+  
+  job = &MAL_Job[MAL_JobIn % MAL_BUF_NBR];
+  job->Cmd = Cmd;
+  job->Add = Add;
+  job->Len = (Cmd == MAL_JOB_ERASE) ? 1 : Len;
+  job->Done = 0;
+  
+  /* Publish the job once it is complete */
+  __DMB();
+  MAL_JobIn++;
+  
+  return MAL_OK;
+}
+
+/**
+  * @brief  MAL_JobTime
+  *         Remaining time of a job from the memory timings.
+  * @param  job: queued job
+  * @retval Time in ms
+  */
+static uint32_t MAL_JobTime(MAL_Job_TypeDef *job)
+{
+  uint32_t memIdx = MAL_CheckAdd(job->Add);
+  
+  if (memIdx >= MAX_USED_MEDIA)
+  {
+    return 0;
+  }
+  
+  if (job->Cmd == MAL_JOB_ERASE)
+  {
+    return ((job->Done == 0) && !MAL_IsErasedAhead(job->Add)) ? 
+           tMALTab[memIdx]->EraseTiming : 0;
+  }
+  
+  /* WriteTiming is given for 1024 bytes */
+  return (((job->Len - job->Done) * tMALTab[memIdx]->WriteTiming) + 1023) / 1024;
+}
+
+/**
+  * @brief  MAL_IsErasedAhead
+  *         Check if a sector was erased ahead and is still blank.
+  * @param  Add: Address in the sector
+  * @retval 1 if the sector is blank, 0 else
+  */
+static uint8_t MAL_IsErasedAhead(uint32_t Add)
+{
+  return ((MAL_AheadState == MAL_AHEAD_ERASED) && 
+          ((Add & ~(MAL_SECTOR_SIZE - 1)) == MAL_AheadAdd)) ? 1 : 0;
 }
 
 /**
@@ -35,7 +35,7 @@
 /* Private function prototypes -----------------------------------------------*/
 uint16_t FLASH_If_Init(void);
 uint16_t FLASH_If_Erase (uint32_t Add);
-uint16_t FLASH_If_Write (uint32_t Add, uint32_t Len);
+uint16_t FLASH_If_Write (uint32_t Add, uint8_t *Buf, uint32_t Len);
 uint8_t *FLASH_If_Read  (uint32_t Add, uint32_t Len);
 uint16_t FLASH_If_DeInit(void);
 uint16_t FLASH_If_CheckAdd(uint32_t Add);
@@ -53,9 +53,9 @@ DFU_MAL_Prop_TypeDef DFU_Flash_cb =
   FLASH_If_CheckAdd,
   40, /* Erase Time in ms : extracted from flash memory datasheet Maximum 
   timming value for Sector Erase*/
-  60  /* Programming Time in ms (60us * RAM Buffer size (1024 Bytes) 
-    extracted from flash memory datasheet Maximum timming value for  1024 bytes 
-    Write)*/
+  31  /* Programming Time in ms for 1024 bytes (512 half-words * 60us, 
+    extracted from flash memory datasheet Maximum timming value for half-word
+    programming)*/
 };
 
 /* Private functions ---------------------------------------------------------*/
@@ -97,7 +97,10 @@ uint16_t FLASH_If_DeInit(void)
 uint16_t FLASH_If_Erase(uint32_t Add)
 {
   /* Call the standard Flash erase function */
-  FLASH_ErasePage(Add);  
+  if (FLASH_ErasePage(Add) != FLASH_COMPLETE)
+  {
+    return MAL_FAIL;
+  }
   
   return MAL_OK;
 }
@@ -106,10 +109,11 @@ uint16_t FLASH_If_Erase(uint32_t Add)
   * @brief  FLASH_If_Write
   *         Memory write routine.
   * @param  Add: Address to be written to.
+  * @param  Buf: Data to be written, word aligned.
   * @param  Len: Number of data to be written (in bytes).
   * @retval MAL_OK if operation is successful, MAL_FAIL else.
   */
-uint16_t FLASH_If_Write(uint32_t Add, uint32_t Len)
+uint16_t FLASH_If_Write(uint32_t Add, uint8_t *Buf, uint32_t Len)
 {
   uint32_t idx = 0;
   
@@ -117,14 +121,17 @@ uint16_t FLASH_If_Write(uint32_t Add, uint32_t Len)
   {
     for (idx = Len; idx < ((Len & 0xFFFC) + 4); idx++)
     {
-      MAL_Buffer[idx] = 0xFF;
+      Buf[idx] = 0xFF;
     }
   }
   
   /* Data received are Word multiple */
   for (idx = 0; idx <  Len; idx = idx + 4)
   {
-    FLASH_ProgramWord(Add, *(uint32_t *)(MAL_Buffer + idx));
+    if (FLASH_ProgramWord(Add, *(uint32_t *)(Buf + idx)) != FLASH_COMPLETE)
+    {
+      return MAL_FAIL;
+    }
     Add += 4;
   }
   return MAL_OK;
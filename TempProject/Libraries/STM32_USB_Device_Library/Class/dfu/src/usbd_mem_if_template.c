@@ -37,7 +37,7 @@
 /* Private function prototypes -----------------------------------------------*/
 uint16_t MEM_If_Init(void);
 uint16_t MEM_If_Erase (uint32_t Add);
-uint16_t MEM_If_Write (uint32_t Add, uint32_t Len);
+uint16_t MEM_If_Write (uint32_t Add, uint8_t *Buf, uint32_t Len);
 uint8_t *MEM_If_Read  (uint32_t Add, uint32_t Len);
 uint16_t MEM_If_DeInit(void);
 uint16_t MEM_If_CheckAdd(uint32_t Add);
@@ -95,10 +95,11 @@ uint16_t MEM_If_Erase(uint32_t Add)
   * @brief  MEM_If_Write
   *         Memory write routine.
   * @param  Add: Address to be written to.
+  * @param  Buf: Data to be written.
   * @param  Len: Number of data to be written (in bytes).
   * @retval MAL_OK if operation is successful, MAL_FAIL else.
   */
-uint16_t MEM_If_Write(uint32_t Add, uint32_t Len)
+uint16_t MEM_If_Write(uint32_t Add, uint8_t *Buf, uint32_t Len)
 {
   return MAL_OK;
 }
@@ -113,7 +114,7 @@ uint16_t MEM_If_Write(uint32_t Add, uint32_t Len)
 uint8_t *MEM_If_Read (uint32_t Add, uint32_t Len)
 {
   /* Return a valid address to avoid HardFault */
-  return  (uint8_t*)(MAL_Buffer); 
+  return  MAL_Buffer[0]; 
 }
 
 /**
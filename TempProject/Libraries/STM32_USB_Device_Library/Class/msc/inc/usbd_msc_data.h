@@ -36,13 +36,17 @@
 /* Exported defines ----------------------------------------------------------*/
 #define MODE_SENSE6_LEN			 8
 #define MODE_SENSE10_LEN		 8
-#define LENGTH_INQUIRY_PAGE00		 7
+#define LENGTH_INQUIRY_PAGE00		 9
+#define LENGTH_INQUIRY_PAGEB0		64
+#define LENGTH_INQUIRY_PAGEB2		 8
 #define LENGTH_FORMAT_CAPACITIES    	20
 
 /* Exported types ------------------------------------------------------------*/
 /* Exported macros -----------------------------------------------------------*/
 /* Exported variables --------------------------------------------------------*/
 extern const uint8_t MSC_Page00_Inquiry_Data[];  
+extern const uint8_t MSC_PageB0_Inquiry_Data[];  
+extern const uint8_t MSC_PageB2_Inquiry_Data[];  
 extern const uint8_t MSC_Mode_Sense6_data[];
 extern const uint8_t MSC_Mode_Sense10_data[]; 
 
@@ -35,6 +35,11 @@
 /* Exported defines ----------------------------------------------------------*/
 #define USBD_STD_INQUIRY_LENGTH		36
 
+/* Read/Write return value of a split-phase access: the operation is started
+   and its end is reported with USBD_STORAGE_Cplt(). The buffer belongs to
+   the medium until then: the endpoint NAKs and the CSW is held back. */
+#define USBD_STORAGE_BUSY             1
+
 /* Exported types ------------------------------------------------------------*/
 typedef struct _USBD_STORAGE
 {
@@ -46,6 +51,8 @@ typedef struct _USBD_STORAGE
   int8_t (* Write)(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
   int8_t (* GetMaxLun)(void);
   int8_t *pInquiry;
+  /* Optional: blocks freed by the host (UNMAP), NULL if not supported */
+  int8_t (* Unmap)(uint8_t lun, uint32_t blk_addr, uint32_t blk_len);
   
 }USBD_STORAGE_cb_TypeDef;
 
@@ -54,6 +61,8 @@ typedef struct _USBD_STORAGE
 /* Exported functions ------------------------------------------------------- */ 
 extern USBD_STORAGE_cb_TypeDef *USBD_STORAGE_fops;
 
+void USBD_STORAGE_Cplt (uint8_t lun, int8_t status);
+
 
 #endif /* __USBD_MEM_H */
 
@@ -51,6 +51,11 @@
 
 #define SCSI_READ_CAPACITY10                        0x25
 #define SCSI_READ_CAPACITY16                        0x9E
+#define SCSI_SAI_READ_CAPACITY16                    0x10
+
+#define SCSI_WRITE_SAME10                           0x41
+#define SCSI_WRITE_SAME16                           0x93
+#define SCSI_UNMAP                                  0x42
 
 #define SCSI_REQUEST_SENSE                          0x03
 #define SCSI_START_STOP_UNIT                        0x1B
@@ -96,6 +101,7 @@
 
 #define READ_FORMAT_CAPACITY_DATA_LEN               0x0C
 #define READ_CAPACITY10_DATA_LEN                    0x08
+#define READ_CAPACITY16_DATA_LEN                    0x20
 #define MODE_SENSE10_DATA_LEN                       0x08
 #define MODE_SENSE6_DATA_LEN                        0x04
 #define REQUEST_SENSE_DATA_LEN                      0x12
@@ -136,8 +136,8 @@ static uint8_t  USBD_MSC_AltSet = 0;
 uint8_t  USBD_MSC_Init (void  *pdev, 
                             uint8_t cfgidx)
 { 
-  DCD_PMA_Config(pdev , MSC_IN_EP,USB_SNG_BUF,MSC_IN_TX_ADDRESS);
-  DCD_PMA_Config(pdev , MSC_OUT_EP,USB_SNG_BUF,MSC_OUT_RX_ADDRESS);
+  DCD_PMA_Config(pdev , MSC_IN_EP,BULK_EP_KIND,MSC_IN_TX_ADDRESS);
+  DCD_PMA_Config(pdev , MSC_OUT_EP,BULK_EP_KIND,MSC_OUT_RX_ADDRESS);
  
   /* Open EP IN */
   DCD_EP_Open(pdev,
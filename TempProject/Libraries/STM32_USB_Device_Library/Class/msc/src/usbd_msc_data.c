@@ -40,8 +40,41 @@ const uint8_t  MSC_Page00_Inquiry_Data[] = {//7
 	(LENGTH_INQUIRY_PAGE00 - 4),
 	0x00, 
 	0x80, 
-	0x83 
+	0x83,
+	0xB0,
+	0xB2
 };  
+/* USB Mass storage Block Limits VPD page */
+const uint8_t  MSC_PageB0_Inquiry_Data[] = {
+	0x00,
+	0xB0,
+	0x00,
+	(LENGTH_INQUIRY_PAGEB0 - 4),
+	0x00, 0x00, 0x00, 0x00,                       /* Transfer length granularity */
+	0x00, 0x00, 0x00, 0x00,                       /* Maximum transfer length */
+	0x00, 0x00, 0x00, 0x00,                       /* Optimal transfer length */
+	0x00, 0x00, 0x00, 0x00,                       /* Maximum prefetch length */
+	0xFF, 0xFF, 0xFF, 0xFF,                       /* Maximum unmap LBA count */
+	0x00, 0x00, 0x00,                             /* Maximum unmap block descriptors */
+	(uint8_t)((MSC_MEDIA_PACKET - 8) / 16 > 0xFF ? 0xFF : (MSC_MEDIA_PACKET - 8) / 16),
+	0x00, 0x00, 0x00, 0x01,                       /* Optimal unmap granularity */
+	0x00, 0x00, 0x00, 0x00,                       /* Unmap granularity alignment */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, /* Maximum write same length */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00
+};
+/* USB Mass storage Logical Block Provisioning VPD page */
+const uint8_t  MSC_PageB2_Inquiry_Data[] = {
+	0x00,
+	0xB2,
+	0x00,
+	(LENGTH_INQUIRY_PAGEB2 - 4),
+	0x00,                                         /* Threshold exponent */
+	0xE0,                                         /* LBPU, LBPWS, LBPWS10 */
+	0x02,                                         /* Thin provisioned */
+	0x00
+};
 /* USB Mass storage sense 6  Data */
 const uint8_t  MSC_Mode_Sense6_data[] = {
 	0x00,
@@ -30,6 +30,9 @@
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+#define SCSI_MEDIA_IDLE               0       /* No medium access ongoing */
+#define SCSI_MEDIA_BUSY               1       /* Split-phase access started */
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 SCSI_Sense_TypeDef     SCSI_Sense [SENSE_LIST_DEEPTH];
@@ -44,6 +47,11 @@ uint32_t  SCSI_blk_len;
 
 USB_CORE_HANDLE  *cdev;
 
+__IO uint8_t   SCSI_MediaState;
+__IO uint8_t   SCSI_MediaDiscard;   /* The access belongs to an aborted command */
+
+__IO uint8_t   SCSI_MediaPending;   /* Data stage waiting for the medium */
+
 /* Private function prototypes -----------------------------------------------*/
 static int8_t SCSI_TestUnitReady(uint8_t lun, uint8_t *params);
 static int8_t SCSI_Inquiry(uint8_t lun, uint8_t *params);
@@ -56,6 +64,11 @@ static int8_t SCSI_ModeSense10 (uint8_t lun, uint8_t *params);
 static int8_t SCSI_Write10(uint8_t lun , uint8_t *params);
 static int8_t SCSI_Read10(uint8_t lun , uint8_t *params);
 static int8_t SCSI_Verify10(uint8_t lun, uint8_t *params);
+static int8_t SCSI_ReadCapacity16(uint8_t lun, uint8_t *params);
+static int8_t SCSI_Unmap(uint8_t lun, uint8_t *params);
+static int8_t SCSI_WriteSame(uint8_t lun, uint8_t *params);
+static int8_t SCSI_ReceiveParams(uint8_t lun, uint32_t len);
+static int8_t SCSI_UnmapRange(uint8_t lun, uint32_t blk_offset, uint32_t blk_nbr);
 static int8_t SCSI_CheckAddressRange (uint8_t lun , 
                                       uint32_t blk_offset , 
                                       uint16_t blk_nbr);
@@ -63,6 +76,9 @@ static int8_t SCSI_ProcessRead (uint8_t lun);
 
 static int8_t SCSI_ProcessWrite (uint8_t lun);
 
+static int8_t SCSI_ReadCplt (uint8_t lun, int8_t status);
+static int8_t SCSI_WriteCplt (uint8_t lun, int8_t status);
+
 /* Private function ----------------------------------------------------------*/
 /**
   * @brief  SCSI_ProcessCmd
@@ -78,6 +94,12 @@ int8_t SCSI_ProcessCmd(USB_CORE_HANDLE  *pdev,
 {
   cdev = pdev;
   
+  /* The medium may still be completing an access of an aborted command */
+  if ((MSC_BOT_State == BOT_IDLE) && (SCSI_MediaState != SCSI_MEDIA_IDLE))
+  {
+    SCSI_MediaDiscard = 1;
+  }
+  
   switch (params[0])
   {
   case SCSI_TEST_UNIT_READY:
@@ -115,6 +137,16 @@ int8_t SCSI_ProcessCmd(USB_CORE_HANDLE  *pdev,
   case SCSI_VERIFY10:
     return SCSI_Verify10(lun, params);
     
+  case SCSI_READ_CAPACITY16:
+    return SCSI_ReadCapacity16(lun, params);
+    
+  case SCSI_UNMAP:
+    return SCSI_Unmap(lun, params);
+    
+  case SCSI_WRITE_SAME10:
+  case SCSI_WRITE_SAME16:
+    return SCSI_WriteSame(lun, params);
+    
   default:
     SCSI_SenseCode(lun,
                    ILLEGAL_REQUEST, 
@@ -168,8 +200,28 @@ static int8_t  SCSI_Inquiry(uint8_t lun, uint8_t *params)
   
   if (params[1] & 0x01)/*Evpd is set*/
   {
-    pPage = (uint8_t *)MSC_Page00_Inquiry_Data;
-    len = LENGTH_INQUIRY_PAGE00;
+    switch (params[2])
+    {
+    case 0xB0:
+      pPage = (uint8_t *)MSC_PageB0_Inquiry_Data;
+      len = LENGTH_INQUIRY_PAGEB0;
+      break;
+      
+    case 0xB2:
+      pPage = (uint8_t *)MSC_PageB2_Inquiry_Data;
+      len = LENGTH_INQUIRY_PAGEB2;
+      break;
+      
+    default:
+      pPage = (uint8_t *)MSC_Page00_Inquiry_Data;
+      len = LENGTH_INQUIRY_PAGE00;
+      break;
+    }
+    
+    if (((params[3] << 8) | params[4]) <= len)
+    {
+      len = (params[3] << 8) | params[4];
+    }
   }
   else
   {
@@ -189,6 +241,14 @@ static int8_t  SCSI_Inquiry(uint8_t lun, uint8_t *params)
     len--;
     MSC_BOT_Data[len] = pPage[len];
   }
+  
+  /* No provisioning support without an Unmap callback */
+  if ((pPage == (uint8_t *)MSC_PageB2_Inquiry_Data) && 
+      (USBD_STORAGE_fops->Unmap == 0) && 
+      (MSC_BOT_DataLen > 5))
+  {
+    MSC_BOT_Data[5] = 0;
+  }
   return 0;
 }
 
@@ -226,6 +286,59 @@ static int8_t SCSI_ReadCapacity10(uint8_t lun, uint8_t *params)
     return 0;
   }
 }
+/**
+  * @brief  SCSI_ReadCapacity16
+  *         Process Read Capacity 16 command (Service Action In 16)
+  * @param  lun: Logical unit number
+  * @param  params: Command parameters
+  * @retval status
+  */
+static int8_t SCSI_ReadCapacity16(uint8_t lun, uint8_t *params)
+{
+  uint32_t len;
+  uint8_t i;
+  
+  if ((params[1] & 0x1F) != SCSI_SAI_READ_CAPACITY16)
+  {
+    SCSI_SenseCode(lun, ILLEGAL_REQUEST, INVALID_CDB);
+    return -1;
+  }
+  
+  if(USBD_STORAGE_fops->GetCapacity(lun, &SCSI_blk_nbr, &SCSI_blk_size) != 0)
+  {
+    SCSI_SenseCode(lun,
+                   NOT_READY, 
+                   MEDIUM_NOT_PRESENT);
+    return -1;
+  } 
+  
+  for(i=0 ; i < READ_CAPACITY16_DATA_LEN ; i++) 
+  {
+    MSC_BOT_Data[i] = 0;
+  }
+  
+  MSC_BOT_Data[4] = (uint8_t)((SCSI_blk_nbr - 1) >> 24);
+  MSC_BOT_Data[5] = (uint8_t)((SCSI_blk_nbr - 1) >> 16);
+  MSC_BOT_Data[6] = (uint8_t)((SCSI_blk_nbr - 1) >>  8);
+  MSC_BOT_Data[7] = (uint8_t)(SCSI_blk_nbr - 1);
+  
+  MSC_BOT_Data[8]  = (uint8_t)(SCSI_blk_size >>  24);
+  MSC_BOT_Data[9]  = (uint8_t)(SCSI_blk_size >>  16);
+  MSC_BOT_Data[10] = (uint8_t)(SCSI_blk_size >>  8);
+  MSC_BOT_Data[11] = (uint8_t)(SCSI_blk_size);
+  
+  if (USBD_STORAGE_fops->Unmap != 0)
+  {
+    MSC_BOT_Data[14] = 0x80; /* LBPME */
+  }
+  
+  len = ((uint32_t)params[10] << 24) | (params[11] << 16) | \
+    (params[12] << 8) | params[13];
+  
+  MSC_BOT_DataLen = MIN(len, READ_CAPACITY16_DATA_LEN);
+  return 0;
+}
+
 /**
   * @brief  SCSI_ReadFormatCapacity
   *         Process Read Format Capacity command
@@ -414,7 +527,7 @@ static int8_t SCSI_Read10(uint8_t lun , uint8_t *params)
       return -1;
     } 
     
-    SCSI_blk_addr = (params[2] << 24) | \
+    SCSI_blk_addr = ((uint32_t)params[2] << 24) | \
       (params[3] << 16) | \
         (params[4] <<  8) | \
           params[5];
@@ -489,7 +602,7 @@ static int8_t SCSI_Write10 (uint8_t lun , uint8_t *params)
     } 
     
     
-    SCSI_blk_addr = (params[2] << 24) | \
+    SCSI_blk_addr = ((uint32_t)params[2] << 24) | \
       (params[3] << 16) | \
         (params[4] <<  8) | \
           params[5];
@@ -544,6 +657,10 @@ static int8_t SCSI_Verify10(uint8_t lun , uint8_t *params){
     return -1; /* Error, Verify Mode Not supported*/
   }
   
+  SCSI_blk_addr = ((uint32_t)params[2] << 24) | (params[3] << 16) | \
+    (params[4] << 8) | params[5];
+  SCSI_blk_len = (params[7] << 8) | params[8];
+  
   if(SCSI_CheckAddressRange(lun, SCSI_blk_addr, SCSI_blk_len) < 0)
   {
     return -1; /* error */      
@@ -552,6 +669,218 @@ static int8_t SCSI_Verify10(uint8_t lun , uint8_t *params){
   return 0;
 }
 
+/**
+  * @brief  SCSI_Unmap
+  *         Process Unmap command
+  * @param  lun: Logical unit number
+  * @param  params: Command parameters
+  * @retval status
+  */
+static int8_t SCSI_Unmap(uint8_t lun, uint8_t *params)
+{
+  uint32_t len;
+  uint32_t desc_len;
+  uint32_t blk_offset;
+  uint32_t blk_nbr;
+  uint8_t *pDesc;
+  
+  if (MSC_BOT_State == BOT_IDLE) /* Idle */
+  {
+    len = (params[7] << 8) | params[8];
+    
+    if (USBD_STORAGE_fops->Unmap == 0)
+    {
+      SCSI_SenseCode(lun, ILLEGAL_REQUEST, INVALID_CDB);
+      return -1;
+    }
+    
+    if (len == 0)
+    {
+      MSC_BOT_DataLen = 0;
+      return 0;
+    }
+    
+    if ((len < 8) || (len > MSC_MEDIA_PACKET))
+    {
+      SCSI_SenseCode(lun, ILLEGAL_REQUEST, INVALID_FIELED_IN_COMMAND);
+      return -1;
+    }
+    
+    /* Get the parameter list first */
+    return SCSI_ReceiveParams(lun, len);
+  }
+  
+  MSC_BOT_csw.dDataResidue -= MSC_BOT_cbw.dDataLength;
+  
+  desc_len = (MSC_BOT_Data[2] << 8) | MSC_BOT_Data[3];
+  if (desc_len > MSC_BOT_cbw.dDataLength - 8)
+  {
+    SCSI_SenseCode(lun, ILLEGAL_REQUEST, PARAMETER_LIST_LENGTH_ERROR);
+    return -1;
+  }
+  
+  /* 16 bytes block descriptors: 64-bit LBA, 32-bit number of blocks */
+  for (pDesc = &MSC_BOT_Data[8]; desc_len >= 16; desc_len -= 16, pDesc += 16)
+  {
+    if (pDesc[0] | pDesc[1] | pDesc[2] | pDesc[3])
+    {
+      SCSI_SenseCode(lun, ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE);
+      return -1;
+    }
+    blk_offset = ((uint32_t)pDesc[4] << 24) | (pDesc[5] << 16) | \
+      (pDesc[6] << 8) | pDesc[7];
+    blk_nbr = ((uint32_t)pDesc[8] << 24) | (pDesc[9] << 16) | \
+      (pDesc[10] << 8) | pDesc[11];
+    
+    if (SCSI_UnmapRange(lun, blk_offset, blk_nbr) < 0)
+    {
+      return -1;
+    }
+  }
+  
+  MSC_BOT_SendCSW (cdev, CSW_CMD_PASSED);
+  return 0;
+}
+
+/**
+  * @brief  SCSI_WriteSame
+  *         Process Write Same 10/16 commands, only with the UNMAP bit set
+  * @param  lun: Logical unit number
+  * @param  params: Command parameters
+  * @retval status
+  */
+static int8_t SCSI_WriteSame(uint8_t lun, uint8_t *params)
+{
+  if (MSC_BOT_State == BOT_IDLE) /* Idle */
+  {
+    if (((params[1] & 0x08) == 0) || (USBD_STORAGE_fops->Unmap == 0))
+    {
+      SCSI_SenseCode(lun, ILLEGAL_REQUEST, INVALID_FIELED_IN_COMMAND);
+      return -1; /* Error, only unmapping is supported */
+    }
+    
+    if (params[0] == SCSI_WRITE_SAME10)
+    {
+      SCSI_blk_addr = ((uint32_t)params[2] << 24) | (params[3] << 16) | \
+        (params[4] << 8) | params[5];
+      SCSI_blk_len = (params[7] << 8) | params[8];
+    }
+    else
+    {
+      if (params[2] | params[3] | params[4] | params[5])
+      {
+        SCSI_SenseCode(lun, ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE);
+        return -1;
+      }
+      SCSI_blk_addr = ((uint32_t)params[6] << 24) | (params[7] << 16) | \
+        (params[8] << 8) | params[9];
+      SCSI_blk_len = ((uint32_t)params[10] << 24) | (params[11] << 16) | \
+        (params[12] << 8) | params[13];
+    }
+    
+    /* The capacity of this LUN, READ CAPACITY may not have been sent yet */
+    if(USBD_STORAGE_fops->GetCapacity(lun, &SCSI_blk_nbr, &SCSI_blk_size) != 0)
+    {
+      SCSI_SenseCode(lun,
+                     NOT_READY, 
+                     MEDIUM_NOT_PRESENT);
+      return -1;
+    }
+    
+    /* Zero blocks means up to the last block of the medium */
+    if ((SCSI_blk_len == 0) && (SCSI_blk_addr < SCSI_blk_nbr))
+    {
+      SCSI_blk_len = SCSI_blk_nbr - SCSI_blk_addr;
+    }
+    
+    if (SCSI_blk_size > MSC_MEDIA_PACKET)
+    {
+      SCSI_SenseCode(lun, ILLEGAL_REQUEST, INVALID_FIELED_IN_COMMAND);
+      return -1;
+    }
+    
+    /* The single block of data is received but not written */
+    return SCSI_ReceiveParams(lun, SCSI_blk_size);
+  }
+  
+  MSC_BOT_csw.dDataResidue -= MSC_BOT_cbw.dDataLength;
+  
+  if (SCSI_UnmapRange(lun, SCSI_blk_addr, SCSI_blk_len) < 0)
+  {
+    return -1;
+  }
+  
+  MSC_BOT_SendCSW (cdev, CSW_CMD_PASSED);
+  return 0;
+}
+
+/**
+  * @brief  SCSI_ReceiveParams
+  *         Start the data out stage of a command carrying a parameter list
+  * @param  lun: Logical unit number
+  * @param  len: parameter list length
+  * @retval status
+  */
+static int8_t SCSI_ReceiveParams(uint8_t lun, uint32_t len)
+{
+  /* case 8 : Hi <> Do */
+  if ((MSC_BOT_cbw.bmFlags & 0x80) == 0x80)
+  {
+    SCSI_SenseCode(lun, ILLEGAL_REQUEST, INVALID_CDB);
+    return -1;
+  }
+  
+  /* cases 3,11,13 : Hn,Ho <> D0 */
+  if (MSC_BOT_cbw.dDataLength != len)
+  {
+    SCSI_SenseCode(lun, ILLEGAL_REQUEST, INVALID_CDB);
+    return -1;
+  }
+  
+  MSC_BOT_State = BOT_DATA_OUT;
+  DCD_EP_PrepareRx (cdev,
+                    MSC_OUT_EP,
+                    MSC_BOT_Data, 
+                    len);  
+  return 0;
+}
+
+/**
+  * @brief  SCSI_UnmapRange
+  *         Check a range of freed blocks and pass it to the storage
+  * @param  lun: Logical unit number
+  * @param  blk_offset: first block address
+  * @param  blk_nbr: number of blocks
+  * @retval status
+  */
+static int8_t SCSI_UnmapRange(uint8_t lun, uint32_t blk_offset, uint32_t blk_nbr)
+{
+  uint32_t lun_blk_nbr, lun_blk_size;
+  
+  /* The capacity of this LUN, READ CAPACITY may not have been sent yet */
+  if(USBD_STORAGE_fops->GetCapacity(lun, &lun_blk_nbr, &lun_blk_size) != 0)
+  {
+    SCSI_SenseCode(lun,
+                   NOT_READY, 
+                   MEDIUM_NOT_PRESENT);
+    return -1;
+  }
+  
+  if ((blk_offset > lun_blk_nbr) || (blk_nbr > lun_blk_nbr - blk_offset))
+  {
+    SCSI_SenseCode(lun, ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE);
+    return -1;
+  }
+  
+  if ((blk_nbr != 0) && 
+      (USBD_STORAGE_fops->Unmap(lun, blk_offset, blk_nbr) < 0))
+  {
+    SCSI_SenseCode(lun, HARDWARE_ERROR, WRITE_FAULT);
+    return -1;
+  }
+  return 0;
+}
+
 /**
   * @brief  SCSI_CheckAddressRange
   *         Check address range
@@ -563,7 +892,8 @@ static int8_t SCSI_Verify10(uint8_t lun , uint8_t *params){
 static int8_t SCSI_CheckAddressRange (uint8_t lun , uint32_t blk_offset , uint16_t blk_nbr)
 {
   
-  if ((blk_offset + blk_nbr) > SCSI_blk_nbr )
+  /* Written so that an address near 0xFFFFFFFF cannot wrap past the end */
+  if ((blk_offset > SCSI_blk_nbr) || (blk_nbr > SCSI_blk_nbr - blk_offset))
   {
     SCSI_SenseCode(lun, ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE);
     return -1;
@@ -580,19 +910,135 @@ static int8_t SCSI_CheckAddressRange (uint8_t lun , uint32_t blk_offset , uint16
 static int8_t SCSI_ProcessRead (uint8_t lun)
 {
   uint32_t len;
+  int8_t status;
+  
+  if (SCSI_MediaState != SCSI_MEDIA_IDLE)
+  {
+    /* Started again by USBD_STORAGE_Cplt() of the aborted command */
+    SCSI_MediaPending = 1;
+    return 0;
+  }
   
   len = MIN(SCSI_blk_len , MSC_MEDIA_PACKET); 
   
-  if( USBD_STORAGE_fops->Read(lun ,
-                              MSC_BOT_Data, 
-                              SCSI_blk_addr / SCSI_blk_size, 
-                              len / SCSI_blk_size) < 0)
+  status = USBD_STORAGE_fops->Read(lun ,
+                                   MSC_BOT_Data, 
+                                   SCSI_blk_addr / SCSI_blk_size, 
+                                   len / SCSI_blk_size);
+  if (status == USBD_STORAGE_BUSY)
+  {
+    /* IN endpoint NAKs until USBD_STORAGE_Cplt() */
+    SCSI_MediaState = SCSI_MEDIA_BUSY;
+    return 0;
+  }
+  
+  return SCSI_ReadCplt(lun, status);
+}
+
+/**
+  * @brief  SCSI_ProcessWrite
+  *         Handle Write Process
+  * @param  lun: Logical unit number
+  * @retval status
+  */
+
+static int8_t SCSI_ProcessWrite (uint8_t lun)
+{
+  uint32_t len;
+  int8_t status;
+  
+  len = MIN(SCSI_blk_len , MSC_MEDIA_PACKET); 
+  
+  if (SCSI_MediaState != SCSI_MEDIA_IDLE)
+  {
+    /* Started again by USBD_STORAGE_Cplt() of the aborted command */
+    SCSI_MediaPending = 1;
+    return 0;
+  }
+  
+  status = USBD_STORAGE_fops->Write(lun ,
+                                    MSC_BOT_Data, 
+                                    SCSI_blk_addr / SCSI_blk_size, 
+                                    len / SCSI_blk_size);
+  if (status == USBD_STORAGE_BUSY)
+  {
+    /* OUT endpoint NAKs, and the CSW waits, until USBD_STORAGE_Cplt() */
+    SCSI_MediaState = SCSI_MEDIA_BUSY;
+    return 0;
+  }
+  
+  return SCSI_WriteCplt(lun, status);
+}
+
+/**
+  * @brief  USBD_STORAGE_Cplt
+  *         Report the end of a Read/Write which returned USBD_STORAGE_BUSY,
+  *         and go on with the data stage. Can be called from the main loop
+  *         or from an interrupt handler, not with the USB interrupt disabled.
+  * @param  lun: Logical unit number
+  * @param  status: 0 if the access succeeded, -1 otherwise
+  * @retval None
+  */
+void USBD_STORAGE_Cplt (uint8_t lun, int8_t status)
+{
+  int8_t ret = 0;
+  
+  NVIC_DisableIRQ(USB_IRQn);
+  SCSI_MediaState = SCSI_MEDIA_IDLE;
+  
+  if (SCSI_MediaDiscard || 
+      ((MSC_BOT_State != BOT_DATA_IN) && (MSC_BOT_State != BOT_DATA_OUT)))
+  {
+    /* End of an access of an aborted command, the data stage of the
+       current one may be waiting for it */
+    SCSI_MediaDiscard = 0;
+    if (SCSI_MediaPending)
+    {
+      SCSI_MediaPending = 0;
+      if (MSC_BOT_State == BOT_DATA_IN)
+      {
+        ret = SCSI_ProcessRead(MSC_BOT_cbw.bLUN);
+      }
+      else if (MSC_BOT_State == BOT_DATA_OUT)
+      {
+        ret = SCSI_ProcessWrite(MSC_BOT_cbw.bLUN);
+      }
+    }
+  }
+  else if (MSC_BOT_State == BOT_DATA_IN)
+  {
+    ret = SCSI_ReadCplt(lun, status);
+  }
+  else
+  {
+    ret = SCSI_WriteCplt(lun, status);
+  }
+  
+  if (ret < 0)
+  {
+    MSC_BOT_SendCSW (cdev, CSW_CMD_FAILED);
+  }
+  NVIC_EnableIRQ(USB_IRQn);
+}
+
+/**
+  * @brief  SCSI_ReadCplt
+  *         Send the data read from the medium
+  * @param  lun: Logical unit number
+  * @param  status: Read status
+  * @retval status
+  */
+static int8_t SCSI_ReadCplt (uint8_t lun, int8_t status)
+{
+  uint32_t len;
+  
+  if (status < 0)
   {
-    
     SCSI_SenseCode(lun, HARDWARE_ERROR, UNRECOVERED_READ_ERROR);
     return -1; 
   }
   
+  len = MIN(SCSI_blk_len , MSC_MEDIA_PACKET); 
   
   DCD_EP_Tx (cdev, 
              MSC_IN_EP,
@@ -614,27 +1060,23 @@ static int8_t SCSI_ProcessRead (uint8_t lun)
 }
 
 /**
-  * @brief  SCSI_ProcessWrite
-  *         Handle Write Process
+  * @brief  SCSI_WriteCplt
+  *         Receive the next data once the medium is written
   * @param  lun: Logical unit number
+  * @param  status: Write status
   * @retval status
   */
-
-static int8_t SCSI_ProcessWrite (uint8_t lun)
+static int8_t SCSI_WriteCplt (uint8_t lun, int8_t status)
 {
   uint32_t len;
   
-  len = MIN(SCSI_blk_len , MSC_MEDIA_PACKET); 
-  
-  if(USBD_STORAGE_fops->Write(lun ,
-                              MSC_BOT_Data, 
-                              SCSI_blk_addr / SCSI_blk_size, 
-                              len / SCSI_blk_size) < 0)
+  if (status < 0)
   {
     SCSI_SenseCode(lun, HARDWARE_ERROR, WRITE_FAULT);     
     return -1; 
   }
   
+  len = MIN(SCSI_blk_len , MSC_MEDIA_PACKET); 
   
   SCSI_blk_addr  += len; 
   SCSI_blk_len   -= len; 
@@ -0,0 +1,53 @@
+/**
+  ******************************************************************************
+  * @file    usbd_msc_cdc_wrapper.h
+  * @author  MCD Application Team
+  * @version V1.0.1
+  * @date    31-January-2014
+  * @brief   header file for the usbd_msc_cdc_wrapper.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_MSC_CDC_WRAPPER_H_
+#define __USB_MSC_CDC_WRAPPER_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc_core.h"
+#include "usbd_cdc_core.h"
+
+/* Exported defines ----------------------------------------------------------*/
+#define MSC_INTERFACE        0x0
+#define CDC_COM_INTERFACE    0x1
+#define CDC_DATA_INTERFACE   0x2
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported macros -----------------------------------------------------------*/
+#define USB_MSC_CDC_CONFIG_DESC_SIZ  (USB_MSC_CONFIG_DESC_SIZ -9 + USB_CDC_CONFIG_DESC_SIZ + 8)
+
+/* Exported variables --------------------------------------------------------*/
+extern USBD_Class_cb_TypeDef  USBD_MSC_CDC_cb;
+
+/* Exported functions ------------------------------------------------------- */
+
+
+#endif  /* __USB_MSC_CDC_WRAPPER_H_ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
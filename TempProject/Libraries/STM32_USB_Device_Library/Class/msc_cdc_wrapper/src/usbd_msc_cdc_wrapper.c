@@ -0,0 +1,382 @@
+/**
+  ******************************************************************************
+  * @file    usbd_msc_cdc_wrapper.c
+  * @author  MCD Application Team
+  * @version V1.0.1
+  * @date    31-January-2014
+  * @brief   This file calls to the separate MSC and CDC class layer handlers.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  *****************************************************************************/
+  /*
+  *    ===================================================================
+  *                          composite MSC_CDC
+  *    =================================================================== */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc_cdc_wrapper.h"
+#include "usbd_desc.h"
+#include "usbd_req.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static uint8_t  USBD_MSC_CDC_Init         (void *pdev , uint8_t cfgidx);
+static uint8_t  USBD_MSC_CDC_DeInit       (void *pdev , uint8_t cfgidx);
+
+/* Control Endpoints*/
+static uint8_t  USBD_MSC_CDC_Setup        (void *pdev , USB_SETUP_REQ  *req);
+static uint8_t  USBD_MSC_CDC_EP0_RxReady  (void *pdev);
+
+/* Class Specific Endpoints*/
+static uint8_t  USBD_MSC_CDC_DataIn       (void *pdev , uint8_t epnum);
+static uint8_t  USBD_MSC_CDC_DataOut      (void *pdev , uint8_t epnum);
+static uint8_t  USBD_MSC_CDC_SOF          (void *pdev);
+
+static uint8_t*  USBD_MSC_CDC_GetConfigDescriptor( uint8_t speed , uint16_t *length);
+
+USBD_Class_cb_TypeDef  USBD_MSC_CDC_cb =
+{
+  USBD_MSC_CDC_Init,
+  USBD_MSC_CDC_DeInit,
+  USBD_MSC_CDC_Setup,
+  NULL,
+  USBD_MSC_CDC_EP0_RxReady,
+  USBD_MSC_CDC_DataIn,
+  USBD_MSC_CDC_DataOut,
+  USBD_MSC_CDC_SOF,
+  USBD_MSC_CDC_GetConfigDescriptor,
+};
+
+/* USB MSC_CDC device Configuration Descriptor */
+const uint8_t USBD_MSC_CDC_CfgDesc[USB_MSC_CDC_CONFIG_DESC_SIZ] =
+{
+  0x09, /* bLength: Configuration Descriptor size */
+  USB_CONFIGURATION_DESCRIPTOR_TYPE, /* bDescriptorType: Configuration */
+  USB_MSC_CDC_CONFIG_DESC_SIZ,
+  /* wTotalLength: Bytes returned */
+  0x00,
+  0x03,         /*bNumInterfaces: 3 interfaces (1 for MSC, 2 for CDC)*/
+  0x01,         /*bConfigurationValue: Configuration value*/
+  0x00,         /*iConfiguration: Index of string descriptor describing
+  the configuration*/
+  0xC0,         /*bmAttributes: self powered */
+  0x32,         /*MaxPower 100 mA: this current is used for detecting Vbus*/
+
+  /********************  Mass Storage interface ********************/
+  /* 09 */
+  0x09,   /* bLength: Interface Descriptor size */
+  0x04,   /* bDescriptorType: */
+  MSC_INTERFACE,   /* bInterfaceNumber: Number of Interface */
+  0x00,   /* bAlternateSetting: Alternate setting */
+  0x02,   /* bNumEndpoints*/
+  0x08,   /* bInterfaceClass: MSC Class */
+  0x06,   /* bInterfaceSubClass : SCSI transparent*/
+  0x50,   /* nInterfaceProtocol */
+  0x00,   /* iInterface: */
+  /********************  Mass Storage Endpoints ********************/
+  0x07,   /*Endpoint descriptor length = 7*/
+  0x05,   /*Endpoint descriptor type */
+  MSC_IN_EP,   /*Endpoint address (IN, address 1) */
+  0x02,   /*Bulk endpoint type */
+  LOBYTE(MSC_MAX_PACKET),
+  HIBYTE(MSC_MAX_PACKET),
+  0x00,   /*Polling interval in milliseconds */
+
+  0x07,   /*Endpoint descriptor length = 7 */
+  0x05,   /*Endpoint descriptor type */
+  MSC_OUT_EP,   /*Endpoint address (OUT, address 2) */
+  0x02,   /*Bulk endpoint type */
+  LOBYTE(MSC_MAX_PACKET),
+  HIBYTE(MSC_MAX_PACKET),
+  0x00,   /*Polling interval in milliseconds*/
+  /* 32 */
+
+  /******** IAD should be positioned just before the CDC interfaces ******
+                IAD to associate the two CDC interfaces */
+
+  0x08, /* bLength */
+  0x0B, /* bDescriptorType */
+  CDC_COM_INTERFACE, /* bFirstInterface */
+  0x02, /* bInterfaceCount */
+  0x02, /* bFunctionClass */
+  0x02, /* bFunctionSubClass */
+  0x01, /* bFunctionProtocol */
+  0x00, /* iFunction (Index of string descriptor describing this function) */
+  /* 40 */
+
+  /*************************** CDC interfaces *******************************/
+
+  /*Interface Descriptor */
+  0x09,   /* bLength: Interface Descriptor size */
+  USB_INTERFACE_DESCRIPTOR_TYPE,  /* bDescriptorType: Interface */
+  /* Interface descriptor type */
+  CDC_COM_INTERFACE,   /* bInterfaceNumber: Number of Interface */
+  0x00,   /* bAlternateSetting: Alternate setting */
+  0x01,   /* bNumEndpoints: One endpoints used */
+  0x02,   /* bInterfaceClass: Communication Interface Class */
+  0x02,   /* bInterfaceSubClass: Abstract Control Model */
+  0x01,   /* bInterfaceProtocol: Common AT commands */
+  0x00,   /* iInterface: */
+
+  /*Header Functional Descriptor*/
+  0x05,   /* bLength: Endpoint Descriptor size */
+  0x24,   /* bDescriptorType: CS_INTERFACE */
+  0x00,   /* bDescriptorSubtype: Header Func Desc */
+  0x10,   /* bcdCDC: spec release number */
+  0x01,
+
+  /*Call Management Functional Descriptor*/
+  0x05,   /* bFunctionLength */
+  0x24,   /* bDescriptorType: CS_INTERFACE */
+  0x01,   /* bDescriptorSubtype: Call Management Func Desc */
+  0x00,   /* bmCapabilities: D0+D1 */
+  CDC_DATA_INTERFACE,   /* bDataInterface: 2 */
+
+  /*ACM Functional Descriptor*/
+  0x04,   /* bFunctionLength */
+  0x24,   /* bDescriptorType: CS_INTERFACE */
+  0x02,   /* bDescriptorSubtype: Abstract Control Management desc */
+  0x02,   /* bmCapabilities */
+
+  /*Union Functional Descriptor*/
+  0x05,   /* bFunctionLength */
+  0x24,   /* bDescriptorType: CS_INTERFACE */
+  0x06,   /* bDescriptorSubtype: Union func desc */
+  CDC_COM_INTERFACE,    /* bMasterInterface: Communication class interface */
+  CDC_DATA_INTERFACE,   /* bSlaveInterface0: Data Class Interface */
+
+  /*Endpoint 2 Descriptor*/
+  0x07,                           /* bLength: Endpoint Descriptor size */
+  USB_ENDPOINT_DESCRIPTOR_TYPE,   /* bDescriptorType: Endpoint */
+  CDC_CMD_EP,                     /* bEndpointAddress */
+  0x03,                           /* bmAttributes: Interrupt */
+  LOBYTE(CDC_CMD_PACKET_SZE),     /* wMaxPacketSize: */
+  HIBYTE(CDC_CMD_PACKET_SZE),
+  0xFF,                           /* bInterval: */
+
+  /*---------------------------------------------------------------------------*/
+
+  /*Data class interface descriptor*/
+  0x09,   /* bLength: Endpoint Descriptor size */
+  USB_INTERFACE_DESCRIPTOR_TYPE,  /* bDescriptorType: */
+  CDC_DATA_INTERFACE,   /* bInterfaceNumber: Number of Interface */
+  0x00,   /* bAlternateSetting: Alternate setting */
+  0x02,   /* bNumEndpoints: Two endpoints used */
+  0x0A,   /* bInterfaceClass: CDC */
+  0x00,   /* bInterfaceSubClass: */
+  0x00,   /* bInterfaceProtocol: */
+  0x00,   /* iInterface: */
+
+  /*Endpoint OUT Descriptor*/
+  0x07,   /* bLength: Endpoint Descriptor size */
+  USB_ENDPOINT_DESCRIPTOR_TYPE,      /* bDescriptorType: Endpoint */
+  CDC_OUT_EP,                        /* bEndpointAddress */
+  0x02,                              /* bmAttributes: Bulk */
+  LOBYTE(CDC_DATA_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
+  HIBYTE(CDC_DATA_MAX_PACKET_SIZE),
+  0x00,                              /* bInterval: ignore for Bulk transfer */
+
+  /*Endpoint IN Descriptor*/
+  0x07,   /* bLength: Endpoint Descriptor size */
+  USB_ENDPOINT_DESCRIPTOR_TYPE,      /* bDescriptorType: Endpoint */
+  CDC_IN_EP,                         /* bEndpointAddress */
+  0x02,                              /* bmAttributes: Bulk */
+  LOBYTE(CDC_DATA_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
+  HIBYTE(CDC_DATA_MAX_PACKET_SIZE),
+  0x00                               /* bInterval: ignore for Bulk transfer */
+
+}; /* USBD_MSC_CDC_CfgDesc */
+
+/* Private function prototypes -----------------------------------------------*/
+/*********************************************
+   MSC Device library callbacks
+*********************************************/
+extern uint8_t  USBD_MSC_Init (void  *pdev, uint8_t cfgidx);
+extern uint8_t  USBD_MSC_DeInit (void  *pdev, uint8_t cfgidx);
+extern uint8_t  USBD_MSC_Setup (void  *pdev, USB_SETUP_REQ *req);
+extern uint8_t  USBD_MSC_DataIn (void  *pdev, uint8_t epnum);
+extern uint8_t  USBD_MSC_DataOut (void  *pdev,  uint8_t epnum);
+
+/*********************************************
+   CDC Device library callbacks
+*********************************************/
+extern uint8_t  usbd_cdc_Init        (void  *pdev, uint8_t cfgidx);
+extern uint8_t  usbd_cdc_DeInit      (void  *pdev, uint8_t cfgidx);
+extern uint8_t  usbd_cdc_Setup       (void  *pdev, USB_SETUP_REQ *req);
+extern uint8_t  usbd_cdc_EP0_RxReady  (void *pdev);
+extern uint8_t  usbd_cdc_DataIn      (void *pdev, uint8_t epnum);
+extern uint8_t  usbd_cdc_DataOut     (void *pdev, uint8_t epnum);
+extern uint8_t  usbd_cdc_SOF         (void *pdev);
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  USBD_MSC_CDC_Init
+  *         Initialize the MSC & CDC interfaces
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t  USBD_MSC_CDC_Init (void  *pdev,
+                                   uint8_t cfgidx)
+{
+  /* MSC initialization */
+  USBD_MSC_Init (pdev,cfgidx);
+
+  /* CDC initialization */
+  usbd_cdc_Init (pdev,cfgidx);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MSC_CDC_DeInit
+  *         DeInitialize the MSC/CDC interfaces
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t  USBD_MSC_CDC_DeInit (void  *pdev,
+                                     uint8_t cfgidx)
+{
+  /* MSC De-initialization */
+  USBD_MSC_DeInit (pdev,cfgidx);
+
+  /* CDC De-initialization */
+  usbd_cdc_DeInit (pdev,cfgidx);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MSC_CDC_Setup
+  *         Route the class specific requests to the MSC or CDC handler
+  * @param  pdev: instance
+  * @param  req: usb requests
+  * @retval status
+  */
+static uint8_t  USBD_MSC_CDC_Setup (void  *pdev,
+                                    USB_SETUP_REQ *req)
+{
+  switch (req->bmRequest & USB_REQ_RECIPIENT_MASK)
+  {
+  case USB_REQ_RECIPIENT_INTERFACE:
+    if ((req->wIndex == CDC_COM_INTERFACE) || (req->wIndex == CDC_DATA_INTERFACE))
+    {
+      return (usbd_cdc_Setup (pdev, req));
+    }
+    else
+    {
+      return (USBD_MSC_Setup(pdev, req));
+    }
+  case USB_REQ_RECIPIENT_ENDPOINT:
+    if ((req->wIndex == CDC_IN_EP) || (req->wIndex == CDC_OUT_EP) ||
+        (req->wIndex == CDC_CMD_EP))
+    {
+      return (usbd_cdc_Setup (pdev, req));
+    }
+    else
+    {
+      return (USBD_MSC_Setup(pdev, req));
+    }
+  }
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_MSC_CDC_GetConfigDescriptor
+  *         return configuration descriptor
+  * @param  speed : current device speed
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_MSC_CDC_GetConfigDescriptor (uint8_t speed, uint16_t *length)
+{
+  *length = sizeof (USBD_MSC_CDC_CfgDesc);
+  return (uint8_t*)USBD_MSC_CDC_CfgDesc;
+}
+
+/**
+  * @brief  USBD_MSC_CDC_DataIn
+  *         handle data IN Stage
+  * @param  pdev: device instance
+  * @param  epnum: endpoint index
+  * @retval status
+  */
+static uint8_t  USBD_MSC_CDC_DataIn (void  *pdev,
+                                     uint8_t epnum)
+{
+  /*DataIN can be for MSC or CDC */
+
+  if (epnum == (MSC_IN_EP&~0x80) )
+  {
+    return (USBD_MSC_DataIn(pdev, epnum));
+  }
+  else
+  {
+    return (usbd_cdc_DataIn(pdev, epnum));
+  }
+}
+
+/**
+  * @brief  USBD_MSC_CDC_DataOut
+  *         handle data OUT Stage
+  * @param  pdev: device instance
+  * @param  epnum: endpoint index
+  * @retval status
+  */
+static uint8_t  USBD_MSC_CDC_DataOut(void *pdev , uint8_t epnum)
+{
+  /*DataOut can be for MSC or CDC */
+
+  if (epnum == (MSC_OUT_EP&~0x80) )
+  {
+    return (USBD_MSC_DataOut(pdev, epnum));
+  }
+  else
+  {
+    return (usbd_cdc_DataOut(pdev, epnum));
+  }
+}
+
+/**
+  * @brief  USBD_MSC_CDC_SOF
+  *         handle SOF event, only the CDC IN pipe is served from it
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t  USBD_MSC_CDC_SOF (void *pdev)
+{
+  return (usbd_cdc_SOF(pdev));
+}
+
+/**
+  * @brief  USBD_MSC_CDC_EP0_RxReady
+  *         handle RxReady processing
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t  USBD_MSC_CDC_EP0_RxReady  (void *pdev)
+{
+  /*RxReady processing needed for CDC only*/
+  return (usbd_cdc_EP0_RxReady(pdev));
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -43,6 +43,7 @@
 #define USBD_ITF_MAX_NUM                1
 #define USB_MAX_STR_DESC_SIZ            200 
 #define AUDIO_OUT_EP                    0x01
+#define AUDIO_FB_EP                     0x82
 
 /*CCID Class user defines*/
 #define USBD_ITF_MAX_NUM                1
@@ -106,7 +107,7 @@
 #define USBD_ITF_MAX_NUM                MAX_USED_MEDIA
 #define USB_MAX_STR_DESC_SIZ            200 
 #define USB_SUPPORT_USER_STRING_DESC
-#define XFERSIZE                        1024   /* Max DFU Packet Size   = 1024 bytes */
+#define XFERSIZE                        2048   /* Max DFU Packet Size   = one 2 KB flash page */
 #define DFU_IN_EP                       0x80
 #define DFU_OUT_EP                      0x00
  /* Maximum number of supported media (Flash) */
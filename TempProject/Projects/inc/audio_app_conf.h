@@ -0,0 +1,72 @@
+/**
+  ******************************************************************************
+  * @file    audio_app_conf.h
+  * @author  MCD Application Team
+  * @version V1.0.0
+  * @date    31-January-2014
+  * @brief   Configuration of the STM32_Audio modules used by the application
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AUDIO_APP_CONF_H
+#define __AUDIO_APP_CONF_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported constants --------------------------------------------------------*/
+/* WAV recorder (stm32_audio_recorder.c) to a file of the FatFs volumes. It
+   needs the capture low layer of the board (STM32_AudioRec_xxx functions
+   called by stm32_audio_in_if.c), and a static ring of
+   AUDIO_RECORDER_BLOCK_NBR blocks of _MAX_SS bytes. It is not part of
+   usbd_msc.uvprojx: the STM32072B-EVAL package has no capture low layer,
+   and the 8 KB ring does not fit in the RAM left by the disk (usbd_conf.h). */
+/* #define __WAV_ENCODER__ */
+
+/* Capture format */
+#define DEFAULT_IN_AUDIO_FREQ         16000
+#define DEFAULT_IN_BIT_RESOLUTION     16
+#define DEFAULT_IN_CHANNEL_NBR        1   /* Mono = 1, Stereo = 2 */
+#define DEFAULT_VOLUME                70
+
+/* Two blocks of _MAX_SS (4 KB): one captured while the other is written.
+   The recorder interrupt, on EXTI4_15 by default, must not be one of the
+   EXTI lines of the application. */
+#define AUDIO_RECORDER_BLOCK_NBR      2
+
+/* USB speaker (usbd_audio_core.c). It is a device of its own, never built
+   with the MSC and CDC one of usbd_conf.h, so its PMA layout takes the place
+   of their bulk buffers (usb_conf.h). The stream comes on EP1 OUT,
+   isochronous and double buffered with two AUDIO_OUT_MPS (384 bytes)
+   buffers, and the rate feedback goes on EP2 IN from one buffer. */
+#define AUDIO_TOTAL_IF_NUM            0x02
+#define AUDIO_OUT_EP                  0x01
+#define AUDIO_FB_EP                   0x82
+#define Audio_IN_TX_ADRESS            (0xB0 | (0x230 << 16))
+#define Audio_FB_TX_ADRESS            (0x3B0)
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported functions ------------------------------------------------------- */
+
+#endif /* __AUDIO_APP_CONF_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
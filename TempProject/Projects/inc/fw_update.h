@@ -0,0 +1,91 @@
+/**
+  ******************************************************************************
+  * @file    fw_update.h
+  * @author  MCD Application Team
+  * @version V1.0.0
+  * @date    31-January-2014
+  * @brief   header file for the fw_update.c file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __FW_UPDATE_H
+#define __FW_UPDATE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+#include "ff.h"
+
+/* Exported types ------------------------------------------------------------*/
+/* Image trailer: appended to FWUPD_FILE by the host tool and programmed at
+   FWUPD_TRAILER_ADDRESS once the image is written and verified */
+typedef struct
+{
+  uint32_t Magic;      /* FWUPD_MAGIC */
+  uint32_t Size;       /* Image size in bytes, trailer excluded */
+  uint32_t Crc;        /* CRC-32 (poly 0x04C11DB7, init 0xFFFFFFFF, not
+                          reflected) of the image padded with 0xFF to a
+                          word multiple, words taken little endian */
+  uint32_t Reserved;
+} FWUPD_Trailer_TypeDef;
+
+typedef enum
+{
+  FWUPD_NONE = 0,      /* No image on the volume */
+  FWUPD_DONE,          /* New image programmed */
+  FWUPD_BAD_IMAGE,     /* Image rejected, renamed to FWUPD_ERROR_FILE */
+  FWUPD_NO_BACKUP,     /* Current image could not be saved, nothing done */
+  FWUPD_ROLLED_BACK,   /* Programming failed, previous image restored */
+  FWUPD_FAILED         /* Programming failed, no valid image in the slot */
+} FWUPD_Status;
+
+/* Exported constants --------------------------------------------------------*/
+/* Drag-and-drop update: the image dropped on the USB disk is checked at
+   reset, before the USB device is started */
+#define USE_FW_UPDATE
+
+/* Application slot in the internal flash */
+#define FWUPD_APP_ADDRESS          0x08010000
+#define FWUPD_APP_SIZE             0x00010000
+#define FWUPD_PAGE_SIZE            0x800
+#define FWUPD_TRAILER_ADDRESS      (FWUPD_APP_ADDRESS + FWUPD_APP_SIZE - sizeof(FWUPD_Trailer_TypeDef))
+#define FWUPD_MAX_IMAGE_SIZE       (FWUPD_APP_SIZE - sizeof(FWUPD_Trailer_TypeDef))
+#define FWUPD_MAGIC                0x50555746  /* "FWUP" */
+
+/* Key held at reset: stay in the updater and show the disk instead of
+   starting the application, the same key main() polls to leave the disk */
+#define FWUPD_STAY_IN_UPDATER()    (GPIO_ReadInputDataBit(GPIOA, GPIO_Pin_0) != Bit_RESET)
+
+/* Bytes read from the volume and programmed at a time */
+#define FWUPD_CHUNK_SIZE           256
+
+#define FWUPD_FILE                 "0:/FIRMWARE.BIN"
+#define FWUPD_BACKUP_FILE          "0:/FW_OLD.BIN"
+#define FWUPD_ERROR_FILE           "0:/FIRMWARE.ERR"
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported functions ------------------------------------------------------- */
+FWUPD_Status FWUPD_Check (FATFS *fs);
+uint8_t      FWUPD_IsAppValid (void);
+void         FWUPD_JumpToApp (void);
+
+#endif /* __FW_UPDATE_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
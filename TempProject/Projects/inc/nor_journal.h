@@ -0,0 +1,110 @@
+/**
+  ******************************************************************************
+  * @file    nor_journal.h
+  * @author  MCD Application Team
+  * @version V1.0.0
+  * @date    31-January-2014
+  * @brief   header file for the nor_journal.c file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __NOR_JOURNAL_H
+#define __NOR_JOURNAL_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+#include "spi_spiflash.h"
+#include "ff.h"
+
+#if defined(USE_NOR_JOURNAL) && !defined(USE_SPI_SD)
+ #error "USE_NOR_JOURNAL migrates the journal to the SD card: define USE_SPI_SD in ffconf.h"
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+/* Header programmed in the first page of each segment when it is opened */
+typedef struct
+{
+  uint32_t Magic;      /* JOURNAL_MAGIC */
+  uint32_t Seq;        /* Incremented for each segment opened, from 1 */
+  uint32_t Crc;        /* CRC-32 of Magic and Seq */
+  uint32_t Migrated;   /* 0xFFFFFFFF, programmed to 0 once copied to the SD */
+} JOURNAL_Header_TypeDef;
+
+/* Header of the data pages, each page holds one batch of samples */
+typedef struct
+{
+  uint16_t Len;        /* Payload length, 0xFFFF for an erased page */
+  uint16_t Reserved;
+  uint32_t Crc;        /* CRC-32 of the segment Seq, Len and the payload: a
+                          torn page or a page left by an older pass fails */
+} JOURNAL_PageHeader_TypeDef;
+
+/* Position of a reader in the journal, see JOURNAL_IterInit */
+typedef struct
+{
+  uint32_t Seg;        /* Segment read */
+  uint32_t Seq;        /* Its sequence number, 0 once the reader is lost */
+  uint32_t Page;       /* Page read, 0 before the first one */
+  uint16_t Len;        /* Payload of the page */
+  uint16_t Off;        /* Payload bytes already returned */
+} JOURNAL_Iter_TypeDef;
+
+typedef struct
+{
+  uint32_t Appended;   /* Bytes accepted by JOURNAL_Append */
+  uint32_t Migrated;   /* Bytes copied to JOURNAL_FILE */
+  uint32_t Dropped;    /* Segments overwritten before they were migrated */
+  uint32_t Stalls;     /* Appends that had to program a page themselves */
+} JOURNAL_Stats_TypeDef;
+
+/* Exported constants --------------------------------------------------------*/
+/* One segment per FLASH sector, at the top of the chip */
+#define JOURNAL_FIRST_SECTOR       FLASH_VOLUME_SECTOR_COUNT
+#define JOURNAL_SEGMENT_NBR        JOURNAL_SECTOR_COUNT
+#define JOURNAL_PAGES_PER_SEGMENT  (FLASH_SECTOR_SIZE / sFLASH_SPI_PAGESIZE)
+
+#define JOURNAL_PAGE_HEADER_SIZE   sizeof(JOURNAL_PageHeader_TypeDef)
+#define JOURNAL_PAGE_DATA_SIZE     (sFLASH_SPI_PAGESIZE - JOURNAL_PAGE_HEADER_SIZE)
+
+#define JOURNAL_MAGIC              0x4C4E524A  /* "JRNL" */
+
+/* Bulk volume the sealed segments are moved to, and size of the batches
+   handed to f_write: a multiple of the SD block so that FatFs passes them
+   to the card without its window. One block to fit in the RAM of the
+   STM32F072 (usbd_conf.h) */
+#define JOURNAL_FILE               "1:/SAMPLES.BIN"
+#define JOURNAL_MIGRATE_SIZE       512
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported variables --------------------------------------------------------*/
+extern JOURNAL_Stats_TypeDef JOURNAL_Stats;
+
+/* Exported functions ------------------------------------------------------- */
+uint8_t  JOURNAL_Init (FATFS *fs);
+uint32_t JOURNAL_Append (const uint8_t *buf, uint32_t len);
+void     JOURNAL_Flush (void);
+void     JOURNAL_Process (void);
+void     JOURNAL_IterInit (JOURNAL_Iter_TypeDef *it);
+uint32_t JOURNAL_IterRead (JOURNAL_Iter_TypeDef *it, uint8_t *buf, uint32_t len);
+
+#endif /* __NOR_JOURNAL_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
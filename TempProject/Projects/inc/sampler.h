@@ -0,0 +1,56 @@
+/**
+  ******************************************************************************
+  * @file    sampler.h
+  * @author  MCD Application Team
+  * @version V1.0.0
+  * @date    31-January-2014
+  * @brief   header file for the sampler.c file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SAMPLER_H
+#define __SAMPLER_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f0xx.h"
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported constants --------------------------------------------------------*/
+/* Time between two samples of the temperature, in SysTick periods (ms) */
+#define SAMPLER_PERIOD_MS          1000
+
+/* One sample is one data line of the PDF report (DATA_LINE_LENGTH in pdf.h),
+   padded with spaces. The journal stores it as is, the CDC stream gets it
+   followed by CR LF */
+#define SAMPLER_LINE_LENGTH        36
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported variables --------------------------------------------------------*/
+extern __IO uint32_t SAMPLER_Tick;
+
+/* Exported functions ------------------------------------------------------- */
+void SAMPLER_Init (void);
+void SAMPLER_Process (void);
+void SAMPLER_FormatLine (char *line, uint32_t index, int32_t temp);
+
+#endif /* __SAMPLER_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -16,6 +16,18 @@
 #define FLASH_SECTOR_SIZE         4096
 #define FLASH_SECTOR_COUNT        512
 
+/* Uncomment to keep the top of the chip out of the FatFs volume for the
+   sample journal, see nor_journal.h. Reformat the volume after changing it. */
+//#define USE_NOR_JOURNAL
+
+#ifdef USE_NOR_JOURNAL
+#define JOURNAL_SECTOR_COUNT      64
+#else
+#define JOURNAL_SECTOR_COUNT      0
+#endif
+/* Sectors seen by FatFs and by the USB host */
+#define FLASH_VOLUME_SECTOR_COUNT (FLASH_SECTOR_COUNT - JOURNAL_SECTOR_COUNT)
+
 #define sFLASH_W25Q16_ID          0xEF4015
 
 #define SPIx                             SPI2
@@ -50,13 +62,13 @@
 /* Deselect sFLASH: Chip Select pin high */
 #define sFLASH_CS_HIGH()      GPIO_WriteBit(GPIOB,GPIO_Pin_12,Bit_SET) 
 
-void SPI_FLASH_PageErase(uint32_t PageAddr);
 void sFLASH_EraseSector(uint32_t SectorAddr);
+void sFLASH_StartEraseSector(uint32_t SectorAddr);
 void sFLASH_EraseBulk(void);
 void sFLASH_WritePage(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite);
+void sFLASH_StartWritePage(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite);
 void sFLASH_WriteBuffer(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite);
 void sFLASH_ReadBuffer(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead);
-void SPI_Flash_Write(uint8_t* pBuffer,uint32_t WriteAddr,uint16_t NumByteToWrite);
 uint32_t sFLASH_ReadID(void);
 void sFLASH_StartReadSequence(uint32_t ReadAddr);
 
@@ -68,7 +80,12 @@ uint8_t sFLASH_SendByte(uint8_t byte);
 uint16_t sFLASH_SendHalfWord(uint16_t HalfWord);
 void sFLASH_WriteEnable(void);
 void sFLASH_WaitForWriteEnd(void);
+uint8_t sFLASH_IsWriteBusy(void);
 
 void SPI_Config(void);
 void sFLASH_sector_read(uint8_t * buffer, uint32_t sector, uint16_t sector_number);
 void sFLASH_sector_write(uint8_t * buffer, uint32_t sector, uint16_t sector_number);
+
+void sFLASH_TrimSectors(uint32_t sector, uint32_t sector_number);
+uint8_t sFLASH_TrimStep(void);
+uint8_t sFLASH_PrepareSectorWrite(uint32_t sector);
@@ -46,20 +46,57 @@
 
 
 /* Endpoints used by the device */
-#define EP_NUM    (3) /* EP0 + EP1 for MSC IN + EP2 for MSC OUT */
+#define EP_NUM    (6) /* EP0 + EP1 for MSC IN + EP2 for MSC OUT + EP3 for CDC data IN
+                         + EP4 for CDC commands + EP5 for CDC data OUT */
 
 /* Buffer table base address */
 #define BTABLE_ADDRESS    (0x00)
 
-/* EP0, RX/TX buffers base address */
-#define ENDP0_RX_ADDRESS    (0x18)
-#define ENDP0_TX_ADDRESS    (0x58)
+/* EP0, RX/TX buffers base address, after the EP_NUM entries of the BTABLE */
+#define ENDP0_RX_ADDRESS    (0x30)
+#define ENDP0_TX_ADDRESS    (0x70)
+
+/* Bulk endpoints are double buffered: the SIE receives or sends one packet
+   while the firmware copies the other one to or from the PMA. A double
+   buffered endpoint only works in one direction, so that each bulk pipe
+   has an endpoint number of its own. */
+#define USE_BULK_DBL_BUF
+
+#ifdef USE_BULK_DBL_BUF
+#define BULK_EP_KIND          USB_DBL_BUF
+
+/* EP1, TX buffers 0/1 base address */
+#define MSC_IN_TX_ADDRESS     (0xB0 | (0xF0 << 16))
+
+/* EP2, RX buffers 0/1 base address */
+#define MSC_OUT_RX_ADDRESS    (0x130 | (0x170 << 16))
+
+/* EP3, TX buffers 0/1 base address */
+#define BULK_IN_TX_ADDRESS    (0x1B0 | (0x1F0 << 16))
+
+/* EP4, TX buffer base address */
+#define INT_IN_TX_ADDRESS     (0x230)
+
+/* EP5, RX buffers 0/1 base address, up to 0x2C0 */
+#define BULK_OUT_RX_ADDRESS   (0x240 | (0x280 << 16))
+#else
+#define BULK_EP_KIND          USB_SNG_BUF
 
 /* EP1, TX buffer base address */
-#define MSC_IN_TX_ADDRESS     (0x98)
+#define MSC_IN_TX_ADDRESS     (0xB0)
     
 /* EP2, Rx buffer base address */
-#define MSC_OUT_RX_ADDRESS    (0xD8)
+#define MSC_OUT_RX_ADDRESS    (0xF0)
+
+/* EP3, TX buffer base address */
+#define BULK_IN_TX_ADDRESS    (0x130)
+
+/* EP4, TX buffer base address */
+#define INT_IN_TX_ADDRESS     (0x170)
+
+/* EP5, RX buffer base address */
+#define BULK_OUT_RX_ADDRESS   (0x180)
+#endif /* USE_BULK_DBL_BUF */
 
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
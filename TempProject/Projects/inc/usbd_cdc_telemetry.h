@@ -0,0 +1,47 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_telemetry.h
+  * @author  MCD Application Team
+  * @version V1.0.0
+  * @date    31-January-2014
+  * @brief   header file for the usbd_cdc_telemetry.c file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CDC_TELEMETRY_H
+#define __USBD_CDC_TELEMETRY_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_cdc_core.h"
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported constants --------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+/* Exported variables --------------------------------------------------------*/
+extern CDC_IF_Prop_TypeDef  TELEMETRY_fops;
+
+/* Exported functions ------------------------------------------------------- */
+uint32_t TELEMETRY_Write (const uint8_t *buf, uint32_t len);
+uint32_t TELEMETRY_Print (const char *str);
+
+#endif /* __USBD_CDC_TELEMETRY_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -34,9 +34,31 @@
 
 /* Exported types ------------------------------------------------------------*/
 /* Exported constants --------------------------------------------------------*/
+/* Composite MSC + CDC device: a virtual COM port streams the samples
+   written with TELEMETRY_Write() next to the disk. It has a PID of its own
+   (usbd_desc.c), and needs APP_RX_DATA_SIZE more bytes of RAM. */
+/* #define USE_MSC_CDC_COMPOSITE */
+
+/* DFU device instead of the disk: the host programs the application slot
+   of fw_update.h, the main loop runs the flash jobs with MAL_Poll(). */
+/* #define USE_USB_DFU */
+
+#if defined(USE_USB_DFU) && defined(USE_MSC_CDC_COMPOSITE)
+ #error "USE_USB_DFU and USE_MSC_CDC_COMPOSITE are exclusive"
+#endif
+
 #define USBD_CFG_MAX_NUM           1
-#define USBD_ITF_MAX_NUM           1
-#define USB_MAX_STR_DESC_SIZ       64 
+#ifdef USE_MSC_CDC_COMPOSITE
+ #define USBD_ITF_MAX_NUM          3  /* MSC, CDC control and CDC data */
+#else
+ #define USBD_ITF_MAX_NUM          1
+#endif /* USE_MSC_CDC_COMPOSITE */
+#ifdef USE_USB_DFU
+ #define USB_MAX_STR_DESC_SIZ      128 /* DFU memory layout string */
+ #define USB_SUPPORT_USER_STRING_DESC
+#else
+ #define USB_MAX_STR_DESC_SIZ      64 
+#endif /* USE_USB_DFU */
 #define USBD_SELF_POWERED       
 
 /* Class Layer Parameter */
@@ -46,6 +68,60 @@
 
 #define MSC_MEDIA_PACKET              4096
 
+/* RAM budget of the STM32F072 (16384 bytes), in bytes:
+     MSC_BOT_Data, one MSC_MEDIA_PACKET         4096
+     PdfFileSystem, FATFS with _MAX_SS 4096     4144
+       (also the work area of FWUPD_Check)
+     PDF line buffers and files (pdf.c)         2601
+     USB_Device_dev (app.c)                      664
+     FWUPD_Chunk (fw_update.c)                   256
+     Other variables                             700
+     Stack_Size (startup_stm32f072.s)           2048
+       (no FATFS on the stack)
+     Heap_Size (startup_stm32f072.s)             512
+                                               -----
+                                               15021, 1.3 KB left
+   USE_MSC_CDC_COMPOSITE adds the CDC buffers, 812 bytes.
+   MSC_MEDIA_PACKET cannot be smaller than the 4 KB block of the disk and
+   there is no room for a second one: the USB interrupt only starts the
+   medium accesses, STORAGE_Process() completes them from the main loop.
+   USE_NOR_JOURNAL adds its page buffers, migration batch and file, 1197
+   bytes, 166 left: the SD card volume shares PdfFileSystem (app.c). It
+   does not fit together with USE_MSC_CDC_COMPOSITE. */
+
+#define CDC_IN_EP                     0x83  /* EP3 for data IN */
+#define CDC_OUT_EP                    0x05  /* EP5 for data OUT: EP3 is double
+                                               buffered for IN only */
+#define CDC_CMD_EP                    0x84  /* EP4 for CDC commands */
+
+/* CDC Endpoints parameters: the IN pipe is served every CDC_IN_FRAME_INTERVAL
+   frames with at most CDC_IN_BATCH_SIZE bytes, leaving the bus to the disk */
+#define CDC_DATA_MAX_PACKET_SIZE      64    /* Endpoint IN & OUT Packet size */
+#define CDC_CMD_PACKET_SZE            8     /* Control Endpoint Packet size */
+#define CDC_IN_FRAME_INTERVAL         5     /* Number of frames between IN transfers */
+#define CDC_IN_BATCH_SIZE             256   /* Max size of one IN transfer */
+#define APP_RX_DATA_SIZE              512   /* Total size of IN buffer */
+#define APP_FOPS                      TELEMETRY_fops
+
+/* DFU Class parameters: a block is one 2 KB flash page. MAL_BUF_NBR blocks
+   are buffered (4 KB), in place of the MSC and PDF buffers which main()
+   leaves out of the link with USE_USB_DFU. */
+#define XFERSIZE                      2048
+#define DFU_IN_EP                     0x80
+#define DFU_OUT_EP                    0x00
+#define MAX_USED_MEDIA                1
+/* The updater below FWUPD_APP_ADDRESS (fw_update.h) is never erased */
+#define APP_DEFAULT_ADD               0x08010000
+#define FLASH_END_ADD                 0x08020000
+#define FLASH_IF_STRING               (uint8_t*) "@Internal Flash   /0x08000000/32*002Ka,32*002Kg"
+#define DFU_MAL_IS_PROTECTED_AREA(add)    (uint8_t)(((add >= 0x08000000) && (add < (APP_DEFAULT_ADD)))? 1:0)
+#define TRANSFER_SIZE_BYTES(sze)          ((uint8_t)(sze)), /* XFERSIZEB0 */\
+                                          ((uint8_t)(sze >> 8)) /* XFERSIZEB1 */
+/* Erase the page after the data downloaded so far while the host sends the
+   next block. When the image size is a multiple of XFERSIZE the page after
+   it is erased too: leave it off if that page holds data to keep. */
+#define MAL_ERASE_AHEAD               1
+
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 
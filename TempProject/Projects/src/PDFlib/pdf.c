@@ -1,4 +1,5 @@
 #include "pdf.h"
+#include "nor_journal.h"
 
 FATFS PdfFileSystem;
 FRESULT PdfGobRes;
@@ -18,16 +19,38 @@ void PDF_Gen_Func(void)
 	char* tempPtr1;
 	char* tempPtr2;
 	char dataLineCounter=0;
+#ifdef USE_NOR_JOURNAL
+	JOURNAL_Iter_TypeDef DataLineIter;
+#endif /* USE_NOR_JOURNAL */
 	//char* dataLinePtr;
 	PdfGobRes = f_mount(0,&PdfFileSystem);												//ļϵͳ
 	//dataLinePtr=malloc(1);
 	dataLineCounter=0;
+#ifdef USE_NOR_JOURNAL
+	/* Data lines streamed from the sample journal: the newest
+	   DATA_POINT_PER_PAGE ones, oldest first. The journal ends on a whole
+	   line but a dropped segment can leave its oldest data mid-line, so the
+	   lines are counted back from the head. */
+	JOURNAL_Flush();
+	JOURNAL_IterInit(&DataLineIter);
+	PdfByte2Read=JOURNAL_IterRead(&DataLineIter,NULL,0xFFFFFFFF);
+	JOURNAL_IterInit(&DataLineIter);
+	if(PdfByte2Read>DATA_POINT_PER_PAGE*DATA_LINE_LENGTH)
+	{
+		JOURNAL_IterRead(&DataLineIter,NULL,PdfByte2Read-DATA_POINT_PER_PAGE*DATA_LINE_LENGTH);
+	}
+#endif /* USE_NOR_JOURNAL */
 	for(j=0;j<5;j++)
 	{
+#ifdef USE_NOR_JOURNAL
+			PdfByte2Read=JOURNAL_IterRead(&DataLineIter,(uint8_t *)dataLinesPtr,DATA_LINES_BUF_LENGTH);
+			memset(dataLinesPtr+PdfByte2Read,' ',DATA_LINES_BUF_LENGTH-PdfByte2Read);
+#else
 			PdfGobRes=f_open(&DataLineFile,"0:demo.txt",FA_READ);
 			f_lseek(&DataLineFile,j*DATA_LINES_BUF_LENGTH);
 			PdfGobRes=f_read(&DataLineFile,dataLinesPtr,DATA_LINES_BUF_LENGTH,&PdfByte2Read);
 			f_close(&DataLineFile);
+#endif /* USE_NOR_JOURNAL */
 			tempPtr1=&pdfLinesPtr[0];
 			tempPtr2=&dataLinesPtr[0];
 			for(i=0;i<DATA_POINT_COUNT_2_BUFFER;i++)
@@ -20,6 +20,9 @@
 #define DATA_LINES_BUF_LENGTH (DATA_LINE_LENGTH*DATA_POINT_COUNT_2_BUFFER)
 #define PDF_DATA_POINT_LINE_BUF_LENGTH (DATA_POINT_LINE_LENGTH*DATA_POINT_COUNT_2_BUFFER)
 
+/* Work area of the SPI flash volume, shared with the firmware update */
+extern FATFS PdfFileSystem;
+
 void PDF_Gen_Func(void);
 
 #endif
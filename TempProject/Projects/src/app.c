@@ -27,17 +27,31 @@
 
 /* Includes ------------------------------------------------------------------*/ 
 #include  "usbd_msc_core.h"
+#include  "usbd_msc_cdc_wrapper.h"
 #include  "usbd_usr.h"
+#include  "usbd_storage_msd.h"
 #include  "spi_spiflash.h"
 #include  "global.h"
 #include  "ff.h"
 #include  "pdf.h"
+#include  "fw_update.h"
+#include  "nor_journal.h"
+#include  "sampler.h"
+#ifdef USE_USB_DFU
+#include  "usbd_dfu_core.h"
+#include  "usbd_dfu_mal.h"
+#endif /* USE_USB_DFU */
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 USB_CORE_HANDLE  USB_Device_dev ;
 uint8_t  global_USB=0;
+/* Private function prototypes -----------------------------------------------*/
+#ifdef USE_USB_DFU
+static void DFU_Run(void);
+#endif /* USE_USB_DFU */
+/* Private functions ---------------------------------------------------------*/
 /**
   * @brief  Program entry point
   * @param  None
@@ -46,26 +60,61 @@ uint8_t  global_USB=0;
 FRESULT res;
 int main(void)
 {
-	FATFS fs;
 	FIL MyFile;
 	uint32_t byteswritten;
 	uint8_t Tx_Buffer[256] = "Firmware Library Example: communication with an M25P64 SPI FLASHSTM32F10x SPI Firmware ";
   RCC_AHBPeriphClockCmd( RCC_AHBPeriph_GPIOA, ENABLE);
 	
 	SPI_Config();
+#ifdef USE_USB_DFU
+  /* Never returns: the disk and its buffers are left out of the link */
+  DFU_Run();
+#else
+#ifdef USE_FW_UPDATE
+  /* Program the image dropped on the disk before the host can see it, then
+     start it unless the disk is asked for */
+  FWUPD_Check(&PdfFileSystem);
+  if (!FWUPD_STAY_IN_UPDATER() && FWUPD_IsAppValid())
+  {
+    FWUPD_JumpToApp();
+  }
+#endif /* USE_FW_UPDATE */
   USBD_Init(&USB_Device_dev,
             &USR_desc, 
+#ifdef USE_MSC_CDC_COMPOSITE
+            &USBD_MSC_CDC_cb, 
+#else
             &USBD_MSC_cb, 
+#endif /* USE_MSC_CDC_COMPOSITE */
             &USR_cb);
+  /* Temperature samples, streamed on the virtual COM port */
+  SAMPLER_Init();
+#ifdef USE_NOR_JOURNAL
+  /* Recover the journal. Its SD card volume shares the work area of the
+     disk volume, PDF_Gen_Func keeps no file open across JOURNAL_Process */
+  JOURNAL_Init(&PdfFileSystem);
+#endif /* USE_NOR_JOURNAL */
 	
-  while(GPIO_ReadInputDataBit(GPIOA,GPIO_Pin_0));
+  while(GPIO_ReadInputDataBit(GPIOA,GPIO_Pin_0))
+  {
+    STORAGE_Process();
+    SAMPLER_Process();
+  }
 	PDF_Gen_Func();
 	
   while (1)
   {
+    /* Complete the USB disk writes */
+    STORAGE_Process();
+    SAMPLER_Process();
+#ifdef USE_NOR_JOURNAL
+    /* Program the journal and move its sealed segments to the SD card */
+    JOURNAL_Process();
+#endif /* USE_NOR_JOURNAL */
+    
 //		if(global_USB==10)
 //		{
-//			res = f_mount(0,&fs);
+//			res = f_mount(0,&PdfFileSystem);
 //			res = f_open(&MyFile, "0:/testusb.TXT", FA_CREATE_ALWAYS | FA_WRITE);
 //			res = f_write(&MyFile, Tx_Buffer, sizeof(Tx_Buffer), (void *)&byteswritten);
 //			res = f_close(&MyFile);
@@ -73,7 +122,30 @@ int main(void)
 //			global_USB=0;
 //		}
   }
+#endif /* USE_USB_DFU */
+}
+
+#ifdef USE_USB_DFU
+/**
+  * @brief  DFU device in place of the disk. The USB interrupt only queues the
+  *         downloaded blocks, they are programmed here while the host sends
+  *         the next ones.
+  * @param  None
+  * @retval None
+  */
+static void DFU_Run(void)
+{
+  USBD_Init(&USB_Device_dev,
+            &USR_desc, 
+            &DFU_cb, 
+            &USR_cb);
+  
+  while (1)
+  {
+    MAL_Poll();
+  }
 }
+#endif /* USE_USB_DFU */
 
 #ifdef USE_FULL_ASSERT
 /**
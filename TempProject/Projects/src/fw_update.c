@@ -0,0 +1,411 @@
+/**
+  ******************************************************************************
+  * @file    fw_update.c
+  * @author  MCD Application Team
+  * @version V1.0.0
+  * @date    31-January-2014
+  * @brief   Firmware update from an image dropped on the USB disk.
+  *          At reset FWUPD_FILE is looked for on the SPI flash volume. A valid
+  *          image is streamed into the application slot FWUPD_CHUNK_SIZE
+  *          bytes at a time, the current image being saved to
+  *          FWUPD_BACKUP_FILE first so that it can be restored if the
+  *          programming fails. The slot trailer is written last: an update
+  *          interrupted by a reset leaves the slot invalid and is restarted
+  *          from the file at the next reset.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
+#include "fw_update.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Word aligned for the CRC unit and the flash programming */
+static uint32_t FWUPD_Chunk[FWUPD_CHUNK_SIZE / 4];
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t  FWUPD_ReadTrailer (FIL *fp, FWUPD_Trailer_TypeDef *trailer);
+static uint32_t FWUPD_FileCrc (FIL *fp, uint32_t size);
+static uint32_t FWUPD_FlashCrc (uint32_t size);
+static uint8_t  FWUPD_Backup (void);
+static uint8_t  FWUPD_OpenBackup (FIL *fp, FWUPD_Trailer_TypeDef *trailer);
+static uint8_t  FWUPD_Program (FIL *fp, FWUPD_Trailer_TypeDef *trailer);
+static uint8_t  FWUPD_ProgramChunk (uint32_t Add, uint32_t len);
+static void     FWUPD_PadChunk (uint32_t len);
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Look for an image on the volume and program it. To be called at
+  *         reset, before the USB device is started: the host must not write
+  *         the volume while FatFs uses it.
+  * @param  fs: FatFs work area, the volume is unmounted on return
+  * @retval Result of the update
+  */
+FWUPD_Status FWUPD_Check (FATFS *fs)
+{
+  FWUPD_Trailer_TypeDef trailer;
+  FWUPD_Status status;
+  FIL file;
+
+  if ((f_mount(0, fs) != FR_OK) ||
+      (f_open(&file, FWUPD_FILE, FA_READ | FA_OPEN_EXISTING) != FR_OK))
+  {
+    f_mount(0, NULL);
+    return FWUPD_NONE;
+  }
+
+  RCC_AHBPeriphClockCmd(RCC_AHBPeriph_CRC, ENABLE);
+  CRC_DeInit();
+
+  /* Check the whole file before touching the slot */
+  if (!FWUPD_ReadTrailer(&file, &trailer) ||
+      (FWUPD_FileCrc(&file, trailer.Size) != trailer.Crc))
+  {
+    f_close(&file);
+    f_unlink(FWUPD_ERROR_FILE);
+    f_rename(FWUPD_FILE, FWUPD_ERROR_FILE);
+    f_mount(0, NULL);
+    return FWUPD_BAD_IMAGE;
+  }
+
+  /* Save the image in place, if any, for the roll back. After an update
+     interrupted by a reset the slot is not valid: FWUPD_BACKUP_FILE still
+     holds the image it replaced */
+  if (FWUPD_IsAppValid() && !FWUPD_Backup())
+  {
+    f_close(&file);
+    f_mount(0, NULL);
+    return FWUPD_NO_BACKUP;
+  }
+
+  if (FWUPD_Program(&file, &trailer))
+  {
+    f_close(&file);
+    f_unlink(FWUPD_FILE);
+    status = FWUPD_DONE;
+  }
+  else
+  {
+    /* Do not retry an image that cannot be programmed at each reset */
+    f_close(&file);
+    f_unlink(FWUPD_ERROR_FILE);
+    f_rename(FWUPD_FILE, FWUPD_ERROR_FILE);
+    status = FWUPD_FAILED;
+
+    if (FWUPD_OpenBackup(&file, &trailer))
+    {
+      if (FWUPD_Program(&file, &trailer))
+      {
+        status = FWUPD_ROLLED_BACK;
+      }
+      f_close(&file);
+    }
+  }
+
+  if (status != FWUPD_FAILED)
+  {
+    f_unlink(FWUPD_BACKUP_FILE);
+  }
+  f_mount(0, NULL);
+
+  return status;
+}
+
+/**
+  * @brief  Check the application slot against its trailer.
+  * @param  None
+  * @retval 1 if the slot holds a complete image, 0 else
+  */
+uint8_t FWUPD_IsAppValid (void)
+{
+  FWUPD_Trailer_TypeDef *trailer = (FWUPD_Trailer_TypeDef *)FWUPD_TRAILER_ADDRESS;
+
+  if ((trailer->Magic != FWUPD_MAGIC) || (trailer->Size > FWUPD_MAX_IMAGE_SIZE))
+  {
+    return 0;
+  }
+
+  RCC_AHBPeriphClockCmd(RCC_AHBPeriph_CRC, ENABLE);
+  CRC_DeInit();
+
+  return (FWUPD_FlashCrc(trailer->Size) == trailer->Crc);
+}
+
+/**
+  * @brief  Start the image of the application slot. Must be called before
+  *         any interrupt is enabled: PRIMASK is left as at reset for the
+  *         application. The Cortex-M0 has no vector table offset register:
+  *         the application copies its vector table to the start of the SRAM
+  *         and remaps the SRAM at address 0.
+  * @param  None
+  * @retval None
+  */
+void FWUPD_JumpToApp (void)
+{
+  uint32_t *vectors = (uint32_t *)FWUPD_APP_ADDRESS;
+  void (*app_reset)(void) = (void (*)(void))vectors[1];
+
+  __set_MSP(vectors[0]);
+  app_reset();
+}
+
+/**
+  * @brief  Read and check the trailer at the end of an image file.
+  * @param  fp: image file
+  * @param  trailer: trailer read
+  * @retval 1 if the trailer matches the file, 0 else
+  */
+static uint8_t FWUPD_ReadTrailer (FIL *fp, FWUPD_Trailer_TypeDef *trailer)
+{
+  UINT br;
+
+  if ((f_size(fp) < sizeof(*trailer)) ||
+      (f_lseek(fp, f_size(fp) - sizeof(*trailer)) != FR_OK) ||
+      (f_read(fp, trailer, sizeof(*trailer), &br) != FR_OK) ||
+      (br != sizeof(*trailer)))
+  {
+    return 0;
+  }
+
+  return ((trailer->Magic == FWUPD_MAGIC) &&
+          (trailer->Size == (f_size(fp) - sizeof(*trailer))) &&
+          (trailer->Size <= FWUPD_MAX_IMAGE_SIZE) &&
+          (trailer->Size != 0));
+}
+
+/**
+  * @brief  CRC of the image part of a file.
+  * @param  fp: image file
+  * @param  size: image size
+  * @retval CRC, 0 if the file cannot be read
+  */
+static uint32_t FWUPD_FileCrc (FIL *fp, uint32_t size)
+{
+  uint32_t offset;
+  uint32_t len;
+  UINT br;
+
+  if (f_lseek(fp, 0) != FR_OK)
+  {
+    return 0;
+  }
+
+  CRC_ResetDR();
+  for (offset = 0; offset < size; offset += len)
+  {
+    len = size - offset;
+    if (len > FWUPD_CHUNK_SIZE)
+    {
+      len = FWUPD_CHUNK_SIZE;
+    }
+
+    if ((f_read(fp, FWUPD_Chunk, len, &br) != FR_OK) || (br != len))
+    {
+      return 0;
+    }
+    FWUPD_PadChunk(len);
+    CRC_CalcBlockCRC(FWUPD_Chunk, (len + 3) / 4);
+  }
+
+  return CRC_GetCRC();
+}
+
+/**
+  * @brief  CRC of the image programmed in the application slot.
+  * @param  size: image size
+  * @retval CRC
+  */
+static uint32_t FWUPD_FlashCrc (uint32_t size)
+{
+  CRC_ResetDR();
+
+  return CRC_CalcBlockCRC((uint32_t *)FWUPD_APP_ADDRESS, (size + 3) / 4);
+}
+
+/**
+  * @brief  Save the image of the application slot, with its trailer, to
+  *         FWUPD_BACKUP_FILE.
+  * @param  None
+  * @retval 1 if the whole image is saved, 0 else
+  */
+static uint8_t FWUPD_Backup (void)
+{
+  FWUPD_Trailer_TypeDef *trailer = (FWUPD_Trailer_TypeDef *)FWUPD_TRAILER_ADDRESS;
+  uint8_t ok;
+  UINT bw1 = 0;
+  UINT bw2 = 0;
+  FIL file;
+
+  if (f_open(&file, FWUPD_BACKUP_FILE, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+  {
+    return 0;
+  }
+
+  ok = (f_write(&file, (void *)FWUPD_APP_ADDRESS, trailer->Size, &bw1) == FR_OK) &&
+       (f_write(&file, trailer, sizeof(*trailer), &bw2) == FR_OK) &&
+       (bw1 == trailer->Size) && (bw2 == sizeof(*trailer));
+
+  if ((f_close(&file) != FR_OK) || !ok)
+  {
+    f_unlink(FWUPD_BACKUP_FILE);
+    return 0;
+  }
+  return 1;
+}
+
+/**
+  * @brief  Open FWUPD_BACKUP_FILE if it holds a complete image, saved now or
+  *         before an interrupted update.
+  * @param  fp: file opened
+  * @param  trailer: trailer of the file
+  * @retval 1 if the file is open and its image valid, 0 else
+  */
+static uint8_t FWUPD_OpenBackup (FIL *fp, FWUPD_Trailer_TypeDef *trailer)
+{
+  if (f_open(fp, FWUPD_BACKUP_FILE, FA_READ | FA_OPEN_EXISTING) != FR_OK)
+  {
+    return 0;
+  }
+
+  if (!FWUPD_ReadTrailer(fp, trailer) ||
+      (FWUPD_FileCrc(fp, trailer->Size) != trailer->Crc))
+  {
+    f_close(fp);
+    return 0;
+  }
+  return 1;
+}
+
+/**
+  * @brief  Program an image file into the application slot. The trailer
+  *         page is erased first and the trailer programmed last, once the
+  *         programmed image is verified.
+  * @param  fp: image file
+  * @param  trailer: trailer of the file, checked by FWUPD_ReadTrailer()
+  * @retval 1 if the image is programmed, 0 else
+  */
+static uint8_t FWUPD_Program (FIL *fp, FWUPD_Trailer_TypeDef *trailer)
+{
+  uint32_t trailer_page = FWUPD_TRAILER_ADDRESS & ~(FWUPD_PAGE_SIZE - 1);
+  uint32_t offset;
+  uint32_t len;
+  uint32_t idx;
+  uint8_t ok = 0;
+  UINT br;
+
+  FLASH_Unlock();
+  FLASH_ClearFlag(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+
+  if ((f_lseek(fp, 0) != FR_OK) ||
+      (FLASH_ErasePage(trailer_page) != FLASH_COMPLETE))
+  {
+    FLASH_Lock();
+    return 0;
+  }
+
+  for (offset = 0; offset < trailer->Size; offset += len)
+  {
+    len = trailer->Size - offset;
+    if (len > FWUPD_CHUNK_SIZE)
+    {
+      len = FWUPD_CHUNK_SIZE;
+    }
+
+    /* Erase each page when the image gets to it */
+    if (((offset % FWUPD_PAGE_SIZE) == 0) &&
+        ((FWUPD_APP_ADDRESS + offset) != trailer_page) &&
+        (FLASH_ErasePage(FWUPD_APP_ADDRESS + offset) != FLASH_COMPLETE))
+    {
+      break;
+    }
+
+    if ((f_read(fp, FWUPD_Chunk, len, &br) != FR_OK) || (br != len))
+    {
+      break;
+    }
+    FWUPD_PadChunk(len);
+
+    if (!FWUPD_ProgramChunk(FWUPD_APP_ADDRESS + offset, len))
+    {
+      break;
+    }
+  }
+
+  /* Validate the slot only once the programmed image is known good */
+  if ((offset >= trailer->Size) && (FWUPD_FlashCrc(trailer->Size) == trailer->Crc))
+  {
+    ok = 1;
+    for (idx = 0; idx < (sizeof(*trailer) / 4); idx++)
+    {
+      if (FLASH_ProgramWord(FWUPD_TRAILER_ADDRESS + (idx * 4),
+                            ((uint32_t *)trailer)[idx]) != FLASH_COMPLETE)
+      {
+        ok = 0;
+        break;
+      }
+    }
+  }
+
+  FLASH_Lock();
+
+  return ok;
+}
+
+/**
+  * @brief  Program FWUPD_Chunk and read it back.
+  * @param  Add: flash address, word aligned
+  * @param  len: number of bytes, rounded up to a word multiple
+  * @retval 1 if the data is programmed, 0 else
+  */
+static uint8_t FWUPD_ProgramChunk (uint32_t Add, uint32_t len)
+{
+  uint32_t idx;
+
+  for (idx = 0; idx < ((len + 3) / 4); idx++)
+  {
+    if ((FLASH_ProgramWord(Add + (idx * 4), FWUPD_Chunk[idx]) != FLASH_COMPLETE) ||
+        (*(__IO uint32_t *)(Add + (idx * 4)) != FWUPD_Chunk[idx]))
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+  * @brief  Pad the last word of FWUPD_Chunk with erased flash bytes.
+  * @param  len: number of valid bytes in the chunk
+  * @retval None
+  */
+static void FWUPD_PadChunk (uint32_t len)
+{
+  uint8_t *pBuf = (uint8_t *)FWUPD_Chunk;
+
+  for (; (len & 0x3) != 0; len++)
+  {
+    pBuf[len] = 0xFF;
+  }
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,779 @@
+/**
+  ******************************************************************************
+  * @file    nor_journal.c
+  * @author  MCD Application Team
+  * @version V1.0.0
+  * @date    31-January-2014
+  * @brief   Sample journal on the SPI flash in front of the SD card volume.
+  *          Samples are appended to RAM page buffers and programmed, one page
+  *          at a time, in a circular journal of JOURNAL_SEGMENT_NBR sectors
+  *          kept out of the FatFs volume. The sector following the head is
+  *          erased in background, so that an append never waits for more
+  *          than a page program. Sealed segments are then moved to
+  *          JOURNAL_FILE on the SD card in JOURNAL_MIGRATE_SIZE batches and
+  *          flagged as migrated. When the SD card is missing or too slow, the
+  *          oldest segments are overwritten.
+  *
+  *          Segments are opened in ring order with a sequence number one
+  *          above the previous one, and the pages and the migrated flags of
+  *          the segments are programmed in order too. The head, the tail and
+  *          the head page are therefore found at reset by binary searches,
+  *          in about 3 * log2(JOURNAL_SEGMENT_NBR) header reads. A power cut
+  *          can only leave a torn segment header or data page, both are
+  *          rejected by their CRC.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
+#include <string.h>
+#include "nor_journal.h"
+#include "usbd_conf.h"
+
+#ifdef USE_NOR_JOURNAL
+
+/* Private typedef -----------------------------------------------------------*/
+typedef enum
+{
+  JOURNAL_PAGE_OK = 0,
+  JOURNAL_PAGE_ERASED,     /* End of the segment data */
+  JOURNAL_PAGE_BAD         /* Torn, or left by an older pass */
+} JOURNAL_PageStatus;
+
+/* Private define ------------------------------------------------------------*/
+#define JOURNAL_NO_PAGE            0xFF
+
+/* Bytes read at a time to check a page CRC */
+#define JOURNAL_CHECK_CHUNK        32
+
+/* The USB disk accesses the FLASH from this interrupt */
+#define JOURNAL_MEDIA_IRQn         USB_IRQn
+
+/* Private macro -------------------------------------------------------------*/
+#define JOURNAL_SEGMENT_ADDR(seg)  ((JOURNAL_FIRST_SECTOR + (seg)) * FLASH_SECTOR_SIZE)
+#define JOURNAL_PAGE_ADDR(seg, pg) (JOURNAL_SEGMENT_ADDR(seg) + (pg) * sFLASH_SPI_PAGESIZE)
+#define JOURNAL_NEXT(seg)          (((seg) + 1) % JOURNAL_SEGMENT_NBR)
+#define JOURNAL_AHEAD(seg, k)      (((seg) + (k)) % JOURNAL_SEGMENT_NBR)
+
+/* Private variables ---------------------------------------------------------*/
+JOURNAL_Stats_TypeDef JOURNAL_Stats;
+
+/* Page being filled by JOURNAL_Append and page waiting to be programmed,
+   word aligned for the page header */
+static uint32_t JOURNAL_Page[2][sFLASH_SPI_PAGESIZE / 4];
+static uint8_t  JOURNAL_Cur = 0;
+static uint8_t  JOURNAL_Pending = JOURNAL_NO_PAGE;
+static uint32_t JOURNAL_Fill = 0;
+
+/* Head: segment and page programmed next. Tail: oldest segment not migrated,
+   equal to the head when no sealed segment waits for the SD card */
+static uint32_t JOURNAL_HeadSeg;
+static uint32_t JOURNAL_HeadPage;
+static uint32_t JOURNAL_HeadSeq;
+static uint32_t JOURNAL_TailSeg;
+static uint8_t  JOURNAL_NextErase = 0;   /* Background erase of the next segment queued */
+
+/* The FATFS is only mounted on the SD card while a segment is migrated */
+static FATFS   *JOURNAL_Fs;
+static FIL      JOURNAL_File;
+static uint8_t  JOURNAL_FileReady = 0;
+static uint8_t  JOURNAL_Batch[JOURNAL_MIGRATE_SIZE];
+static uint32_t JOURNAL_BatchLen;
+
+/* Private function prototypes -----------------------------------------------*/
+static void     JOURNAL_Lock (void);
+static void     JOURNAL_Unlock (void);
+static uint32_t JOURNAL_HeaderCrc (uint32_t seq);
+static uint32_t JOURNAL_ReadSeq (uint32_t seg, uint32_t *migrated);
+static JOURNAL_PageStatus JOURNAL_CheckPage (uint32_t seg, uint32_t seq, uint32_t page, uint16_t *len);
+static void     JOURNAL_FindHead (void);
+static uint32_t JOURNAL_FindOldest (void);
+static void     JOURNAL_ProgramPending (void);
+static void     JOURNAL_OpenSegment (void);
+static uint8_t  JOURNAL_FileOpen (void);
+static void     JOURNAL_FileClose (void);
+static uint8_t  JOURNAL_MigrateSegment (uint32_t seg);
+static uint8_t  JOURNAL_BatchWrite (void);
+static uint8_t  JOURNAL_IterNext (JOURNAL_Iter_TypeDef *it);
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Find the head and the tail of the journal left by the previous run
+  *         and check that JOURNAL_FILE can be opened on the SD card.
+  * @param  fs: FatFs work area for the SD card volume. It is only mounted
+  *         during JOURNAL_Process, so it may be the work area of another
+  *         volume which has no file left open across JOURNAL_Process.
+  * @retval 1 if the segments can be migrated, 0 if the journal only runs
+  *         on the SPI flash
+  */
+uint8_t JOURNAL_Init (FATFS *fs)
+{
+  uint32_t lo, hi, mid, migrated;
+
+  RCC_AHBPeriphClockCmd(RCC_AHBPeriph_CRC, ENABLE);
+  CRC_DeInit();
+
+  JOURNAL_FindHead();
+
+  /* Tail: following the head, the segments are erased or migrated up to the
+     first one still to be migrated */
+  lo = 1;
+  hi = JOURNAL_SEGMENT_NBR;
+  while (lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if ((JOURNAL_ReadSeq(JOURNAL_AHEAD(JOURNAL_HeadSeg, mid), &migrated) == 0) ||
+        (migrated != 0xFFFFFFFF))
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  JOURNAL_TailSeg = JOURNAL_AHEAD(JOURNAL_HeadSeg, lo);
+
+  JOURNAL_Fs = fs;
+  JOURNAL_BatchLen = 0;
+  JOURNAL_FileReady = JOURNAL_FileOpen();
+  if (JOURNAL_FileReady)
+  {
+    JOURNAL_FileClose();
+  }
+
+  return JOURNAL_FileReady;
+}
+
+/**
+  * @brief  Append samples to the journal. Only copies them to RAM unless the
+  *         previous page is still waiting for JOURNAL_Process.
+  * @note   Call it from the main loop, like JOURNAL_Process.
+  * @param  buf: samples to append
+  * @param  len: number of bytes
+  * @retval number of bytes appended
+  */
+uint32_t JOURNAL_Append (const uint8_t *buf, uint32_t len)
+{
+  uint32_t n, done = 0;
+
+  while (done < len)
+  {
+    n = JOURNAL_PAGE_DATA_SIZE - JOURNAL_Fill;
+    if (n > len - done)
+    {
+      n = len - done;
+    }
+    memcpy((uint8_t *)JOURNAL_Page[JOURNAL_Cur] + JOURNAL_PAGE_HEADER_SIZE + JOURNAL_Fill, buf + done, n);
+    JOURNAL_Fill += n;
+    done += n;
+
+    if (JOURNAL_Fill == JOURNAL_PAGE_DATA_SIZE)
+    {
+      if (JOURNAL_Pending != JOURNAL_NO_PAGE)
+      {
+        /* The main loop is late: program the previous page now */
+        JOURNAL_Stats.Stalls++;
+        JOURNAL_ProgramPending();
+      }
+      JOURNAL_Pending = JOURNAL_Cur;
+      JOURNAL_Cur ^= 1;
+      JOURNAL_Fill = 0;
+    }
+  }
+
+  JOURNAL_Stats.Appended += done;
+  return done;
+}
+
+/**
+  * @brief  Program the samples still in RAM, the page left partly filled is
+  *         closed. To be called before the power is removed.
+  * @param  None
+  * @retval None
+  */
+void JOURNAL_Flush (void)
+{
+  if (JOURNAL_Pending != JOURNAL_NO_PAGE)
+  {
+    JOURNAL_ProgramPending();
+  }
+  if (JOURNAL_Fill != 0)
+  {
+    /* The buffer is free again once programmed */
+    JOURNAL_Pending = JOURNAL_Cur;
+    JOURNAL_ProgramPending();
+    JOURNAL_Fill = 0;
+  }
+}
+
+/**
+  * @brief  Background work: program the page filled by JOURNAL_Append, queue
+  *         the erase of the next segment and move one sealed segment to the
+  *         SD card. To be called periodically from the main loop, next to
+  *         STORAGE_Process which runs the background erase.
+  * @param  None
+  * @retval None
+  */
+void JOURNAL_Process (void)
+{
+  uint32_t next = JOURNAL_NEXT(JOURNAL_HeadSeg);
+
+  if (JOURNAL_Pending != JOURNAL_NO_PAGE)
+  {
+    JOURNAL_ProgramPending();
+    return;
+  }
+
+  /* Do not erase a segment that still has to be migrated */
+  if (!JOURNAL_NextErase && ((next != JOURNAL_TailSeg) || (JOURNAL_TailSeg == JOURNAL_HeadSeg)))
+  {
+    sFLASH_TrimSectors(JOURNAL_FIRST_SECTOR + next, 1);
+    JOURNAL_NextErase = 1;
+    return;
+  }
+
+  if (JOURNAL_FileReady && (JOURNAL_TailSeg != JOURNAL_HeadSeg))
+  {
+    JOURNAL_FileReady = JOURNAL_FileOpen();
+    if (JOURNAL_FileReady)
+    {
+      JOURNAL_FileReady = JOURNAL_MigrateSegment(JOURNAL_TailSeg);
+      JOURNAL_FileClose();
+    }
+    if (JOURNAL_FileReady)
+    {
+      JOURNAL_TailSeg = JOURNAL_NEXT(JOURNAL_TailSeg);
+    }
+    /* Else card removed or full: keep journaling on the SPI flash only */
+  }
+}
+
+/**
+  * @brief  Start reading the journal from the oldest page still on the SPI
+  *         flash, migrated or not.
+  * @note   The samples still in RAM are not seen, see JOURNAL_Flush. A
+  *         reader overtaken by the head stops at the segment overwritten.
+  * @param  it: reader to initialize
+  * @retval None
+  */
+void JOURNAL_IterInit (JOURNAL_Iter_TypeDef *it)
+{
+  it->Seg = JOURNAL_FindOldest();
+  it->Seq = JOURNAL_ReadSeq(it->Seg, NULL);
+  it->Page = 0;
+  it->Len = 0;
+  it->Off = 0;
+}
+
+/**
+  * @brief  Read the next samples of the journal. Once the head is reached,
+  *         the reader can be called again later to get the new samples.
+  * @param  it: reader
+  * @param  buf: buffer receiving the samples, NULL to skip them
+  * @param  len: number of bytes wanted
+  * @retval number of bytes read, less than len at the head
+  */
+uint32_t JOURNAL_IterRead (JOURNAL_Iter_TypeDef *it, uint8_t *buf, uint32_t len)
+{
+  uint32_t n, done = 0;
+
+  while (done < len)
+  {
+    if ((it->Off == it->Len) && !JOURNAL_IterNext(it))
+    {
+      break;
+    }
+
+    n = it->Len - it->Off;
+    if (n > len - done)
+    {
+      n = len - done;
+    }
+    if (buf != NULL)
+    {
+      JOURNAL_Lock();
+      sFLASH_ReadBuffer(buf + done, JOURNAL_PAGE_ADDR(it->Seg, it->Page) + JOURNAL_PAGE_HEADER_SIZE + it->Off,
+                        (uint16_t)n);
+      JOURNAL_Unlock();
+    }
+    it->Off += n;
+    done += n;
+  }
+
+  return done;
+}
+
+/**
+  * @brief  Move a reader to the next valid data page.
+  * @param  it: reader
+  * @retval 1 if a page was found, 0 at the head or if the reader is lost
+  */
+static uint8_t JOURNAL_IterNext (JOURNAL_Iter_TypeDef *it)
+{
+  uint16_t len;
+
+  while (it->Seq != 0)
+  {
+    while (++it->Page < JOURNAL_PAGES_PER_SEGMENT)
+    {
+      switch (JOURNAL_CheckPage(it->Seg, it->Seq, it->Page, &len))
+      {
+      case JOURNAL_PAGE_OK:
+        it->Len = len;
+        it->Off = 0;
+        return 1;
+
+      case JOURNAL_PAGE_BAD:
+        continue;
+
+      default:
+        break;
+      }
+      break;
+    }
+
+    if (it->Seq == JOURNAL_HeadSeq)
+    {
+      /* Retry the same page at the next call */
+      it->Page--;
+      it->Len = 0;
+      it->Off = 0;
+      return 0;
+    }
+
+    /* The next segment must follow this one, else the head went past us */
+    it->Seg = JOURNAL_NEXT(it->Seg);
+    it->Seq = (JOURNAL_ReadSeq(it->Seg, NULL) == it->Seq + 1) ? it->Seq + 1 : 0;
+    it->Page = 0;
+  }
+
+  it->Len = 0;
+  it->Off = 0;
+  return 0;
+}
+
+/**
+  * @brief  Find the head segment, its sequence number and the next page to
+  *         program in it.
+  * @note   From segment 0 the sequence numbers go up by one per segment up
+  *         to the head. The segments after it are erased or older.
+  * @param  None
+  * @retval None
+  */
+static void JOURNAL_FindHead (void)
+{
+  uint32_t first, lo, hi, mid;
+  uint16_t len;
+
+  first = JOURNAL_ReadSeq(0, NULL);
+  if (first == 0)
+  {
+    /* Segment 0 is erased: it follows the head, or the journal is blank */
+    JOURNAL_HeadSeq = JOURNAL_ReadSeq(JOURNAL_SEGMENT_NBR - 1, NULL);
+    JOURNAL_HeadSeg = JOURNAL_SEGMENT_NBR - 1;
+    if (JOURNAL_HeadSeq == 0)
+    {
+      /* The first page opens segment 0 */
+      JOURNAL_HeadPage = JOURNAL_PAGES_PER_SEGMENT;
+      return;
+    }
+  }
+  else
+  {
+    lo = 0;
+    hi = JOURNAL_SEGMENT_NBR - 1;
+    while (lo < hi)
+    {
+      mid = (lo + hi + 1) / 2;
+      if (JOURNAL_ReadSeq(mid, NULL) == first + mid)
+      {
+        lo = mid;
+      }
+      else
+      {
+        hi = mid - 1;
+      }
+    }
+    JOURNAL_HeadSeg = lo;
+    JOURNAL_HeadSeq = first + lo;
+  }
+
+  /* First erased page of the head segment, a torn page is skipped */
+  lo = 1;
+  hi = JOURNAL_PAGES_PER_SEGMENT;
+  while (lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if (JOURNAL_CheckPage(JOURNAL_HeadSeg, JOURNAL_HeadSeq, mid, &len) == JOURNAL_PAGE_ERASED)
+    {
+      hi = mid;
+    }
+    else
+    {
+      lo = mid + 1;
+    }
+  }
+  JOURNAL_HeadPage = lo;
+}
+
+/**
+  * @brief  Find the oldest segment still holding data.
+  * @note   Following the head, erased or torn segments come before the
+  *         oldest valid one.
+  * @param  None
+  * @retval segment number
+  */
+static uint32_t JOURNAL_FindOldest (void)
+{
+  uint32_t lo = 1, hi = JOURNAL_SEGMENT_NBR, mid;
+
+  while (lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if (JOURNAL_ReadSeq(JOURNAL_AHEAD(JOURNAL_HeadSeg, mid), NULL) == 0)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  return JOURNAL_AHEAD(JOURNAL_HeadSeg, lo);
+}
+
+/**
+  * @brief  Program the pending page at the head, opening a new segment when
+  *         the head one is full.
+  * @param  None
+  * @retval None
+  */
+static void JOURNAL_ProgramPending (void)
+{
+  JOURNAL_PageHeader_TypeDef *hdr = (JOURNAL_PageHeader_TypeDef *)JOURNAL_Page[JOURNAL_Pending];
+  uint8_t *data = (uint8_t *)JOURNAL_Page[JOURNAL_Pending] + JOURNAL_PAGE_HEADER_SIZE;
+  uint16_t len = (uint16_t)((JOURNAL_Pending == JOURNAL_Cur) ? JOURNAL_Fill : JOURNAL_PAGE_DATA_SIZE);
+  uint32_t i;
+
+  if (JOURNAL_HeadPage == JOURNAL_PAGES_PER_SEGMENT)
+  {
+    JOURNAL_OpenSegment();
+  }
+
+  CRC_ResetDR();
+  CRC_CalcCRC(JOURNAL_HeadSeq);
+  CRC_CalcCRC16bits(len);
+  for (i = 0; i < len; i++)
+  {
+    CRC_CalcCRC8bits(data[i]);
+  }
+  hdr->Len = len;
+  hdr->Reserved = 0xFFFF;
+  hdr->Crc = CRC_GetCRC();
+
+  JOURNAL_Lock();
+  sFLASH_WritePage((uint8_t *)hdr, JOURNAL_PAGE_ADDR(JOURNAL_HeadSeg, JOURNAL_HeadPage),
+                   (uint16_t)(JOURNAL_PAGE_HEADER_SIZE + len));
+  JOURNAL_Unlock();
+
+  JOURNAL_HeadPage++;
+  JOURNAL_Pending = JOURNAL_NO_PAGE;
+}
+
+/**
+  * @brief  Seal the head segment and open the next one, overwriting the
+  *         oldest segment if it was not migrated in time.
+  * @param  None
+  * @retval None
+  */
+static void JOURNAL_OpenSegment (void)
+{
+  JOURNAL_Header_TypeDef hdr;
+  uint32_t next = JOURNAL_NEXT(JOURNAL_HeadSeg);
+
+  if ((next == JOURNAL_TailSeg) && (JOURNAL_TailSeg != JOURNAL_HeadSeg))
+  {
+    JOURNAL_Stats.Dropped++;
+    JOURNAL_TailSeg = JOURNAL_NEXT(JOURNAL_TailSeg);
+  }
+
+  hdr.Magic = JOURNAL_MAGIC;
+  hdr.Seq = JOURNAL_HeadSeq + 1;
+  hdr.Crc = JOURNAL_HeaderCrc(hdr.Seq);
+  hdr.Migrated = 0xFFFFFFFF;
+
+  JOURNAL_Lock();
+  /* Erased in background unless JOURNAL_Process could not run in time */
+  if (!sFLASH_PrepareSectorWrite(JOURNAL_FIRST_SECTOR + next))
+  {
+    sFLASH_EraseSector(JOURNAL_SEGMENT_ADDR(next));
+  }
+  sFLASH_WritePage((uint8_t *)&hdr, JOURNAL_SEGMENT_ADDR(next), sizeof(hdr));
+  JOURNAL_Unlock();
+
+  /* The previous head is now sealed: if no segment was waiting, the tail
+     already points to it */
+  JOURNAL_HeadSeg = next;
+  JOURNAL_HeadSeq = hdr.Seq;
+  JOURNAL_HeadPage = 1;
+  JOURNAL_NextErase = 0;
+}
+
+/**
+  * @brief  Copy the data pages of a sealed segment to JOURNAL_FILE, then flag
+  *         the segment as migrated. A reset in between copies the segment
+  *         again at the next run.
+  * @param  seg: segment to migrate
+  * @retval 1 if done, 0 if the SD card could not be written
+  */
+static uint8_t JOURNAL_MigrateSegment (uint32_t seg)
+{
+  static const uint32_t migrated = 0;
+  JOURNAL_PageStatus status;
+  uint32_t seq, flag, page, off, n;
+  uint16_t len;
+
+  seq = JOURNAL_ReadSeq(seg, &flag);
+  if ((seq == 0) || (flag != 0xFFFFFFFF))
+  {
+    return 1;
+  }
+
+  for (page = 1; page < JOURNAL_PAGES_PER_SEGMENT; page++)
+  {
+    status = JOURNAL_CheckPage(seg, seq, page, &len);
+    if (status == JOURNAL_PAGE_ERASED)
+    {
+      break;
+    }
+    if (status == JOURNAL_PAGE_BAD)
+    {
+      continue;
+    }
+
+    for (off = 0; off < len; off += n)
+    {
+      n = JOURNAL_MIGRATE_SIZE - JOURNAL_BatchLen;
+      if (n > len - off)
+      {
+        n = len - off;
+      }
+      JOURNAL_Lock();
+      sFLASH_ReadBuffer(&JOURNAL_Batch[JOURNAL_BatchLen],
+                        JOURNAL_PAGE_ADDR(seg, page) + JOURNAL_PAGE_HEADER_SIZE + off, (uint16_t)n);
+      JOURNAL_Unlock();
+      JOURNAL_BatchLen += n;
+
+      if ((JOURNAL_BatchLen == JOURNAL_MIGRATE_SIZE) && !JOURNAL_BatchWrite())
+      {
+        return 0;
+      }
+    }
+  }
+
+  /* The segment must be on the card before it is flagged */
+  if (!JOURNAL_BatchWrite() || (f_sync(&JOURNAL_File) != FR_OK))
+  {
+    return 0;
+  }
+
+  JOURNAL_Lock();
+  sFLASH_WritePage((uint8_t *)&migrated, JOURNAL_SEGMENT_ADDR(seg) + offsetof(JOURNAL_Header_TypeDef, Migrated),
+                   sizeof(migrated));
+  JOURNAL_Unlock();
+
+  return 1;
+}
+
+/**
+  * @brief  Mount the SD card volume and open JOURNAL_FILE at its end: the
+  *         samples are only ever appended to the file.
+  * @param  None
+  * @retval 1 if open, 0 with the volume unmounted otherwise
+  */
+static uint8_t JOURNAL_FileOpen (void)
+{
+  if ((f_mount(1, JOURNAL_Fs) == FR_OK) &&
+      (f_open(&JOURNAL_File, JOURNAL_FILE, FA_WRITE | FA_OPEN_ALWAYS) == FR_OK))
+  {
+    if (f_lseek(&JOURNAL_File, f_size(&JOURNAL_File)) == FR_OK)
+    {
+      return 1;
+    }
+    f_close(&JOURNAL_File);
+  }
+  f_mount(1, NULL);
+  return 0;
+}
+
+/**
+  * @brief  Close JOURNAL_FILE and unmount the SD card volume, the FATFS is
+  *         free for another volume.
+  * @param  None
+  * @retval None
+  */
+static void JOURNAL_FileClose (void)
+{
+  f_close(&JOURNAL_File);
+  f_mount(1, NULL);
+}
+
+/**
+  * @brief  Write the migration batch to JOURNAL_FILE.
+  * @param  None
+  * @retval 1 if written, 0 otherwise
+  */
+static uint8_t JOURNAL_BatchWrite (void)
+{
+  UINT written;
+
+  if (JOURNAL_BatchLen != 0)
+  {
+    if ((f_write(&JOURNAL_File, JOURNAL_Batch, JOURNAL_BatchLen, &written) != FR_OK) ||
+        (written != JOURNAL_BatchLen))
+    {
+      return 0;
+    }
+    JOURNAL_Stats.Migrated += JOURNAL_BatchLen;
+    JOURNAL_BatchLen = 0;
+  }
+  return 1;
+}
+
+/**
+  * @brief  Read the header of a segment.
+  * @param  seg: segment number
+  * @param  migrated: if not NULL, receives the migrated flag
+  * @retval sequence number, 0 if the segment is erased or its header torn
+  */
+static uint32_t JOURNAL_ReadSeq (uint32_t seg, uint32_t *migrated)
+{
+  JOURNAL_Header_TypeDef hdr;
+
+  JOURNAL_Lock();
+  sFLASH_ReadBuffer((uint8_t *)&hdr, JOURNAL_SEGMENT_ADDR(seg), sizeof(hdr));
+  JOURNAL_Unlock();
+
+  if (migrated != NULL)
+  {
+    *migrated = hdr.Migrated;
+  }
+
+  if ((hdr.Magic != JOURNAL_MAGIC) || (hdr.Seq == 0) || (hdr.Crc != JOURNAL_HeaderCrc(hdr.Seq)))
+  {
+    return 0;
+  }
+  return hdr.Seq;
+}
+
+/**
+  * @brief  Compute the CRC of a segment header.
+  * @param  seq: sequence number of the segment
+  * @retval CRC
+  */
+static uint32_t JOURNAL_HeaderCrc (uint32_t seq)
+{
+  CRC_ResetDR();
+  CRC_CalcCRC(JOURNAL_MAGIC);
+  return CRC_CalcCRC(seq);
+}
+
+/**
+  * @brief  Check the header and the CRC of a data page.
+  * @param  seg: segment number
+  * @param  seq: sequence number of the segment
+  * @param  page: page in the segment, 1 to JOURNAL_PAGES_PER_SEGMENT - 1
+  * @param  len: payload length of a valid page
+  * @retval JOURNAL_PAGE_OK, JOURNAL_PAGE_ERASED or JOURNAL_PAGE_BAD
+  */
+static JOURNAL_PageStatus JOURNAL_CheckPage (uint32_t seg, uint32_t seq, uint32_t page, uint16_t *len)
+{
+  JOURNAL_PageHeader_TypeDef hdr;
+  uint8_t chunk[JOURNAL_CHECK_CHUNK];
+  uint32_t addr = JOURNAL_PAGE_ADDR(seg, page);
+  uint32_t off, n, i;
+
+  JOURNAL_Lock();
+  sFLASH_ReadBuffer((uint8_t *)&hdr, addr, JOURNAL_PAGE_HEADER_SIZE);
+  JOURNAL_Unlock();
+
+  if ((hdr.Len == 0xFFFF) && (hdr.Crc == 0xFFFFFFFF))
+  {
+    return JOURNAL_PAGE_ERASED;
+  }
+  if ((hdr.Len == 0) || (hdr.Len > JOURNAL_PAGE_DATA_SIZE))
+  {
+    return JOURNAL_PAGE_BAD;
+  }
+
+  CRC_ResetDR();
+  CRC_CalcCRC(seq);
+  CRC_CalcCRC16bits(hdr.Len);
+  for (off = 0; off < hdr.Len; off += n)
+  {
+    n = hdr.Len - off;
+    if (n > JOURNAL_CHECK_CHUNK)
+    {
+      n = JOURNAL_CHECK_CHUNK;
+    }
+    JOURNAL_Lock();
+    sFLASH_ReadBuffer(chunk, addr + JOURNAL_PAGE_HEADER_SIZE + off, (uint16_t)n);
+    JOURNAL_Unlock();
+    for (i = 0; i < n; i++)
+    {
+      CRC_CalcCRC8bits(chunk[i]);
+    }
+  }
+
+  if (CRC_GetCRC() != hdr.Crc)
+  {
+    return JOURNAL_PAGE_BAD;
+  }
+  *len = hdr.Len;
+  return JOURNAL_PAGE_OK;
+}
+
+/**
+  * @brief  Take the FLASH from the USB disk: the media interrupt is held off
+  *         and the erase or program it may have started is waited for.
+  * @param  None
+  * @retval None
+  */
+static void JOURNAL_Lock (void)
+{
+  NVIC_DisableIRQ(JOURNAL_MEDIA_IRQn);
+  sFLASH_WaitForWriteEnd();
+}
+
+/**
+  * @brief  Give the FLASH back to the USB disk.
+  * @param  None
+  * @retval None
+  */
+static void JOURNAL_Unlock (void)
+{
+  NVIC_EnableIRQ(JOURNAL_MEDIA_IRQn);
+}
+
+#endif /* USE_NOR_JOURNAL */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,172 @@
+/**
+  ******************************************************************************
+  * @file    sampler.c
+  * @author  MCD Application Team
+  * @version V1.0.0
+  * @date    31-January-2014
+  * @brief   Temperature sampling. The internal sensor of the STM32F072 is
+  *          converted every SAMPLER_PERIOD_MS, and each sample is formatted
+  *          as one data line of the PDF report, then handed to the outputs
+  *          configured: the sample journal and the CDC telemetry stream.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sampler.h"
+#include "usbd_conf.h"
+#include "nor_journal.h"
+#ifdef USE_MSC_CDC_COMPOSITE
+ #include "usbd_cdc_telemetry.h"
+#endif /* USE_MSC_CDC_COMPOSITE */
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Factory calibration of the temperature sensor, at VDDA = 3.3 V */
+#define TS_CAL1                    (*(__IO uint16_t *)0x1FFFF7B8)  /* 30 degC */
+#define TS_CAL2                    (*(__IO uint16_t *)0x1FFFF7C2)  /* 110 degC */
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+__IO uint32_t SAMPLER_Tick = 0;
+
+static uint32_t SAMPLER_Last = 0;
+static uint32_t SAMPLER_Index = 0;
+static char     SAMPLER_Line[SAMPLER_LINE_LENGTH + 2];
+
+/* Private function prototypes -----------------------------------------------*/
+static int32_t SAMPLER_Read (void);
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Start the SysTick time base and the ADC on the temperature sensor.
+  * @param  None
+  * @retval None
+  */
+void SAMPLER_Init (void)
+{
+  ADC_InitTypeDef ADC_InitStructure;
+
+  SysTick_Config(SystemCoreClock / 1000);
+
+  RCC_APB2PeriphClockCmd(RCC_APB2Periph_ADC1, ENABLE);
+  ADC_DeInit(ADC1);
+  ADC_ClockModeConfig(ADC1, ADC_ClockMode_SynClkDiv4);
+
+  ADC_StructInit(&ADC_InitStructure);
+  ADC_Init(ADC1, &ADC_InitStructure);
+
+  /* The sensor needs 17.1 us of sampling */
+  ADC_ChannelConfig(ADC1, ADC_Channel_TempSensor, ADC_SampleTime_239_5Cycles);
+  ADC_TempSensorCmd(ENABLE);
+
+  ADC_GetCalibrationFactor(ADC1);
+  ADC_Cmd(ADC1, ENABLE);
+  while (ADC_GetFlagStatus(ADC1, ADC_FLAG_ADRDY) == RESET)
+  {
+  }
+
+  SAMPLER_Last = SAMPLER_Tick;
+}
+
+/**
+  * @brief  Take a sample when it is due and hand it to the outputs.
+  * @note   To be called from the main loop.
+  * @param  None
+  * @retval None
+  */
+void SAMPLER_Process (void)
+{
+  if ((uint32_t)(SAMPLER_Tick - SAMPLER_Last) < SAMPLER_PERIOD_MS)
+  {
+    return;
+  }
+  SAMPLER_Last += SAMPLER_PERIOD_MS;
+
+  SAMPLER_FormatLine(SAMPLER_Line, SAMPLER_Index++, SAMPLER_Read());
+
+#ifdef USE_NOR_JOURNAL
+  /* The report reads the journal back as SAMPLER_LINE_LENGTH byte lines */
+  JOURNAL_Append((const uint8_t *)SAMPLER_Line, SAMPLER_LINE_LENGTH);
+#endif /* USE_NOR_JOURNAL */
+
+#ifdef USE_MSC_CDC_COMPOSITE
+  SAMPLER_Line[SAMPLER_LINE_LENGTH] = '\r';
+  SAMPLER_Line[SAMPLER_LINE_LENGTH + 1] = '\n';
+  TELEMETRY_Write((const uint8_t *)SAMPLER_Line, SAMPLER_LINE_LENGTH + 2);
+#endif /* USE_MSC_CDC_COMPOSITE */
+}
+
+/**
+  * @brief  Format a sample as one data line of the PDF report:
+  *         "NNNNNN   +TTT.T C", padded with spaces to SAMPLER_LINE_LENGTH.
+  * @param  line: SAMPLER_LINE_LENGTH chars, not null terminated
+  * @param  index: sample number, modulo 1000000
+  * @param  temp: temperature in tenths of degC
+  * @retval None
+  */
+void SAMPLER_FormatLine (char *line, uint32_t index, int32_t temp)
+{
+  uint32_t i, value;
+
+  for (i = 0; i < SAMPLER_LINE_LENGTH; i++)
+  {
+    line[i] = ' ';
+  }
+
+  for (i = 6, value = index; i > 0; i--, value /= 10)
+  {
+    line[i - 1] = '0' + (value % 10);
+  }
+
+  line[9] = (temp < 0) ? '-' : '+';
+  value = (temp < 0) ? -temp : temp;
+  if (value > 9999)
+  {
+    value = 9999;
+  }
+  line[10] = '0' + (value / 1000);
+  line[11] = '0' + ((value / 100) % 10);
+  line[12] = '0' + ((value / 10) % 10);
+  line[13] = '.';
+  line[14] = '0' + (value % 10);
+  line[16] = 'C';
+}
+
+/**
+  * @brief  Convert the temperature sensor.
+  * @param  None
+  * @retval Temperature in tenths of degC
+  */
+static int32_t SAMPLER_Read (void)
+{
+  int32_t raw;
+
+  ADC_StartOfConversion(ADC1);
+  while (ADC_GetFlagStatus(ADC1, ADC_FLAG_EOC) == RESET)
+  {
+  }
+  raw = ADC_GetConversionValue(ADC1);
+
+  /* Linear between the two calibration points */
+  return 300 + ((raw - (int32_t)TS_CAL1) * 800) / ((int32_t)TS_CAL2 - (int32_t)TS_CAL1);
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -1,5 +1,19 @@
 #include "spi_spiflash.h"
 
+#define sFLASH_NO_SECTOR          0xFFFFFFFF
+
+/* Sector bitmaps used to skip the erase of sectors freed by the host or FatFs */
+uint8_t  sFLASH_TrimMap[FLASH_SECTOR_COUNT / 8];    /* freed, waiting for a background erase */
+uint8_t  sFLASH_ErasedMap[FLASH_SECTOR_COUNT / 8];  /* known to be erased */
+__IO uint32_t sFLASH_TrimSector = sFLASH_NO_SECTOR; /* sector being erased in background */
+uint32_t sFLASH_TrimNext = 0;
+
+#define sFLASH_MapTest(map, sector)   ((map)[(sector) >> 3] & (1 << ((sector) & 7)))
+
+static void sFLASH_MapSet(uint8_t *map, uint32_t sector);
+static void sFLASH_MapClear(uint8_t *map, uint32_t sector);
+static void sFLASH_TrimWait(void);
+
 void SPI_Config(void)
 {
   GPIO_InitTypeDef GPIO_InitStructure;
@@ -56,14 +70,18 @@ void SPI_Config(void)
 
 void sFLASH_sector_write(uint8_t * buffer, uint32_t sector, uint16_t sector_number)
 {
-	uint32_t Address=0,sector_num=0;
+	uint32_t Address=0;
   Address = sector * FLASH_SECTOR_SIZE;
 	while(sector_number--)
 	{
-		sFLASH_EraseSector(Address+sector_num*4096);
+		if(sFLASH_PrepareSectorWrite(sector) == 0)
+		{
+			sFLASH_EraseSector(Address);
+		}
 		sFLASH_WriteBuffer(buffer,Address,FLASH_SECTOR_SIZE);
 		Address+=FLASH_SECTOR_SIZE;
-		sector_num++;
+		buffer+=FLASH_SECTOR_SIZE;
+		sector++;
 	}
 }
 
@@ -71,75 +89,27 @@ void sFLASH_sector_read(uint8_t * buffer, uint32_t sector, uint16_t sector_numbe
 {
 	uint32_t Address;
 	
+	sFLASH_TrimWait();
 	Address = sector * FLASH_SECTOR_SIZE;
   sFLASH_ReadBuffer(buffer,Address,FLASH_SECTOR_SIZE*sector_number);
 }
 
-uint8_t buffer_data[4096];
-void SPI_Flash_Write(uint8_t* pBuffer,uint32_t WriteAddr,uint16_t NumByteToWrite)  
+void sFLASH_EraseSector(uint32_t SectorAddr)
 {
-	uint32_t cycle_number=0;
-	uint32_t secpos;
-	uint16_t secoff;
-	uint16_t secremain;   
-	uint16_t i;     
-	secpos=WriteAddr/4096;
-	secoff=WriteAddr%4096;
-	secremain=4096-secoff; 
- 
-  if(NumByteToWrite<=secremain)secremain=NumByteToWrite;
-  while(1)
-  {
-		sFLASH_ReadBuffer(buffer_data,secpos*4096,4096);//ȡҳ
+  sFLASH_StartEraseSector(SectorAddr);
 
-		sFLASH_EraseSector(secpos*4096);
-		for(i=0;i<secremain;i++)  
-		{
-		  buffer_data[i+secoff]=pBuffer[cycle_number+i];  
-		}
-		
-		for(i=0;i<16;i++)
-		{
-			sFLASH_WritePage(buffer_data+i*256,secpos*4096+i*256,256);
-		}
-		
-		if(NumByteToWrite==secremain)break;
-		else
-		{
-		 secpos++;
-		 secoff=0;
-		 cycle_number+=secremain;
-		 NumByteToWrite-=secremain;
-		 if(NumByteToWrite>4096)secremain=4096;
-		 else secremain=NumByteToWrite;
-		}
-  }
-}
-void SPI_FLASH_PageErase(uint32_t PageAddr)
-{
-	uint32_t cycle_number=0;
-	uint32_t secpos;
-	uint16_t secoff;
-	uint16_t secremain;   
-	uint16_t i;     
-	secpos=PageAddr/4096;
-	secoff=PageAddr%4096;
-	secremain=4096-secoff;
-
-	sFLASH_ReadBuffer(buffer_data,secpos*4096,4096);//ȡҳ
-
-	sFLASH_EraseSector(secpos*4096);
-	for(i=0;i<512;i++)  
-	{
-		buffer_data[i+secoff]=0xFF;  
-	}
-	
-	for(i=0;i<16;i++)
-	{
-		sFLASH_WritePage(buffer_data+i*256,secpos*4096+i*256,256);
-	}
+  /*!< Wait the end of Flash writing */
+  sFLASH_WaitForWriteEnd();
 }
-void sFLASH_EraseSector(uint32_t SectorAddr)
+
+/**
+  * @brief  Starts the erase of the specified FLASH sector without waiting for 
+  *         its end.
+  * @note   sFLASH_IsWriteBusy() must return 0 before the next FLASH access.
+  * @param  SectorAddr: address of the sector to erase.
+  * @retval None
+  */
+void sFLASH_StartEraseSector(uint32_t SectorAddr)
 {
   /*!< Send write enable instruction */
   sFLASH_WriteEnable();
@@ -157,9 +127,6 @@ void sFLASH_EraseSector(uint32_t SectorAddr)
   sFLASH_SendByte(SectorAddr & 0xFF);
   /*!< Deselect the FLASH: Chip Select high */
   sFLASH_CS_HIGH();
-
-  /*!< Wait the end of Flash writing */
-  sFLASH_WaitForWriteEnd();
 }
 
 /**
@@ -196,6 +163,25 @@ void sFLASH_EraseBulk(void)
   * @retval None
   */
 void sFLASH_WritePage(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
+{
+  sFLASH_StartWritePage(pBuffer, WriteAddr, NumByteToWrite);
+
+  /*!< Wait the end of Flash writing */
+  sFLASH_WaitForWriteEnd();
+}
+
+/**
+  * @brief  Sends a Page WRITE sequence without waiting for the end of the 
+  *         programming.
+  * @note   sFLASH_IsWriteBusy() must return 0 before the next FLASH access.
+  * @param  pBuffer: pointer to the buffer  containing the data to be written
+  *         to the FLASH.
+  * @param  WriteAddr: FLASH's internal address to write to.
+  * @param  NumByteToWrite: number of bytes to write to the FLASH, must be equal
+  *         or less than "sFLASH_PAGESIZE" value.
+  * @retval None
+  */
+void sFLASH_StartWritePage(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
 {
   /*!< Enable the write access to the FLASH */
   sFLASH_WriteEnable();
@@ -222,9 +208,6 @@ void sFLASH_WritePage(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t NumByteToWr
 
   /*!< Deselect the FLASH: Chip Select high */
   sFLASH_CS_HIGH();
-
-  /*!< Wait the end of Flash writing */
-  sFLASH_WaitForWriteEnd();
 }
 
 /**
@@ -448,3 +431,143 @@ void sFLASH_WaitForWriteEnd(void)
   /*!< Deselect the FLASH: Chip Select high */
   sFLASH_CS_HIGH();
 }
+
+/**
+  * @brief  Reads the Write In Progress (WIP) flag once, without waiting.
+  * @param  None
+  * @retval 1 while an erase or program operation is ongoing, 0 otherwise.
+  */
+uint8_t sFLASH_IsWriteBusy(void)
+{
+  uint8_t flashstatus = 0;
+
+  /*!< Select the FLASH: Chip Select low */
+  sFLASH_CS_LOW();
+
+  /*!< Send "Read Status Register" instruction */
+  sFLASH_SendByte(sFLASH_CMD_RDSR);
+
+  /*!< Read the status register */
+  flashstatus = sFLASH_SendByte(sFLASH_DUMMY_BYTE);
+
+  /*!< Deselect the FLASH: Chip Select high */
+  sFLASH_CS_HIGH();
+
+  return (flashstatus & sFLASH_WIP_FLAG);
+}
+
+/**
+  * @brief  Marks sectors as free. They are erased in background by 
+  *         sFLASH_TrimStep() so that a later write can skip the erase.
+  * @param  sector: first sector to free.
+  * @param  sector_number: number of sectors to free.
+  * @retval None
+  */
+void sFLASH_TrimSectors(uint32_t sector, uint32_t sector_number)
+{
+  while ((sector_number--) && (sector < FLASH_SECTOR_COUNT))
+  {
+    sFLASH_MapSet(sFLASH_TrimMap, sector);
+    sector++;
+  }
+}
+
+/**
+  * @brief  Runs the background erase of the freed sectors, one sector at a 
+  *         time, without waiting for the end of the erase.
+  * @note   Must not be interrupted by another FLASH access.
+  * @param  None
+  * @retval 1 while freed sectors remain to be erased, 0 otherwise.
+  */
+uint8_t sFLASH_TrimStep(void)
+{
+  uint32_t i;
+
+  if (sFLASH_TrimSector != sFLASH_NO_SECTOR)
+  {
+    if (sFLASH_IsWriteBusy())
+    {
+      return 1;
+    }
+    sFLASH_MapSet(sFLASH_ErasedMap, sFLASH_TrimSector);
+    sFLASH_TrimSector = sFLASH_NO_SECTOR;
+  }
+
+  /* Look for the next freed sector, starting after the last one erased */
+  for (i = 0; i < FLASH_SECTOR_COUNT; i++)
+  {
+    if (sFLASH_MapTest(sFLASH_TrimMap, sFLASH_TrimNext))
+    {
+      sFLASH_MapClear(sFLASH_TrimMap, sFLASH_TrimNext);
+      sFLASH_TrimSector = sFLASH_TrimNext;
+      sFLASH_StartEraseSector(sFLASH_TrimSector * FLASH_SECTOR_SIZE);
+      return 1;
+    }
+    sFLASH_TrimNext = (sFLASH_TrimNext + 1) % FLASH_SECTOR_COUNT;
+  }
+  return 0;
+}
+
+/**
+  * @brief  Claims a sector before it is programmed: waits for a background 
+  *         erase and drops the sector from the free sector bitmaps.
+  * @param  sector: sector about to be written.
+  * @retval 1 if the sector is already erased, 0 if it must be erased first.
+  */
+uint8_t sFLASH_PrepareSectorWrite(uint32_t sector)
+{
+  uint8_t erased;
+
+  sFLASH_TrimWait();
+
+  sFLASH_MapClear(sFLASH_TrimMap, sector);
+  erased = sFLASH_MapTest(sFLASH_ErasedMap, sector) ? 1 : 0;
+  sFLASH_MapClear(sFLASH_ErasedMap, sector);
+
+  return erased;
+}
+
+/**
+  * @brief  Waits for the end of the background erase, if any.
+  * @param  None
+  * @retval None
+  */
+static void sFLASH_TrimWait(void)
+{
+  if (sFLASH_TrimSector != sFLASH_NO_SECTOR)
+  {
+    sFLASH_WaitForWriteEnd();
+    sFLASH_MapSet(sFLASH_ErasedMap, sFLASH_TrimSector);
+    sFLASH_TrimSector = sFLASH_NO_SECTOR;
+  }
+}
+
+/**
+  * @brief  Sets a sector bit, the bitmaps are also updated from interrupts.
+  * @param  map: sector bitmap.
+  * @param  sector: sector number.
+  * @retval None
+  */
+static void sFLASH_MapSet(uint8_t *map, uint32_t sector)
+{
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  map[sector >> 3] |= (uint8_t)(1 << (sector & 7));
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Clears a sector bit, the bitmaps are also updated from interrupts.
+  * @param  map: sector bitmap.
+  * @param  sector: sector number.
+  * @retval None
+  */
+static void sFLASH_MapClear(uint8_t *map, uint32_t sector)
+{
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  map[sector >> 3] &= (uint8_t)~(1 << (sector & 7));
+  __set_PRIMASK(primask);
+}
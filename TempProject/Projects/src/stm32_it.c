@@ -30,6 +30,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32_it.h"
+#include "sampler.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -91,6 +92,7 @@ void PendSV_Handler(void)
   */
 void SysTick_Handler(void)
 {
+  SAMPLER_Tick++;
 } 
 
 /**
@@ -0,0 +1,214 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_telemetry.c
+  * @author  MCD Application Team
+  * @version V1.0.0
+  * @date    31-January-2014
+  * @brief   CDC interface streaming the application telemetry to the host.
+  *          The sampling code writes into APP_Rx_Buffer without locking, the
+  *          CDC core sends it in batches of up to CDC_IN_BATCH_SIZE.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_cdc_telemetry.h"
+#include "usbd_pwr.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* These are external variables imported from CDC core to be used for IN
+   transfer management. */
+extern uint8_t  APP_Rx_Buffer [];
+extern __IO uint32_t APP_Rx_ptr_in;
+extern __IO uint32_t APP_Rx_ptr_out;
+extern __IO uint8_t  USB_Tx_State;
+
+/* Line coding is only stored and reported back, there is no UART behind */
+uint8_t TELEMETRY_LineCoding[7] =
+{
+  0x00, 0xC2, 0x01, 0x00, /* 115200 bps */
+  0x00,                   /* 1 stop bit */
+  0x00,                   /* no parity */
+  0x08                    /* 8 data bits */
+};
+
+/* Private function prototypes -----------------------------------------------*/
+static uint16_t TELEMETRY_Init     (void);
+static uint16_t TELEMETRY_DeInit   (void);
+static uint16_t TELEMETRY_Ctrl     (uint32_t Cmd, uint8_t* Buf, uint32_t Len);
+static uint16_t TELEMETRY_DataTx   (uint8_t* Buf, uint32_t Len);
+static uint16_t TELEMETRY_DataRx   (uint8_t* Buf, uint32_t Len);
+
+CDC_IF_Prop_TypeDef TELEMETRY_fops =
+{
+  TELEMETRY_Init,
+  TELEMETRY_DeInit,
+  TELEMETRY_Ctrl,
+  TELEMETRY_DataTx,
+  TELEMETRY_DataRx
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Queue telemetry data to be sent to the host and start sending it
+  *         if the IN pipe is idle. Never blocks: what does not fit in the 
+  *         buffer is dropped and counted in CDC_Stats.TxOverrun.
+  * @note   Single producer: call it from one context only (main loop or one
+  *         interrupt), the USB interrupt is the only consumer.
+  * @param  buf: data to send
+  * @param  len: number of bytes
+  * @retval number of bytes queued
+  */
+uint32_t TELEMETRY_Write (const uint8_t *buf, uint32_t len)
+{
+  uint32_t ptr_in = APP_Rx_ptr_in;
+  uint32_t room;
+  uint32_t i;
+
+  /* Free running indexes: the whole buffer can be used */
+  room = APP_RX_DATA_SIZE - (ptr_in - APP_Rx_ptr_out);
+
+  if (len > room)
+  {
+    CDC_Stats.TxOverrun += len - room;
+    len = room;
+  }
+
+  for (i = 0; i < len; i++, ptr_in++)
+  {
+    APP_Rx_Buffer[ptr_in & APP_RX_DATA_MASK] = buf[i];
+  }
+
+  /* Publish the data only once it is in the buffer */
+  __DMB();
+  APP_Rx_ptr_in = ptr_in;
+
+  /* Do not wait for the next SOF interval */
+  if ((len != 0) && (USB_Tx_State == 0))
+  {
+    NVIC_DisableIRQ(USB_IRQn);
+    usbd_cdc_Kick(&USB_Device_dev);
+    NVIC_EnableIRQ(USB_IRQn);
+  }
+
+  return len;
+}
+
+/**
+  * @brief  Queue a null terminated string, see TELEMETRY_Write.
+  * @param  str: string to send
+  * @retval number of bytes queued
+  */
+uint32_t TELEMETRY_Print (const char *str)
+{
+  uint32_t len = 0;
+
+  while (str[len] != 0)
+  {
+    len++;
+  }
+  return TELEMETRY_Write((const uint8_t *)str, len);
+}
+
+/**
+  * @brief  TELEMETRY_Init
+  *         Initializes the telemetry interface
+  * @param  None
+  * @retval Result of the operation: USBD_OK
+  */
+static uint16_t TELEMETRY_Init(void)
+{
+  return USBD_OK;
+}
+
+/**
+  * @brief  TELEMETRY_DeInit
+  *         DeInitializes the telemetry interface
+  * @param  None
+  * @retval Result of the operation: USBD_OK
+  */
+static uint16_t TELEMETRY_DeInit(void)
+{
+  return USBD_OK;
+}
+
+/**
+  * @brief  TELEMETRY_Ctrl
+  *         Manage the CDC class requests
+  * @param  Cmd: Command code
+  * @param  Buf: Buffer containing command data (request parameters)
+  * @param  Len: Number of data to be sent (in bytes)
+  * @retval Result of the operation: USBD_OK
+  */
+static uint16_t TELEMETRY_Ctrl (uint32_t Cmd, uint8_t* Buf, uint32_t Len)
+{
+  uint32_t i;
+
+  switch (Cmd)
+  {
+  case SET_LINE_CODING:
+    for (i = 0; (i < Len) && (i < sizeof(TELEMETRY_LineCoding)); i++)
+    {
+      TELEMETRY_LineCoding[i] = Buf[i];
+    }
+    break;
+
+  case GET_LINE_CODING:
+    for (i = 0; (i < Len) && (i < sizeof(TELEMETRY_LineCoding)); i++)
+    {
+      Buf[i] = TELEMETRY_LineCoding[i];
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  TELEMETRY_DataTx
+  *         Data to be sent to the host
+  * @param  Buf: Buffer of data to be sent
+  * @param  Len: Number of data to be sent (in bytes)
+  * @retval Result of the operation: USBD_OK if all the data is queued
+  */
+static uint16_t TELEMETRY_DataTx (uint8_t* Buf, uint32_t Len)
+{
+  return (TELEMETRY_Write(Buf, Len) == Len) ? USBD_OK : USBD_FAIL;
+}
+
+/**
+  * @brief  TELEMETRY_DataRx
+  *         Data received from the host, ignored: the channel is one way.
+  * @param  Buf: Buffer of data received
+  * @param  Len: Number of data received (in bytes)
+  * @retval Result of the operation: USBD_OK
+  */
+static uint16_t TELEMETRY_DataRx (uint8_t* Buf, uint32_t Len)
+{
+  return USBD_OK;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -31,15 +31,34 @@
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
 #define USBD_VID                   0x0483
-#define USBD_PID                   0x5720
+#if defined(USE_MSC_CDC_COMPOSITE)
+/* Not the PID of the MSC only device: the host would keep the driver
+   binding of its single interface */
+ #define USBD_PID                  0x5722
+#elif defined(USE_USB_DFU)
+ #define USBD_PID                  0xDF11
+#else
+ #define USBD_PID                  0x5720
+#endif /* USE_MSC_CDC_COMPOSITE */
 
 #define USBD_LANGID_STRING         0x409
 #define USBD_MANUFACTURER_STRING   "STMicroelectronics"
 
-#define USBD_PRODUCT_FS_STRING     "Mass Storage in FS Mode"
+#if defined(USE_MSC_CDC_COMPOSITE)
+ #define USBD_PRODUCT_FS_STRING    "Mass Storage and VCP in FS Mode"
+#elif defined(USE_USB_DFU)
+ #define USBD_PRODUCT_FS_STRING    "DFU in FS Mode"
+#else
+ #define USBD_PRODUCT_FS_STRING    "Mass Storage in FS Mode"
+#endif /* USE_MSC_CDC_COMPOSITE */
 
-#define USBD_CONFIGURATION_FS_STRING  "MSC Config"
-#define USBD_INTERFACE_FS_STRING      "MSC Interface"
+#ifdef USE_USB_DFU
+ #define USBD_CONFIGURATION_FS_STRING  "DFU Config"
+ #define USBD_INTERFACE_FS_STRING      "DFU Interface"
+#else
+ #define USBD_CONFIGURATION_FS_STRING  "MSC Config"
+ #define USBD_INTERFACE_FS_STRING      "MSC Interface"
+#endif /* USE_USB_DFU */
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 char USBD_SERIALNUMBER_FS_STRING[26];
@@ -63,9 +82,15 @@ const uint8_t USBD_DeviceDesc[USB_SIZ_DEVICE_DESC] =
   USB_DEVICE_DESCRIPTOR_TYPE, /*bDescriptorType*/
   0x00,                       /*bcdUSB */
   0x02,
+#ifdef USE_MSC_CDC_COMPOSITE
+  0xEF,                       /*bDeviceClass: Miscellaneous (IAD)*/
+  0x02,                       /*bDeviceSubClass: Common Class*/
+  0x01,                       /*bDeviceProtocol: Interface Association*/
+#else
   0x00,                       /*bDeviceClass*/
   0x00,                       /*bDeviceSubClass*/
   0x00,                       /*bDeviceProtocol*/
+#endif /* USE_MSC_CDC_COMPOSITE */
   USB_MAX_EP0_SIZE,           /*bMaxPacketSize*/
   LOBYTE(USBD_VID),           /*idVendor*/
   HIBYTE(USBD_VID),           /*idVendor*/
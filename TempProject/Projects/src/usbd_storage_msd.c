@@ -26,13 +26,20 @@
   */ 
 
 /* Includes ------------------------------------------------------------------*/
-#include "usbd_msc_mem.h"
+#include "usbd_storage_msd.h"
 #include "spi_spiflash.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
 #define STORAGE_LUN_NBR                  1 
 
+#define STORAGE_PAGES_PER_SECTOR         (FLASH_SECTOR_SIZE / sFLASH_SPI_PAGESIZE)
+
+/* Split-phase write states */
+#define STORAGE_IDLE                     0
+#define STORAGE_ERASE                    1
+#define STORAGE_PROGRAM                  2
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 /* USB Mass storage Standard Inquiry Data */
@@ -54,7 +61,18 @@ const int8_t  STORAGE_Inquirydata[] = {
 }; 
 
 __IO uint32_t count = 0;
+
+/* Split-phase write, run by STORAGE_Process() */
+__IO uint8_t STORAGE_State = STORAGE_IDLE;
+uint8_t  STORAGE_Lun;
+uint8_t  *STORAGE_pBuf;
+uint32_t STORAGE_Addr;
+uint16_t STORAGE_SectorNbr;
+uint16_t STORAGE_Page;
 /* Private function prototypes -----------------------------------------------*/
+static void STORAGE_StartSector (void);
+static uint8_t STORAGE_Step (void);
+
 int8_t STORAGE_Init (uint8_t lun);
 
 int8_t STORAGE_GetCapacity (uint8_t lun, 
@@ -77,6 +95,10 @@ int8_t STORAGE_Write (uint8_t lun,
 
 int8_t STORAGE_GetMaxLun (void);
 
+int8_t STORAGE_Unmap (uint8_t lun, 
+                      uint32_t blk_addr,
+                      uint32_t blk_len);
+
 
 USBD_STORAGE_cb_TypeDef USBD_MICRO_SDIO_fops =
 {
@@ -88,6 +110,7 @@ USBD_STORAGE_cb_TypeDef USBD_MICRO_SDIO_fops =
   STORAGE_Write,
   STORAGE_GetMaxLun,
   (int8_t *)STORAGE_Inquirydata,
+  STORAGE_Unmap,
 };
 
 USBD_STORAGE_cb_TypeDef  *USBD_STORAGE_fops = &USBD_MICRO_SDIO_fops;
@@ -116,7 +139,7 @@ int8_t STORAGE_GetCapacity (uint8_t lun, uint32_t *block_num, uint32_t *block_si
 { 
 	
   *block_size =  FLASH_SECTOR_SIZE;  
-  *block_num = FLASH_SECTOR_COUNT;  
+  *block_num = FLASH_VOLUME_SECTOR_COUNT;  
   
   return (0);
 }
@@ -172,7 +195,124 @@ int8_t STORAGE_Write (uint8_t lun,
                   uint32_t blk_addr,
                   uint16_t blk_len)
 {
-  sFLASH_sector_write(buf,blk_addr,blk_len);
+  /* Only start the first sector, STORAGE_Process() runs the rest of the 
+     write from the main loop instead of the USB interrupt */
+  STORAGE_Lun = lun;
+  STORAGE_pBuf = buf;
+  STORAGE_Addr = blk_addr * FLASH_SECTOR_SIZE;
+  STORAGE_SectorNbr = blk_len;
+  
+  if (blk_len == 0)
+  {
+    return (0);
+  }
+  
+  STORAGE_StartSector();
+  
+  return (USBD_STORAGE_BUSY);
+}
+
+/**
+  * @brief  Advance the write started by STORAGE_Write each time the FLASH 
+  *         is done with the previous erase or page program. To be called 
+  *         periodically from the main loop.
+  * @param  None
+  * @retval None
+  */
+void STORAGE_Process (void)
+{
+  uint8_t done = 0;
+  
+  /* The medium is read, and writes are started, from the USB interrupt */
+  NVIC_DisableIRQ(USB_IRQn);
+  
+  if (STORAGE_State == STORAGE_IDLE)
+  {
+    /* Erase the freed sectors while the medium is not written */
+    sFLASH_TrimStep();
+  }
+  else if (!sFLASH_IsWriteBusy())
+  {
+    done = STORAGE_Step();
+  }
+  
+  NVIC_EnableIRQ(USB_IRQn);
+  
+  if (done)
+  {
+    USBD_STORAGE_Cplt(STORAGE_Lun, 0);
+  }
+}
+
+/**
+  * @brief  Start writing the current sector, erasing it only if it is not 
+  *         already known to be erased.
+  * @param  None
+  * @retval None
+  */
+static void STORAGE_StartSector (void)
+{
+  if (sFLASH_PrepareSectorWrite(STORAGE_Addr / FLASH_SECTOR_SIZE))
+  {
+    STORAGE_State = STORAGE_PROGRAM;
+    STORAGE_Page = 0;
+    STORAGE_Step();
+  }
+  else
+  {
+    STORAGE_State = STORAGE_ERASE;
+    sFLASH_StartEraseSector(STORAGE_Addr);
+  }
+}
+
+/**
+  * @brief  Start the next FLASH operation of the current write.
+  * @param  None
+  * @retval 1 once the write is complete, 0 otherwise
+  */
+static uint8_t STORAGE_Step (void)
+{
+  if (STORAGE_State == STORAGE_ERASE)
+  {
+    STORAGE_State = STORAGE_PROGRAM;
+    STORAGE_Page = 0;
+  }
+  
+  if (STORAGE_Page < STORAGE_PAGES_PER_SECTOR)
+  {
+    sFLASH_StartWritePage(STORAGE_pBuf + STORAGE_Page * sFLASH_SPI_PAGESIZE,
+                          STORAGE_Addr + STORAGE_Page * sFLASH_SPI_PAGESIZE,
+                          sFLASH_SPI_PAGESIZE);
+    STORAGE_Page++;
+  }
+  else if (--STORAGE_SectorNbr != 0)
+  {
+    /* Next sector of the same request */
+    STORAGE_pBuf += FLASH_SECTOR_SIZE;
+    STORAGE_Addr += FLASH_SECTOR_SIZE;
+    
+    STORAGE_StartSector();
+  }
+  else
+  {
+    STORAGE_State = STORAGE_IDLE;
+    return 1;
+  }
+  return 0;
+}
+
+/**
+  * @brief  Free blocks of the medium, they are erased in background
+  * @param  lun : logical unit number
+  * @param  blk_addr :  address of 1st block to be freed
+  * @param  blk_len : number of blocks to be freed
+  * @retval Status
+  */
+int8_t STORAGE_Unmap (uint8_t lun, 
+                      uint32_t blk_addr,
+                      uint32_t blk_len)
+{
+  sFLASH_TrimSectors(blk_addr, blk_len);
   
   return (0);
 }
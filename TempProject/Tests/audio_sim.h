@@ -0,0 +1,28 @@
+/**
+  ******************************************************************************
+  * @file    audio_sim.h
+  * @brief   Settings of the USB speaker application for the host test of the
+  *          audio class (usbd_audio_core.c), forced in front of it with
+  *          -include: the stream format and buffer of the ST example, the
+  *          headers of the board LEDs and of the WAV add-on it calls, and
+  *          interrupt masking left out on the single host thread.
+  ******************************************************************************
+  */
+
+#ifndef __AUDIO_SIM_H
+#define __AUDIO_SIM_H
+
+#include "stm32f0xx.h"
+#include "stm32072b_eval.h"
+#include "wavaddon.h"
+
+/* 48 kHz stereo, 80 packets of 1 ms */
+#define DEFAULT_OUT_AUDIO_FREQ   48000
+#define SUPPORTED_FREQ_NBR       1
+#define OUT_PACKET_NUM           80
+#define TOTAL_OUT_BUF_SIZE       ((uint32_t)(AUDIO_OUT_PACKET * OUT_PACKET_NUM))
+
+#define __disable_irq()          ((void)0)
+#define __enable_irq()           ((void)0)
+
+#endif /* __AUDIO_SIM_H */
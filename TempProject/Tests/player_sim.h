@@ -0,0 +1,42 @@
+/**
+  ******************************************************************************
+  * @file    player_sim.h
+  * @brief   Settings of the audio player application for the host test of
+  *          the decode ring (stm32_audio_player.c), forced in front of it
+  *          with -include: the buffer and header sizes of the ST examples, a
+  *          ring deeper than the default refilled from a low watermark, the
+  *          NVIC calls of the decode task interrupt simulated by
+  *          test_player.c, and interrupt masking left out on the single host
+  *          thread.
+  ******************************************************************************
+  */
+
+#ifndef __PLAYER_SIM_H
+#define __PLAYER_SIM_H
+
+#include "stm32f0xx.h"
+
+#define MAX_OUT_PACKET_SZE           2048
+#define MAX_AUDIO_HEADER_SIZE        512
+
+/* 4 buffers, the decode task triggered with one left ahead of the one
+   playing */
+#define AUDIO_PLAYER_BUFFER_NBR      4
+#define AUDIO_PLAYER_LOW_WATERMARK   1
+
+void Sim_NVIC_SetPriority (IRQn_Type IRQn, uint32_t priority);
+void Sim_NVIC_EnableIRQ (IRQn_Type IRQn);
+void Sim_NVIC_DisableIRQ (IRQn_Type IRQn);
+void Sim_NVIC_SetPendingIRQ (IRQn_Type IRQn);
+void Sim_NVIC_ClearPendingIRQ (IRQn_Type IRQn);
+
+#define NVIC_SetPriority             Sim_NVIC_SetPriority
+#define NVIC_EnableIRQ               Sim_NVIC_EnableIRQ
+#define NVIC_DisableIRQ              Sim_NVIC_DisableIRQ
+#define NVIC_SetPendingIRQ           Sim_NVIC_SetPendingIRQ
+#define NVIC_ClearPendingIRQ         Sim_NVIC_ClearPendingIRQ
+
+#define __disable_irq()              ((void)0)
+#define __enable_irq()               ((void)0)
+
+#endif /* __PLAYER_SIM_H */
@@ -0,0 +1,20 @@
+/**
+  ******************************************************************************
+  * @file    pma_sim.h
+  * @brief   Simulated USB packet memory for the host tests, forced in front of
+  *          the driver sources with -include so PMAAddr points to it.
+  ******************************************************************************
+  */
+
+#ifndef __PMA_SIM_H
+#define __PMA_SIM_H
+
+#include <stdint.h>
+
+#define PMA_SIM_SIZE  1024
+
+extern uint16_t PMA_Sim[PMA_SIM_SIZE / 2];
+
+#define PMAAddr ((uintptr_t)PMA_Sim)
+
+#endif /* __PMA_SIM_H */
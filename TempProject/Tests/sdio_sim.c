@@ -0,0 +1,256 @@
+/**
+  ******************************************************************************
+  * @file    sdio_sim.c
+  * @brief   Software model of the STM32F1 SDIO and DMA2 channel 4 with a
+  *          standard capacity SD card for the host tests: command responses,
+  *          DMA data transfers and the SDIO interrupt at their end.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "sdio_sdcard.h"
+#include "sdio_sim.h"
+
+#define SD_R1_READY_FOR_DATA  ((uint32_t)0x00000100)
+#define SD_R1_OUT_OF_RANGE    ((uint32_t)0x80000000)
+
+SDIO_TypeDef        SDIO_Sim;
+DMA_Channel_TypeDef DMA2_Channel4_Sim;
+
+uint8_t     SD_SimCard[SD_SIM_BLOCKS * 512];
+SD_SimWrite SD_SimLog[32];
+uint32_t    SD_SimLogNbr;
+uint32_t    SD_SimProgPolls;
+uint8_t     SD_SimFailCmd;
+
+static DMA_InitTypeDef DmaInit;
+static uint8_t  DmaOn, SdioDma;
+static uint32_t DmaFlags;
+static uint8_t  AppCmd;
+static uint32_t PreErase;
+static uint8_t  DataCmd;
+static uint32_t DataBlock;
+static uint32_t ProgLeft;
+
+void SD_SimReset (void)
+{
+  memset(&SDIO_Sim, 0, sizeof(SDIO_Sim));
+  memset(SD_SimCard, 0, sizeof(SD_SimCard));
+  SD_SimLogNbr = 0;
+  SD_SimProgPolls = 0;
+  SD_SimFailCmd = 0;
+  DmaOn = 0;
+  SdioDma = 0;
+  DmaFlags = 0;
+  AppCmd = 0;
+  PreErase = 0;
+  DataCmd = 0;
+  ProgLeft = 0;
+}
+
+/* The data moves once the command, the data path and both DMA enables are
+   there, whatever their order; the card then programs what it received */
+static void SD_SimTransfer (void)
+{
+  uint8_t *mem = (uint8_t *)(uintptr_t)DmaInit.DMA_MemoryBaseAddr;
+  uint32_t len = SDIO_Sim.DLEN;
+  uint8_t write = (DataCmd == SD_CMD_WRITE_SINGLE_BLOCK) || (DataCmd == SD_CMD_WRITE_MULT_BLOCK);
+
+  if ((DataCmd == 0) || !DmaOn || !SdioDma || !(SDIO_Sim.DCTRL & SDIO_DPSM_Enable))
+  {
+    return;
+  }
+
+  if ((DataBlock * 512 + len) > sizeof(SD_SimCard))
+  {
+    SDIO_Sim.STA |= SDIO_FLAG_DTIMEOUT;
+  }
+  else if (write)
+  {
+    memcpy(&SD_SimCard[DataBlock * 512], mem, len);
+    if (SD_SimLogNbr < sizeof(SD_SimLog) / sizeof(SD_SimLog[0]))
+    {
+      SD_SimLog[SD_SimLogNbr].Cmd = DataCmd;
+      SD_SimLog[SD_SimLogNbr].Block = DataBlock;
+      SD_SimLog[SD_SimLogNbr].Count = len / 512;
+      SD_SimLog[SD_SimLogNbr].PreErase = PreErase;
+      SD_SimLog[SD_SimLogNbr].Buffer = mem;
+    }
+    SD_SimLogNbr++;
+    ProgLeft = SD_SimProgPolls;
+    DmaFlags |= DMA2_FLAG_TC4;
+    SDIO_Sim.STA |= SDIO_FLAG_DATAEND | SDIO_FLAG_DBCKEND;
+  }
+  else
+  {
+    memcpy(mem, &SD_SimCard[DataBlock * 512], len);
+    DmaFlags |= DMA2_FLAG_TC4;
+    SDIO_Sim.STA |= SDIO_FLAG_DATAEND | SDIO_FLAG_DBCKEND;
+  }
+
+  /* Both the DMA count and the data path are done */
+  DataCmd = 0;
+  PreErase = 0;
+  DmaOn = 0;
+  SDIO_Sim.DCTRL &= ~SDIO_DPSM_Enable;
+
+  /* SDIO_IRQHandler */
+  if (SDIO_Sim.STA & SDIO_Sim.MASK)
+  {
+    SD_ProcessIRQSrc();
+  }
+}
+
+void SDIO_DeInit (void)
+{
+}
+
+void SDIO_Init (SDIO_InitTypeDef *SDIO_InitStruct)
+{
+}
+
+void SDIO_ClockCmd (FunctionalState NewState)
+{
+}
+
+void SDIO_SetPowerState (uint32_t SDIO_PowerState)
+{
+  SDIO_Sim.POWER = SDIO_PowerState;
+}
+
+uint32_t SDIO_GetPowerState (void)
+{
+  return SDIO_Sim.POWER;
+}
+
+void SDIO_ITConfig (uint32_t SDIO_IT, FunctionalState NewState)
+{
+  if (NewState != DISABLE)
+  {
+    SDIO_Sim.MASK |= SDIO_IT;
+  }
+  else
+  {
+    SDIO_Sim.MASK &= ~SDIO_IT;
+  }
+}
+
+void SDIO_DMACmd (FunctionalState NewState)
+{
+  SdioDma = (NewState != DISABLE);
+  SD_SimTransfer();
+}
+
+void SDIO_SendCommand (SDIO_CmdInitTypeDef *SDIO_CmdInitStruct)
+{
+  uint8_t  cmd = (uint8_t)SDIO_CmdInitStruct->SDIO_CmdIndex;
+  uint32_t arg = SDIO_CmdInitStruct->SDIO_Argument;
+  uint32_t state = SD_CARD_TRANSFER;
+
+  switch (cmd)
+  {
+    case SD_CMD_SEND_STATUS:
+      if (ProgLeft != 0)
+      {
+        ProgLeft--;
+        state = SD_CARD_PROGRAMMING;
+      }
+      break;
+
+    case SD_CMD_SET_BLOCK_COUNT:
+      if (AppCmd)
+      {
+        PreErase = arg;
+      }
+      break;
+
+    case SD_CMD_WRITE_SINGLE_BLOCK:
+    case SD_CMD_WRITE_MULT_BLOCK:
+    case SD_CMD_READ_SINGLE_BLOCK:
+    case SD_CMD_READ_MULT_BLOCK:
+      /* Byte addressed */
+      DataCmd = cmd;
+      DataBlock = arg / 512;
+      break;
+
+    default:
+      break;
+  }
+  AppCmd = (cmd == SD_CMD_APP_CMD);
+
+  SDIO_Sim.ARG = arg;
+  SDIO_Sim.RESPCMD = cmd;
+  SDIO_Sim.RESP1 = (state << 9) | ((state == SD_CARD_TRANSFER) ? SD_R1_READY_FOR_DATA : 0) |
+                   ((cmd == SD_SimFailCmd) ? SD_R1_OUT_OF_RANGE : 0);
+  SDIO_Sim.STA |= (SDIO_CmdInitStruct->SDIO_Response == SDIO_Response_No) ?
+                  SDIO_FLAG_CMDSENT : SDIO_FLAG_CMDREND;
+}
+
+uint8_t SDIO_GetCommandResponse (void)
+{
+  return (uint8_t)SDIO_Sim.RESPCMD;
+}
+
+uint32_t SDIO_GetResponse (uint32_t SDIO_RESP)
+{
+  return (&SDIO_Sim.RESP1)[SDIO_RESP / 4];
+}
+
+void SDIO_DataConfig (SDIO_DataInitTypeDef *SDIO_DataInitStruct)
+{
+  SDIO_Sim.DLEN = SDIO_DataInitStruct->SDIO_DataLength;
+  SDIO_Sim.DCTRL = SDIO_DataInitStruct->SDIO_DPSM | SDIO_DataInitStruct->SDIO_TransferDir |
+                   SDIO_DataInitStruct->SDIO_DataBlockSize;
+  SD_SimTransfer();
+}
+
+/* The FIFO is only used by the polling and interrupt modes, not simulated */
+uint32_t SDIO_ReadData (void)
+{
+  return 0;
+}
+
+void SDIO_WriteData (uint32_t Data)
+{
+}
+
+FlagStatus SDIO_GetFlagStatus (uint32_t SDIO_FLAG)
+{
+  return (SDIO_Sim.STA & SDIO_FLAG) ? SET : RESET;
+}
+
+void SDIO_ClearFlag (uint32_t SDIO_FLAG)
+{
+  SDIO_Sim.STA &= ~SDIO_FLAG;
+}
+
+ITStatus SDIO_GetITStatus (uint32_t SDIO_IT)
+{
+  return (SDIO_Sim.STA & SDIO_IT) ? SET : RESET;
+}
+
+void SDIO_ClearITPendingBit (uint32_t SDIO_IT)
+{
+  SDIO_Sim.STA &= ~SDIO_IT;
+}
+
+void DMA_Init (DMA_Channel_TypeDef *DMAy_Channelx, DMA_InitTypeDef *DMA_InitStruct)
+{
+  DmaInit = *DMA_InitStruct;
+}
+
+void DMA_Cmd (DMA_Channel_TypeDef *DMAy_Channelx, FunctionalState NewState)
+{
+  DmaOn = (NewState != DISABLE);
+  SD_SimTransfer();
+}
+
+FlagStatus DMA_GetFlagStatus (uint32_t DMAy_FLAG)
+{
+  return (DmaFlags & DMAy_FLAG & 0x0FFFFFFF) ? SET : RESET;
+}
+
+void DMA_ClearFlag (uint32_t DMAy_FLAG)
+{
+  DmaFlags &= ~(DMAy_FLAG & 0x0FFFFFFF);
+}
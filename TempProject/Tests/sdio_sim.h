@@ -0,0 +1,41 @@
+/**
+  ******************************************************************************
+  * @file    sdio_sim.h
+  * @brief   Simulated SD card behind the SDIO and DMA2 calls of
+  *          stubs/stm32f10x.h for the host tests (sdio_sim.c): a standard
+  *          capacity card in the transfer state, the data written and read by
+  *          DMA, the SDIO interrupt taken at the end of each transfer, and a
+  *          log of the data writes.
+  ******************************************************************************
+  */
+
+#ifndef __SDIO_SIM_H
+#define __SDIO_SIM_H
+
+#include <stdint.h>
+
+#define SD_SIM_BLOCKS   256
+
+/* One CMD24 or CMD25 data write */
+typedef struct
+{
+  uint8_t        Cmd;
+  uint32_t       Block;
+  uint32_t       Count;
+  uint32_t       PreErase;   /* ACMD23 count sent before it, 0 if none */
+  const uint8_t *Buffer;     /* memory the DMA read the data from */
+} SD_SimWrite;
+
+extern uint8_t     SD_SimCard[SD_SIM_BLOCKS * 512];
+extern SD_SimWrite SD_SimLog[32];
+extern uint32_t    SD_SimLogNbr;
+
+/* CMD13 answers PROGRAMMING this many times after each write */
+extern uint32_t    SD_SimProgPolls;
+
+/* Command answered with ADDRESS_OUT_OF_RANGE, 0 for none */
+extern uint8_t     SD_SimFailCmd;
+
+void SD_SimReset (void);
+
+#endif /* __SDIO_SIM_H */
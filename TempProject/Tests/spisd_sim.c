@@ -0,0 +1,540 @@
+/**
+  ******************************************************************************
+  * @file    spisd_sim.c
+  * @brief   Software model of SPI1, of its DMA1 channels 2 (Rx) and 3 (Tx) and
+  *          of an SD card in SPI mode for the host tests: the commands with
+  *          their CRC7, the R1, R3 and R7 responses, the data tokens and blocks
+  *          with their CRC16, the data responses and the busy signal.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "stm32072b_eval_spi_sd.h"
+#include "spisd_sim.h"
+
+#define SD_TOKEN_READ         0xFE
+#define SD_TOKEN_WRITE        0xFE
+#define SD_TOKEN_WRITE_MULT   0xFC
+#define SD_TOKEN_STOP_TRAN    0xFD
+
+#define MODE_CMD    0   /* commands */
+#define MODE_TOKEN  1   /* waiting for the token of a written block */
+#define MODE_DATA   2   /* receiving a written block and its CRC */
+#define MODE_READ   3   /* CMD18 blocks sent until CMD12 */
+
+SPI_TypeDef   SPI1_Sim;
+
+uint8_t       SPISD_SimCard[SPISD_SIM_BLOCKS * 512];
+SPISD_SimData SPISD_SimLog[16];
+uint32_t      SPISD_SimLogNbr;
+uint32_t      SPISD_SimCmdCrcErrors;
+uint32_t      SPISD_SimDataCrcErrors;
+uint16_t      SPISD_SimLastCrc;
+uint16_t      SPISD_SimIdlePrescaler;
+uint16_t      SPISD_SimDataPrescaler;
+uint32_t      SPISD_SimBadReadCrc;
+uint32_t      SPISD_SimRejectBlock;
+
+static uint8_t  Type, Cs, Mode, Idle, App, CrcOn, Hcs, Multi;
+static uint32_t Polls;
+static uint8_t  Frame[6];
+static uint32_t FrameLen;
+static uint8_t  Out[1024];
+static uint32_t OutHead, OutTail;
+static uint8_t  Block[514];
+static uint32_t BlockLen;
+static uint32_t Addr, Count, PreErase;
+static SPISD_SimData  Spare;
+static SPISD_SimData *Data = &Spare;
+
+static DMA_InitTypeDef Dma[2];
+static uint8_t  DmaOn[2];
+static uint16_t DmaReq;
+static uint32_t DmaFlags;
+
+void SPISD_SimReset (uint8_t CardType)
+{
+  memset(&SPI1_Sim, 0, sizeof(SPI1_Sim));
+  memset(SPISD_SimCard, 0, sizeof(SPISD_SimCard));
+  SPISD_SimLogNbr = 0;
+  SPISD_SimCmdCrcErrors = 0;
+  SPISD_SimDataCrcErrors = 0;
+  SPISD_SimLastCrc = 0;
+  SPISD_SimIdlePrescaler = 0xFFFF;
+  SPISD_SimDataPrescaler = 0xFFFF;
+  SPISD_SimBadReadCrc = 0;
+  SPISD_SimRejectBlock = 0;
+  Type = CardType;
+  Cs = 0;
+  Mode = MODE_CMD;
+  Idle = 1;
+  App = 0;
+  CrcOn = 0;
+  Hcs = 0;
+  Polls = 0;
+  FrameLen = 0;
+  OutHead = OutTail = 0;
+  PreErase = 0;
+  Data = &Spare;
+  DmaOn[0] = DmaOn[1] = 0;
+  DmaReq = 0;
+  DmaFlags = 0;
+}
+
+/* Bit by bit, not the way the driver computes them */
+static uint8_t SPISD_SimCrc7 (const uint8_t *Data, uint32_t Length)
+{
+  uint8_t crc = 0, in;
+  uint32_t i;
+  int b;
+
+  for (i = 0; i < Length; i++)
+  {
+    for (b = 7; b >= 0; b--)
+    {
+      in = ((Data[i] >> b) ^ (crc >> 6)) & 1;
+      crc = (uint8_t)((crc << 1) & 0x7F);
+      if (in)
+      {
+        crc ^= 0x09;
+      }
+    }
+  }
+  return crc;
+}
+
+uint16_t SPISD_SimCrc16 (const uint8_t *Data, uint32_t Length)
+{
+  uint16_t crc = 0;
+  uint32_t i;
+  int b;
+
+  for (i = 0; i < Length; i++)
+  {
+    crc ^= (uint16_t)(Data[i] << 8);
+    for (b = 0; b < 8; b++)
+    {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+static void Put (uint8_t Byte)
+{
+  Out[OutTail++ % sizeof(Out)] = Byte;
+}
+
+static void PutBusy (void)
+{
+  Put(0x00);
+  Put(0x00);
+}
+
+/* Next block of a read: Nac, token, data and CRC */
+static void SPISD_SimSendBlock (void)
+{
+  uint16_t crc;
+  uint32_t i;
+
+  Count++;
+  Put(SD_DUMMY_BYTE);
+  if (Addr >= SPISD_SIM_BLOCKS)
+  {
+    /* Data error token: out of range */
+    Put(0x08);
+    return;
+  }
+  Put(SD_TOKEN_READ);
+  for (i = 0; i < 512; i++)
+  {
+    Put(SPISD_SimCard[Addr * 512 + i]);
+  }
+  crc = SPISD_SimCrc16(&SPISD_SimCard[Addr * 512], 512);
+  if (Count == SPISD_SimBadReadCrc)
+  {
+    crc ^= 0x0001;
+  }
+  Put((uint8_t)(crc >> 8));
+  Put((uint8_t)crc);
+  Addr++;
+}
+
+static void SPISD_SimCommand (void)
+{
+  uint8_t  cmd = Frame[0] & 0x3F;
+  uint32_t arg = ((uint32_t)Frame[1] << 24) | ((uint32_t)Frame[2] << 16) |
+                 ((uint32_t)Frame[3] << 8) | Frame[4];
+  uint8_t  app = App;
+  uint8_t  r1;
+
+  App = 0;
+
+  if (cmd == SD_CMD_STOP_TRANSMISSION)
+  {
+    /* The rest of the block being sent is dropped, a stuff byte follows */
+    OutHead = OutTail;
+    Put(0x3F);
+    if (Mode == MODE_READ)
+    {
+      Data->Stopped = 1;
+    }
+    Mode = MODE_CMD;
+  }
+
+  /* Ncr */
+  Put(SD_DUMMY_BYTE);
+
+  /* CMD0 and CMD8 are always checked, the others after CMD59 */
+  if (((Frame[5] != ((SPISD_SimCrc7(Frame, 5) << 1) | 1))) &&
+      (CrcOn || (cmd == SD_CMD_GO_IDLE_STATE) || (cmd == SD_CMD_SEND_IF_COND)))
+  {
+    SPISD_SimCmdCrcErrors++;
+    Put(Idle | SD_COM_CRC_ERROR);
+    return;
+  }
+
+  r1 = Idle;
+  switch (cmd)
+  {
+    case SD_CMD_GO_IDLE_STATE:
+      Idle = 1;
+      r1 = Idle;
+      CrcOn = 0;
+      Polls = 0;
+      SPISD_SimIdlePrescaler = SPI1_Sim.CR1 & SPI_CR1_BR;
+      break;
+
+    case SD_CMD_SEND_IF_COND:
+      if (Type == SPISD_SIM_V1)
+      {
+        r1 |= SD_ILLEGAL_COMMAND;
+        break;
+      }
+      /* R7: voltage accepted and check pattern echoed */
+      Put(r1);
+      Put(0x00);
+      Put(0x00);
+      Put((uint8_t)((arg >> 8) & 0x0F));
+      Put((uint8_t)arg);
+      return;
+
+    case SD_CMD_APP_CMD:
+      App = 1;
+      break;
+
+    case SD_ACMD_SD_SEND_OP_COND:
+      if (!app)
+      {
+        r1 |= SD_ILLEGAL_COMMAND;
+        break;
+      }
+      Hcs = ((arg & 0x40000000) != 0);
+      if (++Polls >= 3)
+      {
+        Idle = 0;
+      }
+      r1 = Idle;
+      break;
+
+    case SD_CMD_READ_OCR:
+      /* R3: CCS set once a High Capacity card is initialized with HCS */
+      Put(r1);
+      Put((uint8_t)(0x80 | (((Type == SPISD_SIM_HC) && Hcs && !Idle) ? 0x40 : 0x00)));
+      Put(0xFF);
+      Put(0x80);
+      Put(0x00);
+      return;
+
+    case SD_CMD_SET_BLOCKLEN:
+      if (arg != 512)
+      {
+        r1 |= SD_PARAMETER_ERROR;
+      }
+      break;
+
+    case SD_CMD_CRC_ON_OFF:
+      CrcOn = arg & 1;
+      break;
+
+    case SD_CMD_SEND_STATUS:
+      /* R2 */
+      Put(r1);
+      Put(0x00);
+      return;
+
+    case SD_ACMD_SET_WR_BLK_ERASE_COUNT:
+      if (!app)
+      {
+        r1 |= SD_ILLEGAL_COMMAND;
+        break;
+      }
+      PreErase = arg;
+      break;
+
+    case SD_CMD_STOP_TRANSMISSION:
+      /* R1b */
+      Put(r1);
+      PutBusy();
+      return;
+
+    case SD_CMD_READ_SINGLE_BLOCK:
+    case SD_CMD_READ_MULT_BLOCK:
+    case SD_CMD_WRITE_SINGLE_BLOCK:
+    case SD_CMD_WRITE_MULT_BLOCK:
+      Addr = (Type == SPISD_SIM_HC) ? arg : arg / 512;
+      if (Idle)
+      {
+        r1 |= SD_ILLEGAL_COMMAND;
+        break;
+      }
+      if ((Type != SPISD_SIM_HC) && (arg % 512 != 0))
+      {
+        r1 |= SD_ADDRESS_ERROR;
+        break;
+      }
+      if (Addr >= SPISD_SIM_BLOCKS)
+      {
+        r1 |= SD_PARAMETER_ERROR;
+        break;
+      }
+
+      Data = (SPISD_SimLogNbr < sizeof(SPISD_SimLog) / sizeof(SPISD_SimLog[0])) ?
+             &SPISD_SimLog[SPISD_SimLogNbr] : &Spare;
+      SPISD_SimLogNbr++;
+      memset(Data, 0, sizeof(*Data));
+      Data->Cmd = cmd;
+      Data->Arg = arg;
+      Data->PreErase = (cmd == SD_CMD_WRITE_MULT_BLOCK) ? PreErase : 0;
+      PreErase = 0;
+      Count = 0;
+      SPISD_SimDataPrescaler = SPI1_Sim.CR1 & SPI_CR1_BR;
+
+      Put(r1);
+      if (cmd == SD_CMD_READ_SINGLE_BLOCK)
+      {
+        SPISD_SimSendBlock();
+      }
+      else if (cmd == SD_CMD_READ_MULT_BLOCK)
+      {
+        Mode = MODE_READ;
+      }
+      else
+      {
+        Multi = (cmd == SD_CMD_WRITE_MULT_BLOCK);
+        Mode = MODE_TOKEN;
+      }
+      return;
+
+    default:
+      r1 |= SD_ILLEGAL_COMMAND;
+      break;
+  }
+  Put(r1);
+}
+
+static void SPISD_SimToken (uint8_t Byte)
+{
+  if (Byte == (Multi ? SD_TOKEN_WRITE_MULT : SD_TOKEN_WRITE))
+  {
+    Mode = MODE_DATA;
+    BlockLen = 0;
+  }
+  else if (Multi && (Byte == SD_TOKEN_STOP_TRAN))
+  {
+    /* Nbr, then busy until the last block is programmed */
+    Data->Stopped = 1;
+    Put(SD_DUMMY_BYTE);
+    PutBusy();
+    Mode = MODE_CMD;
+  }
+}
+
+static void SPISD_SimReceive (uint8_t Byte)
+{
+  uint16_t crc;
+
+  Block[BlockLen++] = Byte;
+  if (BlockLen < sizeof(Block))
+  {
+    return;
+  }
+
+  crc = (uint16_t)((Block[512] << 8) | Block[513]);
+  SPISD_SimLastCrc = crc;
+  Count++;
+  Mode = Multi ? MODE_TOKEN : MODE_CMD;
+
+  /* Data response, the upper bits are undefined */
+  if (CrcOn && (crc != SPISD_SimCrc16(Block, 512)))
+  {
+    SPISD_SimDataCrcErrors++;
+    Put(0xE0 | SD_DATA_CRC_ERROR);
+  }
+  else if ((Count == SPISD_SimRejectBlock) || (Addr >= SPISD_SIM_BLOCKS))
+  {
+    Put(0xE0 | SD_DATA_WRITE_ERROR);
+  }
+  else
+  {
+    memcpy(&SPISD_SimCard[Addr * 512], Block, 512);
+    Addr++;
+    Data->Blocks++;
+    Put(0xE0 | SD_DATA_OK);
+  }
+  PutBusy();
+}
+
+/* One byte each way while the chip select is low */
+uint8_t STM_SPI_WriteRead (uint8_t Byte)
+{
+  uint8_t miso = SD_DUMMY_BYTE;
+
+  if (!(SPI1_Sim.CR1 & SPI_CR1_SPE) || !Cs)
+  {
+    return SD_DUMMY_BYTE;
+  }
+
+  if (OutHead != OutTail)
+  {
+    miso = Out[OutHead++ % sizeof(Out)];
+  }
+  if ((Mode == MODE_READ) && (OutHead == OutTail))
+  {
+    SPISD_SimSendBlock();
+  }
+
+  switch (Mode)
+  {
+    case MODE_TOKEN:
+      SPISD_SimToken(Byte);
+      break;
+
+    case MODE_DATA:
+      SPISD_SimReceive(Byte);
+      break;
+
+    default:
+      if ((FrameLen != 0) || ((Byte & 0xC0) == 0x40))
+      {
+        Frame[FrameLen++] = Byte;
+        if (FrameLen == sizeof(Frame))
+        {
+          FrameLen = 0;
+          SPISD_SimCommand();
+        }
+      }
+      break;
+  }
+  return miso;
+}
+
+void SD_LowLevel_Init (void)
+{
+  SPI1_Sim.CR1 = SPI_CR1_MSTR | SPI_BaudRatePrescaler_4 | SPI_CR1_SPE;
+}
+
+void SD_LowLevel_DeInit (void)
+{
+  SPI1_Sim.CR1 = 0;
+}
+
+void SPI_Cmd (SPI_TypeDef *SPIx, FunctionalState NewState)
+{
+  if (NewState != DISABLE)
+  {
+    SPIx->CR1 |= SPI_CR1_SPE;
+  }
+  else
+  {
+    SPIx->CR1 &= (uint16_t)~SPI_CR1_SPE;
+  }
+}
+
+/* Chip select on PF.02 */
+void GPIO_SetBits (GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+  if ((GPIOx == SD_CS_GPIO_PORT) && (GPIO_Pin & SD_CS_PIN))
+  {
+    Cs = 0;
+    FrameLen = 0;
+  }
+}
+
+void GPIO_ResetBits (GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+  if ((GPIOx == SD_CS_GPIO_PORT) && (GPIO_Pin & SD_CS_PIN))
+  {
+    Cs = 1;
+  }
+}
+
+/* The card is always present */
+uint16_t GPIO_ReadInputData (GPIO_TypeDef *GPIOx)
+{
+  return 0;
+}
+
+/* The bytes move once both channels and both SPI requests are enabled, the
+   Rx channel then reports the end of the transfer */
+static void SPISD_SimDma (void)
+{
+  uint8_t *rx = (uint8_t *)(uintptr_t)Dma[0].DMA_MemoryBaseAddr;
+  const uint8_t *tx = (const uint8_t *)(uintptr_t)Dma[1].DMA_MemoryBaseAddr;
+  uint32_t i;
+
+  if (!DmaOn[0] || !DmaOn[1] || ((DmaReq & (SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx)) !=
+                                 (SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx)))
+  {
+    return;
+  }
+
+  for (i = 0; i < Dma[0].DMA_BufferSize; i++)
+  {
+    *rx = STM_SPI_WriteRead(*tx);
+    if (Dma[0].DMA_MemoryInc == DMA_MemoryInc_Enable)
+    {
+      rx++;
+    }
+    if (Dma[1].DMA_MemoryInc == DMA_MemoryInc_Enable)
+    {
+      tx++;
+    }
+  }
+  DmaFlags |= SD_SPI_DMA_RX_FLAG_TC | SD_SPI_DMA_RX_FLAG_GL | SD_SPI_DMA_TX_FLAG_GL;
+  DmaOn[0] = DmaOn[1] = 0;
+}
+
+void SPI_I2S_DMACmd (SPI_TypeDef *SPIx, uint16_t SPI_I2S_DMAReq, FunctionalState NewState)
+{
+  if (NewState != DISABLE)
+  {
+    DmaReq |= SPI_I2S_DMAReq;
+  }
+  else
+  {
+    DmaReq &= (uint16_t)~SPI_I2S_DMAReq;
+  }
+  SPISD_SimDma();
+}
+
+void DMA_Init (DMA_Channel_TypeDef *DMAy_Channelx, DMA_InitTypeDef *DMA_InitStruct)
+{
+  Dma[(DMAy_Channelx == SD_SPI_DMA_RX_CHANNEL) ? 0 : 1] = *DMA_InitStruct;
+}
+
+void DMA_Cmd (DMA_Channel_TypeDef *DMAy_Channelx, FunctionalState NewState)
+{
+  DmaOn[(DMAy_Channelx == SD_SPI_DMA_RX_CHANNEL) ? 0 : 1] = (NewState != DISABLE);
+  SPISD_SimDma();
+}
+
+FlagStatus DMA_GetFlagStatus (uint32_t DMAy_FLAG)
+{
+  return (DmaFlags & DMAy_FLAG) ? SET : RESET;
+}
+
+void DMA_ClearFlag (uint32_t DMAy_FLAG)
+{
+  DmaFlags &= ~DMAy_FLAG;
+}
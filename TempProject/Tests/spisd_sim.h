@@ -0,0 +1,61 @@
+/**
+  ******************************************************************************
+  * @file    spisd_sim.h
+  * @brief   Simulated SD card on SPI1 for the host tests, forced in front of
+  *          stm32072b_eval_spi_sd.c with -include so SD_SPI points to it: the
+  *          byte exchanges of STM_SPI_WriteRead and of the DMA1 channels 2 and
+  *          3, and a card answering them in SPI mode (spisd_sim.c).
+  ******************************************************************************
+  */
+
+#ifndef __SPISD_SIM_H
+#define __SPISD_SIM_H
+
+#include "stm32f0xx.h"
+
+extern SPI_TypeDef SPI1_Sim;
+
+#undef  SPI1
+#define SPI1 (&SPI1_Sim)
+
+#define SPISD_SIM_BLOCKS  64
+
+/* Card types */
+#define SPISD_SIM_V1      0   /* no CMD8 */
+#define SPISD_SIM_V2      1   /* byte addressed */
+#define SPISD_SIM_HC      2   /* block addressed */
+
+/* One CMD17, CMD18, CMD24 or CMD25 */
+typedef struct
+{
+  uint8_t  Cmd;
+  uint32_t Arg;       /* as sent, in bytes or in blocks */
+  uint32_t PreErase;  /* ACMD23 count sent before it, 0 if none */
+  uint32_t Blocks;    /* blocks written by the card */
+  uint8_t  Stopped;   /* stop token or CMD12 seen */
+} SPISD_SimData;
+
+extern uint8_t       SPISD_SimCard[SPISD_SIM_BLOCKS * 512];
+extern SPISD_SimData SPISD_SimLog[16];
+extern uint32_t      SPISD_SimLogNbr;
+
+/* Commands and data blocks received with a wrong CRC */
+extern uint32_t      SPISD_SimCmdCrcErrors;
+extern uint32_t      SPISD_SimDataCrcErrors;
+/* CRC16 of the last data block received */
+extern uint16_t      SPISD_SimLastCrc;
+/* SPI1 prescaler bits at CMD0 and at the last data command */
+extern uint16_t      SPISD_SimIdlePrescaler;
+extern uint16_t      SPISD_SimDataPrescaler;
+
+/* Block sent with a corrupted CRC, counted from 1 since the read command,
+   0 for none */
+extern uint32_t      SPISD_SimBadReadCrc;
+/* Block received answered with a write error, counted from 1 since the write
+   command, 0 for none */
+extern uint32_t      SPISD_SimRejectBlock;
+
+void     SPISD_SimReset (uint8_t Type);
+uint16_t SPISD_SimCrc16 (const uint8_t *Data, uint32_t Length);
+
+#endif /* __SPISD_SIM_H */
@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * @file    stm32_sim.c
+  * @brief   Software model of the STM32F0 CRC unit for the host tests.
+  ******************************************************************************
+  */
+
+#include "stm32f0xx.h"
+
+static uint32_t CRC_Value = 0xFFFFFFFF;
+
+static uint32_t CRC_Feed (uint32_t data, uint32_t bits)
+{
+  uint32_t i;
+
+  CRC_Value ^= data << (32 - bits);
+  for (i = 0; i < bits; i++)
+  {
+    CRC_Value = (CRC_Value & 0x80000000) ? (CRC_Value << 1) ^ 0x04C11DB7 : (CRC_Value << 1);
+  }
+  return CRC_Value;
+}
+
+void CRC_DeInit (void)
+{
+  CRC_Value = 0xFFFFFFFF;
+}
+
+void CRC_ResetDR (void)
+{
+  CRC_Value = 0xFFFFFFFF;
+}
+
+uint32_t CRC_CalcCRC (uint32_t CRC_Data)
+{
+  return CRC_Feed(CRC_Data, 32);
+}
+
+uint32_t CRC_CalcCRC16bits (uint16_t CRC_Data)
+{
+  return CRC_Feed(CRC_Data, 16);
+}
+
+uint32_t CRC_CalcCRC8bits (uint8_t CRC_Data)
+{
+  return CRC_Feed(CRC_Data, 8);
+}
+
+uint32_t CRC_GetCRC (void)
+{
+  return CRC_Value;
+}
@@ -0,0 +1,15 @@
+/**
+  ******************************************************************************
+  * @file    global_includes.h
+  * @brief   Host stand-in for the application header of the audio utilities:
+  *          the decoders are selected on the command line.
+  ******************************************************************************
+  */
+
+#ifndef __GLOBAL_INCLUDES_H
+#define __GLOBAL_INCLUDES_H
+
+#include "stm32f0xx.h"
+#include "ff.h"
+
+#endif /* __GLOBAL_INCLUDES_H */
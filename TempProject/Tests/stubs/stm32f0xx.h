@@ -0,0 +1,45 @@
+/**
+  ******************************************************************************
+  * @file    stm32f0xx.h
+  * @brief   Host stand-in for the device header: the types, and the CRC unit
+  *          and interrupt calls used by the code under test (stm32_sim.c).
+  ******************************************************************************
+  */
+
+#ifndef __STM32F0XX_H
+#define __STM32F0XX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __IO volatile
+
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+
+typedef enum
+{
+  USB_IRQn     = 31
+} IRQn_Type;
+
+#define RCC_AHBPeriph_CRC          ((uint32_t)0x00000040)
+
+#define RCC_AHBPeriphClockCmd(periph, state)  ((void)(periph), (void)(state))
+#define NVIC_DisableIRQ(irq)                  ((void)(irq))
+#define NVIC_EnableIRQ(irq)                   ((void)(irq))
+
+/* The code under test runs on one thread, nothing to mask */
+#define __get_PRIMASK()                       (0)
+#define __set_PRIMASK(mask)                   ((void)(mask))
+#define __disable_irq()                       ((void)0)
+#define __DMB()                               ((void)0)
+
+/* CRC unit, reset configuration: CRC-32 poly 0x04C11DB7, init 0xFFFFFFFF,
+   not reflected */
+void     CRC_DeInit (void);
+void     CRC_ResetDR (void);
+uint32_t CRC_CalcCRC (uint32_t CRC_Data);
+uint32_t CRC_CalcCRC16bits (uint16_t CRC_Data);
+uint32_t CRC_CalcCRC8bits (uint8_t CRC_Data);
+uint32_t CRC_GetCRC (void);
+
+#endif /* __STM32F0XX_H */
@@ -0,0 +1,229 @@
+/**
+  ******************************************************************************
+  * @file    stm32f10x.h
+  * @brief   Host stand-in for the STM32F1 device header of sdio_sdcard.c: the
+  *          SDIO, DMA2 and GPIO declarations it uses, run by the card model
+  *          of sdio_sim.c.
+  ******************************************************************************
+  */
+
+#ifndef __STM32F10x_H
+#define __STM32F10x_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus;
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+typedef enum {Bit_RESET = 0, Bit_SET} BitAction;
+
+/* SDIO ----------------------------------------------------------------------*/
+typedef struct
+{
+  __IO uint32_t POWER;
+  __IO uint32_t CLKCR;
+  __IO uint32_t ARG;
+  __IO uint32_t CMD;
+  __IO uint32_t RESPCMD;
+  __IO uint32_t RESP1;
+  __IO uint32_t RESP2;
+  __IO uint32_t RESP3;
+  __IO uint32_t RESP4;
+  __IO uint32_t DTIMER;
+  __IO uint32_t DLEN;
+  __IO uint32_t DCTRL;
+  __IO uint32_t DCOUNT;
+  __IO uint32_t STA;
+  __IO uint32_t ICR;
+  __IO uint32_t MASK;
+} SDIO_TypeDef;
+
+extern SDIO_TypeDef SDIO_Sim;
+#define SDIO                               (&SDIO_Sim)
+
+typedef struct
+{
+  uint32_t SDIO_ClockEdge;
+  uint32_t SDIO_ClockBypass;
+  uint32_t SDIO_ClockPowerSave;
+  uint32_t SDIO_BusWide;
+  uint32_t SDIO_HardwareFlowControl;
+  uint8_t  SDIO_ClockDiv;
+} SDIO_InitTypeDef;
+
+typedef struct
+{
+  uint32_t SDIO_Argument;
+  uint32_t SDIO_CmdIndex;
+  uint32_t SDIO_Response;
+  uint32_t SDIO_Wait;
+  uint32_t SDIO_CPSM;
+} SDIO_CmdInitTypeDef;
+
+typedef struct
+{
+  uint32_t SDIO_DataTimeOut;
+  uint32_t SDIO_DataLength;
+  uint32_t SDIO_DataBlockSize;
+  uint32_t SDIO_TransferDir;
+  uint32_t SDIO_TransferMode;
+  uint32_t SDIO_DPSM;
+} SDIO_DataInitTypeDef;
+
+#define SDIO_ClockEdge_Rising              ((uint32_t)0x00000000)
+#define SDIO_ClockBypass_Disable           ((uint32_t)0x00000000)
+#define SDIO_ClockPowerSave_Disable        ((uint32_t)0x00000000)
+#define SDIO_BusWide_1b                    ((uint32_t)0x00000000)
+#define SDIO_BusWide_4b                    ((uint32_t)0x00000800)
+#define SDIO_BusWide_8b                    ((uint32_t)0x00001000)
+#define SDIO_HardwareFlowControl_Disable   ((uint32_t)0x00000000)
+#define SDIO_PowerState_OFF                ((uint32_t)0x00000000)
+#define SDIO_PowerState_ON                 ((uint32_t)0x00000003)
+
+#define SDIO_Response_No                   ((uint32_t)0x00000000)
+#define SDIO_Response_Short                ((uint32_t)0x00000040)
+#define SDIO_Response_Long                 ((uint32_t)0x000000C0)
+#define SDIO_Wait_No                       ((uint32_t)0x00000000)
+#define SDIO_CPSM_Enable                   ((uint32_t)0x00000400)
+
+#define SDIO_RESP1                         ((uint32_t)0x00000000)
+#define SDIO_RESP2                         ((uint32_t)0x00000004)
+#define SDIO_RESP3                         ((uint32_t)0x00000008)
+#define SDIO_RESP4                         ((uint32_t)0x0000000C)
+
+#define SDIO_DataBlockSize_1b              ((uint32_t)0x00000000)
+#define SDIO_DataBlockSize_8b              ((uint32_t)0x00000030)
+#define SDIO_DataBlockSize_64b             ((uint32_t)0x00000060)
+#define SDIO_DataBlockSize_512b            ((uint32_t)0x00000090)
+#define SDIO_TransferDir_ToCard            ((uint32_t)0x00000000)
+#define SDIO_TransferDir_ToSDIO            ((uint32_t)0x00000002)
+#define SDIO_TransferMode_Block            ((uint32_t)0x00000000)
+#define SDIO_DPSM_Disable                  ((uint32_t)0x00000000)
+#define SDIO_DPSM_Enable                   ((uint32_t)0x00000001)
+
+#define SDIO_FLAG_CCRCFAIL                 ((uint32_t)0x00000001)
+#define SDIO_FLAG_DCRCFAIL                 ((uint32_t)0x00000002)
+#define SDIO_FLAG_CTIMEOUT                 ((uint32_t)0x00000004)
+#define SDIO_FLAG_DTIMEOUT                 ((uint32_t)0x00000008)
+#define SDIO_FLAG_TXUNDERR                 ((uint32_t)0x00000010)
+#define SDIO_FLAG_RXOVERR                  ((uint32_t)0x00000020)
+#define SDIO_FLAG_CMDREND                  ((uint32_t)0x00000040)
+#define SDIO_FLAG_CMDSENT                  ((uint32_t)0x00000080)
+#define SDIO_FLAG_DATAEND                  ((uint32_t)0x00000100)
+#define SDIO_FLAG_STBITERR                 ((uint32_t)0x00000200)
+#define SDIO_FLAG_DBCKEND                  ((uint32_t)0x00000400)
+#define SDIO_FLAG_TXACT                    ((uint32_t)0x00001000)
+#define SDIO_FLAG_RXACT                    ((uint32_t)0x00002000)
+#define SDIO_FLAG_TXFIFOHE                 ((uint32_t)0x00004000)
+#define SDIO_FLAG_RXFIFOHF                 ((uint32_t)0x00008000)
+#define SDIO_FLAG_RXDAVL                   ((uint32_t)0x00200000)
+
+#define SDIO_IT_DCRCFAIL                   SDIO_FLAG_DCRCFAIL
+#define SDIO_IT_DTIMEOUT                   SDIO_FLAG_DTIMEOUT
+#define SDIO_IT_TXUNDERR                   SDIO_FLAG_TXUNDERR
+#define SDIO_IT_RXOVERR                    SDIO_FLAG_RXOVERR
+#define SDIO_IT_DATAEND                    SDIO_FLAG_DATAEND
+#define SDIO_IT_STBITERR                   SDIO_FLAG_STBITERR
+#define SDIO_IT_TXFIFOHE                   SDIO_FLAG_TXFIFOHE
+#define SDIO_IT_RXFIFOHF                   SDIO_FLAG_RXFIFOHF
+
+void       SDIO_DeInit (void);
+void       SDIO_Init (SDIO_InitTypeDef *SDIO_InitStruct);
+void       SDIO_ClockCmd (FunctionalState NewState);
+void       SDIO_SetPowerState (uint32_t SDIO_PowerState);
+uint32_t   SDIO_GetPowerState (void);
+void       SDIO_ITConfig (uint32_t SDIO_IT, FunctionalState NewState);
+void       SDIO_DMACmd (FunctionalState NewState);
+void       SDIO_SendCommand (SDIO_CmdInitTypeDef *SDIO_CmdInitStruct);
+uint8_t    SDIO_GetCommandResponse (void);
+uint32_t   SDIO_GetResponse (uint32_t SDIO_RESP);
+void       SDIO_DataConfig (SDIO_DataInitTypeDef *SDIO_DataInitStruct);
+uint32_t   SDIO_ReadData (void);
+void       SDIO_WriteData (uint32_t Data);
+FlagStatus SDIO_GetFlagStatus (uint32_t SDIO_FLAG);
+void       SDIO_ClearFlag (uint32_t SDIO_FLAG);
+ITStatus   SDIO_GetITStatus (uint32_t SDIO_IT);
+void       SDIO_ClearITPendingBit (uint32_t SDIO_IT);
+
+/* DMA -----------------------------------------------------------------------*/
+typedef struct
+{
+  __IO uint32_t CCR;
+  __IO uint32_t CNDTR;
+  __IO uint32_t CPAR;
+  __IO uint32_t CMAR;
+} DMA_Channel_TypeDef;
+
+extern DMA_Channel_TypeDef DMA2_Channel4_Sim;
+#define DMA2_Channel4                      (&DMA2_Channel4_Sim)
+
+typedef struct
+{
+  uint32_t DMA_PeripheralBaseAddr;
+  uint32_t DMA_MemoryBaseAddr;
+  uint32_t DMA_DIR;
+  uint32_t DMA_BufferSize;
+  uint32_t DMA_PeripheralInc;
+  uint32_t DMA_MemoryInc;
+  uint32_t DMA_PeripheralDataSize;
+  uint32_t DMA_MemoryDataSize;
+  uint32_t DMA_Mode;
+  uint32_t DMA_Priority;
+  uint32_t DMA_M2M;
+} DMA_InitTypeDef;
+
+#define DMA_DIR_PeripheralDST              ((uint32_t)0x00000010)
+#define DMA_DIR_PeripheralSRC              ((uint32_t)0x00000000)
+#define DMA_PeripheralInc_Disable          ((uint32_t)0x00000000)
+#define DMA_MemoryInc_Enable               ((uint32_t)0x00000080)
+#define DMA_PeripheralDataSize_Word        ((uint32_t)0x00000200)
+#define DMA_MemoryDataSize_Word            ((uint32_t)0x00000800)
+#define DMA_Mode_Normal                    ((uint32_t)0x00000000)
+#define DMA_Priority_High                  ((uint32_t)0x00002000)
+#define DMA_M2M_Disable                    ((uint32_t)0x00000000)
+
+#define DMA2_FLAG_GL4                      ((uint32_t)0x10001000)
+#define DMA2_FLAG_TC4                      ((uint32_t)0x10002000)
+#define DMA2_FLAG_HT4                      ((uint32_t)0x10004000)
+#define DMA2_FLAG_TE4                      ((uint32_t)0x10008000)
+
+void       DMA_Init (DMA_Channel_TypeDef *DMAy_Channelx, DMA_InitTypeDef *DMA_InitStruct);
+void       DMA_Cmd (DMA_Channel_TypeDef *DMAy_Channelx, FunctionalState NewState);
+FlagStatus DMA_GetFlagStatus (uint32_t DMAy_FLAG);
+void       DMA_ClearFlag (uint32_t DMAy_FLAG);
+
+/* GPIO and RCC, the pins and clocks have nothing to simulate ----------------*/
+typedef struct
+{
+  uint16_t GPIO_Pin;
+  uint32_t GPIO_Speed;
+  uint32_t GPIO_Mode;
+} GPIO_InitTypeDef;
+
+#define GPIOC                              ((void *)0)
+#define GPIOD                              ((void *)0)
+#define GPIO_Pin_1                         ((uint16_t)0x0002)
+#define GPIO_Pin_2                         ((uint16_t)0x0004)
+#define GPIO_Pin_8                         ((uint16_t)0x0100)
+#define GPIO_Pin_9                         ((uint16_t)0x0200)
+#define GPIO_Pin_10                        ((uint16_t)0x0400)
+#define GPIO_Pin_11                        ((uint16_t)0x0800)
+#define GPIO_Pin_12                        ((uint16_t)0x1000)
+#define GPIO_Speed_50MHz                   3
+#define GPIO_Mode_IN_FLOATING              0x04
+#define GPIO_Mode_IPU                      0x48
+#define GPIO_Mode_AF_PP                    0x18
+
+#define RCC_AHBPeriph_DMA2                 ((uint32_t)0x00000002)
+#define RCC_AHBPeriph_SDIO                 ((uint32_t)0x00000400)
+#define RCC_APB2Periph_GPIOC               ((uint32_t)0x00000010)
+#define RCC_APB2Periph_GPIOD               ((uint32_t)0x00000020)
+
+/* The card is always present */
+#define GPIO_Init(port, init)                 ((void)(port), (void)(init))
+#define GPIO_ReadInputDataBit(port, pin)      ((void)(port), (void)(pin), Bit_RESET)
+#define RCC_AHBPeriphClockCmd(periph, state)  ((void)(periph), (void)(state))
+#define RCC_APB2PeriphClockCmd(periph, state) ((void)(periph), (void)(state))
+
+#endif /* __STM32F10x_H */
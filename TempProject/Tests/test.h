@@ -0,0 +1,28 @@
+/**
+  ******************************************************************************
+  * @file    test.h
+  * @brief   Minimal check macros shared by the host tests
+  ******************************************************************************
+  */
+
+#ifndef __TEST_H
+#define __TEST_H
+
+#include <stdio.h>
+
+static int TestFailures = 0;
+
+#define CHECK(cond)                                                         \
+  do {                                                                      \
+    if (!(cond))                                                            \
+    {                                                                       \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);       \
+      TestFailures++;                                                       \
+    }                                                                       \
+  } while (0)
+
+#define TEST_RESULT()                                                       \
+  (printf("%s: %s\n", __FILE__, TestFailures ? "FAILED" : "passed"),        \
+   TestFailures ? 1 : 0)
+
+#endif /* __TEST_H */
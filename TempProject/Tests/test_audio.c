@@ -0,0 +1,451 @@
+/**
+  ******************************************************************************
+  * @file    test_audio.c
+  * @brief   Host test of the asynchronous feedback of the USB speaker
+  *          (usbd_audio_core.c): a host sending the packets the feedback asks
+  *          for, frame by frame, to a DAC running off the nominal rate. The
+  *          feedback follows the DAC and holds the buffer around its half,
+  *          stays within one sample of the nominal rate, restarts from it
+  *          when the stream stops; the timer trim keeps a host ignoring the
+  *          feedback from running the buffer dry.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "usbd_audio_core.h"
+#include "usbd_ioreq.h"
+#include "usbd_req.h"
+#include "test.h"
+
+#define FB_EP       (AUDIO_FB_EP & 0x7F)
+#define HALF_FILL   (TOTAL_OUT_BUF_SIZE / (2 * AUDIO_OUT_FRAME_SIZE))
+
+/* Timer cycles of one sample period of the DAC trigger */
+#define DAC_PERIOD  1000
+
+extern uint8_t  IsocOutBuff[];
+extern uint32_t IsocOutWrTotal;
+extern uint8_t  AudioFbBuff[];
+extern int32_t  AudioFbTrim;
+
+static USB_CORE_HANDLE Dev;
+
+/* OUT endpoint: where the next packet goes */
+static uint8_t  *RxBuf;
+static uint32_t RxOutside;
+
+/* Feedback endpoint: the buffer armed for the next IN token, NULL once
+   sent, and the IN tokens it was not armed for */
+static uint8_t  *FbTxBuf;
+static uint32_t FbTxLen;
+static uint32_t FbMissed;
+
+/* Host: the feedback it last read, the part of a sample it owes, and
+   whether it ignores the feedback */
+static uint32_t HostFb;
+static double   HostPhase;
+static uint8_t  HostFixed;
+static uint32_t Frames;
+
+/* DAC: the bytes left to the DMA, samples per frame at the nominal period,
+   the timer cycles trimmed and the samples played since the stream started */
+static uint8_t  DacOn;
+static uint32_t DacRem;
+static double   DacRate;
+static double   DacPhase;
+static int32_t  DacTrim;
+static uint32_t DacPlayed;
+
+static uint32_t Pauses;
+
+uint32_t DCD_PMA_Config (USB_CORE_HANDLE *pdev, uint16_t ep_addr, uint16_t ep_kind,
+                         uint32_t pmaadress)
+{
+  return 0;
+}
+
+uint32_t DCD_EP_Open (USB_CORE_HANDLE *pdev, uint16_t ep_addr, uint16_t ep_mps, uint8_t ep_type)
+{
+  return 0;
+}
+
+uint32_t DCD_EP_Close (USB_CORE_HANDLE *pdev, uint8_t ep_addr)
+{
+  return 0;
+}
+
+/* Each packet is received where the class says, within its buffer */
+uint32_t DCD_EP_PrepareRx (USB_CORE_HANDLE *pdev, uint8_t ep_addr, uint8_t *pbuf, uint16_t buf_len)
+{
+  if ((pbuf < IsocOutBuff) || (pbuf + buf_len > IsocOutBuff + TOTAL_OUT_BUF_SIZE + AUDIO_OUT_MPS))
+  {
+    RxOutside++;
+  }
+  RxBuf = pbuf;
+  return 0;
+}
+
+uint32_t DCD_EP_Tx (USB_CORE_HANDLE *pdev, uint8_t ep_addr, uint8_t *pbuf, uint32_t buf_len)
+{
+  if (ep_addr == AUDIO_FB_EP)
+  {
+    FbTxBuf = pbuf;
+    FbTxLen = buf_len;
+  }
+  return 0;
+}
+
+/* Control transfers, not reached by the stream */
+USBD_Status USBD_CtlSendData (USB_CORE_HANDLE *pdev, uint8_t *buf, uint16_t len)
+{
+  return USBD_OK;
+}
+
+USBD_Status USBD_CtlPrepareRx (USB_CORE_HANDLE *pdev, uint8_t *pbuf, uint16_t len)
+{
+  return USBD_OK;
+}
+
+void USBD_CtlError (USB_CORE_HANDLE *pdev, USB_SETUP_REQ *req)
+{
+}
+
+void STM_EVAL_LEDToggle (Led_TypeDef Led)
+{
+}
+
+/* The samples themselves do not matter here */
+void WAVADDON_Init (uint32_t NChannelBitsSample, uint32_t Option)
+{
+}
+
+void WAVADDON_AudioProcessing (void *pBuffer, uint32_t BufferSize)
+{
+}
+
+static uint8_t Out_Init (uint32_t AudioFreq, uint32_t Volume, uint32_t options)
+{
+  return AUDIO_OK;
+}
+
+static uint8_t Out_DeInit (void)
+{
+  return AUDIO_OK;
+}
+
+/* Play starts the DMA on one packet, pause stops it and the stream */
+static uint8_t Out_AudioCmd (uint8_t *pbuf, uint32_t size, uint8_t cmd)
+{
+  if (cmd == AUDIO_CMD_PLAY)
+  {
+    DacOn = 1;
+    DacRem = size;
+  }
+  else
+  {
+    DacOn = 0;
+    DacPlayed = 0;
+    Pauses++;
+  }
+  return AUDIO_OK;
+}
+
+static uint8_t Out_MuteCtl (uint8_t cmd)
+{
+  return AUDIO_OK;
+}
+
+AUDIO_FOPS_TypeDef AUDIO_OUT_fops =
+{
+  Out_Init, Out_DeInit, Out_AudioCmd, NULL, Out_MuteCtl, NULL, NULL, NULL, NULL
+};
+
+uint32_t Audio_MAL_GetRemBytes (void)
+{
+  return DacRem;
+}
+
+/* Positive, shorter periods of the DAC trigger: a higher rate */
+uint32_t EVAL_AUDIO_SamplingRateTrimm (int32_t Cycles)
+{
+  DacTrim += Cycles;
+  return 0;
+}
+
+static uint32_t Fb_Value (const uint8_t *buf)
+{
+  return buf[0] | (buf[1] << 8) | ((uint32_t)buf[2] << 16);
+}
+
+/* Samples per frame */
+static double Fb_Samples (uint32_t fb)
+{
+  return fb / 16384.0;
+}
+
+/* One frame: the SOF, the packet of the host copied to the buffer as the
+   driver does from the PMA, the feedback read every 2^AUDIO_FB_REFRESH
+   frames, then the samples the DAC plays meanwhile */
+static void Audio_Frame (uint8_t send)
+{
+  uint32_t n, step;
+  uint8_t  *pbuf;
+  uint32_t size;
+
+  AUDIO_cb.SOF(&Dev);
+
+  if (send)
+  {
+    HostPhase += Fb_Samples(HostFb);
+    n = (uint32_t)HostPhase;
+    HostPhase -= n;
+    memset(RxBuf, 0x55, n * AUDIO_OUT_FRAME_SIZE);
+    Dev.dev.out_ep[AUDIO_OUT_EP].xfer_count = n * AUDIO_OUT_FRAME_SIZE;
+    AUDIO_cb.DataOut(&Dev, AUDIO_OUT_EP);
+  }
+
+  if ((++Frames % (1 << AUDIO_FB_REFRESH)) == 0)
+  {
+    if (FbTxBuf == NULL)
+    {
+      FbMissed++;
+    }
+    else
+    {
+      if (!HostFixed)
+      {
+        HostFb = Fb_Value(FbTxBuf);
+      }
+      FbTxBuf = NULL;
+      AUDIO_cb.DataIn(&Dev, FB_EP);
+    }
+  }
+
+  DacPhase += DacRate * DAC_PERIOD / (DAC_PERIOD - DacTrim);
+  n = (uint32_t)DacPhase;
+  DacPhase -= n;
+  while (DacOn && (n != 0))
+  {
+    step = DacRem / AUDIO_OUT_FRAME_SIZE;
+    if (step > n)
+    {
+      step = n;
+    }
+    DacRem -= step * AUDIO_OUT_FRAME_SIZE;
+    DacPlayed += step;
+    n -= step;
+    if (DacRem == 0)
+    {
+      usbd_audio_BuffXferCplt(&pbuf, &size);
+    }
+  }
+}
+
+/* After the stream of the former test has stopped */
+static void Audio_Start (double rate, uint8_t fixed)
+{
+  uint32_t i;
+
+  for (i = 0; DacOn && (i < 1000); i++)
+  {
+    Audio_Frame(0);
+  }
+  HostFb = AUDIO_FB_NOMINAL;
+  HostPhase = 0;
+  HostFixed = fixed;
+  Frames = 0;
+  DacOn = 0;
+  DacRem = 0;
+  DacRate = rate;
+  DacPhase = 0;
+  DacTrim = 0;
+  DacPlayed = 0;
+  Pauses = 0;
+  RxOutside = 0;
+  FbTxBuf = NULL;
+  FbMissed = 0;
+  CHECK(AUDIO_cb.Init(&Dev, 0) == USBD_OK);
+  CHECK((FbTxBuf == AudioFbBuff) && (FbTxLen == AUDIO_FB_PACKET));
+  CHECK(Fb_Value(AudioFbBuff) == AUDIO_FB_NOMINAL);
+}
+
+/* Samples received and not played yet */
+static int32_t Audio_Fill (void)
+{
+  return (int32_t)(IsocOutWrTotal / AUDIO_OUT_FRAME_SIZE) - (int32_t)DacPlayed;
+}
+
+/* Runs the stream for some seconds, the fill within +/- margin samples of
+   the half of the buffer over the last one */
+static int Audio_Run (uint32_t seconds, int32_t margin)
+{
+  uint32_t i;
+  int ok = 1;
+
+  for (i = 0; i < seconds * 1000; i++)
+  {
+    Audio_Frame(1);
+    if ((i >= (seconds - 1) * 1000) && DacOn &&
+        ((Audio_Fill() < (int32_t)HALF_FILL - margin) || (Audio_Fill() > (int32_t)HALF_FILL + margin)))
+    {
+      ok = 0;
+    }
+  }
+  if (!ok)
+  {
+    printf("fill %d samples, feedback %f\n", Audio_Fill(), Fb_Samples(HostFb));
+  }
+  return ok;
+}
+
+static void Test_Nominal (void)
+{
+  uint32_t i;
+
+  Audio_Start(48.0, 0);
+  CHECK(Audio_Run(10, 48));
+  CHECK(DacOn && (Pauses == 0));
+  CHECK(RxOutside == 0);
+  CHECK(FbMissed == 0);
+  CHECK(DacTrim == 0);
+  CHECK((HostFb > AUDIO_FB_NOMINAL - 164) && (HostFb < AUDIO_FB_NOMINAL + 164));
+
+  /* 20 packets lost: the fill goes back to the half */
+  for (i = 0; i < 20; i++)
+  {
+    Audio_Frame(0);
+  }
+  CHECK(Audio_Fill() < (int32_t)HALF_FILL - 20 * 48 + 48);
+  CHECK(Audio_Run(10, 48));
+  CHECK(DacOn && (Pauses == 0));
+}
+
+/* The feedback settles on the DAC rate, 0.1% off either way */
+static void Test_Drift (void)
+{
+  uint32_t i;
+
+  Audio_Start(48.048, 0);
+  CHECK(Audio_Run(20, 48));
+  CHECK(DacOn && (Pauses == 0));
+  CHECK(RxOutside == 0);
+  CHECK(DacTrim == 0);
+  CHECK((Fb_Samples(HostFb) > 48.048 - 0.01) && (Fb_Samples(HostFb) < 48.048 + 0.01));
+
+  Audio_Start(47.952, 0);
+  CHECK(Audio_Run(20, 48));
+  CHECK(DacOn && (Pauses == 0));
+  CHECK(RxOutside == 0);
+  CHECK(DacTrim == 0);
+  CHECK((Fb_Samples(HostFb) > 47.952 - 0.01) && (Fb_Samples(HostFb) < 47.952 + 0.01));
+  CHECK(FbMissed == 0);
+
+  /* The stream stops, the feedback is back to nominal */
+  CHECK(Fb_Value(AudioFbBuff) != AUDIO_FB_NOMINAL);
+  for (i = 0; i < 200; i++)
+  {
+    Audio_Frame(0);
+  }
+  CHECK(!DacOn && (Pauses == 1));
+  CHECK(Fb_Value(AudioFbBuff) == AUDIO_FB_NOMINAL);
+}
+
+/* Never more than a sample off the nominal rate, whatever the DAC does */
+static void Test_Range (void)
+{
+  uint32_t i;
+  uint32_t min = AUDIO_FB_NOMINAL, max = AUDIO_FB_NOMINAL;
+
+  Audio_Start(50.0, 0);
+  for (i = 0; i < 5000; i++)
+  {
+    Audio_Frame(1);
+    max = (HostFb > max) ? HostFb : max;
+  }
+  CHECK(max == AUDIO_FB_NOMINAL + AUDIO_FB_RANGE);
+
+  Audio_Start(46.0, 0);
+  for (i = 0; i < 5000; i++)
+  {
+    Audio_Frame(1);
+    min = (HostFb < min) ? HostFb : min;
+  }
+  CHECK(min == AUDIO_FB_NOMINAL - AUDIO_FB_RANGE);
+  CHECK(RxOutside == 0);
+}
+
+/* A host sending 48 samples a frame whatever the feedback: the DAC is
+   slowed down by one timer cycle before the buffer runs dry */
+static void Test_Trim (void)
+{
+  uint32_t i;
+  int32_t  low = 0, high = 0;
+
+  Audio_Start(48.024, 1);
+  for (i = 0; i < 120000; i++)
+  {
+    Audio_Frame(1);
+    low = (DacTrim < low) ? DacTrim : low;
+  }
+  CHECK(low == -1);
+  CHECK(DacOn && (Pauses == 0));
+  CHECK(Audio_Fill() > (int32_t)HALF_FILL / 8);
+  CHECK(DacTrim == AudioFbTrim);
+
+  /* And sped up before it overflows */
+  Audio_Start(47.976, 1);
+  for (i = 0; i < 120000; i++)
+  {
+    Audio_Frame(1);
+    high = (DacTrim > high) ? DacTrim : high;
+  }
+  CHECK(high == 1);
+  CHECK(DacOn && (Pauses == 0));
+  CHECK(Audio_Fill() < (int32_t)(HALF_FILL * 15) / 8);
+  CHECK(DacTrim == AudioFbTrim);
+  CHECK(RxOutside == 0);
+}
+
+/* The stream stops: the DAC pauses, the feedback and the trim go back to
+   nominal for the next one */
+static void Test_Stop (void)
+{
+  uint32_t i;
+
+  Audio_Start(48.024, 1);
+  for (i = 0; (DacTrim == 0) && (i < 120000); i++)
+  {
+    Audio_Frame(1);
+  }
+  CHECK(DacTrim != 0);
+  for (i = 0; i < 200; i++)
+  {
+    Audio_Frame(0);
+  }
+  CHECK(!DacOn && (Pauses == 1));
+  CHECK(DacTrim == 0);
+  CHECK(Fb_Value(AudioFbBuff) == AUDIO_FB_NOMINAL);
+
+  /* The next stream buffers half of the packets again, played from the
+     SOF after */
+  HostFixed = 0;
+  for (i = 0; i < OUT_PACKET_NUM / 2; i++)
+  {
+    Audio_Frame(1);
+  }
+  CHECK(!DacOn);
+  Audio_Frame(1);
+  CHECK(DacOn);
+  CHECK(Audio_Run(5, 48));
+  CHECK(Pauses == 1);
+}
+
+int main (void)
+{
+  Test_Nominal();
+  Test_Drift();
+  Test_Range();
+  Test_Trim();
+  Test_Stop();
+  return TEST_RESULT();
+}
@@ -0,0 +1,247 @@
+/**
+  ******************************************************************************
+  * @file    test_cdc.c
+  * @brief   Host test of the CDC data pipes of usbd_cdc_core.c, fed by the
+  *          telemetry interface, on the endpoints of usb_dcd.c and the
+  *          simulated peripheral of usb_sim.c: the IN ring across its wrap,
+  *          the batches and their chaining, the zero-length packets, the
+  *          OUT data received straight into a consumer buffer, and the
+  *          telemetry stream dropping what does not fit.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "usbd_cdc_core.h"
+#include "usbd_cdc_telemetry.h"
+#include "usbd_ioreq.h"
+#include "usbd_req.h"
+#include "usb_dcd_int.h"
+#include "test.h"
+
+#define CDC_IN    (CDC_IN_EP & 0x7F)
+#define CDC_OUT   (CDC_OUT_EP & 0x7F)
+#define MPS       CDC_DATA_MAX_PACKET_SIZE
+
+USB_CORE_HANDLE  USB_Device_dev;
+
+extern uint8_t  APP_Rx_Buffer[];
+extern __IO uint32_t APP_Rx_ptr_in;
+extern __IO uint32_t APP_Rx_ptr_out;
+
+static uint8_t   Src[2 * APP_RX_DATA_SIZE];
+static uint8_t   Dst[2 * APP_RX_DATA_SIZE];
+
+/* Packets of the last Host_Read */
+static uint16_t  PktLen[64];
+static uint32_t  PktNbr;
+
+static uint8_t Dev_DataIn (USB_CORE_HANDLE *pdev, uint8_t epnum)
+{
+  return USBD_CDC_cb.DataIn(pdev, epnum);
+}
+
+static uint8_t Dev_DataOut (USB_CORE_HANDLE *pdev, uint8_t epnum)
+{
+  return USBD_CDC_cb.DataOut(pdev, epnum);
+}
+
+static uint8_t Dev_None (USB_CORE_HANDLE *pdev)
+{
+  return 0;
+}
+
+static USBD_DCD_INT_cb_TypeDef Dev_cb =
+{
+  Dev_DataOut, Dev_DataIn, Dev_None, Dev_None, Dev_None, Dev_None, Dev_None
+};
+
+USBD_DCD_INT_cb_TypeDef *USBD_DCD_INT_fops = &Dev_cb;
+
+/* Control transfers and power management, not reached by the data pipes */
+USBD_Status USBD_CtlSendData (USB_CORE_HANDLE *pdev, uint8_t *buf, uint16_t len)
+{
+  return USBD_OK;
+}
+
+USBD_Status USBD_CtlPrepareRx (USB_CORE_HANDLE *pdev, uint8_t *pbuf, uint16_t len)
+{
+  return USBD_OK;
+}
+
+void USBD_CtlError (USB_CORE_HANDLE *pdev, USB_SETUP_REQ *req)
+{
+}
+
+void Suspend (void)
+{
+}
+
+void Resume (RESUME_STATE eResumeSetVal)
+{
+}
+
+/* Configure the device: the CDC endpoints are opened with the PMA map of
+   usb_conf.h, the IN ring keeps its indexes */
+static void Dev_Configure (void)
+{
+  uint32_t i;
+
+  USB_SimReset();
+  memset(&USB_Device_dev, 0, sizeof(USB_Device_dev));
+  USB_Device_dev.dev.device_status = USB_CONFIGURED;
+  USBD_CDC_cb.Init(&USB_Device_dev, 0);
+  memset(&CDC_Stats, 0, sizeof(CDC_Stats));
+  for (i = 0; i < sizeof(Src); i++)
+  {
+    Src[i] = (uint8_t)(i * 13 + 5);
+  }
+}
+
+/* Read IN packets until the device NAKs */
+static uint32_t Host_Read (uint8_t *buf)
+{
+  uint32_t got = 0;
+  int n;
+
+  PktNbr = 0;
+  while ((n = USB_SimIn(CDC_IN, &buf[got])) >= 0)
+  {
+    PktLen[PktNbr++] = (uint16_t)n;
+    got += n;
+    CTR();
+  }
+  return got;
+}
+
+static void Test_Ring (void)
+{
+  uint32_t len, sent = 0;
+
+  Dev_Configure();
+
+  /* Writes of all sizes, the ring wraps several times */
+  for (len = 1; len < 300; len += 37)
+  {
+    CHECK(TELEMETRY_Write(&Src[sent % APP_RX_DATA_SIZE], len) == len);
+    CHECK(Host_Read(Dst) == len);
+    CHECK(memcmp(Dst, &Src[sent % APP_RX_DATA_SIZE], len) == 0);
+    sent += len;
+  }
+  CHECK(APP_Rx_ptr_out == APP_Rx_ptr_in);
+  CHECK(CDC_Stats.TxBytes == sent);
+  CHECK(APP_Rx_ptr_in > APP_RX_DATA_SIZE);
+}
+
+static void Test_Batch (void)
+{
+  static const uint16_t chained[] = {10, MPS, MPS, MPS, MPS, MPS, MPS, 6};
+  uint32_t i;
+
+  Dev_Configure();
+
+  /* The first write starts a transfer, what is written meanwhile follows
+     in batches of up to CDC_IN_BATCH_SIZE chained from the IN completion,
+     without a zero-length packet between them */
+  CHECK(TELEMETRY_Write(Src, 10) == 10);
+  CHECK(TELEMETRY_Write(Src + 10, 390) == 390);
+  CHECK(Host_Read(Dst) == 400);
+  CHECK(memcmp(Dst, Src, 400) == 0);
+  CHECK(PktNbr == sizeof(chained) / sizeof(chained[0]));
+  for (i = 0; (i < PktNbr) && (i < sizeof(chained) / sizeof(chained[0])); i++)
+  {
+    CHECK(PktLen[i] == chained[i]);
+  }
+
+  /* Data ending on a full packet is followed by a zero-length packet */
+  CHECK(TELEMETRY_Write(Src, 1) == 1);
+  CHECK(TELEMETRY_Write(Src + 1, 2 * MPS) == 2 * MPS);
+  CHECK(Host_Read(Dst) == 2 * MPS + 1);
+  CHECK(PktNbr == 4);
+  CHECK(PktLen[1] == MPS);
+  CHECK(PktLen[2] == MPS);
+  CHECK(PktLen[3] == 0);
+
+  /* Data queued without a kick is sent at the SOF interval */
+  APP_Rx_Buffer[APP_Rx_ptr_in & APP_RX_DATA_MASK] = 0x5A;
+  APP_Rx_ptr_in++;
+  CHECK(Host_Read(Dst) == 0);
+  for (i = 0; i <= CDC_IN_FRAME_INTERVAL; i++)
+  {
+    USBD_CDC_cb.SOF(&USB_Device_dev);
+  }
+  CHECK(Host_Read(Dst) == 1);
+  CHECK(Dst[0] == 0x5A);
+}
+
+static void Test_RxUser (void)
+{
+  static uint8_t buf[2 * MPS];
+
+  Dev_Configure();
+
+  /* Without a consumer buffer every packet goes through USB_Rx_Buffer */
+  CHECK(USB_SimOut(CDC_OUT, Src, MPS) == MPS);
+  CTR();
+  CHECK(USB_SimOut(CDC_OUT, Src, 20) == 20);
+  CTR();
+  CHECK(CDC_Stats.RxBytes == MPS + 20);
+
+  CHECK(usbd_cdc_PrepareRx(&USB_Device_dev, buf, MPS + 1) == USBD_FAIL);
+  CHECK(usbd_cdc_PrepareRx(&USB_Device_dev, buf, sizeof(buf)) == USBD_OK);
+  CHECK(usbd_cdc_PrepareRx(&USB_Device_dev, buf, sizeof(buf)) == USBD_FAIL);
+
+  /* Received in place; once full the host is held off until the next
+     buffer, the double buffered endpoint keeps one packet meanwhile */
+  CHECK(USB_SimOut(CDC_OUT, Src + 100, MPS) == MPS);
+  CTR();
+  CHECK(USB_SimOut(CDC_OUT, Src + 100 + MPS, MPS) == MPS);
+  CTR();
+  CHECK(memcmp(buf, Src + 100, 2 * MPS) == 0);
+  CHECK(CDC_Stats.RxBytes == 3 * MPS + 20);
+
+  CHECK(USB_SimOut(CDC_OUT, Src + 300, 7) == 7);
+  CTR();
+  CHECK(USB_SimOut(CDC_OUT, Src, MPS) < 0);
+  CHECK(CDC_Stats.RxBytes == 3 * MPS + 20);
+
+  /* The next buffer gets the packet held, a short packet completes it */
+  memset(buf, 0, sizeof(buf));
+  CHECK(usbd_cdc_PrepareRx(&USB_Device_dev, buf, sizeof(buf)) == USBD_OK);
+  CHECK(CDC_Stats.RxBytes == 3 * MPS + 27);
+  CHECK(memcmp(buf, Src + 300, 7) == 0);
+}
+
+static void Test_Telemetry (void)
+{
+  static uint8_t coding[7] = {0x80, 0x25, 0x00, 0x00, 0x00, 0x00, 0x08};
+  uint8_t get[7];
+
+  Dev_Configure();
+
+  /* A full ring drops the excess and counts it, never blocks */
+  CHECK(TELEMETRY_Write(Src, 1) == 1);
+  CHECK(TELEMETRY_Write(Src + 1, APP_RX_DATA_SIZE) == APP_RX_DATA_SIZE - 1);
+  CHECK(CDC_Stats.TxOverrun == 1);
+  CHECK(TELEMETRY_Print("lost") == 0);
+  CHECK(CDC_Stats.TxOverrun == 5);
+  CHECK(Host_Read(Dst) == APP_RX_DATA_SIZE);
+  CHECK(memcmp(Dst, Src, APP_RX_DATA_SIZE) == 0);
+
+  CHECK(TELEMETRY_Print("000001   +024.5 C\r\n") == 19);
+  CHECK(Host_Read(Dst) == 19);
+  CHECK(memcmp(Dst, "000001   +024.5 C\r\n", 19) == 0);
+
+  /* The line coding is only stored and reported back */
+  TELEMETRY_fops.pIf_Ctrl(SET_LINE_CODING, coding, sizeof(coding));
+  TELEMETRY_fops.pIf_Ctrl(GET_LINE_CODING, get, sizeof(get));
+  CHECK(memcmp(get, coding, sizeof(coding)) == 0);
+}
+
+int main (void)
+{
+  Test_Ring();
+  Test_Batch();
+  Test_RxUser();
+  Test_Telemetry();
+  return TEST_RESULT();
+}
@@ -0,0 +1,246 @@
+/**
+  ******************************************************************************
+  * @file    test_dcd.c
+  * @brief   Host test of the endpoint state machine of usb_dcd.c and
+  *          usb_dcd_int.c on the simulated peripheral of usb_sim.c: double
+  *          buffered bulk IN and OUT transfers with the PMA map of usb_conf.h,
+  *          a ring buffer wrap, a packet received before the transfer is
+  *          armed, a stall cleared with a packet pending, and the
+  *          isochronous IN buffers selected by DTOG_TX.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "usb_dcd.h"
+#include "usb_dcd_int.h"
+#include "usbd_conf.h"
+#include "audio_app_conf.h"
+#include "test.h"
+
+#define MPS       64
+
+USB_CORE_HANDLE  USB_Device_dev;
+
+static uint32_t  InDone, OutDone;
+static uint8_t   Src[512];
+static uint8_t   Dst[512];
+static uint8_t   Pkt[MPS];
+
+static uint8_t Dev_DataIn (USB_CORE_HANDLE *pdev, uint8_t epnum)
+{
+  InDone++;
+  return 0;
+}
+
+static uint8_t Dev_DataOut (USB_CORE_HANDLE *pdev, uint8_t epnum)
+{
+  OutDone++;
+  return 0;
+}
+
+static uint8_t Dev_None (USB_CORE_HANDLE *pdev)
+{
+  return 0;
+}
+
+static USBD_DCD_INT_cb_TypeDef Dev_cb =
+{
+  Dev_DataOut, Dev_DataIn, Dev_None, Dev_None, Dev_None, Dev_None, Dev_None
+};
+
+USBD_DCD_INT_cb_TypeDef *USBD_DCD_INT_fops = &Dev_cb;
+
+/* Power management of usbd_pwr.c, not reached by CTR() */
+void Suspend (void)
+{
+}
+
+void Resume (RESUME_STATE eResumeSetVal)
+{
+}
+
+static void Dev_Open (uint8_t ep_addr, uint8_t type, uint16_t kind,
+                      uint32_t pmaadress, uint16_t mps)
+{
+  DCD_PMA_Config(&USB_Device_dev, ep_addr, kind, pmaadress);
+  DCD_EP_Open(&USB_Device_dev, ep_addr, mps, type);
+}
+
+static void Dev_Reset (void)
+{
+  uint32_t i;
+
+  USB_SimReset();
+  memset(&USB_Device_dev, 0, sizeof(USB_Device_dev));
+  memset(Dst, 0, sizeof(Dst));
+  InDone = 0;
+  OutDone = 0;
+  for (i = 0; i < sizeof(Src); i++)
+  {
+    Src[i] = (uint8_t)(i * 7 + 1);
+  }
+}
+
+/* Read the packets of one IN transfer: each is ready as soon as the CTR
+   interrupt of the previous one has run, not before */
+static uint32_t Host_In (uint8_t ep, uint8_t *buf, uint32_t npkt)
+{
+  uint32_t got = 0;
+  uint32_t i;
+  int n;
+
+  for (i = 0; (i < npkt) && (InDone == 0); i++)
+  {
+    n = USB_SimIn(ep, &buf[got]);
+    CHECK(n >= 0);
+    if (n < 0)
+    {
+      break;
+    }
+    got += n;
+    CHECK(USB_SimIn(ep, Pkt) < 0);
+    CTR();
+  }
+  CHECK(InDone == 1);
+  CHECK(i == npkt);
+  return got;
+}
+
+static void Test_BulkIn (void)
+{
+  Dev_Reset();
+  Dev_Open(MSC_IN_EP, USB_EP_BULK, BULK_EP_KIND, MSC_IN_TX_ADDRESS, MPS);
+  CHECK(USB_SimIn(MSC_IN_EP & 0x7F, Pkt) < 0);
+
+  /* 3 full packets and a short one */
+  DCD_EP_Tx(&USB_Device_dev, MSC_IN_EP, Src, 200);
+  CHECK(Host_In(MSC_IN_EP & 0x7F, Dst, 4) == 200);
+  CHECK(memcmp(Dst, Src, 200) == 0);
+  CHECK(USB_SimIn(MSC_IN_EP & 0x7F, Pkt) < 0);
+
+  /* The next transfers start from the buffer the last one left off */
+  InDone = 0;
+  DCD_EP_Tx(&USB_Device_dev, MSC_IN_EP, Src + 13, MPS);
+  CHECK(Host_In(MSC_IN_EP & 0x7F, Dst, 1) == MPS);
+  CHECK(memcmp(Dst, Src + 13, MPS) == 0);
+
+  InDone = 0;
+  DCD_EP_Tx(&USB_Device_dev, MSC_IN_EP, Src, 0);
+  CHECK(Host_In(MSC_IN_EP & 0x7F, Dst, 1) == 0);
+
+  InDone = 0;
+  DCD_EP_Tx(&USB_Device_dev, MSC_IN_EP, Src + 1, 2 * MPS);
+  CHECK(Host_In(MSC_IN_EP & 0x7F, Dst, 2) == 2 * MPS);
+  CHECK(memcmp(Dst, Src + 1, 2 * MPS) == 0);
+}
+
+static void Test_BulkInRing (void)
+{
+  Dev_Reset();
+  Dev_Open(MSC_IN_EP, USB_EP_BULK, BULK_EP_KIND, MSC_IN_TX_ADDRESS, MPS);
+
+  /* 150 bytes from the last 56 of a 256 bytes ring: the second packet is
+     gathered across the wrap */
+  DCD_EP_TxRing(&USB_Device_dev, MSC_IN_EP, Src + 200, 150, Src, 256);
+  CHECK(Host_In(MSC_IN_EP & 0x7F, Dst, 3) == 150);
+  CHECK(memcmp(Dst, Src + 200, 56) == 0);
+  CHECK(memcmp(Dst + 56, Src, 94) == 0);
+}
+
+static void Test_BulkOut (void)
+{
+  uint8_t ep = MSC_OUT_EP;
+  uint32_t sent;
+  int n;
+
+  Dev_Reset();
+  Dev_Open(MSC_OUT_EP, USB_EP_BULK, BULK_EP_KIND, MSC_OUT_RX_ADDRESS, MPS);
+
+  /* A packet before the transfer is armed stays in the PMA, the SIE NAKs
+     the next one */
+  CHECK(USB_SimOut(ep, Src, MPS) == MPS);
+  CTR();
+  CHECK(USB_SimOut(ep, Src + MPS, MPS) < 0);
+  CHECK(OutDone == 0);
+
+  DCD_EP_PrepareRx(&USB_Device_dev, MSC_OUT_EP, Dst, 200);
+  CHECK(USB_Device_dev.dev.out_ep[ep].xfer_count == MPS);
+
+  for (sent = MPS; sent < 200; sent += n)
+  {
+    n = USB_SimOut(ep, Src + sent, (200 - sent > MPS) ? MPS : 200 - sent);
+    CHECK(n > 0);
+    if (n <= 0)
+    {
+      break;
+    }
+    CTR();
+  }
+  CHECK(OutDone == 1);
+  CHECK(USB_Device_dev.dev.out_ep[ep].xfer_count == 200);
+  CHECK(memcmp(Dst, Src, 200) == 0);
+
+  /* The first packet of the next transfer is taken in meanwhile */
+  CHECK(USB_SimOut(ep, Src + 300, 31) == 31);
+  CTR();
+  CHECK(OutDone == 1);
+  DCD_EP_PrepareRx(&USB_Device_dev, MSC_OUT_EP, Dst, MPS);
+  CHECK(OutDone == 2);
+  CHECK(USB_Device_dev.dev.out_ep[ep].xfer_count == 31);
+  CHECK(memcmp(Dst, Src + 300, 31) == 0);
+}
+
+static void Test_BulkOutStall (void)
+{
+  uint8_t ep = MSC_OUT_EP;
+
+  Dev_Reset();
+  Dev_Open(MSC_OUT_EP, USB_EP_BULK, BULK_EP_KIND, MSC_OUT_RX_ADDRESS, MPS);
+
+  /* Clearing the stall drops the packet pending in the PMA */
+  CHECK(USB_SimOut(ep, Src, MPS) == MPS);
+  CTR();
+  DCD_EP_Stall(&USB_Device_dev, MSC_OUT_EP);
+  CHECK(USB_SimOut(ep, Src, MPS) < 0);
+  DCD_EP_ClrStall(&USB_Device_dev, MSC_OUT_EP);
+
+  CHECK(USB_SimOut(ep, Src + 100, 13) == 13);
+  CTR();
+  DCD_EP_PrepareRx(&USB_Device_dev, MSC_OUT_EP, Dst, MPS);
+  CHECK(OutDone == 1);
+  CHECK(USB_Device_dev.dev.out_ep[ep].xfer_count == 13);
+  CHECK(memcmp(Dst, Src + 100, 13) == 0);
+}
+
+static void Test_IsoIn (void)
+{
+  uint8_t fb[3];
+  uint32_t frame;
+
+  Dev_Reset();
+  Dev_Open(0x82, USB_EP_ISOC, USB_SNG_BUF, Audio_FB_TX_ADRESS, 3);
+
+  /* DTOG_TX toggles every frame, each of the two buffers it selects holds
+     the packet */
+  for (frame = 0; frame < 4; frame++)
+  {
+    fb[0] = (uint8_t)frame;
+    fb[1] = (uint8_t)(frame + 0x10);
+    fb[2] = (uint8_t)(frame + 0x20);
+    DCD_EP_Tx(&USB_Device_dev, 0x82, fb, 3);
+    CHECK(USB_SimIn(2, Pkt) == 3);
+    CHECK(memcmp(Pkt, fb, 3) == 0);
+    CTR();
+    CHECK(InDone == frame + 1);
+  }
+}
+
+int main (void)
+{
+  Test_BulkIn();
+  Test_BulkInRing();
+  Test_BulkOut();
+  Test_BulkOutStall();
+  Test_IsoIn();
+  return TEST_RESULT();
+}
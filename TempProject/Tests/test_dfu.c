@@ -0,0 +1,321 @@
+/**
+  ******************************************************************************
+  * @file    test_dfu.c
+  * @brief   Host test of the DFU media job queue (usbd_dfu_mal.c) on a
+  *          simulated internal flash: the download buffers, the write steps
+  *          of MAL_Process, the page erased ahead of the host, the poll
+  *          timeouts of MAL_GetStatus, the errors, and a step requested from
+  *          the interrupt while the main loop programs the flash.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "usbd_dfu_mal.h"
+#include "test.h"
+
+#define FLASH_BASE_ADD   0x08000000
+#define PAGE_SIZE        2048
+#define PAGE_NBR         ((FLASH_END_ADD - FLASH_BASE_ADD) / PAGE_SIZE)
+#define PAGE_ADD(n)      (APP_DEFAULT_ADD + (n) * PAGE_SIZE)
+
+#define ERASE_TIME       40   /* ms per page */
+#define WRITE_TIME       31   /* ms per 1024 bytes */
+
+/* Simulated flash -----------------------------------------------------------*/
+static uint8_t   Flash[FLASH_END_ADD - FLASH_BASE_ADD];
+static uint32_t  EraseCount[PAGE_NBR];
+static uint32_t  EraseCalls;
+static uint32_t  WriteCalls;
+static uint32_t  FailAdd;          /* Write or erase failing at this address */
+static uint8_t   NestedStep;       /* Ask for a step while writing */
+static uint8_t   NestedResult;
+
+static uint16_t Sim_Init (void)
+{
+  return MAL_OK;
+}
+
+static uint16_t Sim_Erase (uint32_t Add)
+{
+  uint32_t page = (Add - FLASH_BASE_ADD) / PAGE_SIZE;
+
+  if (Add == FailAdd)
+  {
+    return MAL_FAIL;
+  }
+  EraseCalls++;
+  EraseCount[page]++;
+  memset(&Flash[page * PAGE_SIZE], 0xFF, PAGE_SIZE);
+  return MAL_OK;
+}
+
+/* Programming only clears bits: data over a page not erased is wrong */
+static uint16_t Sim_Write (uint32_t Add, uint8_t *Buf, uint32_t Len)
+{
+  uint32_t i;
+
+  WriteCalls++;
+  if (NestedStep)
+  {
+    NestedStep = 0;
+    NestedResult = MAL_Process();
+  }
+  if ((FailAdd >= Add) && (FailAdd < Add + Len))
+  {
+    return MAL_FAIL;
+  }
+  for (i = 0; i < Len; i++)
+  {
+    Flash[Add - FLASH_BASE_ADD + i] &= Buf[i];
+  }
+  return MAL_OK;
+}
+
+static uint8_t *Sim_Read (uint32_t Add, uint32_t Len)
+{
+  return &Flash[Add - FLASH_BASE_ADD];
+}
+
+static uint16_t Sim_CheckAdd (uint32_t Add)
+{
+  return ((Add >= FLASH_BASE_ADD) && (Add < FLASH_END_ADD)) ? MAL_OK : MAL_FAIL;
+}
+
+DFU_MAL_Prop_TypeDef DFU_Flash_cb =
+{
+  (uint8_t *)"@Internal Flash",
+  Sim_Init,
+  Sim_Init,
+  Sim_Erase,
+  Sim_Write,
+  Sim_Read,
+  Sim_CheckAdd,
+  ERASE_TIME,
+  WRITE_TIME
+};
+
+/* Helpers -------------------------------------------------------------------*/
+static uint8_t Block[PAGE_SIZE];
+
+/* Run the queued jobs, a job that never completes fails the test rather
+   than hanging it */
+static uint32_t Dfu_Flush (void)
+{
+  uint32_t steps;
+
+  for (steps = 0; (steps < 1000) && (MAL_Process() != 0); steps++)
+  {
+  }
+  CHECK(steps < 1000);
+  return (steps < 1000) ? MAL_Flush() : 1;
+}
+
+static void Dfu_Reset (void)
+{
+  memset(Flash, 0x00, sizeof(Flash));
+  memset(EraseCount, 0, sizeof(EraseCount));
+  EraseCalls = 0;
+  WriteCalls = 0;
+  FailAdd = 0;
+  Dfu_Flush();
+  MAL_Init();
+}
+
+static void Block_Fill (uint32_t seed)
+{
+  uint32_t i;
+
+  for (i = 0; i < PAGE_SIZE; i++)
+  {
+    Block[i] = (uint8_t)(i * 3 + seed);
+  }
+}
+
+/* Download a block as the DFU core does: into the buffer given by
+   MAL_GetBuffer, then queued */
+static uint16_t Dfu_Download (uint32_t Add, uint32_t Len)
+{
+  uint8_t *buf = MAL_GetBuffer();
+
+  if (buf == NULL)
+  {
+    return MAL_FAIL;
+  }
+  memcpy(buf, Block, Len);
+  return MAL_Write(Add, Len);
+}
+
+static uint32_t Dfu_PollTimeout (uint32_t Add, uint8_t Cmd, uint32_t Len)
+{
+  uint8_t status[6];
+
+  memset(status, 0, sizeof(status));
+  CHECK(MAL_GetStatus(Add, Cmd, Len, status) == MAL_OK);
+  return status[1] | (status[2] << 8) | (status[3] << 16);
+}
+
+/* Tests ---------------------------------------------------------------------*/
+static void Test_Queue (void)
+{
+  uint8_t *buf0;
+  uint32_t steps;
+
+  Dfu_Reset();
+
+  /* One buffer per queued job: the host is held off once all are queued */
+  buf0 = MAL_GetBuffer();
+  CHECK(MAL_Erase(PAGE_ADD(0)) == MAL_OK);
+  CHECK(MAL_GetBuffer() != buf0);
+  Block_Fill(1);
+  CHECK(Dfu_Download(PAGE_ADD(0), PAGE_SIZE) == MAL_OK);
+  CHECK(MAL_GetBuffer() == NULL);
+  CHECK(MAL_Write(PAGE_ADD(1), PAGE_SIZE) == MAL_FAIL);
+  CHECK(MAL_GetError() == STATUS_ERRTARGET);
+  MAL_ClearError();
+
+  /* The erase, then MAL_WRITE_CHUNK bytes per step */
+  CHECK(MAL_Process() == 1);
+  CHECK(EraseCount[PAGE_NBR / 2] == 1);
+  CHECK(MAL_GetBuffer() == buf0);
+  for (steps = 0; (steps < 100) && (MAL_Process() != 0); steps++)
+  {
+  }
+  CHECK(steps == PAGE_SIZE / MAL_WRITE_CHUNK);
+  CHECK(WriteCalls == PAGE_SIZE / MAL_WRITE_CHUNK);
+  CHECK(MAL_GetBuffer() == buf0);
+  CHECK(memcmp(MAL_Read(PAGE_ADD(0), PAGE_SIZE), Block, PAGE_SIZE) == 0);
+  CHECK(MAL_GetError() == STATUS_OK);
+}
+
+static void Test_EraseAhead (void)
+{
+  uint32_t n;
+
+  Dfu_Reset();
+
+  /* A full block written: the next page is erased while the host sends
+     the next block, its erase command then costs nothing */
+  CHECK(MAL_Erase(PAGE_ADD(0)) == MAL_OK);
+  Block_Fill(2);
+  CHECK(Dfu_Download(PAGE_ADD(0), PAGE_SIZE) == MAL_OK);
+  CHECK(Dfu_Flush() == 0);
+  CHECK(EraseCount[PAGE_NBR / 2 + 1] == 0);
+  CHECK(MAL_Poll() == 1);
+  CHECK(EraseCount[PAGE_NBR / 2 + 1] == 1);
+  CHECK(MAL_Poll() == 0);
+
+  CHECK(Dfu_PollTimeout(PAGE_ADD(1), MAL_JOB_ERASE, 0) == 0);
+  CHECK(MAL_Erase(PAGE_ADD(1)) == MAL_OK);
+  CHECK(Dfu_PollTimeout(PAGE_ADD(1), MAL_JOB_FLUSH, 0) == 0);
+  Block_Fill(3);
+  CHECK(Dfu_Download(PAGE_ADD(1), PAGE_SIZE / 2) == MAL_OK);
+  CHECK(Dfu_Flush() == 0);
+  CHECK(EraseCount[PAGE_NBR / 2 + 1] == 1);
+  CHECK(memcmp(MAL_Read(PAGE_ADD(1), PAGE_SIZE / 2), Block, PAGE_SIZE / 2) == 0);
+
+  /* A half block is the end of the image: nothing erased ahead. The page
+     written since is erased again when asked. */
+  for (n = 0; n < 4; n++)
+  {
+    MAL_Poll();
+  }
+  CHECK(EraseCount[PAGE_NBR / 2 + 2] == 0);
+  CHECK(MAL_Erase(PAGE_ADD(1)) == MAL_OK);
+  CHECK(Dfu_Flush() == 0);
+  CHECK(EraseCount[PAGE_NBR / 2 + 1] == 2);
+
+  /* Never past the end of the flash */
+  CHECK(MAL_Erase(PAGE_ADD(PAGE_NBR / 2 - 1)) == MAL_OK);
+  Block_Fill(4);
+  CHECK(Dfu_Download(PAGE_ADD(PAGE_NBR / 2 - 1), PAGE_SIZE) == MAL_OK);
+  CHECK(Dfu_Flush() == 0);
+  n = EraseCalls;
+  MAL_Poll();
+  CHECK(MAL_Poll() == 0);
+  CHECK(EraseCalls == n);
+}
+
+static void Test_PollTimeout (void)
+{
+  Dfu_Reset();
+
+  /* Nothing queued: the host may go on at once */
+  CHECK(Dfu_PollTimeout(PAGE_ADD(0), MAL_JOB_NONE, 0) == 0);
+
+  /* With one job queued a buffer is still free for the new one, with two
+     the host waits for the oldest */
+  CHECK(MAL_Erase(PAGE_ADD(0)) == MAL_OK);
+  CHECK(Dfu_PollTimeout(PAGE_ADD(0), MAL_JOB_NONE, 0) == 0);
+  CHECK(Dfu_PollTimeout(PAGE_ADD(0), MAL_JOB_WRITE, PAGE_SIZE) == ERASE_TIME);
+  CHECK(Dfu_PollTimeout(PAGE_ADD(0), MAL_JOB_FLUSH, 0) == ERASE_TIME);
+
+  Block_Fill(5);
+  CHECK(Dfu_Download(PAGE_ADD(0), PAGE_SIZE) == MAL_OK);
+  CHECK(Dfu_PollTimeout(PAGE_ADD(0), MAL_JOB_FLUSH, 0) ==
+        ERASE_TIME + 2 * WRITE_TIME);
+
+  /* The time left shrinks with the steps run */
+  CHECK(MAL_Process() == 1);
+  CHECK(MAL_Process() == 1);
+  CHECK(Dfu_PollTimeout(PAGE_ADD(0), MAL_JOB_FLUSH, 0) ==
+        ((PAGE_SIZE - MAL_WRITE_CHUNK) * WRITE_TIME + 1023) / 1024);
+
+  /* An address of no memory */
+  CHECK(MAL_GetStatus(0x20000000, MAL_JOB_NONE, 0, Block) == MAL_FAIL);
+  Dfu_Flush();
+}
+
+static void Test_Errors (void)
+{
+  Dfu_Reset();
+
+  /* The updater is never touched */
+  CHECK(MAL_Erase(FLASH_BASE_ADD) == MAL_FAIL);
+  CHECK(MAL_GetError() == STATUS_ERRTARGET);
+  MAL_ClearError();
+  CHECK(MAL_GetError() == STATUS_OK);
+
+  /* A failed step drops the rest of its job, the next one still runs */
+  FailAdd = PAGE_ADD(0) + 3 * MAL_WRITE_CHUNK;
+  CHECK(MAL_Erase(PAGE_ADD(0)) == MAL_OK);
+  Block_Fill(6);
+  CHECK(Dfu_Download(PAGE_ADD(0), PAGE_SIZE) == MAL_OK);
+  CHECK(Dfu_Flush() == 0);
+  CHECK(MAL_GetError() == STATUS_ERRPROG);
+  CHECK(WriteCalls == 4);
+  MAL_ClearError();
+
+  FailAdd = PAGE_ADD(2);
+  CHECK(MAL_Erase(PAGE_ADD(2)) == MAL_OK);
+  CHECK(Dfu_Flush() == 0);
+  CHECK(MAL_GetError() == STATUS_ERRERASE);
+  MAL_ClearError();
+}
+
+static void Test_Nested (void)
+{
+  Dfu_Reset();
+
+  /* A step asked from the interrupt while the main loop writes is refused,
+     the write goes on */
+  CHECK(MAL_Erase(PAGE_ADD(0)) == MAL_OK);
+  Block_Fill(7);
+  CHECK(Dfu_Download(PAGE_ADD(0), PAGE_SIZE) == MAL_OK);
+  CHECK(MAL_Poll() == 1);
+  NestedStep = 1;
+  NestedResult = 0xFF;
+  CHECK(MAL_Poll() == 1);
+  CHECK(NestedResult == 0);
+  CHECK(Dfu_Flush() == 0);
+  CHECK(memcmp(MAL_Read(PAGE_ADD(0), PAGE_SIZE), Block, PAGE_SIZE) == 0);
+}
+
+int main (void)
+{
+  Test_Queue();
+  Test_EraseAhead();
+  Test_PollTimeout();
+  Test_Errors();
+  Test_Nested();
+  return TEST_RESULT();
+}
@@ -0,0 +1,289 @@
+/**
+  ******************************************************************************
+  * @file    test_journal.c
+  * @brief   Host test of the sample journal (nor_journal.c) on a simulated
+  *          SPI NOR flash and SD card file: read back, migration, recovery
+  *          after a reset, the ring overwriting unmigrated segments and the
+  *          SD card volume released between two migrations.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include <stdlib.h>
+#include "nor_journal.h"
+#include "test.h"
+
+/* Simulated SPI flash ------------------------------------------------------*/
+static uint8_t  Flash[FLASH_SECTOR_COUNT * FLASH_SECTOR_SIZE];
+static uint8_t  TrimMap[FLASH_SECTOR_COUNT];
+static uint8_t  ErasedMap[FLASH_SECTOR_COUNT];
+
+void sFLASH_EraseSector (uint32_t SectorAddr)
+{
+  memset(&Flash[SectorAddr & ~(FLASH_SECTOR_SIZE - 1)], 0xFF, FLASH_SECTOR_SIZE);
+}
+
+void sFLASH_WritePage (uint8_t *pBuffer, uint32_t WriteAddr, uint16_t NumByteToWrite)
+{
+  uint32_t i;
+
+  /* NOR programming only clears bits, within one page */
+  CHECK((WriteAddr / sFLASH_SPI_PAGESIZE) == ((WriteAddr + NumByteToWrite - 1) / sFLASH_SPI_PAGESIZE));
+  for (i = 0; i < NumByteToWrite; i++)
+  {
+    Flash[WriteAddr + i] &= pBuffer[i];
+  }
+}
+
+void sFLASH_ReadBuffer (uint8_t *pBuffer, uint32_t ReadAddr, uint16_t NumByteToRead)
+{
+  memcpy(pBuffer, &Flash[ReadAddr], NumByteToRead);
+}
+
+void sFLASH_WaitForWriteEnd (void)
+{
+}
+
+void sFLASH_TrimSectors (uint32_t sector, uint32_t sector_number)
+{
+  while (sector_number--)
+  {
+    TrimMap[sector++] = 1;
+  }
+}
+
+uint8_t sFLASH_PrepareSectorWrite (uint32_t sector)
+{
+  uint8_t erased = ErasedMap[sector];
+
+  TrimMap[sector] = 0;
+  ErasedMap[sector] = 0;
+  return erased;
+}
+
+/* STORAGE_Process: background erase of the trimmed sectors */
+static void Trim_Step (void)
+{
+  uint32_t s;
+
+  for (s = 0; s < FLASH_SECTOR_COUNT; s++)
+  {
+    if (TrimMap[s])
+    {
+      TrimMap[s] = 0;
+      sFLASH_EraseSector(s * FLASH_SECTOR_SIZE);
+      ErasedMap[s] = 1;
+      return;
+    }
+  }
+}
+
+/* Simulated SD card file ---------------------------------------------------*/
+static uint8_t  SdFile[2 * 1024 * 1024];
+static uint32_t SdSize;
+static uint8_t  SdFull = 0;
+
+/* The journal shares its FATFS: the SD card volume is only mounted, and
+   the file only open, while a segment is migrated */
+static FATFS   *Mounted[2];
+static uint8_t  FileOpen = 0;
+
+FRESULT f_mount (BYTE vol, FATFS *fs)
+{
+  CHECK(vol < 2);
+  CHECK(!FileOpen);
+  Mounted[vol] = fs;
+  return FR_OK;
+}
+
+FRESULT f_open (FIL *fp, const TCHAR *path, BYTE mode)
+{
+  (void)path; (void)mode;
+  CHECK(Mounted[1] != NULL);
+  FileOpen = 1;
+  fp->fsize = SdSize;
+  fp->fptr = 0;
+  return FR_OK;
+}
+
+FRESULT f_lseek (FIL *fp, DWORD ofs)
+{
+  fp->fptr = ofs;
+  return FR_OK;
+}
+
+FRESULT f_write (FIL *fp, const void *buff, UINT btw, UINT *bw)
+{
+  CHECK(FileOpen);
+  if (SdFull || (fp->fptr + btw > sizeof(SdFile)))
+  {
+    *bw = 0;
+    return FR_DENIED;
+  }
+  memcpy(&SdFile[fp->fptr], buff, btw);
+  fp->fptr += btw;
+  if (fp->fptr > SdSize)
+  {
+    SdSize = fp->fptr;
+  }
+  *bw = btw;
+  return FR_OK;
+}
+
+FRESULT f_sync (FIL *fp)
+{
+  (void)fp;
+  return FR_OK;
+}
+
+FRESULT f_close (FIL *fp)
+{
+  (void)fp;
+  CHECK(FileOpen);
+  FileOpen = 0;
+  return FR_OK;
+}
+
+/* Samples ------------------------------------------------------------------*/
+#define LINE_LENGTH    36
+
+static FATFS    Fs;
+static uint8_t  Expected[4 * 1024 * 1024];
+static uint32_t ExpectedLen;
+static uint8_t  ReadBack[sizeof(Expected)];
+
+static void Append_Lines (uint32_t nbr, uint32_t process_every)
+{
+  uint8_t line[LINE_LENGTH];
+  uint32_t i, k;
+
+  for (i = 0; i < nbr; i++)
+  {
+    for (k = 0; k < LINE_LENGTH; k++)
+    {
+      line[k] = (uint8_t)(ExpectedLen / LINE_LENGTH * 31 + k);
+    }
+    CHECK(JOURNAL_Append(line, LINE_LENGTH) == LINE_LENGTH);
+    memcpy(&Expected[ExpectedLen], line, LINE_LENGTH);
+    ExpectedLen += LINE_LENGTH;
+
+    if ((i % process_every) == 0)
+    {
+      JOURNAL_Process();
+      Trim_Step();
+      CHECK((Mounted[1] == NULL) && !FileOpen);
+    }
+  }
+}
+
+static uint32_t Read_All (void)
+{
+  JOURNAL_Iter_TypeDef it;
+  uint32_t len = 0, n;
+
+  JOURNAL_IterInit(&it);
+  do
+  {
+    n = JOURNAL_IterRead(&it, &ReadBack[len], 1000);
+    len += n;
+  } while (n != 0);
+  return len;
+}
+
+/* Everything appended reads back, the migrated file is a prefix of it */
+static void Test_ReadBack (void)
+{
+  uint32_t len;
+
+  memset(Flash, 0xFF, sizeof(Flash));
+  CHECK(JOURNAL_Init(&Fs) == 1);
+  CHECK((Mounted[1] == NULL) && !FileOpen);
+
+  /* Empty journal */
+  CHECK(Read_All() == 0);
+
+  Append_Lines(1000, 3);
+  JOURNAL_Flush();
+
+  len = Read_All();
+  CHECK(len == ExpectedLen);
+  CHECK(memcmp(ReadBack, Expected, len) == 0);
+
+  /* Migrate the sealed segments */
+  for (len = 0; len < 1000; len++)
+  {
+    JOURNAL_Process();
+    Trim_Step();
+  }
+  CHECK(SdSize != 0);
+  CHECK(SdSize == JOURNAL_Stats.Migrated);
+  CHECK(memcmp(SdFile, Expected, SdSize) == 0);
+}
+
+/* A reset finds the head and the tail again, the samples go on after the
+   ones already journaled */
+static void Test_Recovery (void)
+{
+  uint32_t len;
+
+  CHECK(JOURNAL_Init(&Fs) == 1);
+  len = Read_All();
+  CHECK(len == ExpectedLen);
+  CHECK(memcmp(ReadBack, Expected, len) == 0);
+
+  Append_Lines(500, 1);
+  JOURNAL_Flush();
+  len = Read_All();
+  CHECK(len == ExpectedLen);
+  CHECK(memcmp(ReadBack, Expected, len) == 0);
+}
+
+/* With the card gone, the ring wraps and drops the oldest segments: the
+   reader gets the newest samples, in order */
+static void Test_Wrap (void)
+{
+  uint32_t len, seg_bytes;
+
+  SdFull = 1;
+  CHECK(JOURNAL_Init(&Fs) == 1);
+  seg_bytes = (JOURNAL_PAGES_PER_SEGMENT - 1) * JOURNAL_PAGE_DATA_SIZE;
+  Append_Lines((JOURNAL_SEGMENT_NBR * 2 * seg_bytes) / LINE_LENGTH, 5);
+  JOURNAL_Flush();
+  CHECK(JOURNAL_Stats.Dropped != 0);
+
+  len = Read_All();
+  CHECK(len >= (JOURNAL_SEGMENT_NBR - 2) * seg_bytes);
+  CHECK(len <= JOURNAL_SEGMENT_NBR * seg_bytes);
+  CHECK(memcmp(ReadBack, &Expected[ExpectedLen - len], len) == 0);
+
+  /* And after a reset */
+  JOURNAL_Init(&Fs);
+  CHECK(Read_All() == len);
+  CHECK(memcmp(ReadBack, &Expected[ExpectedLen - len], len) == 0);
+}
+
+/* The newest lines, skipped to from the head as the PDF report does */
+static void Test_Newest (void)
+{
+  JOURNAL_Iter_TypeDef it;
+  uint32_t total, want = 120 * LINE_LENGTH;
+
+  JOURNAL_IterInit(&it);
+  total = JOURNAL_IterRead(&it, NULL, 0xFFFFFFFF);
+  CHECK(total > want);
+  JOURNAL_IterInit(&it);
+  CHECK(JOURNAL_IterRead(&it, NULL, total - want) == total - want);
+  CHECK(JOURNAL_IterRead(&it, ReadBack, want) == want);
+  CHECK(memcmp(ReadBack, &Expected[ExpectedLen - want], want) == 0);
+  CHECK(JOURNAL_IterRead(&it, ReadBack, want) == 0);
+}
+
+int main (void)
+{
+  Test_ReadBack();
+  Test_Recovery();
+  Test_Wrap();
+  Test_Newest();
+
+  return TEST_RESULT();
+}
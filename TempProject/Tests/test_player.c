@@ -0,0 +1,520 @@
+/**
+  ******************************************************************************
+  * @file    test_player.c
+  * @brief   Host test of the decode-ahead ring of the audio player
+  *          (stm32_audio_player.c), timed in microseconds: a DAC whose DMA
+  *          transfer complete preempts the decode task interrupt, a decoder
+  *          passing the file through, and FatFs on a RAM disk with the access
+  *          times of a slow card and stalls. The DAC checks each buffer it
+  *          plays against the file: in order, and untouched while it plays,
+  *          an underrun included; the statistics, the chunked reads and the
+  *          decoder position are checked against the simulation.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "stm32_audio_player.h"
+#include "diskio.h"
+#include "test.h"
+
+#define BUF_SIZE          MAX_OUT_PACKET_SZE
+#define BUF_US            (BUF_SIZE / 4 * 1000000 / 48000)
+
+/* PCM data after a WAV header, not aligned on the sectors */
+#define DATA_START        44
+#define SONG_SIZE         (DATA_START + 120 * BUF_SIZE + 1000)
+
+#define NONE              0xFFFFFFFF
+
+/* Time ---------------------------------------------------------------------*/
+static uint32_t Now;                /* us */
+/* Decode task interrupt */
+static uint8_t  TaskPending;
+static uint8_t  TaskOn;
+static uint32_t TaskPrio;
+
+/* DAC: the transfer playing, the file offset its data must come from, and
+   the offset of the next buffer */
+static fnXFerCpltCallback_TypeDef *DacCallback;
+static uint8_t  DacOn;
+static uint8_t  *DacBuf;
+static uint32_t DacSize;
+static uint32_t DacEnd;
+static uint32_t DacPos;
+static uint32_t DacNextPos;
+static uint32_t DacBuffers;
+static uint32_t DacRepeats;
+static uint32_t DacErrors;
+
+static void Dac_Complete (void);
+
+/* The DMA interrupt preempts whatever runs meanwhile */
+static void Sim_Spend (uint32_t us)
+{
+  uint32_t end = Now + us;
+
+  while (DacOn && (DacEnd <= end))
+  {
+    Now = DacEnd;
+    Dac_Complete();
+  }
+  Now = end;
+}
+
+/* Thread mode: the pending decode task, else idle until the next transfer
+   complete */
+static void Sim_Run (uint32_t us)
+{
+  uint32_t until = Now + us;
+
+  while (Now < until)
+  {
+    if (TaskPending && TaskOn)
+    {
+      TaskPending = 0;
+      AUDIO_PLAYER_IRQHandler();
+    }
+    else if (DacOn && (DacEnd <= until))
+    {
+      Sim_Spend(DacEnd - Now);
+    }
+    else
+    {
+      Now = until;
+    }
+  }
+}
+
+void Sim_NVIC_SetPriority (IRQn_Type IRQn, uint32_t priority)
+{
+  if (IRQn == AUDIO_PLAYER_IRQn)
+  {
+    TaskPrio = priority;
+  }
+}
+
+void Sim_NVIC_EnableIRQ (IRQn_Type IRQn)
+{
+  TaskOn |= (IRQn == AUDIO_PLAYER_IRQn);
+}
+
+void Sim_NVIC_DisableIRQ (IRQn_Type IRQn)
+{
+  TaskOn &= (IRQn != AUDIO_PLAYER_IRQn);
+}
+
+void Sim_NVIC_SetPendingIRQ (IRQn_Type IRQn)
+{
+  TaskPending |= (IRQn == AUDIO_PLAYER_IRQn);
+}
+
+void Sim_NVIC_ClearPendingIRQ (IRQn_Type IRQn)
+{
+  TaskPending &= (IRQn != AUDIO_PLAYER_IRQn);
+}
+
+/* Slow card ----------------------------------------------------------------*/
+#define DISK_SECTOR_SIZE  512
+#define DISK_SECTOR_COUNT 1024
+
+static uint8_t  Disk[DISK_SECTOR_COUNT * DISK_SECTOR_SIZE];
+static uint32_t DiskSetupUs, DiskSectorUs;
+static uint32_t DiskStallSector = NONE, DiskStallUs;
+static uint32_t DiskReads, DiskSingles;
+
+DSTATUS disk_initialize (BYTE drv)
+{
+  return 0;
+}
+
+DSTATUS disk_status (BYTE drv)
+{
+  return 0;
+}
+
+/* An access costs its setup and its sectors, a stalled one more */
+DRESULT disk_read (BYTE drv, BYTE *buff, DWORD sector, BYTE count)
+{
+  DiskReads++;
+  DiskSingles += (count == 1);
+  if ((DiskStallSector >= sector) && (DiskStallSector < sector + count))
+  {
+    DiskStallSector = NONE;
+    Sim_Spend(DiskStallUs);
+  }
+  Sim_Spend(DiskSetupUs + count * DiskSectorUs);
+  memcpy(buff, &Disk[sector * DISK_SECTOR_SIZE], count * DISK_SECTOR_SIZE);
+  return RES_OK;
+}
+
+DRESULT disk_write (BYTE drv, const BYTE *buff, DWORD sector, BYTE count)
+{
+  memcpy(&Disk[sector * DISK_SECTOR_SIZE], buff, count * DISK_SECTOR_SIZE);
+  return RES_OK;
+}
+
+DRESULT disk_ioctl (BYTE drv, BYTE ctrl, void *buff)
+{
+  switch (ctrl)
+  {
+  case GET_SECTOR_COUNT:
+    *(DWORD *)buff = DISK_SECTOR_COUNT;
+    return RES_OK;
+  case GET_SECTOR_SIZE:
+    *(WORD *)buff = DISK_SECTOR_SIZE;
+    return RES_OK;
+  case GET_BLOCK_SIZE:
+    *(DWORD *)buff = 1;
+    return RES_OK;
+  case CTRL_SYNC:
+    return RES_OK;
+  default:
+    return RES_PARERR;
+  }
+}
+
+DWORD get_fattime (void)
+{
+  return ((DWORD)(2013 - 1980) << 25) | (1 << 21) | (1 << 16);
+}
+
+/* Decoder: the PCM data of the file as it is --------------------------------*/
+static fnReadCallback_TypeDef        *DecRead;
+static fnSetPositionCallback_TypeDef *DecSetPos;
+static uint32_t DecPos;             /* offset in the file of the next byte */
+static uint32_t DecUs;              /* time to decode a buffer */
+
+static uint32_t Dec_Init (uint8_t *pHeader, fnReadCallback_TypeDef *pReadCallback,
+                          fnSetPositionCallback_TypeDef *pSetPosCallback)
+{
+  DecRead = pReadCallback;
+  DecSetPos = pSetPosCallback;
+  DecPos = DATA_START;
+  return DecSetPos(DATA_START);
+}
+
+static uint32_t Dec_DeInit (void)
+{
+  return 0;
+}
+
+static uint32_t Dec_DecodeData (__IO int16_t *pbuf, uint32_t samples, void *user)
+{
+  uint32_t n = DecRead((void *)pbuf, samples * 4, NULL);
+
+  DecPos += n;
+  Sim_Spend(DecUs);
+  return n;
+}
+
+static uint32_t Dec_GetSamplingRate (void)
+{
+  return 48000;
+}
+
+/* In bytes, to check the positions */
+static uint32_t Dec_GetStreamLength (uint32_t fLength)
+{
+  return fLength;
+}
+
+static uint32_t Dec_GetElapsedTime (uint32_t CurrPos)
+{
+  return CurrPos;
+}
+
+int8_t Decoders_SelectDecoder (Decoder_TypeDef *pDecoderStruct, int8_t ch)
+{
+  memset(pDecoderStruct, 0, sizeof(*pDecoderStruct));
+  pDecoderStruct->PacketSize = MAX_OUT_PACKET_SZE;
+  if (ch == 'V')
+  {
+    pDecoderStruct->DecoderInit = Dec_Init;
+    pDecoderStruct->DecoderDeInit = Dec_DeInit;
+    pDecoderStruct->Decoder_DecodeData = Dec_DecodeData;
+    pDecoderStruct->Decoder_GetSamplingRate = Dec_GetSamplingRate;
+    pDecoderStruct->Decoder_GetStreamLength = Dec_GetStreamLength;
+    pDecoderStruct->Decoder_GetElapsedTime = Dec_GetElapsedTime;
+  }
+  return 0;
+}
+
+/* DAC ----------------------------------------------------------------------*/
+static uint8_t Song[SONG_SIZE];
+
+/* Each buffer played holds the file data that follows the former one, or
+   the same data when played again */
+static void Dac_Complete (void)
+{
+  uint8_t  *pbuf;
+  uint32_t size;
+
+  if ((DacPos + DacSize > SONG_SIZE) || (memcmp(DacBuf, Song + DacPos, DacSize) != 0))
+  {
+    DacErrors++;
+  }
+  DacBuffers++;
+  DacCallback(&pbuf, &size);
+}
+
+static uint8_t Out_Init (uint32_t AudioFreq, uint32_t Volume, uint32_t options)
+{
+  return AUDIO_OK;
+}
+
+static uint8_t Out_DeInit (void)
+{
+  return AUDIO_OK;
+}
+
+/* A buffer again is played from its start: an underrun, or a resume */
+static uint8_t Out_AudioCmd (uint8_t *pbuf, uint32_t size, uint8_t cmd)
+{
+  if (cmd == AUDIO_CMD_PLAY)
+  {
+    if (pbuf == DacBuf)
+    {
+      DacRepeats += DacOn;
+    }
+    else
+    {
+      DacPos = DacNextPos;
+      DacNextPos += size;
+    }
+    DacEnd = (DacOn ? DacEnd : Now) + size / 4 * 1000000 / 48000;
+    DacBuf = pbuf;
+    DacSize = size;
+    DacOn = 1;
+  }
+  else
+  {
+    DacOn = 0;
+  }
+  return AUDIO_OK;
+}
+
+static uint8_t Out_VolumeCtl (uint8_t vol)
+{
+  return AUDIO_OK;
+}
+
+static void Out_SetXferCpltCallback (fnXFerCpltCallback_TypeDef *Clbck)
+{
+  DacCallback = Clbck;
+}
+
+AUDIO_FOPS_TypeDef AUDIO_OUT_fops =
+{
+  Out_Init, Out_DeInit, Out_AudioCmd, Out_VolumeCtl, NULL, NULL, NULL,
+  Out_SetXferCpltCallback, NULL
+};
+
+/* Helpers ------------------------------------------------------------------*/
+static FATFS Fs;
+
+static void Song_Write (void)
+{
+  FIL  f;
+  UINT n;
+  uint32_t i;
+
+  for (i = 0; i < SONG_SIZE; i++)
+  {
+    Song[i] = (uint8_t)(i * 7 + (i >> 9));
+  }
+  CHECK(f_open(&f, "SONG.WAV", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+  CHECK((f_write(&f, Song, SONG_SIZE, &n) == FR_OK) && (n == SONG_SIZE));
+  CHECK(f_close(&f) == FR_OK);
+}
+
+static void Player_Start (uint32_t setup, uint32_t sector, uint32_t decode)
+{
+  DiskSetupUs = setup;
+  DiskSectorUs = sector;
+  DiskStallSector = NONE;
+  DecUs = decode;
+  DacBuf = NULL;
+  DacNextPos = DATA_START;
+  DacBuffers = 0;
+  DacRepeats = 0;
+  DacErrors = 0;
+  AudioPlayer_ResetStats();
+  CHECK(AudioPlayer_Play((uint8_t *)"SONG.WAV") == 0);
+  CHECK(AudioPlayer_GetState() == PLAYER_PLAYING);
+  CHECK(DacOn);
+}
+
+/* Plays to the end of the song, then closes it */
+static void Player_Finish (void)
+{
+  uint32_t i;
+
+  for (i = 0; (AudioPlayer_GetState() != PLAYER_IDLE) && (i < 1000); i++)
+  {
+    Sim_Run(BUF_US);
+  }
+  CHECK(AudioPlayer_GetState() == PLAYER_IDLE);
+  CHECK(!DacOn);
+  CHECK(AudioPlayer_Close() == 0);
+}
+
+/* Sector of an offset of the song */
+static uint32_t Song_Sector (uint32_t offset)
+{
+  FIL f;
+
+  CHECK(f_open(&f, "SONG.WAV", FA_OPEN_EXISTING | FA_READ) == FR_OK);
+  CHECK(f_lseek(&f, offset) == FR_OK);
+  f_close(&f);
+  return f.dsect;
+}
+
+/* Tests --------------------------------------------------------------------*/
+static void Test_Ring (void)
+{
+  AudioPlayer_Stats_TypeDef st;
+  uint32_t length = 0, elapsed = 0, reads = 0;
+
+  CHECK(TaskOn && (TaskPrio == AUDIO_PLAYER_TASK_PRIO));
+
+  /* All the buffers decoded ahead of the first transfer */
+  Player_Start(500, 100, 500);
+  AudioPlayer_GetStats(&st);
+  CHECK(st.Refills == AUDIO_PLAYER_BUFFER_NBR);
+  CHECK(st.Depth == AUDIO_PLAYER_BUFFER_NBR - 1);
+  CHECK(DecPos == DATA_START + AUDIO_PLAYER_BUFFER_NBR * BUF_SIZE);
+
+  /* Nothing decoded until one buffer only is left ahead, then the ring is
+     filled again */
+  Sim_Run(BUF_US + 1);
+  AudioPlayer_GetStats(&st);
+  CHECK((DacBuffers == 1) && (st.Refills == AUDIO_PLAYER_BUFFER_NBR) && (st.Depth == 2));
+  Sim_Run(BUF_US);
+  AudioPlayer_GetStats(&st);
+  CHECK((DacBuffers == 2) && (st.Refills == AUDIO_PLAYER_BUFFER_NBR + 2));
+  CHECK(st.Depth == AUDIO_PLAYER_LOW_WATERMARK);
+  CHECK(st.RefillLatency == 0);
+
+  /* The decoder position, not the chunk read ahead */
+  AudioPlayer_GetTimeInfo(&length, &elapsed);
+  CHECK(length == SONG_SIZE);
+  CHECK(elapsed == DecPos);
+
+  /* Whole chunks, each one access to the card */
+  reads = DiskReads;
+  AudioPlayer_ResetStats();
+  DiskSingles = 0;
+  Sim_Run(50 * BUF_US);
+  AudioPlayer_GetStats(&st);
+  CHECK(st.Reads == DiskReads - reads);
+  CHECK(DiskSingles == 0);
+  CHECK(st.Reads <= (50 * BUF_SIZE) / AUDIO_PLAYER_CHUNK_SIZE + 2);
+
+  Player_Finish();
+  AudioPlayer_GetStats(&st);
+  CHECK(st.Underruns == 0);
+  CHECK(st.DepthMin == AUDIO_PLAYER_LOW_WATERMARK);
+  /* The first buffer released waited for the others */
+  CHECK(st.RefillLatencyMax == AUDIO_PLAYER_BUFFER_NBR - 2 - AUDIO_PLAYER_LOW_WATERMARK);
+  CHECK((DacErrors == 0) && (DacRepeats == 0));
+  /* Stopped at the end of the file with the buffers decoded ahead */
+  CHECK(DacNextPos >= SONG_SIZE - AUDIO_PLAYER_BUFFER_NBR * BUF_SIZE);
+}
+
+/* A stall longer than the ring: the buffer playing is played again, kept
+   from the decode task, and the song goes on where it was. The card is fast
+   otherwise, the task fills the rest of the ring before the end of the buffer
+   played again. */
+static void Test_Underrun (void)
+{
+  AudioPlayer_Stats_TypeDef st;
+
+  Player_Start(100, 50, 100);
+  Sim_Run(20 * BUF_US);
+  DiskStallSector = Song_Sector(DecPos + AUDIO_PLAYER_CHUNK_SIZE);
+  DiskStallUs = 4 * BUF_US;
+  Player_Finish();
+  AudioPlayer_GetStats(&st);
+  CHECK(DiskStallSector == NONE);
+  CHECK(st.Underruns >= 2);
+  CHECK(DacRepeats == st.Underruns);
+  CHECK(st.DepthMin == 0);
+  CHECK(st.RefillLatencyMax >= 4);
+  CHECK(DacErrors == 0);
+  CHECK(DacNextPos >= SONG_SIZE - AUDIO_PLAYER_BUFFER_NBR * BUF_SIZE);
+
+  /* Shorter than the buffer decoded ahead: nothing heard */
+  Player_Start(2000, 300, 1000);
+  Sim_Run(20 * BUF_US);
+  DiskStallSector = Song_Sector(DecPos + AUDIO_PLAYER_CHUNK_SIZE);
+  DiskStallUs = BUF_US / 2;
+  Player_Finish();
+  AudioPlayer_GetStats(&st);
+  CHECK(DiskStallSector == NONE);
+  CHECK(st.Underruns == 0);
+  CHECK(DacErrors == 0);
+}
+
+/* A card too slow for the stream: every transfer finds the ring empty, and
+   still plays the song in order */
+static void Test_SlowCard (void)
+{
+  AudioPlayer_Stats_TypeDef st;
+
+  Player_Start(6000, 1000, 2000);
+  Player_Finish();
+  AudioPlayer_GetStats(&st);
+  CHECK(st.Underruns > 50);
+  CHECK(DacErrors == 0);
+  CHECK(DacNextPos >= SONG_SIZE - AUDIO_PLAYER_BUFFER_NBR * BUF_SIZE);
+}
+
+static void Test_Pause (void)
+{
+  AudioPlayer_Stats_TypeDef st;
+  uint32_t buffers, refills;
+
+  Player_Start(500, 100, 500);
+  Sim_Run(10 * BUF_US + BUF_US / 2);
+  CHECK(AudioPlayer_Pause() == 0);
+  CHECK(!DacOn);
+
+  /* Nothing played nor decoded while paused */
+  buffers = DacBuffers;
+  AudioPlayer_GetStats(&st);
+  refills = st.Refills;
+  Sim_Run(10 * BUF_US);
+  AudioPlayer_GetStats(&st);
+  CHECK((DacBuffers == buffers) && (st.Refills == refills));
+
+  /* The buffer paused is played again from its start */
+  CHECK(AudioPlayer_Play(NULL) == 0);
+  CHECK(DacOn);
+  Player_Finish();
+  AudioPlayer_GetStats(&st);
+  CHECK(st.Underruns == 0);
+  CHECK(DacErrors == 0);
+
+  /* Statistics cleared */
+  AudioPlayer_ResetStats();
+  AudioPlayer_GetStats(&st);
+  CHECK((st.Underruns == 0) && (st.Refills == 0) && (st.Reads == 0));
+  CHECK(st.DepthMin == AUDIO_PLAYER_BUFFER_NBR);
+}
+
+int main (void)
+{
+  CHECK(f_mount(0, &Fs) == FR_OK);
+  /* Clusters of 4 KB, as on a card */
+  CHECK(f_mkfs(0, 1, 4096) == FR_OK);
+  Song_Write();
+
+  AudioPlayer_Init();
+  Test_Ring();
+  Test_Underrun();
+  Test_SlowCard();
+  Test_Pause();
+  AudioPlayer_DeInit();
+  CHECK(!TaskOn);
+  return TEST_RESULT();
+}
@@ -0,0 +1,139 @@
+/**
+  ******************************************************************************
+  * @file    test_pma.c
+  * @brief   Host test of the user memory <-> PMA copy routines of usb_core.c:
+  *          every length and alignment, and gathers split at every point.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "pma_sim.h"
+#include "usb_core.h"
+#include "test.h"
+
+uint16_t PMA_Sim[PMA_SIM_SIZE / 2];
+
+#define PMA_BUF   0x40
+#define FILL      0xA5A5
+
+static uint8_t Src[160];
+
+static void PMA_Fill(void)
+{
+  uint32_t i;
+  
+  for (i = 0; i < PMA_SIM_SIZE / 2; i++)
+  {
+    PMA_Sim[i] = FILL;
+  }
+}
+
+/* The PMA holds the bytes of p, little endian, and nothing after them */
+static int PMA_Holds(const uint8_t *p, uint32_t len)
+{
+  const uint8_t *pma = (const uint8_t *)PMA_Sim + PMA_BUF;
+  uint32_t i;
+  
+  if ((memcmp(pma, p, len) != 0) ||
+      (PMA_Sim[PMA_BUF / 2 - 1] != FILL))
+  {
+    return 0;
+  }
+  for (i = PMA_BUF / 2 + (len + 1) / 2; i < PMA_SIM_SIZE / 2; i++)
+  {
+    if (PMA_Sim[i] != FILL)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void Test_Copy(void)
+{
+  uint32_t off, len;
+  
+  for (off = 0; off < 4; off++)
+  {
+    for (len = 0; len <= 64; len++)
+    {
+      PMA_Fill();
+      UserToPMABufferCopy(&Src[off], PMA_BUF, len);
+      CHECK(PMA_Holds(&Src[off], len));
+    }
+  }
+}
+
+static void Test_Gather(void)
+{
+  PMA_Segment_TypeDef seg[3];
+  uint32_t off, len, cut, cut2;
+  
+  for (off = 0; off < 4; off++)
+  {
+    for (len = 0; len <= 64; len++)
+    {
+      for (cut = 0; cut <= len; cut++)
+      {
+        /* Two segments from the two ends of a buffer, like a ring wrap */
+        seg[0].pBuf = &Src[96 + off];
+        seg[0].wLen = cut;
+        seg[1].pBuf = &Src[off];
+        seg[1].wLen = len - cut;
+        memcpy(&Src[128], seg[0].pBuf, cut);
+        memcpy(&Src[128 + cut], seg[1].pBuf, len - cut);
+        
+        PMA_Fill();
+        CHECK(UserToPMABufferGather(seg, 2, PMA_BUF) == len);
+        CHECK(PMA_Holds(&Src[128], len));
+        
+        /* Three segments, the middle one may be empty */
+        cut2 = (cut + len) / 2;
+        seg[0].pBuf = &Src[128];
+        seg[0].wLen = cut;
+        seg[1].pBuf = &Src[128 + cut];
+        seg[1].wLen = cut2 - cut;
+        seg[2].pBuf = &Src[128 + cut2];
+        seg[2].wLen = len - cut2;
+        
+        PMA_Fill();
+        CHECK(UserToPMABufferGather(seg, 3, PMA_BUF) == len);
+        CHECK(PMA_Holds(&Src[128], len));
+      }
+    }
+  }
+}
+
+static void Test_ToUser(void)
+{
+  uint8_t dst[80];
+  uint32_t off, len;
+  
+  for (off = 0; off < 4; off++)
+  {
+    for (len = 0; len <= 64; len++)
+    {
+      memcpy((uint8_t *)PMA_Sim + PMA_BUF, Src, 64);
+      memset(dst, 0x5A, sizeof(dst));
+      PMAToUserBufferCopy(&dst[off], PMA_BUF, len);
+      CHECK(memcmp(&dst[off], Src, len) == 0);
+      CHECK(dst[off + len] == 0x5A);
+    }
+  }
+}
+
+int main(void)
+{
+  uint32_t i;
+  
+  for (i = 0; i < sizeof(Src); i++)
+  {
+    Src[i] = (uint8_t)(i * 7 + 1);
+  }
+  
+  Test_Copy();
+  Test_Gather();
+  Test_ToUser();
+  
+  return TEST_RESULT();
+}
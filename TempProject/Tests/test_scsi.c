@@ -0,0 +1,603 @@
+/**
+  ******************************************************************************
+  * @file    test_scsi.c
+  * @brief   Host test of the MSC SCSI layer (usbd_msc_scsi.c) on a simulated
+  *          bulk endpoint pair and RAM disk: READ10/WRITE10 data, media
+  *          errors, the LBA range checks of READ10, VERIFY10, UNMAP and
+  *          WRITE SAME, split-phase media accesses and the time taken by a
+  *          64 KB READ10/WRITE10.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "usbd_msc_scsi.h"
+#include "test.h"
+
+/* Simulated time, in us: a 64 bytes full speed bulk packet, and the SPI
+   flash access of one 512 bytes block */
+#define USB_PACKET_TIME    52
+#define MEDIA_READ_TIME    250
+#define MEDIA_WRITE_TIME   1400
+
+#define DISK_BLK_SIZE      512
+#define DISK_BLK_NBR       256
+#define NO_BLK             0xFFFFFFFF
+
+static USB_CORE_HANDLE  Dev;
+static uint32_t  Now;
+
+/* RAM disk -----------------------------------------------------------------*/
+static uint8_t   Disk[DISK_BLK_NBR * DISK_BLK_SIZE];
+static uint32_t  FailBlk = NO_BLK;   /* Block whose access fails */
+static uint8_t   SplitPhase;         /* Read/Write return USBD_STORAGE_BUSY */
+static uint32_t  MediaTime;          /* Total time spent by the medium */
+static uint32_t  UnmapAddr, UnmapLen, UnmapCount;
+
+/* Pending split-phase access */
+static uint32_t  MediaEnd;
+static uint8_t  *MediaBuf;
+static uint32_t  MediaAddr, MediaLen;
+static uint8_t   MediaIsWrite;
+
+static int8_t Disk_Init (uint8_t lun)
+{
+  return 0;
+}
+
+static int8_t Disk_GetCapacity (uint8_t lun, uint32_t *block_num, uint32_t *block_size)
+{
+  *block_num  = DISK_BLK_NBR;
+  *block_size = DISK_BLK_SIZE;
+  return 0;
+}
+
+static int8_t Disk_IsReady (uint8_t lun)
+{
+  return 0;
+}
+
+static int8_t Disk_IsWriteProtected (uint8_t lun)
+{
+  return 0;
+}
+
+static int8_t Disk_GetMaxLun (void)
+{
+  return 0;
+}
+
+/* Copy the data of an access once it is done, so a buffer reused too early
+   by the SCSI layer shows up as corrupted data */
+static int8_t Disk_Transfer (void)
+{
+  if ((FailBlk >= MediaAddr) && (FailBlk < MediaAddr + MediaLen))
+  {
+    return -1;
+  }
+  if (MediaIsWrite)
+  {
+    memcpy(&Disk[MediaAddr * DISK_BLK_SIZE], MediaBuf, MediaLen * DISK_BLK_SIZE);
+  }
+  else
+  {
+    memcpy(MediaBuf, &Disk[MediaAddr * DISK_BLK_SIZE], MediaLen * DISK_BLK_SIZE);
+  }
+  return 0;
+}
+
+static int8_t Disk_Access (uint8_t *buf, uint32_t blk_addr, uint16_t blk_len,
+                           uint8_t write)
+{
+  uint32_t time = blk_len * (write ? MEDIA_WRITE_TIME : MEDIA_READ_TIME);
+
+  CHECK(MediaEnd == 0);
+  if ((blk_addr > DISK_BLK_NBR) || (blk_len > DISK_BLK_NBR - blk_addr))
+  {
+    CHECK(0); /* The SCSI layer let an out of range access through */
+    return -1;
+  }
+
+  MediaBuf = buf;
+  MediaAddr = blk_addr;
+  MediaLen = blk_len;
+  MediaIsWrite = write;
+  MediaTime += time;
+
+  if (SplitPhase)
+  {
+    MediaEnd = Now + time;
+    return USBD_STORAGE_BUSY;
+  }
+  Now += time;
+  return Disk_Transfer();
+}
+
+static int8_t Disk_Read (uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  return Disk_Access(buf, blk_addr, blk_len, 0);
+}
+
+static int8_t Disk_Write (uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  return Disk_Access(buf, blk_addr, blk_len, 1);
+}
+
+static int8_t Disk_Unmap (uint8_t lun, uint32_t blk_addr, uint32_t blk_len)
+{
+  UnmapAddr = blk_addr;
+  UnmapLen = blk_len;
+  UnmapCount++;
+  return 0;
+}
+
+static USBD_STORAGE_cb_TypeDef Disk_fops =
+{
+  Disk_Init,
+  Disk_GetCapacity,
+  Disk_IsReady,
+  Disk_IsWriteProtected,
+  Disk_Read,
+  Disk_Write,
+  Disk_GetMaxLun,
+  0,
+  Disk_Unmap,
+};
+
+USBD_STORAGE_cb_TypeDef *USBD_STORAGE_fops = &Disk_fops;
+
+/* Bulk endpoints -----------------------------------------------------------*/
+static uint8_t   Host[64 * 1024];    /* Data stage, host side */
+static uint32_t  HostPos;
+static uint32_t  UsbTime;            /* Total time spent on the bus */
+
+/* Pending transfer */
+static uint32_t  UsbEnd;
+static uint8_t  *UsbBuf;
+static uint32_t  UsbLen;
+static uint8_t   UsbIsIn;
+
+static uint32_t USB_Start (uint8_t *pbuf, uint32_t len, uint8_t in)
+{
+  uint32_t time = ((len + MSC_MAX_PACKET - 1) / MSC_MAX_PACKET) * USB_PACKET_TIME;
+
+  CHECK(UsbEnd == 0);
+  CHECK(HostPos + len <= sizeof(Host));
+
+  UsbBuf = pbuf;
+  UsbLen = len;
+  UsbIsIn = in;
+  UsbEnd = Now + time;
+  UsbTime += time;
+  return 0;
+}
+
+uint32_t DCD_EP_Tx (USB_CORE_HANDLE *pdev, uint8_t ep_addr, uint8_t *pbuf, uint32_t buf_len)
+{
+  CHECK(ep_addr == MSC_IN_EP);
+  return USB_Start(pbuf, buf_len, 1);
+}
+
+uint32_t DCD_EP_PrepareRx (USB_CORE_HANDLE *pdev, uint8_t ep_addr, uint8_t *pbuf, uint16_t buf_len)
+{
+  CHECK(ep_addr == MSC_OUT_EP);
+  return USB_Start(pbuf, buf_len, 0);
+}
+
+/* Stand-in for the BOT layer (usbd_msc_bot.c) ------------------------------*/
+uint8_t              MSC_BOT_Data[MSC_MEDIA_PACKET];
+uint16_t             MSC_BOT_DataLen;
+uint8_t              MSC_BOT_State;
+MSC_BOT_CBW_TypeDef  MSC_BOT_cbw;
+MSC_BOT_CSW_TypeDef  MSC_BOT_csw;
+
+static uint8_t   CswSent;
+
+void MSC_BOT_SendCSW (USB_CORE_HANDLE *pdev, uint8_t CSW_Status)
+{
+  CHECK(CswSent == 0);
+  MSC_BOT_csw.bStatus = CSW_Status;
+  MSC_BOT_State = BOT_IDLE;
+  CswSent = 1;
+}
+
+static void BOT_DataIn (void)
+{
+  switch (MSC_BOT_State)
+  {
+  case BOT_DATA_IN:
+    if (SCSI_ProcessCmd(&Dev, MSC_BOT_cbw.bLUN, &MSC_BOT_cbw.CB[0]) < 0)
+    {
+      MSC_BOT_SendCSW(&Dev, CSW_CMD_FAILED);
+    }
+    break;
+
+  case BOT_LAST_DATA_IN:
+    MSC_BOT_SendCSW(&Dev, CSW_CMD_PASSED);
+    break;
+
+  default:
+    break;
+  }
+}
+
+static void BOT_DataOut (void)
+{
+  if (MSC_BOT_State == BOT_DATA_OUT)
+  {
+    if (SCSI_ProcessCmd(&Dev, MSC_BOT_cbw.bLUN, &MSC_BOT_cbw.CB[0]) < 0)
+    {
+      MSC_BOT_SendCSW(&Dev, CSW_CMD_FAILED);
+    }
+  }
+}
+
+/* Simulation ---------------------------------------------------------------*/
+
+/* End of the transfer on the bus */
+static void UsbDone (void)
+{
+  Now = (UsbEnd > Now) ? UsbEnd : Now;
+  UsbEnd = 0;
+  if (UsbIsIn)
+  {
+    memcpy(&Host[HostPos], UsbBuf, UsbLen);
+    HostPos += UsbLen;
+    BOT_DataIn();
+  }
+  else
+  {
+    memcpy(UsbBuf, &Host[HostPos], UsbLen);
+    HostPos += UsbLen;
+    BOT_DataOut();
+  }
+}
+
+/* End of the split-phase access, as STORAGE_Process() reports it */
+static void MediaDone (void)
+{
+  Now = (MediaEnd > Now) ? MediaEnd : Now;
+  MediaEnd = 0;
+  USBD_STORAGE_Cplt(0, Disk_Transfer());
+}
+
+/* Run the events of the data stage until the CSW */
+static void Run (void)
+{
+  while (CswSent == 0)
+  {
+    if ((UsbEnd != 0) && ((MediaEnd == 0) || (UsbEnd <= MediaEnd)))
+    {
+      UsbDone();
+    }
+    else if (MediaEnd != 0)
+    {
+      MediaDone();
+    }
+    else
+    {
+      break;
+    }
+  }
+  CHECK(CswSent);
+}
+
+/* Issue one command as the BOT layer does after a valid CBW */
+static void CommandStart (const uint8_t *cdb, uint32_t len, uint8_t in)
+{
+  CswSent = 0;
+  HostPos = 0;
+  MSC_BOT_State = BOT_IDLE;
+  MSC_BOT_DataLen = 0;
+  memset(&MSC_BOT_cbw, 0, sizeof(MSC_BOT_cbw));
+  memcpy(MSC_BOT_cbw.CB, cdb, 16);
+  MSC_BOT_cbw.dDataLength = len;
+  MSC_BOT_cbw.bmFlags = in ? 0x80 : 0x00;
+  MSC_BOT_csw.dDataResidue = len;
+
+  if (SCSI_ProcessCmd(&Dev, 0, MSC_BOT_cbw.CB) < 0)
+  {
+    MSC_BOT_SendCSW(&Dev, CSW_CMD_FAILED);
+  }
+  else if ((MSC_BOT_State != BOT_DATA_IN) &&
+           (MSC_BOT_State != BOT_DATA_OUT) &&
+           (MSC_BOT_State != BOT_LAST_DATA_IN))
+  {
+    memcpy(Host, MSC_BOT_Data, MSC_BOT_DataLen);
+    MSC_BOT_csw.dDataResidue -= MIN(len, MSC_BOT_DataLen);
+    MSC_BOT_SendCSW(&Dev, CSW_CMD_PASSED);
+  }
+}
+
+/* Issue one command and run it to its CSW. Returns the CSW status. */
+static uint8_t Command (const uint8_t *cdb, uint32_t len, uint8_t in)
+{
+  CommandStart(cdb, len, in);
+  Run();
+
+  /* A failed command leaves nothing running behind it */
+  CHECK((UsbEnd == 0) && (MediaEnd == 0));
+  UsbEnd = MediaEnd = 0;
+  return MSC_BOT_csw.bStatus;
+}
+
+static void Cdb10 (uint8_t *cdb, uint8_t op, uint32_t lba, uint16_t nbr)
+{
+  memset(cdb, 0, 16);
+  cdb[0] = op;
+  cdb[2] = lba >> 24;
+  cdb[3] = lba >> 16;
+  cdb[4] = lba >> 8;
+  cdb[5] = lba;
+  cdb[7] = nbr >> 8;
+  cdb[8] = nbr;
+}
+
+static uint8_t Read10 (uint32_t lba, uint16_t nbr)
+{
+  uint8_t cdb[16];
+
+  Cdb10(cdb, SCSI_READ10, lba, nbr);
+  return Command(cdb, nbr * DISK_BLK_SIZE, 1);
+}
+
+static uint8_t Write10 (uint32_t lba, uint16_t nbr)
+{
+  uint8_t cdb[16];
+
+  Cdb10(cdb, SCSI_WRITE10, lba, nbr);
+  return Command(cdb, nbr * DISK_BLK_SIZE, 0);
+}
+
+/* The last sense code reported */
+static int LastSense (uint8_t sKey, uint8_t ASC)
+{
+  SCSI_Sense_TypeDef *s = &SCSI_Sense[(SCSI_Sense_Tail + SENSE_LIST_DEEPTH - 1) % SENSE_LIST_DEEPTH];
+  int match = (s->Skey == sKey) && (s->w.ASC == (ASC << 8));
+
+  s->Skey = 0;
+  return match;
+}
+
+static void Disk_Fill (uint8_t seed)
+{
+  uint32_t i;
+
+  for (i = 0; i < sizeof(Disk); i++)
+  {
+    Disk[i] = (uint8_t)(i * 7 + (i >> 9) + seed);
+  }
+}
+
+/* Tests --------------------------------------------------------------------*/
+static void Test_Capacity (void)
+{
+  uint8_t cdb[16] = {SCSI_READ_CAPACITY10};
+
+  CHECK(Command(cdb, 8, 1) == CSW_CMD_PASSED);
+  CHECK((Host[2] == 0) && (Host[3] == DISK_BLK_NBR - 1));
+  CHECK((Host[6] << 8 | Host[7]) == DISK_BLK_SIZE);
+}
+
+static void Test_ReadWrite (void)
+{
+  uint32_t lba, nbr;
+
+  Disk_Fill(1);
+  for (nbr = 1; nbr <= 24; nbr += 7)
+  {
+    for (lba = 0; lba + nbr <= DISK_BLK_NBR; lba += 61)
+    {
+      CHECK(Read10(lba, nbr) == CSW_CMD_PASSED);
+      CHECK(HostPos == nbr * DISK_BLK_SIZE);
+      CHECK(MSC_BOT_csw.dDataResidue == 0);
+      CHECK(memcmp(Host, &Disk[lba * DISK_BLK_SIZE], nbr * DISK_BLK_SIZE) == 0);
+    }
+  }
+
+  for (nbr = 1; nbr <= 24; nbr += 7)
+  {
+    lba = DISK_BLK_NBR - nbr - 3;
+    memset(Host, 0x5A ^ nbr, nbr * DISK_BLK_SIZE);
+    Host[0] = 0;
+    Host[nbr * DISK_BLK_SIZE - 1] = 0xFF;
+    CHECK(Write10(lba, nbr) == CSW_CMD_PASSED);
+    CHECK(MSC_BOT_csw.dDataResidue == 0);
+    CHECK(Disk[lba * DISK_BLK_SIZE] == 0);
+    CHECK(Disk[(lba + nbr) * DISK_BLK_SIZE - 1] == 0xFF);
+    CHECK(Disk[(lba + nbr) * DISK_BLK_SIZE] != 0xFF);
+    CHECK(Disk[(lba + 1) * DISK_BLK_SIZE - 2] == (0x5A ^ nbr));
+  }
+
+  CHECK(Read10(0, 0) == CSW_CMD_PASSED);
+  CHECK(HostPos == 0);
+}
+
+static void Test_MediaError (void)
+{
+  FailBlk = 20;
+  CHECK(Read10(0, 24) == CSW_CMD_FAILED);
+  CHECK(LastSense(HARDWARE_ERROR, UNRECOVERED_READ_ERROR));
+  CHECK(Write10(4, 24) == CSW_CMD_FAILED);
+  CHECK(LastSense(HARDWARE_ERROR, WRITE_FAULT));
+  FailBlk = NO_BLK;
+
+  /* The next command is not affected */
+  CHECK(Read10(0, 24) == CSW_CMD_PASSED);
+}
+
+static void Test_Range (void)
+{
+  uint8_t cdb[16];
+
+  CHECK(Read10(DISK_BLK_NBR - 1, 1) == CSW_CMD_PASSED);
+  CHECK(Read10(DISK_BLK_NBR - 1, 2) == CSW_CMD_FAILED);
+  CHECK(LastSense(ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE));
+  CHECK(Read10(DISK_BLK_NBR, 1) == CSW_CMD_FAILED);
+  CHECK(LastSense(ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE));
+  CHECK(Write10(DISK_BLK_NBR - 8, 9) == CSW_CMD_FAILED);
+  CHECK(LastSense(ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE));
+
+  /* The end of the range must not wrap around 0 */
+  CHECK(Read10(0xFFFFFFFF, 2) == CSW_CMD_FAILED);
+  CHECK(LastSense(ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE));
+  CHECK(Write10(0xFFFFFF00, 0x100) == CSW_CMD_FAILED);
+  CHECK(LastSense(ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE));
+
+  /* VERIFY10 checks its own range, not the one of the previous command */
+  Cdb10(cdb, SCSI_VERIFY10, DISK_BLK_NBR - 4, 4);
+  CHECK(Command(cdb, 0, 0) == CSW_CMD_PASSED);
+  Cdb10(cdb, SCSI_VERIFY10, DISK_BLK_NBR - 4, 5);
+  CHECK(Command(cdb, 0, 0) == CSW_CMD_FAILED);
+  CHECK(LastSense(ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE));
+}
+
+/* UNMAP parameter list with one block descriptor */
+static uint8_t Unmap (uint32_t lba_hi, uint32_t lba, uint32_t nbr)
+{
+  uint8_t cdb[16] = {SCSI_UNMAP};
+  uint8_t *d = &Host[8];
+
+  cdb[8] = 24;
+  memset(Host, 0, 24);
+  Host[1] = 22;
+  Host[3] = 16;
+  d[0] = lba_hi >> 24; d[1] = lba_hi >> 16; d[2] = lba_hi >> 8; d[3] = lba_hi;
+  d[4] = lba >> 24;    d[5] = lba >> 16;    d[6] = lba >> 8;    d[7] = lba;
+  d[8] = nbr >> 24;    d[9] = nbr >> 16;    d[10] = nbr >> 8;   d[11] = nbr;
+  return Command(cdb, 24, 0);
+}
+
+static void Test_Unmap (void)
+{
+  uint8_t cdb[16];
+
+  UnmapCount = 0;
+  CHECK(Unmap(0, DISK_BLK_NBR - 4, 4) == CSW_CMD_PASSED);
+  CHECK((UnmapCount == 1) && (UnmapAddr == DISK_BLK_NBR - 4) && (UnmapLen == 4));
+  CHECK(Unmap(0, DISK_BLK_NBR - 4, 5) == CSW_CMD_FAILED);
+  CHECK(LastSense(ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE));
+  CHECK(Unmap(0, 1, 0xFFFFFFFF) == CSW_CMD_FAILED);
+  CHECK(LastSense(ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE));
+  CHECK(Unmap(1, 0, 1) == CSW_CMD_FAILED);
+  CHECK(LastSense(ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE));
+  CHECK(UnmapCount == 1);
+
+  /* WRITE SAME (10) with UNMAP and no length: up to the last block */
+  Cdb10(cdb, SCSI_WRITE_SAME10, 10, 0);
+  cdb[1] = 0x08;
+  CHECK(Command(cdb, DISK_BLK_SIZE, 0) == CSW_CMD_PASSED);
+  CHECK((UnmapCount == 2) && (UnmapAddr == 10) && (UnmapLen == DISK_BLK_NBR - 10));
+
+  /* WRITE SAME (16) beyond 32-bit LBAs */
+  memset(cdb, 0, sizeof(cdb));
+  cdb[0] = SCSI_WRITE_SAME16;
+  cdb[1] = 0x08;
+  cdb[5] = 1;
+  cdb[13] = 1;
+  CHECK(Command(cdb, DISK_BLK_SIZE, 0) == CSW_CMD_FAILED);
+  CHECK(LastSense(ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE));
+  CHECK(UnmapCount == 2);
+}
+
+/* While the medium writes a buffer the OUT endpoint NAKs and the CSW waits */
+static void Test_SplitWrite (void)
+{
+  uint8_t cdb[16];
+  uint32_t nbr = 2 * MSC_MEDIA_PACKET / DISK_BLK_SIZE;
+
+  memset(Host, 0x33, nbr * DISK_BLK_SIZE);
+  Cdb10(cdb, SCSI_WRITE10, 16, nbr);
+  CommandStart(cdb, nbr * DISK_BLK_SIZE, 0);
+  UsbDone();
+  CHECK((MediaEnd != 0) && (UsbEnd == 0) && (CswSent == 0));
+  MediaDone();
+  CHECK((UsbEnd != 0) && (CswSent == 0));
+  UsbDone();
+  CHECK((MediaEnd != 0) && (UsbEnd == 0) && (CswSent == 0));
+  MediaDone();
+  CHECK(CswSent && (MSC_BOT_csw.bStatus == CSW_CMD_PASSED));
+  CHECK(MSC_BOT_csw.dDataResidue == 0);
+  CHECK(Disk[(16 + nbr) * DISK_BLK_SIZE - 1] == 0x33);
+}
+
+/* The access of a command aborted by a BOT reset ends during the next one */
+static void Test_Abort (void)
+{
+  uint8_t cdb[16];
+
+  Disk_Fill(2);
+  memset(Host, 0x44, MSC_MEDIA_PACKET);
+  Cdb10(cdb, SCSI_WRITE10, 32, 16);
+  CommandStart(cdb, 16 * DISK_BLK_SIZE, 0);
+  UsbDone();
+  CHECK(MediaEnd != 0);
+  MSC_BOT_State = BOT_IDLE;
+
+  /* READ10 waits for the medium, then runs as usual */
+  CHECK(Read10(0, 8) == CSW_CMD_PASSED);
+  CHECK(memcmp(Host, Disk, 8 * DISK_BLK_SIZE) == 0);
+  CHECK(Disk[32 * DISK_BLK_SIZE] == 0x44);
+
+  /* The end of the access comes after a command without data stage */
+  CommandStart(cdb, 16 * DISK_BLK_SIZE, 0);
+  UsbDone();
+  MSC_BOT_State = BOT_IDLE;
+  memset(cdb, 0, sizeof(cdb));
+  cdb[0] = SCSI_TEST_UNIT_READY;
+  CommandStart(cdb, 0, 0);
+  CHECK(CswSent);
+  CswSent = 0;
+  MediaDone();
+  CHECK((CswSent == 0) && (UsbEnd == 0) && (MediaEnd == 0));
+
+  /* Nothing is left behind */
+  CHECK(Write10(0, 8) == CSW_CMD_PASSED);
+}
+
+/* Time of a 64 KB transfer: the bus and medium times add up */
+static void Bench (const char *name, uint8_t write)
+{
+  uint32_t start = Now;
+  uint32_t nbr = sizeof(Host) / DISK_BLK_SIZE;
+  uint32_t time, serial;
+
+  UsbTime = MediaTime = 0;
+  CHECK((write ? Write10(0, nbr) : Read10(0, nbr)) == CSW_CMD_PASSED);
+  time = Now - start;
+  serial = UsbTime + MediaTime;
+
+  printf("  %-22s %6lu us  %4lu KB/s  (bus %lu us + medium %lu us)\n", name,
+         (unsigned long)time, (unsigned long)(sizeof(Host) / 1024 * 1000000 / time),
+         (unsigned long)UsbTime, (unsigned long)MediaTime);
+
+  CHECK(time == serial);
+}
+
+static void Test_All (void)
+{
+  Test_Capacity();
+  Test_ReadWrite();
+  Test_MediaError();
+  Test_Range();
+  Test_Unmap();
+  if (SplitPhase)
+  {
+    Test_SplitWrite();
+    Test_Abort();
+  }
+}
+
+int main (void)
+{
+  Test_All();
+  Bench("READ10", 0);
+  Bench("WRITE10", 1);
+
+  /* Same again with the medium accesses split-phase */
+  SplitPhase = 1;
+  Test_All();
+  Bench("READ10 split-phase", 0);
+  Bench("WRITE10 split-phase", 1);
+
+  return TEST_RESULT();
+}
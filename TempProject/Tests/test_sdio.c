@@ -0,0 +1,210 @@
+/**
+  ******************************************************************************
+  * @file    test_sdio.c
+  * @brief   Host test of the write aggregation of sdio_sdcard.c (Spi Fatfs
+  *          Example) on the simulated SDIO card of sdio_sim.c: blocks gathered
+  *          up to the SD_WRBUF_BLOCKS boundaries and written with a pre-erased
+  *          CMD25, aligned chunks written straight from the caller's buffer,
+  *          the flush of a run that is not continued, the next chunk filled
+  *          while the card programs the last one, and a failed write.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "sdio_sdcard.h"
+#include "sdio_sim.h"
+#include "test.h"
+
+#define CHUNK   SD_WRBUF_BLOCKS
+
+SD_CardInfo SDCardInfo;
+
+/* Static, and so below 4 GB: the driver hands the DMA 32 bits addresses */
+static uint32_t SrcWords[(3 * CHUNK) * 512 / 4];
+#define Src     ((uint8_t *)SrcWords)
+
+static void Sd_Reset (void)
+{
+  uint32_t i;
+
+  SD_SetDeviceMode(SD_DMA_MODE);
+  SD_FlushWrite();
+  SD_SimReset();
+  for (i = 0; i < sizeof(SrcWords); i++)
+  {
+    Src[i] = (uint8_t)(i * 7 + i / 512);
+  }
+}
+
+static int Card_Holds (uint32_t block, const uint8_t *data, uint32_t count)
+{
+  return memcmp(&SD_SimCard[block * 512], data, count * 512) == 0;
+}
+
+static int Log_Is (uint32_t n, uint8_t cmd, uint32_t block, uint32_t count)
+{
+  return (SD_SimLog[n].Cmd == cmd) && (SD_SimLog[n].Block == block) &&
+         (SD_SimLog[n].Count == count);
+}
+
+static void Test_Gather (void)
+{
+  uint32_t i;
+
+  Sd_Reset();
+
+  /* Single blocks are kept until the chunk is full */
+  for (i = 0; i < CHUNK - 1; i++)
+  {
+    CHECK(SD_WriteBuffered(Src + i * 512, 2 * CHUNK + i, 1) == SD_OK);
+  }
+  CHECK(SD_SimLogNbr == 0);
+  CHECK(SD_IsWriteBuffered(3 * CHUNK - 2, 1));
+  CHECK(!SD_IsWriteBuffered(3 * CHUNK - 1, 1));
+  CHECK(SD_IsWriteBuffered(CHUNK, CHUNK + 1));
+  CHECK(!SD_IsWriteBuffered(CHUNK, CHUNK));
+
+  /* Then written at once, pre-erased, from the driver's buffer */
+  CHECK(SD_WriteBuffered(Src + i * 512, 2 * CHUNK + i, 1) == SD_OK);
+  CHECK(SD_SimLogNbr == 1);
+  CHECK(Log_Is(0, SD_CMD_WRITE_MULT_BLOCK, 2 * CHUNK, CHUNK));
+  CHECK(SD_SimLog[0].PreErase == CHUNK);
+  CHECK(SD_SimLog[0].Buffer != Src);
+  CHECK(!SD_IsWriteBuffered(2 * CHUNK, CHUNK));
+  CHECK(Card_Holds(2 * CHUNK, Src, CHUNK));
+}
+
+static void Test_Boundary (void)
+{
+  Sd_Reset();
+
+  /* A run across a boundary is cut there, the rest waits for more */
+  CHECK(SD_WriteBuffered(Src, 5, CHUNK) == SD_OK);
+  CHECK(SD_SimLogNbr == 1);
+  CHECK(Log_Is(0, SD_CMD_WRITE_MULT_BLOCK, 5, CHUNK - 5));
+  CHECK(SD_SimLog[0].PreErase == CHUNK - 5);
+  CHECK(SD_IsWriteBuffered(CHUNK, 5));
+  CHECK(!SD_IsWriteBuffered(CHUNK + 5, 1));
+
+  CHECK(SD_FlushWrite() == SD_OK);
+  CHECK(SD_SimLogNbr == 2);
+  CHECK(Log_Is(1, SD_CMD_WRITE_MULT_BLOCK, CHUNK, 5));
+  CHECK(!SD_IsWriteBuffered(CHUNK, 5));
+  CHECK(Card_Holds(5, Src, CHUNK));
+
+  /* Nothing left to flush */
+  CHECK(SD_FlushWrite() == SD_OK);
+  CHECK(SD_SimLogNbr == 2);
+}
+
+static void Test_Direct (void)
+{
+  Sd_Reset();
+
+  /* Whole aligned chunks of a word aligned buffer are not copied */
+  CHECK(SD_WriteBuffered(Src, 4 * CHUNK, 2 * CHUNK + 4) == SD_OK);
+  CHECK(SD_SimLogNbr == 1);
+  CHECK(Log_Is(0, SD_CMD_WRITE_MULT_BLOCK, 4 * CHUNK, 2 * CHUNK));
+  CHECK(SD_SimLog[0].Buffer == Src);
+  CHECK(SD_IsWriteBuffered(6 * CHUNK, 4));
+  CHECK(SD_FlushWrite() == SD_OK);
+  CHECK(SD_SimLogNbr == 2);
+  CHECK(Log_Is(1, SD_CMD_WRITE_MULT_BLOCK, 6 * CHUNK, 4));
+  CHECK(SD_SimLog[1].Buffer != Src + 2 * CHUNK * 512);
+  CHECK(Card_Holds(4 * CHUNK, Src, 2 * CHUNK + 4));
+
+  /* From an odd address they go through the two buffers in turn */
+  SD_SimLogNbr = 0;
+  CHECK(SD_WriteBuffered(Src + 1, 8 * CHUNK, 2 * CHUNK) == SD_OK);
+  CHECK(SD_SimLogNbr == 2);
+  CHECK(Log_Is(0, SD_CMD_WRITE_MULT_BLOCK, 8 * CHUNK, CHUNK));
+  CHECK(Log_Is(1, SD_CMD_WRITE_MULT_BLOCK, 9 * CHUNK, CHUNK));
+  CHECK(SD_SimLog[0].Buffer != Src + 1);
+  CHECK(SD_SimLog[1].Buffer != Src + 1);
+  CHECK(SD_SimLog[0].Buffer != SD_SimLog[1].Buffer);
+  CHECK(Card_Holds(8 * CHUNK, Src + 1, 2 * CHUNK));
+}
+
+static void Test_Discontiguous (void)
+{
+  Sd_Reset();
+
+  /* A write elsewhere first writes the run */
+  CHECK(SD_WriteBuffered(Src, 40, 1) == SD_OK);
+  CHECK(SD_WriteBuffered(Src + 512, 41, 1) == SD_OK);
+  CHECK(SD_WriteBuffered(Src + 2 * 512, 100, 1) == SD_OK);
+  CHECK(SD_SimLogNbr == 1);
+  CHECK(Log_Is(0, SD_CMD_WRITE_MULT_BLOCK, 40, 2));
+  CHECK(SD_SimLog[0].PreErase == 2);
+  CHECK(SD_IsWriteBuffered(100, 1));
+
+  /* A single block goes out with CMD24, no pre-erase */
+  CHECK(SD_WriteBuffered(Src + 3 * 512, 7, 1) == SD_OK);
+  CHECK(SD_SimLogNbr == 2);
+  CHECK(Log_Is(1, SD_CMD_WRITE_SINGLE_BLOCK, 100, 1));
+  CHECK(SD_SimLog[1].PreErase == 0);
+
+  CHECK(SD_FlushWrite() == SD_OK);
+  CHECK(SD_SimLogNbr == 3);
+  CHECK(Log_Is(2, SD_CMD_WRITE_SINGLE_BLOCK, 7, 1));
+  CHECK(Card_Holds(40, Src, 2));
+  CHECK(Card_Holds(100, Src + 2 * 512, 1));
+  CHECK(Card_Holds(7, Src + 3 * 512, 1));
+}
+
+static void Test_Programming (void)
+{
+  uint32_t i;
+
+  Sd_Reset();
+  SD_SimProgPolls = 3;
+
+  /* A full chunk is started, not waited for: the next one is filled while
+     the card programs it */
+  CHECK(SD_WriteBuffered(Src + 1, 0, CHUNK) == SD_OK);
+  CHECK(SD_SimLogNbr == 1);
+  CHECK(SD_WriteBuffered(Src + 1 + CHUNK * 512, CHUNK, CHUNK - 1) == SD_OK);
+  CHECK(SD_SimLogNbr == 1);
+  CHECK(SD_CheckRequest() == SD_REQUEST_PENDING);
+
+  /* The next write waits for the card */
+  CHECK(SD_WriteBuffered(Src + 1 + (2 * CHUNK - 1) * 512, 2 * CHUNK - 1, 1) == SD_OK);
+  CHECK(SD_SimLogNbr == 2);
+  CHECK(Log_Is(1, SD_CMD_WRITE_MULT_BLOCK, CHUNK, CHUNK));
+  CHECK(SD_SimLog[0].Buffer != SD_SimLog[1].Buffer);
+
+  for (i = 0; i < 3; i++)
+  {
+    CHECK(SD_CheckRequest() == SD_REQUEST_PENDING);
+  }
+  CHECK(SD_CheckRequest() == SD_OK);
+  CHECK(Card_Holds(0, Src + 1, 2 * CHUNK));
+}
+
+static void Test_Error (void)
+{
+  Sd_Reset();
+  SD_SimFailCmd = SD_CMD_WRITE_MULT_BLOCK;
+
+  /* The error of the chunk write is returned, the blocks are dropped */
+  CHECK(SD_WriteBuffered(Src + 1, 0, CHUNK - 1) == SD_OK);
+  CHECK(SD_WriteBuffered(Src + 1, CHUNK - 1, 1) == SD_ADDR_OUT_OF_RANGE);
+  CHECK(SD_SimLogNbr == 0);
+  CHECK(!SD_IsWriteBuffered(0, CHUNK));
+
+  SD_SimFailCmd = 0;
+  CHECK(SD_WriteBuffered(Src, 3, 1) == SD_OK);
+  CHECK(SD_FlushWrite() == SD_OK);
+  CHECK(Log_Is(0, SD_CMD_WRITE_SINGLE_BLOCK, 3, 1));
+}
+
+int main (void)
+{
+  Test_Gather();
+  Test_Boundary();
+  Test_Direct();
+  Test_Discontiguous();
+  Test_Programming();
+  Test_Error();
+  return TEST_RESULT();
+}
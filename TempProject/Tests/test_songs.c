@@ -0,0 +1,510 @@
+/**
+  ******************************************************************************
+  * @file    test_songs.c
+  * @brief   Host test of the song utilities (songutilities.c) on FatFs over a
+  *          RAM disk: the ID3v2 and WMA tag parsers on well formed and
+  *          corrupted tags, and the song index of a folder kept across
+  *          songs added, removed and modified, while the player holds a
+  *          song open.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include <stdio.h>
+#include "songutilities.h"
+#include "diskio.h"
+#include "test.h"
+
+/* RAM disk -----------------------------------------------------------------*/
+#define DISK_SECTOR_SIZE   512
+#define DISK_SECTOR_COUNT  1024
+
+static uint8_t   Disk[DISK_SECTOR_COUNT * DISK_SECTOR_SIZE];
+static uint32_t  DiskWrites;
+static DWORD     FatTime = ((DWORD)(2013 - 1980) << 25) | (1 << 21) | (1 << 16);
+
+DSTATUS disk_initialize (BYTE drv)
+{
+  return 0;
+}
+
+DSTATUS disk_status (BYTE drv)
+{
+  return 0;
+}
+
+DRESULT disk_read (BYTE drv, BYTE *buff, DWORD sector, BYTE count)
+{
+  memcpy(buff, &Disk[sector * DISK_SECTOR_SIZE], count * DISK_SECTOR_SIZE);
+  return RES_OK;
+}
+
+DRESULT disk_write (BYTE drv, const BYTE *buff, DWORD sector, BYTE count)
+{
+  memcpy(&Disk[sector * DISK_SECTOR_SIZE], buff, count * DISK_SECTOR_SIZE);
+  DiskWrites++;
+  return RES_OK;
+}
+
+DRESULT disk_ioctl (BYTE drv, BYTE ctrl, void *buff)
+{
+  switch (ctrl)
+  {
+  case GET_SECTOR_COUNT:
+    *(DWORD *)buff = DISK_SECTOR_COUNT;
+    return RES_OK;
+  case GET_SECTOR_SIZE:
+    *(WORD *)buff = DISK_SECTOR_SIZE;
+    return RES_OK;
+  case GET_BLOCK_SIZE:
+    *(DWORD *)buff = 1;
+    return RES_OK;
+  case CTRL_SYNC:
+  case CTRL_ERASE_SECTOR:
+    return RES_OK;
+  default:
+    return RES_PARERR;
+  }
+}
+
+DWORD get_fattime (void)
+{
+  return FatTime;
+}
+
+/* Helpers ------------------------------------------------------------------*/
+static FATFS     Fs;
+static uint8_t   File[4096];     /* File being built */
+static uint8_t   Buf[SONG_INDEX_BUFFER_SIZE];
+static uint8_t   Pic[1024];      /* Picture stand-in, larger than Buf */
+static char      Tags[5][MAX_TAG_STRING_LENGTH + 1];
+static TAGS_TypeDef  T;
+
+static void Put (const char *path, const uint8_t *data, uint32_t len)
+{
+  FIL f;
+  UINT n;
+
+  CHECK(f_open(&f, path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+  CHECK((f_write(&f, data, len, &n) == FR_OK) && (n == len));
+  CHECK(f_close(&f) == FR_OK);
+}
+
+static void Tags_Clear (void)
+{
+  memset(Tags, 0, sizeof(Tags));
+  T.Title  = Tags[0];
+  T.Artist = Tags[1];
+  T.Album  = Tags[2];
+  T.Year   = Tags[3];
+  T.Genre  = Tags[4];
+  T.SamplingRate = 0;
+}
+
+static void Be32 (uint8_t *p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static void Le16 (uint8_t *p, uint32_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void Le32 (uint8_t *p, uint32_t v)
+{
+  Le16(p, v);
+  Le16(p + 2, v >> 16);
+}
+
+/* ID3v2.3 ------------------------------------------------------------------*/
+static uint32_t Id3Frame (uint8_t *p, const char *id, uint8_t enc, const void *text, uint32_t len)
+{
+  memcpy(p, id, 4);
+  Be32(p + 4, len + 1);
+  p[8] = p[9] = 0;
+  p[10] = enc;
+  memcpy(p + 11, text, len);
+  return 11 + len;
+}
+
+/* Tag header, and a few bytes of audio after the tag */
+static uint32_t Id3End (uint8_t *p)
+{
+  uint32_t size = p - File - 10;
+
+  memcpy(File, "ID3\x03\x00\x00", 6);
+  File[6] = (size >> 21) & 0x7F;
+  File[7] = (size >> 14) & 0x7F;
+  File[8] = (size >> 7) & 0x7F;
+  File[9] = size & 0x7F;
+  memset(p, 0, 64);
+  p[0] = 0xFF;
+  p[1] = 0xFB;
+  return size + 10 + 64;
+}
+
+static uint32_t Mp3 (const char *title, const char *artist, uint32_t pic)
+{
+  uint8_t *p = File + 10;
+
+  if (pic != 0)
+  {
+    memset(Pic, 0x55, pic);
+    p += Id3Frame(p, "APIC", 0, Pic, pic);
+  }
+  p += Id3Frame(p, "TIT2", 0, title, strlen(title));
+  p += Id3Frame(p, "TPE1", 0, artist, strlen(artist));
+  p += Id3Frame(p, "TALB", 0, "Album", 5);
+  p += Id3Frame(p, "TYER", 0, "2013", 4);
+  p += Id3Frame(p, "TCON", 0, "Rock", 4);
+  return Id3End(p);
+}
+
+static int8_t ParseMp3 (uint32_t len)
+{
+  FIL f;
+  int8_t res;
+
+  Put("0:/T.MP3", File, len);
+  Tags_Clear();
+  CHECK(f_open(&f, "0:/T.MP3", FA_OPEN_EXISTING | FA_READ) == FR_OK);
+  res = SongUtilities_MP3TagParser(Buf, &T, &f);
+  f_close(&f);
+  return res;
+}
+
+static void Test_ID3 (void)
+{
+  uint8_t *p;
+  char title[101];
+
+  CHECK(ParseMp3(Mp3("Title", "Artist", 0)) == 0);
+  CHECK(strcmp(T.Title, "Title") == 0);
+  CHECK(strcmp(T.Artist, "Artist") == 0);
+  CHECK(strcmp(T.Album, "Album") == 0);
+  CHECK(strcmp(T.Year, "2013") == 0);
+  CHECK(strcmp(T.Genre, "Rock") == 0);
+
+  /* A picture larger than the parse buffer is skipped */
+  CHECK(ParseMp3(Mp3("After picture", "Artist", 1000)) == 0);
+  CHECK(strcmp(T.Title, "After picture") == 0);
+  CHECK(strcmp(T.Genre, "Rock") == 0);
+
+  /* Truncated to MAX_TAG_STRING_LENGTH */
+  memset(title, 'x', 100);
+  title[100] = 0;
+  CHECK(ParseMp3(Mp3(title, "Artist", 0)) == 0);
+  CHECK(strlen(T.Title) == MAX_TAG_STRING_LENGTH);
+
+  /* UTF-16 with BOM, little endian, to UTF-8 */
+  p = File + 10;
+  p += Id3Frame(p, "TIT2", 1, "\xFF\xFE" "C\0a\0f\0\xE9\0", 10);
+  CHECK(ParseMp3(Id3End(p)) == 0);
+  CHECK(strcmp(T.Title, "Caf\xC3\xA9") == 0);
+
+  /* A frame claiming more than the tag holds ends the parsing */
+  p = File + 10;
+  p += Id3Frame(p, "TPE1", 0, "Artist", 6);
+  p += Id3Frame(p, "TIT2", 0, "Title", 5);
+  Be32(p - 5 - 7, 0x0FFFFFFF);
+  CHECK(ParseMp3(Id3End(p)) == 0);
+  CHECK(strcmp(T.Artist, "Artist") == 0);
+  CHECK(T.Title[0] == 0);
+
+  /* A tag larger than the file */
+  p = File + 10;
+  p += Id3Frame(p, "TIT2", 0, "Title", 5);
+  Id3End(p);
+  File[7] = 0x7F;
+  ParseMp3(p - File);
+  CHECK(strlen(T.Title) <= MAX_TAG_STRING_LENGTH);
+
+  /* No tag */
+  memset(File, 0, 100);
+  File[0] = 0xFF;
+  File[1] = 0xFB;
+  CHECK(ParseMp3(100) == 0);
+  CHECK(T.Title[0] == 0);
+}
+
+/* ASF header ---------------------------------------------------------------*/
+static const uint8_t GuidCD[16] =
+  {0x33, 0x26, 0xb2, 0x75, 0x8e, 0x66, 0xcf, 0x11, 0xa6, 0xd9, 0x00, 0xaa, 0x00, 0x62, 0xce, 0x6c};
+static const uint8_t GuidECD[16] =
+  {0x40, 0xA4, 0xD0, 0xD2, 0x07, 0xe3, 0xd2, 0x11, 0x97, 0xf0, 0x00, 0xa0, 0xc9, 0x5e, 0xa8, 0x50};
+static const uint8_t GuidOther[16] =
+  {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF, 0x00};
+
+/* UTF-16LE string with its terminator, returns its size */
+static uint32_t Utf16 (uint8_t *p, const char *s)
+{
+  uint32_t i, len = strlen(s) + 1;
+
+  for (i = 0; i < len; i++)
+  {
+    Le16(p + 2 * i, (uint8_t)s[i]);
+  }
+  return 2 * len;
+}
+
+static uint8_t *AsfObject (uint8_t *p, const uint8_t *guid, uint32_t size)
+{
+  memcpy(p, guid, 16);
+  Le32(p + 16, size);
+  Le32(p + 20, 0);
+  return p + 24;
+}
+
+static uint8_t *AsfCD (uint8_t *p, const char *title, const char *author)
+{
+  uint8_t *d = p + 24 + 10;
+
+  memset(p + 24, 0, 10);
+  Le16(p + 24, Utf16(d, title));
+  d += Utf16(d, title);
+  Le16(p + 26, Utf16(d, author));
+  d += Utf16(d, author);
+  AsfObject(p, GuidCD, d - p);
+  return d;
+}
+
+static uint8_t *AsfDescriptor (uint8_t *p, const char *name, const char *value)
+{
+  uint32_t n = Utf16(p + 2, name);
+
+  Le16(p, n);
+  Le16(p + 2 + n, 0);
+  Le16(p + 4 + n, Utf16(p + 6 + n, value));
+  return p + 6 + n + Utf16(p + 6 + n, value);
+}
+
+/* Extended content description, after a picture of pic bytes */
+static uint8_t *AsfECD (uint8_t *p, uint32_t pic)
+{
+  uint8_t *d = p + 24 + 2;
+
+  Le16(p + 24, 4);
+  Le16(d, Utf16(d + 2, "WM/Picture"));
+  d += 2 + Utf16(d + 2, "WM/Picture");
+  Le16(d, 1);
+  Le16(d + 2, pic);
+  memset(d + 4, 0x55, pic);
+  d += 4 + pic;
+  d = AsfDescriptor(d, "WM/album", "Album");
+  d = AsfDescriptor(d, "WM/Year", "2013");
+  d = AsfDescriptor(d, "WM/Genre", "Jazz");
+  AsfObject(p, GuidECD, d - p);
+  return d;
+}
+
+/* Header object and its objects: end of the file */
+static uint32_t AsfEnd (uint8_t *p, uint32_t objects)
+{
+  p = AsfObject(p, GuidOther, 24);   /* Padding, last object */
+  AsfObject(File, GuidOther, p - File);
+  Le32(File + 24, objects + 1);
+  File[28] = 1;
+  File[29] = 2;
+  memset(p, 0, 64);
+  return p - File + 64;
+}
+
+static void ParseWma (uint32_t len)
+{
+  FIL f;
+
+  Put("0:/T.WMA", File, len);
+  Tags_Clear();
+  CHECK(f_open(&f, "0:/T.WMA", FA_OPEN_EXISTING | FA_READ) == FR_OK);
+  SongUtilities_WMATagParser(&T, &f, Buf, sizeof(Buf));
+  f_close(&f);
+}
+
+static void Test_WMA (void)
+{
+  uint8_t *p, *o;
+
+  p = AsfObject(File + 30, GuidOther, 24 + 80) + 80;   /* File properties */
+  p = AsfCD(p, "Title", "Author");
+  p = AsfECD(p, 0);
+  ParseWma(AsfEnd(p, 3));
+  CHECK(strcmp(T.Title, "Title") == 0);
+  CHECK(strcmp(T.Artist, "Author") == 0);
+  CHECK(strcmp(T.Album, "Album") == 0);
+  CHECK(strcmp(T.Year, "2013") == 0);
+  CHECK(strcmp(T.Genre, "Jazz") == 0);
+
+  /* The descriptors past the parse buffer are skipped, and the objects
+     after them still found */
+  p = AsfECD(File + 30, 1000);
+  p = AsfCD(p, "After picture", "Author");
+  ParseWma(AsfEnd(p, 2));
+  CHECK(strcmp(T.Title, "After picture") == 0);
+  CHECK(strcmp(T.Artist, "Author") == 0);
+  CHECK(T.Album[0] == 0);
+
+  /* Title longer than the object: copied up to the end of the object, the
+     author past it is not read */
+  o = File + 30;
+  p = AsfCD(o, "Trunc", "Author");
+  Le16(o + 24, 0xFFF0);
+  AsfObject(o, GuidCD, 24 + 10 + 12);
+  ParseWma(AsfEnd(o + 24 + 10 + 12, 1));
+  CHECK(strcmp(T.Title, "Trunc") == 0);
+  CHECK(T.Artist[0] == 0);
+
+  /* Descriptor value longer than the object */
+  o = File + 30;
+  p = AsfECD(o, 0);
+  Le16(p - 2 * 5 - 2, 0x00F0);
+  ParseWma(AsfEnd(p, 1));
+  CHECK(strcmp(T.Album, "Album") == 0);
+  CHECK(strcmp(T.Year, "2013") == 0);
+  CHECK(T.Genre[0] == 0);
+
+  /* Truncated file */
+  p = AsfCD(File + 30, "Title", "Author");
+  ParseWma(40);
+  CHECK(strlen(T.Title) <= MAX_TAG_STRING_LENGTH);
+}
+
+/* Song index ---------------------------------------------------------------*/
+#define SONG_NBR           20
+
+static char      Path[32];
+static char      Title[32];
+
+static const char *SongPath (uint32_t i)
+{
+  sprintf(Path, "0:/MUSIC/S%02u.%s", (unsigned)i, (i & 1) ? "WMA" : "MP3");
+  return Path;
+}
+
+static void PutSong (uint32_t i, const char *title)
+{
+  uint8_t *p;
+  uint32_t len;
+
+  if (i & 1)
+  {
+    p = AsfCD(File + 30, title, "Author");
+    len = AsfEnd(p, 1);
+  }
+  else
+  {
+    len = Mp3(title, "Artist", 0);
+  }
+  Put(SongPath(i), File, len);
+}
+
+/* Get a record, 1 if its tags were parsed and saved now */
+static int Get (uint32_t i, SONG_IndexRecord_TypeDef *rec)
+{
+  uint32_t writes = DiskWrites;
+
+  CHECK(SongUtilities_IndexGet(i, rec));
+  CHECK(rec->Flags & SONG_FLAG_PARSED);
+  return DiskWrites != writes;
+}
+
+static void Test_Index (void)
+{
+  SONG_IndexRecord_TypeDef rec;
+  FIL player;
+  uint32_t i, writes;
+
+  CHECK(f_mkdir("0:/MUSIC") == FR_OK);
+  CHECK(SongUtilities_IndexOpen("0:/MUSIC") == 0);
+  CHECK(!SongUtilities_IndexGet(0, &rec));
+
+  for (i = 0; i < SONG_NBR; i++)
+  {
+    sprintf(Title, "Song %u", (unsigned)i);
+    PutSong(i, Title);
+  }
+  Put("0:/MUSIC/README.TXT", (const uint8_t *)"text", 4);
+
+  /* The player holds a song open: of the two files of _FS_SHARE, the index
+     only ever uses the other one */
+  CHECK(f_open(&player, SongPath(0), FA_OPEN_EXISTING | FA_READ) == FR_OK);
+
+  CHECK(SongUtilities_IndexOpen("0:/MUSIC") == SONG_NBR);
+  CHECK(SongUtilities_IndexCount() == SONG_NBR);
+  for (i = 0; i < SONG_NBR; i++)
+  {
+    CHECK(Get(i, &rec));
+    sprintf(Title, "Song %u", (unsigned)i);
+    CHECK(strcmp(rec.Title, Title) == 0);
+    CHECK(strcmp(SongUtilities_IndexPath(&rec), SongPath(i)) == 0);
+  }
+  CHECK(!SongUtilities_IndexGet(SONG_NBR, &rec));
+
+  /* Nothing changed: the index is checked, nothing is written or parsed */
+  writes = DiskWrites;
+  CHECK(SongUtilities_IndexOpen("0:/MUSIC") == SONG_NBR);
+  CHECK(!Get(5, &rec));
+  CHECK(DiskWrites == writes);
+
+  /* One removed, one added in its directory entry, one modified: only these
+     two are parsed again */
+  CHECK(f_unlink(SongPath(3)) == FR_OK);
+  FatTime += 2;
+  PutSong(10, "Song 10 edited");
+  PutSong(41, "Song 41");
+  CHECK(SongUtilities_IndexOpen("0:/MUSIC") == SONG_NBR);
+  for (i = 0; i < SONG_NBR; i++)
+  {
+    if (i == 3)
+    {
+      CHECK(Get(i, &rec));
+      CHECK(strcmp(rec.Title, "Song 41") == 0);
+    }
+    else if (i == 10)
+    {
+      CHECK(Get(i, &rec));
+      CHECK(strcmp(rec.Title, "Song 10 edited") == 0);
+    }
+    else
+    {
+      CHECK(!Get(i, &rec));
+    }
+  }
+
+  /* More songs removed than SONG_INDEX_LOOKAHEAD */
+  for (i = 4; i < 4 + SONG_INDEX_LOOKAHEAD + 2; i++)
+  {
+    CHECK(f_unlink(SongPath(i)) == FR_OK);
+  }
+  CHECK(SongUtilities_IndexOpen("0:/MUSIC") == SONG_NBR - SONG_INDEX_LOOKAHEAD - 2);
+  for (i = 0; i < SongUtilities_IndexCount(); i++)
+  {
+    Get(i, &rec);
+  }
+  CHECK(strcmp(SongUtilities_IndexPath(&rec), SongPath(SONG_NBR - 1)) == 0);
+
+  CHECK(f_close(&player) == FR_OK);
+  SongUtilities_IndexClose();
+  CHECK(SongUtilities_IndexCount() == 0);
+
+  /* The root folder */
+  CHECK(SongUtilities_IndexOpen("0:") == 2);
+  CHECK(SongUtilities_IndexGet(0, &rec));
+  CHECK(strcmp(SongUtilities_IndexPath(&rec), "0:T.MP3") == 0);
+}
+
+int main (void)
+{
+  CHECK(f_mount(0, &Fs) == FR_OK);
+  CHECK(f_mkfs(0, 1, 0) == FR_OK);
+
+  Test_ID3();
+  Test_WMA();
+  Test_Index();
+
+  return TEST_RESULT();
+}
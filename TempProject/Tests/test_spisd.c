@@ -0,0 +1,184 @@
+/**
+  ******************************************************************************
+  * @file    test_spisd.c
+  * @brief   Host test of the SPI SD driver of the STM32072B-EVAL
+  *          (stm32072b_eval_spi_sd.c) on the simulated card of spisd_sim.c:
+  *          the identification of the card types at the low clock, the CRC7
+  *          of the commands and the CRC16 of the data blocks, the ACMD23 and
+  *          CMD25 multi-block writes with their tokens, the CMD18 reads ended
+  *          by CMD12, and the CRC and write errors.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "stm32072b_eval_spi_sd.h"
+#include "spisd_sim.h"
+#include "test.h"
+
+/* Static, and so below 4 GB: the driver hands the DMA 32 bits addresses */
+static uint8_t Buf[4 * 512];
+
+static void Spisd_Reset (uint8_t type)
+{
+  uint32_t i;
+
+  SPISD_SimReset(type);
+  for (i = 0; i < sizeof(SPISD_SimCard); i++)
+  {
+    SPISD_SimCard[i] = (uint8_t)(i * 3 + i / 512);
+  }
+  for (i = 0; i < sizeof(Buf); i++)
+  {
+    Buf[i] = (uint8_t)(i * 5 + 1);
+  }
+  CHECK(SD_Init() == SD_RESPONSE_NO_ERROR);
+}
+
+static int Card_Holds (uint32_t block, const uint8_t *data, uint32_t count)
+{
+  return memcmp(&SPISD_SimCard[block * 512], data, count * 512) == 0;
+}
+
+static void Test_Init (void)
+{
+  /* High capacity: identified at the low clock, then block addressed */
+  Spisd_Reset(SPISD_SIM_HC);
+  CHECK(SPISD_SimIdlePrescaler == SPI_BaudRatePrescaler_128);
+  CHECK((SPI1_Sim.CR1 & SPI_CR1_BR) == SPI_BaudRatePrescaler_2);
+  CHECK(SPI1_Sim.CR1 & SPI_CR1_SPE);
+  CHECK(SPISD_SimCmdCrcErrors == 0);
+  CHECK(SD_ReadSectors(Buf, 3, 1) == SD_RESPONSE_NO_ERROR);
+  CHECK(SPISD_SimLogNbr == 1);
+  CHECK(SPISD_SimLog[0].Cmd == SD_CMD_READ_SINGLE_BLOCK);
+  CHECK(SPISD_SimLog[0].Arg == 3);
+  CHECK(SPISD_SimDataPrescaler == SPI_BaudRatePrescaler_2);
+  CHECK(Card_Holds(3, Buf, 1));
+
+  /* Version 2.0 and 1.x standard capacity: byte addressed */
+  Spisd_Reset(SPISD_SIM_V2);
+  CHECK(SD_ReadSectors(Buf, 3, 1) == SD_RESPONSE_NO_ERROR);
+  CHECK(SPISD_SimLog[0].Arg == 3 * 512);
+  CHECK(Card_Holds(3, Buf, 1));
+
+  Spisd_Reset(SPISD_SIM_V1);
+  CHECK(SPISD_SimCmdCrcErrors == 0);
+  CHECK(SD_ReadSectors(Buf, 3, 1) == SD_RESPONSE_NO_ERROR);
+  CHECK(SPISD_SimLog[0].Arg == 3 * 512);
+  CHECK(Card_Holds(3, Buf, 1));
+}
+
+static void Test_Crc7 (void)
+{
+  Spisd_Reset(SPISD_SIM_HC);
+
+  /* The CRC of the specification examples, then a wrong one */
+  SD_CS_LOW();
+  SD_SendCmd(SD_CMD_GO_IDLE_STATE, 0, 0x95);
+  CHECK(SD_GetResponse(SD_IN_IDLE_STATE) == SD_RESPONSE_NO_ERROR);
+  SD_SendCmd(SD_CMD_SEND_IF_COND, 0x1AA, 0x87);
+  CHECK(SD_GetResponse(SD_IN_IDLE_STATE) == SD_RESPONSE_NO_ERROR);
+  CHECK(SPISD_SimCmdCrcErrors == 0);
+  SD_SendCmd(SD_CMD_GO_IDLE_STATE, 0, 0x97);
+  CHECK(SD_GetResponse(SD_IN_IDLE_STATE | SD_COM_CRC_ERROR) == SD_RESPONSE_NO_ERROR);
+  CHECK(SPISD_SimCmdCrcErrors == 1);
+  SD_CS_HIGH();
+}
+
+static void Test_Write (void)
+{
+  Spisd_Reset(SPISD_SIM_HC);
+
+  /* Pre-erased, one CMD25, each block with its CRC, then the stop token */
+  CHECK(SD_WriteSectors(Buf, 5, 4) == SD_RESPONSE_NO_ERROR);
+  CHECK(SPISD_SimLogNbr == 1);
+  CHECK(SPISD_SimLog[0].Cmd == SD_CMD_WRITE_MULT_BLOCK);
+  CHECK(SPISD_SimLog[0].Arg == 5);
+  CHECK(SPISD_SimLog[0].PreErase == 4);
+  CHECK(SPISD_SimLog[0].Blocks == 4);
+  CHECK(SPISD_SimLog[0].Stopped);
+  CHECK(SPISD_SimDataCrcErrors == 0);
+  CHECK(SPISD_SimLastCrc == SPISD_SimCrc16(Buf + 3 * 512, 512));
+  CHECK(Card_Holds(5, Buf, 4));
+
+  /* One block with CMD24; the CRC of 512 0xFF of the specification */
+  memset(Buf, 0xFF, 512);
+  CHECK(SD_WriteSectors(Buf, 20, 1) == SD_RESPONSE_NO_ERROR);
+  CHECK(SPISD_SimLogNbr == 2);
+  CHECK(SPISD_SimLog[1].Cmd == SD_CMD_WRITE_SINGLE_BLOCK);
+  CHECK(SPISD_SimLog[1].PreErase == 0);
+  CHECK(SPISD_SimLog[1].Blocks == 1);
+  CHECK(SPISD_SimLastCrc == 0x7FA1);
+  CHECK(Card_Holds(20, Buf, 1));
+}
+
+static void Test_Read (void)
+{
+  Spisd_Reset(SPISD_SIM_V2);
+
+  /* One CMD18 stopped by CMD12 */
+  CHECK(SD_ReadSectors(Buf, 10, 4) == SD_RESPONSE_NO_ERROR);
+  CHECK(SPISD_SimLogNbr == 1);
+  CHECK(SPISD_SimLog[0].Cmd == SD_CMD_READ_MULT_BLOCK);
+  CHECK(SPISD_SimLog[0].Arg == 10 * 512);
+  CHECK(SPISD_SimLog[0].Stopped);
+  CHECK(Card_Holds(10, Buf, 4));
+
+  /* The card is back to commands */
+  CHECK(SD_ReadSectors(Buf, 30, 1) == SD_RESPONSE_NO_ERROR);
+  CHECK(SPISD_SimLog[1].Cmd == SD_CMD_READ_SINGLE_BLOCK);
+  CHECK(Card_Holds(30, Buf, 1));
+  CHECK(SD_WriteSectors(Buf, 31, 2) == SD_RESPONSE_NO_ERROR);
+  CHECK(Card_Holds(31, Buf, 1));
+  CHECK(Card_Holds(32, Buf + 512, 1));
+}
+
+static void Test_ReadCrc (void)
+{
+  /* A corrupted block in the middle, the last one, a single one */
+  Spisd_Reset(SPISD_SIM_HC);
+  SPISD_SimBadReadCrc = 2;
+  CHECK(SD_ReadSectors(Buf, 0, 4) == SD_DATA_CRC_ERROR);
+  CHECK(SPISD_SimLog[0].Stopped);
+
+  SPISD_SimBadReadCrc = 4;
+  CHECK(SD_ReadSectors(Buf, 0, 4) == SD_DATA_CRC_ERROR);
+  CHECK(SPISD_SimLog[1].Stopped);
+
+  SPISD_SimBadReadCrc = 1;
+  CHECK(SD_ReadSectors(Buf, 0, 1) == SD_DATA_CRC_ERROR);
+
+  SPISD_SimBadReadCrc = 0;
+  CHECK(SD_ReadSectors(Buf, 0, 4) == SD_RESPONSE_NO_ERROR);
+  CHECK(Card_Holds(0, Buf, 4));
+}
+
+static void Test_WriteError (void)
+{
+  Spisd_Reset(SPISD_SIM_HC);
+
+  /* The write stops at the rejected block */
+  SPISD_SimRejectBlock = 2;
+  CHECK(SD_WriteSectors(Buf, 8, 4) == SD_RESPONSE_FAILURE);
+  CHECK(SPISD_SimLog[0].Blocks == 1);
+  CHECK(SPISD_SimLog[0].Stopped);
+  CHECK(Card_Holds(8, Buf, 1));
+  CHECK(!Card_Holds(9, Buf + 512, 1));
+
+  SPISD_SimRejectBlock = 0;
+  CHECK(SD_WriteSectors(Buf, 8, 4) == SD_RESPONSE_NO_ERROR);
+  CHECK(Card_Holds(8, Buf, 4));
+
+  /* Out of the card */
+  CHECK(SD_WriteSectors(Buf, SPISD_SIM_BLOCKS, 1) == SD_RESPONSE_FAILURE);
+}
+
+int main (void)
+{
+  Test_Init();
+  Test_Crc7();
+  Test_Write();
+  Test_Read();
+  Test_ReadCrc();
+  Test_WriteError();
+  return TEST_RESULT();
+}
@@ -0,0 +1,201 @@
+/**
+  ******************************************************************************
+  * @file    test_wav.c
+  * @brief   Host test of the PCM processing of the WAV add-on (wavaddon.c)
+  *          against the halfword sign flip it replaced and a per sample
+  *          reference: full volume, gain, mute, stereo downmix, unaligned and
+  *          odd length buffers, 8-bit samples left alone.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "wavaddon.h"
+#include "test.h"
+
+#define SAMPLES     64
+
+/* A word more on each side to catch writes out of the buffer, &Buf[2] word
+   aligned */
+static uint32_t BufWords[(SAMPLES + 4) / 2];
+#define Buf     ((uint16_t *)BufWords)
+static uint16_t In[SAMPLES + 4];
+static uint32_t Seed = 1;
+
+static uint16_t Random (void)
+{
+  Seed = Seed * 1103515245 + 12345;
+  return (uint16_t)(Seed >> 16);
+}
+
+/* Extremes first, then random samples */
+static void Fill (void)
+{
+  uint32_t i;
+
+  for (i = 0; i < SAMPLES + 4; i++)
+  {
+    In[i] = Random();
+  }
+  In[2] = 0x8000;
+  In[3] = 0x8000;
+  In[4] = 0x7FFF;
+  In[5] = 0x7FFF;
+  In[6] = 0x0000;
+  In[7] = 0xFFFF;
+  memcpy(Buf, In, sizeof(In));
+}
+
+/* The conversion before the single pass: the sign bit only */
+static uint16_t Old_Sample (uint16_t s)
+{
+  return s ^ 0x8000;
+}
+
+static uint16_t Ref_Sample (uint16_t s, int32_t gain)
+{
+  return (uint16_t)((((int32_t)(int16_t)s * gain) >> 15) + 0x8000);
+}
+
+static uint16_t Ref_Mean (uint16_t l, uint16_t r, int32_t gain)
+{
+  return (uint16_t)(((((int32_t)(int16_t)l + (int16_t)r) * gain) >> 16) + 0x8000);
+}
+
+/* Samples first..first+count-1 of Buf processed, the others untouched */
+static int Processed (uint32_t first, uint32_t count, int32_t gain)
+{
+  uint32_t i;
+
+  for (i = 0; i < SAMPLES + 4; i++)
+  {
+    uint16_t expect = ((i >= first) && (i < first + count)) ? Ref_Sample(In[i], gain) : In[i];
+    if (Buf[i] != expect)
+    {
+      printf("sample %u: %04x, expected %04x\n", i, Buf[i], expect);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void Test_FullVolume (void)
+{
+  uint32_t i;
+
+  WAVADDON_Init(0x80 | 16, 0);
+  VolumeControl(100);
+
+  /* The same as the sign flip, aligned, unaligned, odd length */
+  Fill();
+  WAVADDON_AudioProcessing(&Buf[2], SAMPLES * 2);
+  for (i = 2; i < SAMPLES + 2; i++)
+  {
+    CHECK(Buf[i] == Old_Sample(In[i]));
+  }
+  CHECK(Processed(2, SAMPLES, 0x8000));
+
+  Fill();
+  WAVADDON_AudioProcessing(&Buf[1], SAMPLES * 2);
+  CHECK(Processed(1, SAMPLES, 0x8000));
+
+  WAVADDON_Init(0x40 | 16, 0);
+  Fill();
+  WAVADDON_AudioProcessing(&Buf[2], (SAMPLES - 1) * 2);
+  CHECK(Processed(2, SAMPLES - 1, 0x8000));
+
+  /* Above the maximum */
+  VolumeControl(255);
+  Fill();
+  WAVADDON_AudioProcessing(&Buf[2], SAMPLES * 2);
+  CHECK(Processed(2, SAMPLES, 0x8000));
+}
+
+static void Test_Volume (void)
+{
+  WAVADDON_Init(0x80 | 16, 0);
+
+  /* Half of the maximum volume, 100 */
+  VolumeControl(50);
+  Fill();
+  WAVADDON_AudioProcessing(&Buf[2], SAMPLES * 2);
+  CHECK(Processed(2, SAMPLES, 0x4000));
+  CHECK(Buf[2] == 0x4000);
+  CHECK(Buf[4] == 0xBFFF);
+
+  Fill();
+  WAVADDON_AudioProcessing(&Buf[1], SAMPLES * 2);
+  CHECK(Processed(1, SAMPLES, 0x4000));
+
+  WAVADDON_Init(0x40 | 16, 0);
+  Fill();
+  WAVADDON_AudioProcessing(&Buf[2], (SAMPLES - 1) * 2);
+  CHECK(Processed(2, SAMPLES - 1, 0x4000));
+
+  /* Mute plays the mid-scale, unmute restores the volume */
+  MuteControl(AUDIO_MUTE_ON);
+  Fill();
+  WAVADDON_AudioProcessing(&Buf[2], SAMPLES * 2);
+  CHECK(Processed(2, SAMPLES, 0));
+  CHECK(Buf[2] == 0x8000);
+
+  MuteControl(AUDIO_MUTE_OFF);
+  Fill();
+  WAVADDON_AudioProcessing(&Buf[2], SAMPLES * 2);
+  CHECK(Processed(2, SAMPLES, 0x4000));
+}
+
+static void Test_Downmix (void)
+{
+  uint32_t i;
+  int ok = 1;
+
+  /* Both outputs play the mean of the channels */
+  WAVADDON_Init(0x80 | 16, WAVADDON_OPTION_DOWNMIX);
+  VolumeControl(100);
+  Fill();
+  WAVADDON_AudioProcessing(&Buf[2], SAMPLES * 2);
+  for (i = 2; i < SAMPLES + 2; i += 2)
+  {
+    ok &= (Buf[i] == Ref_Mean(In[i], In[i + 1], 0x8000)) && (Buf[i + 1] == Buf[i]);
+  }
+  CHECK(ok);
+  CHECK(Buf[2] == 0x0000);
+  CHECK(Buf[4] == 0xFFFF);
+  CHECK(Buf[6] == 0x7FFF);
+  CHECK((Buf[0] == In[0]) && (Buf[1] == In[1]) && (Buf[SAMPLES + 2] == In[SAMPLES + 2]));
+
+  VolumeControl(50);
+  Fill();
+  WAVADDON_AudioProcessing(&Buf[2], SAMPLES * 2);
+  ok = 1;
+  for (i = 2; i < SAMPLES + 2; i += 2)
+  {
+    ok &= (Buf[i] == Ref_Mean(In[i], In[i + 1], 0x4000)) && (Buf[i + 1] == Buf[i]);
+  }
+  CHECK(ok);
+
+  /* Nothing to mix in a mono stream */
+  WAVADDON_Init(0x40 | 16, WAVADDON_OPTION_DOWNMIX);
+  Fill();
+  WAVADDON_AudioProcessing(&Buf[2], SAMPLES * 2);
+  CHECK(Processed(2, SAMPLES, 0x4000));
+}
+
+static void Test_8Bit (void)
+{
+  /* Unsigned already */
+  WAVADDON_Init(0x80 | 8, 0);
+  VolumeControl(50);
+  Fill();
+  WAVADDON_AudioProcessing(&Buf[2], SAMPLES * 2);
+  CHECK(memcmp(Buf, In, sizeof(In)) == 0);
+}
+
+int main (void)
+{
+  Test_FullVolume();
+  Test_Volume();
+  Test_Downmix();
+  Test_8Bit();
+  return TEST_RESULT();
+}
@@ -0,0 +1,173 @@
+/**
+  ******************************************************************************
+  * @file    usb_sim.c
+  * @brief   Software model of the STM32F0 USB peripheral for the host tests:
+  *          the endpoint register write semantics and the SIE handling of
+  *          single buffered, double buffered and isochronous endpoints.
+  ******************************************************************************
+  */
+
+#include <string.h>
+#include "usb_sim.h"
+#include "usb_regs.h"
+
+uint32_t USB_SimReg[0x60 / 4];
+uint16_t PMA_Sim[PMA_SIM_SIZE / 2];
+
+static uint16_t USB_SimEP[USB_SIM_EP_NUM];
+
+/* Bits toggled by writing 1, and read/write bits */
+#define EP_TOGGLE_BITS  (EP_DTOG_RX | EPRX_STAT | EP_DTOG_TX | EPTX_STAT)
+#define EP_RW_BITS      (EP_T_FIELD | EP_KIND | EPADDR_FIELD)
+
+/* ISTR shows the lowest endpoint with a correct transfer pending */
+static void USB_SimUpdateIstr (void)
+{
+  uint8_t ep;
+
+  USB_SimReg[0x44 / 4] = 0;
+  for (ep = 0; ep < USB_SIM_EP_NUM; ep++)
+  {
+    if (USB_SimEP[ep] & (EP_CTR_RX | EP_CTR_TX))
+    {
+      USB_SimReg[0x44 / 4] = ISTR_CTR | ep |
+                             ((USB_SimEP[ep] & EP_CTR_RX) ? ISTR_DIR : 0);
+      return;
+    }
+  }
+}
+
+uint16_t USB_SimGetEP (uint8_t ep)
+{
+  return USB_SimEP[ep];
+}
+
+void USB_SimSetEP (uint8_t ep, uint16_t val)
+{
+  uint16_t reg = USB_SimEP[ep];
+
+  USB_SimEP[ep] = (reg & val & (EP_CTR_RX | EP_CTR_TX)) |
+                  (reg & EP_SETUP) |
+                  (val & EP_RW_BITS) |
+                  ((reg ^ val) & EP_TOGGLE_BITS);
+  USB_SimUpdateIstr();
+}
+
+void USB_SimReset (void)
+{
+  memset(USB_SimReg, 0, sizeof(USB_SimReg));
+  memset(USB_SimEP, 0, sizeof(USB_SimEP));
+  memset(PMA_Sim, 0, sizeof(PMA_Sim));
+}
+
+/* BTABLE entry of an endpoint: 0 TX address, 1 TX count, 2 RX address,
+   3 RX count. Buffer 0 of a double buffered endpoint uses the TX fields,
+   buffer 1 the RX fields. */
+static uint16_t *USB_SimBTable (uint8_t ep, uint8_t entry)
+{
+  return &PMA_Sim[(USB_SimReg[0x50 / 4] & 0xFFF8) / 2 + ep * 4 + entry];
+}
+
+/* Size of the buffer a RX count field allocates */
+static uint16_t USB_SimRxSize (uint16_t count)
+{
+  uint16_t blocks = (count >> 10) & 0x1F;
+
+  return (count & 0x8000) ? (blocks + 1) * 32 : blocks * 2;
+}
+
+static uint8_t USB_SimIsDblBuf (uint16_t reg)
+{
+  return ((reg & EP_T_FIELD) == EP_BULK) && ((reg & EP_KIND) != 0);
+}
+
+int USB_SimIn (uint8_t ep, uint8_t *buf)
+{
+  uint16_t reg = USB_SimEP[ep];
+  uint8_t  bufnum;
+  uint16_t len;
+
+  if ((reg & EPTX_STAT) != EP_TX_VALID)
+  {
+    return -1;
+  }
+
+  if ((reg & EP_T_FIELD) == EP_ISOCHRONOUS)
+  {
+    /* No handshake: DTOG_TX selects the buffer and toggles every frame */
+    bufnum = (reg & EP_DTOG_TX) ? 1 : 0;
+  }
+  else if (USB_SimIsDblBuf(reg))
+  {
+    /* The buffer DTOG_TX points to is the firmware's while SW_BUF (DTOG_RX)
+       points to it too */
+    if (((reg & EP_DTOG_TX) != 0) == ((reg & EP_DTOG_RX) != 0))
+    {
+      return -1;
+    }
+    bufnum = (reg & EP_DTOG_TX) ? 1 : 0;
+  }
+  else
+  {
+    bufnum = 0;
+    reg = (reg & ~EPTX_STAT) | EP_TX_NAK;
+  }
+
+  len = *USB_SimBTable(ep, bufnum * 2 + 1) & 0x3FF;
+  memcpy(buf, (uint8_t *)PMA_Sim + *USB_SimBTable(ep, bufnum * 2), len);
+
+  USB_SimEP[ep] = (reg ^ EP_DTOG_TX) | EP_CTR_TX;
+  USB_SimUpdateIstr();
+  return len;
+}
+
+int USB_SimOut (uint8_t ep, const uint8_t *buf, uint16_t len)
+{
+  uint16_t reg = USB_SimEP[ep];
+  uint8_t  bufnum;
+  uint16_t addr;
+  uint16_t *count;
+
+  if ((reg & EPRX_STAT) != EP_RX_VALID)
+  {
+    return -1;
+  }
+
+  if (USB_SimIsDblBuf(reg))
+  {
+    /* The buffer DTOG_RX points to is the firmware's while SW_BUF (DTOG_TX)
+       points to it too */
+    if (((reg & EP_DTOG_RX) != 0) == ((reg & EP_DTOG_TX) != 0))
+    {
+      return -1;
+    }
+    bufnum = (reg & EP_DTOG_RX) ? 1 : 0;
+  }
+  else
+  {
+    bufnum = 0;
+    reg = (reg & ~EPRX_STAT) | EP_RX_NAK;
+  }
+
+  /* Buffer 0 of a double buffered endpoint uses the TX fields */
+  if (USB_SimIsDblBuf(reg) && (bufnum == 0))
+  {
+    addr  = *USB_SimBTable(ep, 0);
+    count = USB_SimBTable(ep, 1);
+  }
+  else
+  {
+    addr  = *USB_SimBTable(ep, 2);
+    count = USB_SimBTable(ep, 3);
+  }
+  if (len > USB_SimRxSize(*count))
+  {
+    return -1;
+  }
+  memcpy((uint8_t *)PMA_Sim + addr, buf, len);
+  *count = (*count & 0xFC00) | len;
+
+  USB_SimEP[ep] = (reg ^ EP_DTOG_RX) | EP_CTR_RX;
+  USB_SimUpdateIstr();
+  return len;
+}
@@ -0,0 +1,37 @@
+/**
+  ******************************************************************************
+  * @file    usb_sim.h
+  * @brief   Simulated USB peripheral for the host tests, forced in front of
+  *          the driver sources with -include: the endpoint registers with
+  *          their toggle and clear-only bits, the general registers and the
+  *          PMA, and the SIE side of the IN and OUT transactions (usb_sim.c).
+  ******************************************************************************
+  */
+
+#ifndef __USB_SIM_H
+#define __USB_SIM_H
+
+#include <stdint.h>
+#include "pma_sim.h"
+
+#define USB_SIM_EP_NUM  8
+
+/* CNTR, ISTR, FNR, DADDR, BTABLE, ... after the endpoint registers */
+extern uint32_t USB_SimReg[0x60 / 4];
+
+#define RegBase ((uintptr_t)USB_SimReg)
+
+uint16_t USB_SimGetEP (uint8_t ep);
+void     USB_SimSetEP (uint8_t ep, uint16_t val);
+
+#define _GetENDPOINT(bEpNum)            USB_SimGetEP(bEpNum)
+#define _SetENDPOINT(bEpNum,wRegValue)  USB_SimSetEP(bEpNum, (uint16_t)(wRegValue))
+
+/* Transactions of the host: the number of bytes sent or received, -1 when
+   the endpoint NAKs. The CTR flag is raised in the endpoint register and in
+   ISTR as on the device. */
+void USB_SimReset (void);
+int  USB_SimIn (uint8_t ep, uint8_t *buf);
+int  USB_SimOut (uint8_t ep, const uint8_t *buf, uint16_t len);
+
+#endif /* __USB_SIM_H */
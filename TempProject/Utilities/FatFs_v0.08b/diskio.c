@@ -7,12 +7,31 @@
 /*-----------------------------------------------------------------------*/
 #include <string.h>
 #include "diskio.h"
+#include "ffconf.h"		/* Drive configuration */
 #include "spi_spiflash.h"
 /*-----------------------------------------------------------------------*/
 /* Correspondence between physical drive number and physical drive.      */
 /* Note that Tiny-FatFs supports only single drive and always            */
 /* accesses drive number 0.                                              */
 
+#ifdef USE_SPI_SD
+#include "stm32072b_eval_spi_sd.h"
+
+/* Drive 1: SD card on the SPI interface of the STM32072B-EVAL. Several
+   sectors are read or written with one CMD18 or CMD25, the data blocks
+   are moved by DMA. */
+#define SD_DRIVE	1
+
+static SD_CardInfo SD_Info;
+static volatile DSTATUS SD_Stat = STA_NOINIT;
+
+static DSTATUS SD_disk_initialize (void);
+static DSTATUS SD_disk_status (void);
+static DRESULT SD_disk_read (BYTE *buff, DWORD sector, BYTE count);
+static DRESULT SD_disk_write (const BYTE *buff, DWORD sector, BYTE count);
+static DRESULT SD_disk_ioctl (BYTE ctrl, void *buff);
+#endif /* USE_SPI_SD */
+
 /*-----------------------------------------------------------------------*/
 /* Inidialize a Drive                                                    */
 
@@ -20,6 +39,9 @@ DSTATUS disk_initialize (
 	BYTE drv				/* Physical drive nmuber (0..) */
 )
 {
+#ifdef USE_SPI_SD
+	if (drv == SD_DRIVE) return SD_disk_initialize();
+#endif
 	return 0;
 }
 
@@ -32,6 +54,9 @@ DSTATUS disk_status (
 	BYTE drv		/* Physical drive nmuber (0..) */
 )
 {	
+#ifdef USE_SPI_SD
+	if (drv == SD_DRIVE) return SD_disk_status();
+#endif
 	return 0;
 }
 
@@ -47,6 +72,9 @@ DRESULT disk_read (
 	BYTE count		/* Number of sectors to read (1..255) */
 )
 {	 
+#ifdef USE_SPI_SD
+	if (drv == SD_DRIVE) return SD_disk_read(buff, sector, count);
+#endif
   sFLASH_sector_read((uint8_t *)buff,sector,count);
 	return RES_OK;
 }
@@ -64,6 +92,9 @@ DRESULT disk_write (
 	BYTE count			/* Number of sectors to write (1..255) */
 )
 {
+#ifdef USE_SPI_SD
+	if (drv == SD_DRIVE) return SD_disk_write(buff, sector, count);
+#endif
 	  sFLASH_sector_write((uint8_t *)(buff),sector,count);  
 	
   	return RES_OK;
@@ -83,8 +114,10 @@ DRESULT disk_ioctl (
 {
 	DRESULT res = RES_OK;
 	DWORD nFrom,nTo;
-	int i;
 	
+#ifdef USE_SPI_SD
+	if (drv == SD_DRIVE) return SD_disk_ioctl(ctrl, buff);
+#endif
 	switch(ctrl)
 	{
 		case CTRL_SYNC :
@@ -95,7 +128,7 @@ DRESULT disk_ioctl (
 			break;
 	 
 	  case GET_SECTOR_COUNT:
-			*(DWORD*)buff = FLASH_SECTOR_COUNT;
+			*(DWORD*)buff = FLASH_VOLUME_SECTOR_COUNT;
 			break;
 	 
 	  case GET_BLOCK_SIZE:
@@ -104,10 +137,10 @@ DRESULT disk_ioctl (
 		
 		//
 		case CTRL_ERASE_SECTOR:
+			/* Erased in background, the next write of these sectors skips the erase */
 			nFrom = *((DWORD*)buff);
 			nTo = *(((DWORD*)buff)+1);
-			for(i = nFrom;i <= nTo;i ++)
-				sFLASH_EraseSector(i*FLASH_SECTOR_SIZE);	
+			sFLASH_TrimSectors(nFrom, nTo - nFrom + 1);
 			break;
 			
 		default:
@@ -123,6 +156,82 @@ DWORD get_fattime(void){
 
 
 
+#ifdef USE_SPI_SD
+/*-----------------------------------------------------------------------*/
+/* SD card on SPI                                                        */
+
+static DSTATUS SD_disk_initialize (void)
+{
+	if (SD_Detect() != SD_PRESENT) {
+		SD_Stat = STA_NOINIT | STA_NODISK;
+	} else if ((SD_Init() == SD_RESPONSE_NO_ERROR) &&
+	           (SD_GetCardInfo(&SD_Info) == SD_RESPONSE_NO_ERROR)) {
+		SD_Stat = 0;
+	} else {
+		SD_Stat = STA_NOINIT;
+	}
+	return SD_Stat;
+}
+
+static DSTATUS SD_disk_status (void)
+{
+	/* A removed card must be initialized again */
+	if (SD_Detect() != SD_PRESENT) {
+		SD_Stat = STA_NOINIT | STA_NODISK;
+	}
+	return SD_Stat;
+}
+
+static DRESULT SD_disk_read (BYTE *buff, DWORD sector, BYTE count)
+{
+	if (SD_Stat & STA_NOINIT) return RES_NOTRDY;
+
+	return (SD_ReadSectors(buff, sector, count) == SD_RESPONSE_NO_ERROR) ? RES_OK : RES_ERROR;
+}
+
+#if _READONLY == 0
+static DRESULT SD_disk_write (const BYTE *buff, DWORD sector, BYTE count)
+{
+	if (SD_Stat & STA_NOINIT) return RES_NOTRDY;
+
+	return (SD_WriteSectors(buff, sector, count) == SD_RESPONSE_NO_ERROR) ? RES_OK : RES_ERROR;
+}
+#endif /* _READONLY */
+
+static DRESULT SD_disk_ioctl (BYTE ctrl, void *buff)
+{
+	if (SD_Stat & STA_NOINIT) return RES_NOTRDY;
+
+	switch(ctrl)
+	{
+		case CTRL_SYNC :
+			/* SD_WriteSectors returns once the card is done */
+			return RES_OK;
+
+		case GET_SECTOR_SIZE:
+			*(WORD*)buff = SD_BLOCK_SIZE;
+			return RES_OK;
+
+		case GET_SECTOR_COUNT:
+			*(DWORD*)buff = SD_Info.CardBlockNbr;
+			return RES_OK;
+
+		case GET_BLOCK_SIZE:
+			*(DWORD*)buff = 1;
+			return RES_OK;
+
+		case CTRL_ERASE_SECTOR:
+			/* Not erased: ACMD23 lets the card pre-erase on write */
+			return RES_OK;
+
+		default:
+			return RES_PARERR;
+	}
+}
+#endif /* USE_SPI_SD */
+
+
+
 
 
 
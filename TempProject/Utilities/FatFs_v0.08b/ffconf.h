@@ -125,7 +125,15 @@
 / Physical Drive Configurations
 /----------------------------------------------------------------------------*/
 
+/* Uncomment to add the SD card of the STM32072B-EVAL, on SPI, as drive 1,
+/  next to the SPI flash on drive 0. */
+//#define USE_SPI_SD
+
+#ifdef USE_SPI_SD
+#define _VOLUMES	2
+#else
 #define _VOLUMES	1
+#endif
 /* Number of volumes (logical drives) to be used. */
 
 
@@ -143,7 +151,7 @@
 / is tied to the partitions listed in VolToPart[]. */
 
 
-#define	_USE_ERASE	0	/* 0:Disable or 1:Enable */
+#define	_USE_ERASE	1	/* 0:Disable or 1:Enable */
 /* To enable sector erase feature, set _USE_ERASE to 1. CTRL_ERASE_SECTOR command
 /  should be added to the disk_ioctl functio. */
 
@@ -45,29 +45,43 @@ typedef struct
 {
   uint8_t NumberOfChannels;/* 1: mono; 2: stereo */
   uint8_t BitsPerSample; /*8: 8-bit; 16: 16-bit */
+  uint8_t Downmix; /* 1: both channels of a stereo stream play their mean */
 }WavParam_TypeDef;
 
+/* Private define ------------------------------------------------------------*/
+/* Q15 gain applied to the samples, DEFAULT_VOLMAX being full scale */
+#define WAVADDON_GAIN_UNITY           0x8000
+
 /* Private macro -------------------------------------------------------------*/
+/* Signed sample to the unsigned left aligned 12-bit format of the DAC, the
+   4 low bits being ignored by the DHR12Lx registers */
+#define WAVADDON_SAMPLE(S, G)         ((uint16_t)((((int32_t)(S) * (int32_t)(G)) >> 15) + 0x8000))
+
 /* Private variables ---------------------------------------------------------*/
 /* By default: use stereo (2) and 16 bits per sample */
-WavParam_TypeDef WavParam = {2, 16};
+WavParam_TypeDef WavParam = {2, 16, 0};
 __IO float  AudioVolume = 0.25;
 __IO float  SavedAudioVol = 0.25;
+/* AudioVolume converted once for the sample processing */
+static __IO uint32_t AudioGain = WAVADDON_GAIN_UNITY / 2;
 /* Private function prototypes -----------------------------------------------*/
-static uint32_t SignProcessing(void* pBuffer, uint32_t BufferSize);
+static uint32_t PcmProcessing(void* pBuffer, uint32_t BufferSize);
+static void GainUpdate(void);
 
 /* Private functions ---------------------------------------------------------*/
 
 /**
   * @brief Initialize the Audio data processing: number of channels and bits per sample.
   * @param NChannelBitsSample: the number of channels concatenated to the number of bits per sample.
-  * @param Option: Not used.
+  * @param Option: WAVADDON_OPTION_DOWNMIX to play the mean of the two channels
+  *        of a stereo stream on both outputs, else 0.
   * @retval none
   */
 void WAVADDON_Init(uint32_t NChannelBitsSample, uint32_t Option)
 {
   WavParam.NumberOfChannels = (uint8_t) (NChannelBitsSample & 0xC0)>>6;
   WavParam.BitsPerSample = (uint8_t) (NChannelBitsSample & 0x3f);
+  WavParam.Downmix = ((Option & WAVADDON_OPTION_DOWNMIX) != 0) ? 1 : 0;
 }
 
 /**
@@ -78,42 +92,111 @@ void WAVADDON_Init(uint32_t NChannelBitsSample, uint32_t Option)
   */
 void WAVADDON_AudioProcessing(void* pBuffer, uint32_t BufferSize)
 {
-  /* Process the sign: It is used in case of 16-bit data */
-  SignProcessing(pBuffer, BufferSize);
+  /* Volume, downmix and sign in one pass: It is used in case of 16-bit data */
+  PcmProcessing(pBuffer, BufferSize);
 }
 
 /**
-  * @brief Toggle sign bit of input buffer.
+  * @brief Convert the 16-bit signed samples of the input buffer for the DAC:
+  *        volume, downmix of a stereo stream and sign bit, in a single pass.
+  * @note  A 32-bit aligned buffer is processed one word, that is two samples,
+  *        at a time. At full volume without downmix only the sign bits change.
   * @param pBuffer: pointer at the audio buffer. It must be 16 bit-aligned.
   * @param BufferSize: the size of the buffer in bytes.
   * @retval 0 if correct configuration, otherwise wrong configuration.
   */
-static uint32_t SignProcessing(void* pBuffer, uint32_t BufferSize)
+static uint32_t PcmProcessing(void* pBuffer, uint32_t BufferSize)
 {
-  uint32_t readdata = (uint32_t)pBuffer;
-  uint32_t loopcounter = 0;
+  uint32_t *word = (uint32_t *)pBuffer;
+  uint16_t *half = (uint16_t *)pBuffer;
+  uint32_t gain = AudioGain;
+  uint32_t loopcounter = BufferSize / 4;
+  uint32_t data = 0;
+  int32_t  sum = 0;
   
   /* Check if data is 8-bit or 16-bit */
   if(WavParam.BitsPerSample == 8)
   {
     /* No sign bit inversion in case of 8-bit samples: data are always unsigned */
+    return 0;
   }
-  else if(WavParam.BitsPerSample == 16)
+  else if(WavParam.BitsPerSample != 16)
   {
-    /* Invert sign bit: PCM format is 16-bit signed and DAC is 12-bit unsigned */
+    return 1;
+  }
+  
+  if(((uint32_t)pBuffer & 3) != 0)
+  {
+    /* The Cortex-M0 does not access unaligned words: one sample at a time */
     for(loopcounter = 0; loopcounter < BufferSize/2; loopcounter++)
     {
-      *(uint16_t*)readdata ^= 0x8000;
-      readdata+=2;
+      *half = WAVADDON_SAMPLE((int16_t)*half, gain);
+      half++;
+    }
+    return 0;
+  }
+  
+  if((gain == WAVADDON_GAIN_UNITY) && (WavParam.Downmix == 0))
+  {
+    /* Invert sign bit: PCM format is 16-bit signed and DAC is 12-bit unsigned */
+    while(loopcounter--)
+    {
+      *word++ ^= 0x80008000;
+    }
+  }
+  else if((WavParam.NumberOfChannels == 2) && (WavParam.Downmix != 0))
+  {
+    /* The mean of both channels: the sum scaled with one more bit of shift */
+    while(loopcounter--)
+    {
+      data = *word;
+      sum = (int32_t)(int16_t)data + ((int32_t)data >> 16);
+      data = (uint16_t)(((sum * (int32_t)gain) >> 16) + 0x8000);
+      *word++ = data | (data << 16);
     }
   }
   else
   {
-    return 1;
+    while(loopcounter--)
+    {
+      data = *word;
+      *word++ = WAVADDON_SAMPLE((int16_t)data, gain) |
+                ((uint32_t)WAVADDON_SAMPLE((int32_t)data >> 16, gain) << 16);
+    }
+  }
+  
+  /* Last sample of a mono buffer of odd length */
+  if((BufferSize & 2) != 0)
+  {
+    half = (uint16_t *)word;
+    *half = WAVADDON_SAMPLE((int16_t)*half, gain);
   }
   return 0;
 }
 
+/**
+  * @brief Convert AudioVolume to the Q15 gain used by the sample processing.
+  * @param None.
+  * @retval None.
+  */
+static void GainUpdate(void)
+{
+  float gain = (AudioVolume / DEFAULT_VOLMAX) * WAVADDON_GAIN_UNITY;
+  
+  if(gain >= WAVADDON_GAIN_UNITY)
+  {
+    AudioGain = WAVADDON_GAIN_UNITY;
+  }
+  else if(gain <= 0)
+  {
+    AudioGain = 0;
+  }
+  else
+  {
+    AudioGain = (uint32_t)gain;
+  }
+}
+
 /**
   * @brief Control the global variable AudioVolume.
   * @param Volume: The volume of audio stream. It should be lower than DEFAULT_VOLMAX.
@@ -135,6 +218,7 @@ void VolumeControl(uint8_t Volume)
   {
     AudioVolume = DEFAULT_VOLMAX;
   }
+  GainUpdate();
 }
 
 /**
@@ -158,6 +242,7 @@ void MuteControl(uint32_t Cmd)
     /* Unmute: Set volume to the previous saved value */
     AudioVolume = SavedAudioVol;
   }
+  GainUpdate();
 }
 
 #endif /*  __WAV_ADDON__ */
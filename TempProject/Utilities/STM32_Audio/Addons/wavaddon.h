@@ -57,6 +57,9 @@
 #define DEFAULT_VOLMIN                0.0f
 #define DEFAULT_VOLMAX                0.5f
 
+/* WAVADDON_Init options */
+#define WAVADDON_OPTION_DOWNMIX       0x01  /* Stereo played as the mean of both channels */
+
 /* Private variables ---------------------------------------------------------*/
 /* Private function prototypes -----------------------------------------------*/
 void WAVADDON_Init(uint32_t NChannelBitsSample, uint32_t Option);
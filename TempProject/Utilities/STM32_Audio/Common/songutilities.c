@@ -262,6 +262,10 @@ typedef enum
 #define wmin(x,y)                                          (((uint32_t)(x) < (uint32_t)(y))? (x):(y))
 
 /* MP3 macro -----------------------------------------------------------------*/
+/* The tags shown through TAGS_TypeDef: parsing stops once all are found */
+#define SONG_TAG_BIT(type)                                 ((uint32_t)1 << (type))
+#define SONG_TAGS_DISPLAYED                                (SONG_TAG_BIT(SONG_TITLE) | SONG_TAG_BIT(ARTIST) |\
+    SONG_TAG_BIT(ALBUM_TITLE) | SONG_TAG_BIT(YEAR) | SONG_TAG_BIT(GENRE))
 #define GetLength(pBuf,Offset)                             ((uint32_t)(pBuf[Offset + 4] << 24) |\
     (pBuf[Offset + 5] << 16) |\
     (pBuf[Offset + 6] << 8)  |\
@@ -310,8 +314,8 @@ uint8_t SongUtilities_IsGUID_eq(int32_t *_GUID1, int32_t* _GUID2);
 #ifdef __WMA_DECODER__
  void SongUtilities_WMAstrncpy(uint8_t *pDest, const uint8_t *pBuf, uint32_t length);
  int8_t SongUtilities_WMAstrcmp(const uint8_t * string1, const uint8_t * string2);
- void SongUtilities_parseContentDescriptor(uint8_t * pBuf, TAGS_TypeDef *pTAGS);
- void SongUtilities_parseExtendedContentDescriptors(uint8_t *pBuf, TAGS_TypeDef *pTAGS );
+ void SongUtilities_parseContentDescriptor(uint8_t * pBuf, uint32_t Length, TAGS_TypeDef *pTAGS);
+ void SongUtilities_parseExtendedContentDescriptors(uint8_t *pBuf, uint32_t Length, TAGS_TypeDef *pTAGS );
 #endif /* __WMA_DECODER__ */
 
 /**
@@ -384,54 +388,55 @@ int8_t SongUtilities_WMAstrcmp(const uint8_t * string1, const uint8_t * string2)
 /**
   * @brief  extract title and author from content descriptor object.
   * @param  pBuf: data buffer.
+  * @param  Length: bytes of the object in the buffer, the strings are not
+  *         read past it.
   * @param  pTAGS: output struct.
   * @retval None.
   */
-void SongUtilities_parseContentDescriptor(uint8_t * pBuf, TAGS_TypeDef *pTAGS)
+void SongUtilities_parseContentDescriptor(uint8_t * pBuf, uint32_t Length, TAGS_TypeDef *pTAGS)
 {
   ASFContentD_TypeDef * tmp = (ASFContentD_TypeDef*)pBuf;
   uint8_t * pointer = NULL;
+  uint32_t left = 0;
+
+  if (Length <= sizeof(ASFContentD_H))
+  {
+    return;
+  }
   pointer = pBuf;
   pointer += sizeof(ASFContentD_H);
+  left = Length - sizeof(ASFContentD_H);
 
-#ifdef USE_DYNAMIC_MEMORY /* use dynamic memory allocation */
+  /* SongUtilities_WMAstrncpy reads up to the length given included: the
+     copies stop one byte before the end of the buffer */
   /* extract title */
   if (tmp->Header.TitleLength)
   {
     if (pTAGS->Title != NULL)
     {
-      free(pTAGS->Title);
+      SongUtilities_WMAstrncpy((uint8_t*)pTAGS->Title, (uint8_t *) pointer , wmin(wmin(tmp->Header.TitleLength, MAX_TAG_STRING_LENGTH), left - 1));
+    }
+    if (tmp->Header.TitleLength >= left)
+    {
+      return;
     }
-    pTAGS->Title = (char *)malloc(tmp->Header.TitleLength);
-    SongUtilities_WMAstrncpy((uint8_t*)pTAGS->Title, (uint8_t *) pointer , tmp->Header.TitleLength << 1);
     pointer += tmp->Header.TitleLength;
+    left -= tmp->Header.TitleLength;
   }
   /* extract author */
   if (tmp->Header.AuthorLength)
   {
     if (pTAGS->Artist != NULL)
     {
-      free(pTAGS->Artist);
-    }    
-    pTAGS->Artist = (char *)malloc(tmp->Header.AuthorLength);
-    SongUtilities_WMAstrncpy((uint8_t*)pTAGS->Artist, (uint8_t *) pointer , tmp->Header.AuthorLength << 1);
-    pointer += tmp->Header.AuthorLength;
-  }
-
-#else /* Not USE_DYNAMIC_MEMORY */
-  /* extract title */
-  if (tmp->Header.TitleLength)
-  {
-    SongUtilities_WMAstrncpy((uint8_t*)pTAGS->Title, (uint8_t *) pointer , tmp->Header.TitleLength << 1);
-    pointer += tmp->Header.TitleLength;
-  }
-  /* extract author */
-  if (tmp->Header.AuthorLength)
-  {
-    SongUtilities_WMAstrncpy((uint8_t*)pTAGS->Artist, (uint8_t *) pointer , tmp->Header.AuthorLength << 1);
+      SongUtilities_WMAstrncpy((uint8_t*)pTAGS->Artist, (uint8_t *) pointer , wmin(wmin(tmp->Header.AuthorLength, MAX_TAG_STRING_LENGTH), left - 1));
+    }
+    if (tmp->Header.AuthorLength >= left)
+    {
+      return;
+    }
     pointer += tmp->Header.AuthorLength;
+    left -= tmp->Header.AuthorLength;
   }
-#endif /* USE_DYNAMIC_MEMORY */
 
   /* can be extracted too */
   if (tmp->Header.CprLength)
@@ -453,16 +458,19 @@ void SongUtilities_parseContentDescriptor(uint8_t * pBuf, TAGS_TypeDef *pTAGS)
 /**
   * @brief  extract song description from extended content descriptor object.
   * @param  pBuf: data buffer.
+  * @param  Length: bytes of the object in the buffer, the descriptors past
+  *         it are not parsed.
   * @param  pTAGS: output struct.
   * @retval None.
   */
-void SongUtilities_parseExtendedContentDescriptors(uint8_t *pBuf, TAGS_TypeDef *pTAGS )
+void SongUtilities_parseExtendedContentDescriptors(uint8_t *pBuf, uint32_t Length, TAGS_TypeDef *pTAGS )
 {
   __IO uint32_t nb_descriptors;
   static uint8_t tmpBuf[256];
   uint16_t NameLength = 0, ValueLength = 0;
 
   uint8_t * pointer;
+  uint8_t * end = pBuf + Length;
 
   /* retrieve number of descriptors */
   nb_descriptors = *(uint16_t *)pBuf;
@@ -470,73 +478,19 @@ void SongUtilities_parseExtendedContentDescriptors(uint8_t *pBuf, TAGS_TypeDef *
 
   while (nb_descriptors--)
   {
+    /* the descriptor fields must be in the buffer */
+    if ((pointer + sizeof(uint16_t)) > end)
+      break;
     /* retrieve Name field Length */
     NameLength = DescriptorNameLength(pointer);
-    if (NameLength > 255)
+    if ((NameLength > 255) || ((pointer + NameLength + FieldLenght) > end))
       break;
     SongUtilities_WMAstrncpy(tmpBuf, (uint8_t *)DescriptorName(pointer), NameLength);
     /* retrieve Value field Length */
     ValueLength = DescriptorLenght(pointer, (NameLength) );
-    if (ValueLength > 255)
+    if ((ValueLength > 255) || ((pointer + NameLength + FieldLenght + ValueLength) > end))
       break;
 
-#ifdef USE_DYNAMIC_MEMORY /* use dynamic memory allocation */
-    /* check for title object */
-    if (!SongUtilities_WMAstrcmp(tmpBuf, "WM/title"))
-    {
-      if (pTAGS->Title != NULL)
-      {
-        free(pTAGS->Title);
-      }
-      pTAGS->Title = malloc(ValueLength);
-      SongUtilities_WMAstrncpy((uint8_t*)pTAGS->Title, (uint8_t *)DescriptorValue(pointer, (NameLength )), ValueLength);
-    }
-
-    /* check for author object */
-    if (!SongUtilities_WMAstrcmp(tmpBuf, "WM/author"))
-    {
-      if (pTAGS->Artist != NULL)
-      {
-        free(pTAGS->Artist);
-      }
-      pTAGS->Artist = malloc(ValueLength);
-      SongUtilities_WMAstrncpy((uint8_t*)pTAGS->Artist, (uint8_t *)DescriptorValue(pointer, (NameLength )), ValueLength);
-    }
-
-    /* check for album object */
-    if (!SongUtilities_WMAstrcmp(tmpBuf, "WM/album") || !SongUtilities_WMAstrcmp(tmpBuf, "WM/albumtitle"))
-    {
-      if (pTAGS->Album != NULL)
-      {
-        free(pTAGS->Album);
-      }      
-      pTAGS->Album = malloc(ValueLength);
-      SongUtilities_WMAstrncpy((uint8_t*)pTAGS->Album, (uint8_t *)DescriptorValue(pointer, (NameLength )), ValueLength);
-    }
-
-    /* check for year object */
-    if (!SongUtilities_WMAstrcmp(tmpBuf, "WM/year"))
-    {
-      if (pTAGS->Year != NULL)
-      {
-        free(pTAGS->Year);
-      }
-      pTAGS->Year = malloc(ValueLength);
-      SongUtilities_WMAstrncpy((uint8_t*)pTAGS->Year, (uint8_t *)DescriptorValue(pointer, (NameLength )), ValueLength);
-    }
-
-    /* check for genre object */
-    if (!SongUtilities_WMAstrcmp(tmpBuf, "WM/genre"))
-    {
-      if (pTAGS->Genre != NULL)
-      {
-        free(pTAGS->Genre);
-      }      
-      pTAGS->Genre = malloc(ValueLength);
-      SongUtilities_WMAstrncpy((uint8_t*)pTAGS->Genre, (uint8_t *)DescriptorValue(pointer, (NameLength )), ValueLength);
-    }
-
-#else /* Not USE_DYNAMIC_MEMORY */
     /* check for title object */
     if (!SongUtilities_WMAstrcmp(tmpBuf, (const uint8_t*)"WM/title") ||
         !SongUtilities_WMAstrcmp(tmpBuf, (const uint8_t*)"WM/OriginalAlbumTitle") ||
@@ -586,25 +540,28 @@ void SongUtilities_parseExtendedContentDescriptors(uint8_t *pBuf, TAGS_TypeDef *
         SongUtilities_WMAstrncpy((uint8_t*)pTAGS->Genre, (uint8_t *)DescriptorValue(pointer, (NameLength )), wmin(ValueLength, MAX_TAG_STRING_LENGTH));
       }
     }
-#endif /* USE_DYNAMIC_MEMORY */
 
     pointer = NextDescriptor(pointer, NameLength, ValueLength);
   }
 }
 
 /**
-  * @brief  extract song Tags from wma file.
+  * @brief  extract song Tags from wma file. Only the two content description
+  *         objects are read, at most BufSize bytes of each: the other header
+  *         objects, and the descriptors past the buffer (pictures...), are
+  *         skipped with seeks.
   * @param  pTAGS: output struct.
   * @param  file: file handler.
   * @param  pBuf: temporary buffer for parsing.
+  * @param  BufSize: size of the buffer.
   * @retval None.
   */
-void SongUtilities_WMATagParser( TAGS_TypeDef *pIDTAG, FIL * file, uint8_t * pBuf )
+void SongUtilities_WMATagParser( TAGS_TypeDef *pIDTAG, FIL * file, uint8_t * pBuf, uint32_t BufSize )
 {
   t_ASFHeader ASF_header;
   t_ParserObj pParser;
   t_ASFObjectHeader tmp_ASFObjectHeader;
-  uint32_t NB_headers = 0;
+  uint32_t NB_headers = 0, ObjSize = 0, found = 0;
 
   if (file != NULL)
   {
@@ -615,23 +572,32 @@ void SongUtilities_WMATagParser( TAGS_TypeDef *pIDTAG, FIL * file, uint8_t * pBu
     NB_headers--;
     pParser.FirstObjOffset = sizeof(t_ASFHeader);
     pParser.NextObjOffset = sizeof(t_ASFHeader);
-    for (;NB_headers > 0;NB_headers--)
+    /* stop once both description objects are parsed */
+    for (;(NB_headers > 0) && (found != 3);NB_headers--)
     {
       FILE_READ(file, &tmp_ASFObjectHeader, sizeof(t_ASFObjectHeader), &nbr);
+      if (nbr < sizeof(t_ASFObjectHeader))
+        break;
+
+      ObjSize = *(uint32_t*)tmp_ASFObjectHeader.objectSize;
+      if (ObjSize < sizeof(t_ASFObjectHeader))
+        break;
       
       if (SongUtilities_IsGUID_eq((int32_t *)tmp_ASFObjectHeader.objectGUID, (int32_t*)ASF_CONTENT_DESCRIPTION_OBJEC))
       {
-        FILE_READ(file, pBuf, *(uint32_t*)tmp_ASFObjectHeader.objectSize, &nbr);
-        SongUtilities_parseContentDescriptor((uint8_t *)pBuf, pIDTAG);
+        FILE_READ(file, pBuf, wmin(ObjSize - sizeof(t_ASFObjectHeader), BufSize), &nbr);
+        SongUtilities_parseContentDescriptor((uint8_t *)pBuf, nbr, pIDTAG);
+        found |= 1;
       }
 
       if (SongUtilities_IsGUID_eq((int32_t *)tmp_ASFObjectHeader.objectGUID, (int32_t *)ASF_EXTENDED_CONTENT_DESCRIPTION_OBJECT))
       {
-        FILE_READ(file, pBuf, *(uint32_t *)tmp_ASFObjectHeader.objectSize, &nbr);
-        SongUtilities_parseExtendedContentDescriptors((uint8_t *)pBuf, pIDTAG);
+        FILE_READ(file, pBuf, wmin(ObjSize - sizeof(t_ASFObjectHeader), BufSize), &nbr);
+        SongUtilities_parseExtendedContentDescriptors((uint8_t *)pBuf, nbr, pIDTAG);
+        found |= 2;
       }
 
-      pParser.NextObjOffset += *(uint32_t*)tmp_ASFObjectHeader.objectSize;
+      pParser.NextObjOffset += ObjSize;
       FILE_SEEK(file, pParser.NextObjOffset);
     }
   }
@@ -691,15 +657,6 @@ void SongUtilities_FillTags_struct(t_SongInfos *song_info, TAGS_TypeDef * pIDTAG
         /* First byte contain string length retrieve */
         string_length = *(uint8_t *)(song_info->strings + song_info->infos[counter].string_offset);
 
-       #ifdef USE_DYNAMIC_MEMORY /* use dynamic memory allocation */
-        /* check for title object */
-        if (pIDTAGS->Title != NULL)
-        {
-          free(pIDTAGS->Title);
-        }
-        pIDTAGS->Title = malloc((string_length + 1) * sizeof(uint8_t));
-       #endif /* USE_DYNAMIC_MEMORY */
-
         if (pIDTAGS->Title != NULL)
         {
           /* copy string (utf-8) */
@@ -711,15 +668,6 @@ void SongUtilities_FillTags_struct(t_SongInfos *song_info, TAGS_TypeDef * pIDTAG
         /* First byte contain string length retrieve */
         string_length = *(uint8_t *)(song_info->strings + song_info->infos[counter].string_offset);
 
-       #ifdef USE_DYNAMIC_MEMORY /* use dynamic memory allocation */
-        /* check for Artist object */
-        if (pIDTAGS->Artist != NULL)
-        {
-          free(pIDTAGS->Artist);
-        }
-        pIDTAGS->Artist = malloc((string_length + 1) * sizeof(uint8_t));
-       #endif /* USE_DYNAMIC_MEMORY */
-
         if (pIDTAGS->Artist != NULL)
         {
           /* copy string (utf-8) */
@@ -731,15 +679,6 @@ void SongUtilities_FillTags_struct(t_SongInfos *song_info, TAGS_TypeDef * pIDTAG
         /* First byte contain string length retrieve */
         string_length = *(uint8_t *)(song_info->strings + song_info->infos[counter].string_offset);
 
-       #ifdef USE_DYNAMIC_MEMORY /* use dynamic memory allocation */
-        /* check for Album object */
-        if (pIDTAGS->Album != NULL)
-        {
-          free(pIDTAGS->Album);
-        }
-        pIDTAGS->Album = malloc((string_length + 1) * sizeof(uint8_t));
-       #endif /* USE_DYNAMIC_MEMORY */
-
         if (pIDTAGS->Album != NULL)
         {
           /* copy string (utf-8) */
@@ -751,15 +690,6 @@ void SongUtilities_FillTags_struct(t_SongInfos *song_info, TAGS_TypeDef * pIDTAG
         /* First byte contain string length retrieve */
         string_length = *(uint8_t *)(song_info->strings + song_info->infos[counter].string_offset);
 
-       #ifdef USE_DYNAMIC_MEMORY /* use dynamic memory allocation */
-        /* check for Genre object */
-        if (pIDTAGS->Genre != NULL)
-        {
-          free(pIDTAGS->Genre);
-        }
-        pIDTAGS->Genre = malloc((string_length + 1) * sizeof(uint8_t));
-       #endif /* USE_DYNAMIC_MEMORY */
-
         if (pIDTAGS->Genre != NULL)
         {
           /* copy string (utf-8) */
@@ -771,15 +701,6 @@ void SongUtilities_FillTags_struct(t_SongInfos *song_info, TAGS_TypeDef * pIDTAG
         /* First byte contain string length retrieve */
         string_length = *(uint8_t *)(song_info->strings + song_info->infos[counter].string_offset);
 
-       #ifdef USE_DYNAMIC_MEMORY /* use dynamic memory allocation */
-        /* check for Year object */
-        if (pIDTAGS->Year != NULL)
-        {
-          free(pIDTAGS->Year);
-        }
-        pIDTAGS->Year = malloc((string_length + 1) * sizeof(uint8_t));
-       #endif /* USE_DYNAMIC_MEMORY */
-
         if (pIDTAGS->Year != NULL)
         {
           /* copy string (utf-8) */
@@ -805,7 +726,7 @@ int8_t SongUtilities_MP3TagParser(uint8_t * buffer,  TAGS_TypeDef * pIDTAGS , FI
 {
   /* found ID3 Tag version 2 - exctract info */
   int32_t               p = 0, n = 0, cnt = 0, chcnt = 0, index = 0, cnt0 = 0;
-  int32_t               comment = 0;
+  uint32_t              found = 0;       /* SONG_TAG_BIT() of the tags found */
   uint16_t              word = 0;  /* pointer inside ID3 tag */
   ID32_PROCESSING_ENUM  processing_switch = ID32_FIND_FRAME;  /* general functionality switch (find frame, parse info from frame) */
   uint32_t              frID = 0, frflags = 0, id_be = 0;
@@ -977,27 +898,14 @@ int8_t SongUtilities_MP3TagParser(uint8_t * buffer,  TAGS_TypeDef * pIDTAGS , FI
         case TXT_TP1:
           song_info->infos[song_info->n_infos].info_type = ARTIST;
           break;
-        case TXT_COM:
-          if(comment)
-            processing_switch = ID32_FRAME_SKIP;
-          else
-            song_info->infos[song_info->n_infos].info_type = COMMENT;
-          break;
         case TXT_TYE:
           song_info->infos[song_info->n_infos].info_type = YEAR;
           break;
         case TXT_TCO:
           song_info->infos[song_info->n_infos].info_type = GENRE;
           break;
-        case TXT_TRK:
-          song_info->infos[song_info->n_infos].info_type = TRACK_NO;
-          break;
-          /* Picture Tag */
-        case TXT_PIC: 
-          /* we stop processing tags */
-          processing_switch = ID32_TERMINATE;							
-          /* Picture Tag End*/
-          break;
+        /* Comments, track number and pictures are not displayed: skipped,
+           with a seek when the frame is larger than the buffer */
         default:
          processing_switch = ID32_FRAME_SKIP;
          break;
@@ -1035,26 +943,15 @@ int8_t SongUtilities_MP3TagParser(uint8_t * buffer,  TAGS_TypeDef * pIDTAGS , FI
               case TXT_TPE1:
                 song_info->infos[song_info->n_infos].info_type = ARTIST;
                 break;
-              case TXT_COMM:
-                if (comment)
-                  processing_switch = ID32_FRAME_SKIP;
-                else
-                  song_info->infos[song_info->n_infos].info_type = COMMENT;
-                break;
               case TXT_TYER:
                 song_info->infos[song_info->n_infos].info_type = YEAR;
                 break;
               case TXT_TCON:
                 song_info->infos[song_info->n_infos].info_type = GENRE;
                 break;
-              case TXT_TRCK:
-                song_info->infos[song_info->n_infos].info_type = TRACK_NO;
-                break;
-              case TXT_APIC:
-                /* Picture tag */
-                /* Stop processing if picture tag is found. */
-                processing_switch = ID32_TERMINATE;
-                break;
+              /* Comments, track number and pictures (APIC) are not
+                 displayed: skipped, with a seek when the frame is larger
+                 than the buffer */
               default:
                 processing_switch = ID32_FRAME_SKIP;
                 break;
@@ -1210,9 +1107,8 @@ id3_unic_skip2:
 
             if (chcnt > 0)
             {
-              /* first check COMM presence before ptr is increased */
-              if (song_info->infos[song_info->n_infos].info_type == COMMENT)
-                comment = 1;
+              /* keep track of the displayed tags found so far */
+              found |= SONG_TAG_BIT(song_info->infos[song_info->n_infos].info_type);
               song_info->n_infos++;
             }
 
@@ -1289,9 +1185,8 @@ id3_unic_skip:
 
             if (chcnt > 0)
             {
-              /* first check COMM presence before ptr is increased */
-              if (song_info->infos[song_info->n_infos].info_type == COMMENT)
-                comment = 1;
+              /* keep track of the displayed tags found so far */
+              found |= SONG_TAG_BIT(song_info->infos[song_info->n_infos].info_type);
               song_info->n_infos++;
             }
             processing_switch = ID32_FRAME_SKIP; /* continue with next frame */
@@ -1311,7 +1206,7 @@ id32_skipfr:
 
       case ID32_FRAME_SKIP:
         pos = id_frtop;
-        if (pos < v2_length)
+        if ((pos < v2_length) && (found != SONG_TAGS_DISPLAYED))
           processing_switch = ID32_FIND_FRAME;
         else
           processing_switch = ID32_TERMINATE;
@@ -1330,6 +1225,480 @@ id32_skipfr:
 
 #endif /* __MP3_DECODER__ */
 
+#if defined(__MP3_DECODER__) || defined(__WMA_DECODER__)
+
+/* Media index private types and variables -----------------------------------*/
+typedef enum
+{
+  SONG_TYPE_NONE = 0,
+  SONG_TYPE_MP3,
+  SONG_TYPE_WMA
+} SONG_Type_TypeDef;
+
+static char     SongIndexPath[SONG_INDEX_PATH_LENGTH];     /* Folder indexed */
+static char     SongIndexName[SONG_INDEX_PATH_LENGTH + 14]; /* Folder + 8.3 name */
+static uint32_t SongIndexCount = 0;
+static FIL      SongIndexFile;
+static FIL      SongIndexSrc;  /* Previous index while checked, song while parsed */
+static SONG_IndexRecord_TypeDef SongIndexRec;
+static uint8_t  SongIndexBuf[SONG_INDEX_BUFFER_SIZE]; /* Also the records batched while rebuilt */
+/* Records of the previous index looked ahead while rebuilt */
+static SONG_IndexRecord_TypeDef SongIndexWin[SONG_INDEX_LOOKAHEAD];
+static uint32_t SongIndexWinFirst = 0, SongIndexWinCount = 0;
+static char     SongIndexTags[5][MAX_TAG_STRING_LENGTH + 1];
+
+/**
+  * @brief  Build the path of a file of the indexed folder.
+  * @param  Name: 8.3 name of the file.
+  * @retval Path of the file, in a static buffer.
+  */
+static char *SongUtilities_IndexName(const char *Name)
+{
+  uint32_t len = strlen(SongIndexPath);
+
+  strcpy(SongIndexName, SongIndexPath);
+  if ((len > 0) && (SongIndexName[len - 1] != '/') && (SongIndexName[len - 1] != ':'))
+  {
+    SongIndexName[len++] = '/';
+  }
+  strcpy(SongIndexName + len, Name);
+
+  return SongIndexName;
+}
+
+/**
+  * @brief  Get the type of a song from its file name.
+  * @param  Name: 8.3 name of the file.
+  * @retval SONG_TYPE_NONE if the file is not a song of a configured decoder.
+  */
+static SONG_Type_TypeDef SongUtilities_IndexType(const char *Name)
+{
+  const char *ext = strrchr(Name, '.');
+
+  if ((ext == NULL) || (strlen(ext) != 4))
+  {
+    return SONG_TYPE_NONE;
+  }
+#ifdef __MP3_DECODER__
+  if ((toupper(ext[1]) == 'M') && (toupper(ext[2]) == 'P') && (ext[3] == '3'))
+  {
+    return SONG_TYPE_MP3;
+  }
+#endif /* __MP3_DECODER__ */
+#ifdef __WMA_DECODER__
+  if ((toupper(ext[1]) == 'W') && (toupper(ext[2]) == 'M') && (toupper(ext[3]) == 'A'))
+  {
+    return SONG_TYPE_WMA;
+  }
+#endif /* __WMA_DECODER__ */
+  return SONG_TYPE_NONE;
+}
+
+/**
+  * @brief  Check a record against a file of the folder.
+  * @param  pRecord: record of the index.
+  * @param  fno: file information from f_readdir.
+  * @retval 1 if the record describes the file as it is.
+  */
+static uint8_t SongUtilities_IndexMatch(const SONG_IndexRecord_TypeDef *pRecord, const FILINFO *fno)
+{
+  return ((pRecord->Size == fno->fsize) && (pRecord->Date == fno->fdate) &&
+          (pRecord->Time == fno->ftime) && (strcmp(pRecord->Name, fno->fname) == 0));
+}
+
+/**
+  * @brief  Read a record of an index file.
+  * @param  file: index file.
+  * @param  Index: record number.
+  * @param  pRecord: record read.
+  * @retval 1 if the record was read.
+  */
+static uint8_t SongUtilities_IndexRead(FIL *file, uint32_t Index, SONG_IndexRecord_TypeDef *pRecord)
+{
+  UINT n;
+
+  return ((f_lseek(file, (Index + 1) * sizeof(SONG_IndexRecord_TypeDef)) == FR_OK) &&
+          (f_read(file, pRecord, sizeof(SONG_IndexRecord_TypeDef), &n) == FR_OK) &&
+          (n == sizeof(SONG_IndexRecord_TypeDef)));
+}
+
+/**
+  * @brief  Copy a tag to a record field, truncated to the field.
+  * @param  Dst: record field.
+  * @param  Src: tag, of at most MAX_TAG_STRING_LENGTH chars.
+  * @param  Size: size of the field.
+  * @retval None.
+  */
+static void SongUtilities_IndexCopy(char *Dst, char *Src, uint32_t Size)
+{
+  Src[MAX_TAG_STRING_LENGTH] = 0;
+  strncpy(Dst, Src, Size - 1);
+  Dst[Size - 1] = 0;
+}
+
+/**
+  * @brief  Parse the tags of the song of a record.
+  * @param  pRecord: record to complete.
+  * @retval 1 if the song could be opened: the tags found, if any, are in the
+  *         record.
+  */
+static uint8_t SongUtilities_IndexParse(SONG_IndexRecord_TypeDef *pRecord)
+{
+  TAGS_TypeDef tags;
+
+  if (f_open(&SongIndexSrc, SongUtilities_IndexName(pRecord->Name), FA_OPEN_EXISTING | FA_READ) != FR_OK)
+  {
+    return 0;
+  }
+
+  MEM_SET(SongIndexTags, 0, sizeof(SongIndexTags));
+  tags.Title  = SongIndexTags[0];
+  tags.Artist = SongIndexTags[1];
+  tags.Album  = SongIndexTags[2];
+  tags.Year   = SongIndexTags[3];
+  tags.Genre  = SongIndexTags[4];
+  tags.SamplingRate = 0;
+
+  switch (SongUtilities_IndexType(pRecord->Name))
+  {
+#ifdef __MP3_DECODER__
+    case SONG_TYPE_MP3:
+      SongUtilities_MP3TagParser(SongIndexBuf, &tags, &SongIndexSrc);
+      break;
+#endif /* __MP3_DECODER__ */
+#ifdef __WMA_DECODER__
+    case SONG_TYPE_WMA:
+      SongUtilities_WMATagParser(&tags, &SongIndexSrc, SongIndexBuf, sizeof(SongIndexBuf));
+      break;
+#endif /* __WMA_DECODER__ */
+    default:
+      break;
+  }
+  f_close(&SongIndexSrc);
+
+  SongUtilities_IndexCopy(pRecord->Title,  tags.Title,  sizeof(pRecord->Title));
+  SongUtilities_IndexCopy(pRecord->Artist, tags.Artist, sizeof(pRecord->Artist));
+  SongUtilities_IndexCopy(pRecord->Album,  tags.Album,  sizeof(pRecord->Album));
+  SongUtilities_IndexCopy(pRecord->Year,   tags.Year,   sizeof(pRecord->Year));
+  SongUtilities_IndexCopy(pRecord->Genre,  tags.Genre,  sizeof(pRecord->Genre));
+
+  return 1;
+}
+
+/**
+  * @brief  Check the previous index against the folder.
+  * @param  Loaded: records of the previous index, opened in SongIndexSrc.
+  * @retval Number of songs if the index is up to date, else (uint32_t)-1.
+  */
+static uint32_t SongUtilities_IndexCheck(uint32_t Loaded)
+{
+  FILINFO fno;
+  DIR dir;
+  uint32_t count = 0;
+
+  if (f_opendir(&dir, SongIndexPath) != FR_OK)
+  {
+    return (uint32_t)-1;
+  }
+
+  /* The directory order is stable on FAT: the records are compared in step */
+  while ((f_readdir(&dir, &fno) == FR_OK) && (fno.fname[0] != 0))
+  {
+    if ((fno.fattrib & AM_DIR) || (SongUtilities_IndexType(fno.fname) == SONG_TYPE_NONE))
+    {
+      continue;
+    }
+    if ((count >= Loaded) || !SongUtilities_IndexRead(&SongIndexSrc, count, &SongIndexRec) ||
+        !SongUtilities_IndexMatch(&SongIndexRec, &fno))
+    {
+      return (uint32_t)-1;
+    }
+    count++;
+  }
+
+  return (count == Loaded) ? count : (uint32_t)-1;
+}
+
+/**
+  * @brief  Get a record of the previous index while the index is rebuilt.
+  * @note   The records are read SONG_INDEX_LOOKAHEAD at a time, the file
+  *         being closed in between.
+  * @param  Index: record number.
+  * @retval Record, or NULL if it could not be read.
+  */
+static SONG_IndexRecord_TypeDef *SongUtilities_IndexPrev(uint32_t Index)
+{
+  UINT n = 0;
+
+  if ((Index < SongIndexWinFirst) || (Index >= SongIndexWinFirst + SongIndexWinCount))
+  {
+    SongIndexWinFirst = Index;
+    SongIndexWinCount = 0;
+    if (f_open(&SongIndexSrc, SongUtilities_IndexName(SONG_INDEX_FILE), FA_OPEN_EXISTING | FA_READ) != FR_OK)
+    {
+      return NULL;
+    }
+    if ((f_lseek(&SongIndexSrc, (Index + 1) * sizeof(SONG_IndexRecord_TypeDef)) == FR_OK) &&
+        (f_read(&SongIndexSrc, SongIndexWin, sizeof(SongIndexWin), &n) == FR_OK))
+    {
+      SongIndexWinCount = n / sizeof(SONG_IndexRecord_TypeDef);
+    }
+    f_close(&SongIndexSrc);
+    if (SongIndexWinCount == 0)
+    {
+      return NULL;
+    }
+  }
+
+  return &SongIndexWin[Index - SongIndexWinFirst];
+}
+
+/**
+  * @brief  Write data at the end of SONG_INDEX_TEMP_FILE, or at its start.
+  * @param  pData: data to write.
+  * @param  Size: bytes to write.
+  * @param  Append: 1 to append the data, 0 to write them at the start.
+  * @retval 1 if the data were written.
+  */
+static uint8_t SongUtilities_IndexWrite(const void *pData, uint32_t Size, uint8_t Append)
+{
+  UINT n = 0;
+  uint8_t res = 0;
+
+  if (f_open(&SongIndexFile, SongUtilities_IndexName(SONG_INDEX_TEMP_FILE), FA_OPEN_EXISTING | FA_WRITE) != FR_OK)
+  {
+    return 0;
+  }
+  res = ((f_lseek(&SongIndexFile, Append ? SongIndexFile.fsize : 0) == FR_OK) &&
+         (f_write(&SongIndexFile, pData, Size, &n) == FR_OK) && (n == Size));
+
+  return (f_close(&SongIndexFile) == FR_OK) && res;
+}
+
+/**
+  * @brief  Rebuild the index of the folder in SONG_INDEX_TEMP_FILE.
+  * @note   Only one file is open at a time, next to the song the player may
+  *         have open (_FS_SHARE): the records of the previous index are read
+  *         SONG_INDEX_LOOKAHEAD at a time, and the new ones written by
+  *         batches of SongIndexBuf.
+  * @param  Loaded: records of the previous index.
+  * @retval Number of songs, or (uint32_t)-1 on error.
+  */
+static uint32_t SongUtilities_IndexBuild(uint32_t Loaded)
+{
+  SONG_IndexHeader_TypeDef header;
+  SONG_IndexRecord_TypeDef *prev = NULL;
+  FILINFO fno;
+  DIR dir;
+  uint32_t count = 0, src = 0, k = 0, batch = 0;
+
+  if ((f_opendir(&dir, SongIndexPath) != FR_OK) ||
+      (f_open(&SongIndexFile, SongUtilities_IndexName(SONG_INDEX_TEMP_FILE), FA_CREATE_ALWAYS | FA_WRITE) != FR_OK))
+  {
+    return (uint32_t)-1;
+  }
+  f_close(&SongIndexFile);
+
+  /* Header written last: an interrupted rebuild leaves no valid index */
+  MEM_SET(&header, 0, sizeof(header));
+  if (!SongUtilities_IndexWrite(&header, sizeof(header), 1))
+  {
+    return (uint32_t)-1;
+  }
+
+  SongIndexWinCount = 0;
+  while ((f_readdir(&dir, &fno) == FR_OK) && (fno.fname[0] != 0))
+  {
+    if ((fno.fattrib & AM_DIR) || (SongUtilities_IndexType(fno.fname) == SONG_TYPE_NONE))
+    {
+      continue;
+    }
+
+    /* Look for the song a few records ahead of the previous one found: the
+       records skipped are those of songs removed */
+    for (k = src; (k < Loaded) && (k < src + SONG_INDEX_LOOKAHEAD); k++)
+    {
+      prev = SongUtilities_IndexPrev(k);
+      if ((prev != NULL) && SongUtilities_IndexMatch(prev, &fno))
+      {
+        break;
+      }
+    }
+
+    if ((k < Loaded) && (k < src + SONG_INDEX_LOOKAHEAD))
+    {
+      src = k + 1;
+      memcpy(&SongIndexRec, prev, sizeof(SongIndexRec));
+    }
+    else
+    {
+      /* New or modified song: its tags are parsed by SongUtilities_IndexGet */
+      MEM_SET(&SongIndexRec, 0, sizeof(SongIndexRec));
+      SongIndexRec.Size = fno.fsize;
+      SongIndexRec.Date = fno.fdate;
+      SongIndexRec.Time = fno.ftime;
+      strncpy(SongIndexRec.Name, fno.fname, sizeof(SongIndexRec.Name) - 1);
+    }
+
+    /* Batched in SongIndexBuf, copied as it need not be aligned */
+    memcpy(&SongIndexBuf[batch * sizeof(SongIndexRec)], &SongIndexRec, sizeof(SongIndexRec));
+    if (++batch == (sizeof(SongIndexBuf) / sizeof(SongIndexRec)))
+    {
+      if (!SongUtilities_IndexWrite(SongIndexBuf, batch * sizeof(SongIndexRec), 1))
+      {
+        return (uint32_t)-1;
+      }
+      batch = 0;
+    }
+    count++;
+  }
+
+  if ((batch != 0) && !SongUtilities_IndexWrite(SongIndexBuf, batch * sizeof(SongIndexRec), 1))
+  {
+    return (uint32_t)-1;
+  }
+
+  header.Magic = SONG_INDEX_MAGIC;
+  header.Count = count;
+  return SongUtilities_IndexWrite(&header, sizeof(header), 0) ? count : (uint32_t)-1;
+}
+
+/**
+  * @brief  Open the media index of a folder.
+  * @note   The index of the previous call is read from SONG_INDEX_FILE and
+  *         checked against the folder: it is only rewritten when songs were
+  *         added, removed or modified, the records of the songs unchanged
+  *         being kept with their tags. One file is open at a time, so that
+  *         it may be called while the player has a song open (_FS_SHARE).
+  * @param  Path: folder of the songs, "0:" for the root.
+  * @retval Number of songs indexed.
+  */
+uint32_t SongUtilities_IndexOpen(const char *Path)
+{
+  SONG_IndexHeader_TypeDef header;
+  uint32_t loaded = 0, count = 0;
+  const char *name;
+  UINT n;
+
+  SongIndexCount = 0;
+  if (strlen(Path) >= SONG_INDEX_PATH_LENGTH)
+  {
+    return 0;
+  }
+  strcpy(SongIndexPath, Path);
+
+  if (f_open(&SongIndexSrc, SongUtilities_IndexName(SONG_INDEX_FILE), FA_OPEN_EXISTING | FA_READ) == FR_OK)
+  {
+    count = (uint32_t)-1;
+    if ((f_read(&SongIndexSrc, &header, sizeof(header), &n) == FR_OK) && (n == sizeof(header)) &&
+        (header.Magic == SONG_INDEX_MAGIC))
+    {
+      loaded = header.Count;
+
+      /* Fast path: nothing changed in the folder, nothing is written */
+      count = SongUtilities_IndexCheck(loaded);
+    }
+    f_close(&SongIndexSrc);
+    if (count != (uint32_t)-1)
+    {
+      SongIndexCount = count;
+      return count;
+    }
+  }
+
+  count = SongUtilities_IndexBuild(loaded);
+  if (count == (uint32_t)-1)
+  {
+    f_unlink(SongUtilities_IndexName(SONG_INDEX_TEMP_FILE));
+    return 0;
+  }
+
+  /* The new name of f_rename is given without the drive number */
+  f_unlink(SongUtilities_IndexName(SONG_INDEX_FILE));
+  name = strchr(SongUtilities_IndexName(SONG_INDEX_FILE), ':');
+  name = (name != NULL) ? (name + 1) : SongIndexName;
+  strcpy((char *)SongIndexBuf, name);
+  if (f_rename(SongUtilities_IndexName(SONG_INDEX_TEMP_FILE), (const char *)SongIndexBuf) != FR_OK)
+  {
+    return 0;
+  }
+
+  SongIndexCount = count;
+  return count;
+}
+
+/**
+  * @brief  Get the number of songs of the opened index.
+  * @param  None.
+  * @retval Number of songs.
+  */
+uint32_t SongUtilities_IndexCount(void)
+{
+  return SongIndexCount;
+}
+
+/**
+  * @brief  Get a record of the opened index.
+  * @note   The tags of a song new in the index are parsed now and saved to
+  *         its record: the songs never browsed are never opened.
+  * @param  Index: song number, from 0.
+  * @param  pRecord: record read.
+  * @retval 1 if the record was read. Its tags are only valid when
+  *         SONG_FLAG_PARSED is set (the song could not be opened otherwise).
+  */
+uint8_t SongUtilities_IndexGet(uint32_t Index, SONG_IndexRecord_TypeDef *pRecord)
+{
+  UINT n;
+  uint8_t res;
+
+  if ((Index >= SongIndexCount) ||
+      (f_open(&SongIndexFile, SongUtilities_IndexName(SONG_INDEX_FILE), FA_OPEN_EXISTING | FA_READ) != FR_OK))
+  {
+    return 0;
+  }
+  res = SongUtilities_IndexRead(&SongIndexFile, Index, pRecord);
+  f_close(&SongIndexFile);
+
+  /* The index is closed while the song is parsed: one file open at a time */
+  if (res && ((pRecord->Flags & SONG_FLAG_PARSED) == 0) && SongUtilities_IndexParse(pRecord))
+  {
+    pRecord->Flags |= SONG_FLAG_PARSED;
+    /* Failing to save it only means it is parsed again next time */
+    if (f_open(&SongIndexFile, SongUtilities_IndexName(SONG_INDEX_FILE), FA_OPEN_EXISTING | FA_WRITE) == FR_OK)
+    {
+      if (f_lseek(&SongIndexFile, (Index + 1) * sizeof(SONG_IndexRecord_TypeDef)) == FR_OK)
+      {
+        f_write(&SongIndexFile, pRecord, sizeof(SONG_IndexRecord_TypeDef), &n);
+      }
+      f_close(&SongIndexFile);
+    }
+  }
+
+  return res;
+}
+
+/**
+  * @brief  Get the path of the song of a record of the opened index.
+  * @param  pRecord: record read by SongUtilities_IndexGet.
+  * @retval Path, valid until the next call of the index functions.
+  */
+char *SongUtilities_IndexPath(const SONG_IndexRecord_TypeDef *pRecord)
+{
+  return SongUtilities_IndexName(pRecord->Name);
+}
+
+/**
+  * @brief  Close the index opened by SongUtilities_IndexOpen.
+  * @param  None.
+  * @retval None.
+  */
+void SongUtilities_IndexClose(void)
+{
+  SongIndexCount = 0;
+}
+
+#endif /* __MP3_DECODER__ || __WMA_DECODER__ */
+
 /**
   * @brief  Read a buffer from file.
   * @param  pSongInfos: pointer to t_SongInfos struct.
@@ -1339,7 +1708,7 @@ id32_skipfr:
   */
 int32_t SongUtilities_ReadFile(t_SongInfos * song_info, uint8_t *buffer, uint32_t nb_bytes)
 {
-  FILE_READ(song_info->file, buffer, nb_bytes, (void *)(uint32_t)&nbr);
+  FILE_READ(song_info->file, buffer, nb_bytes, (UINT *)&nbr);
 
   return nbr;
 }
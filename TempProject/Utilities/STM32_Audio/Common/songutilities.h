@@ -44,6 +44,8 @@
 /** @defgroup SongUtilities_Exported_Types
   * @{
   */
+/* Tags of a song. The strings are buffers of the caller, of
+   MAX_TAG_STRING_LENGTH + 1 chars, NULL for the tags not wanted */
 typedef struct {
   char * Title;
   char * Artist;
@@ -53,6 +55,28 @@ typedef struct {
   uint32_t SamplingRate;
 }TAGS_TypeDef;
 
+/* One song of a folder, as kept in SONG_INDEX_FILE: a 128-byte record, the
+   tags are truncated to the field sizes */
+typedef struct {
+  uint32_t Size;       /* File size           \  checked against the folder at */
+  uint16_t Date;       /* Last modified date   > each SongUtilities_IndexOpen, */
+  uint16_t Time;       /* Last modified time  /  tags parsed again if changed  */
+  char     Name[13];   /* 8.3 name as returned by f_readdir */
+  uint8_t  Flags;      /* SONG_FLAG_xxx */
+  char     Title[32];
+  char     Artist[32];
+  char     Album[24];
+  char     Year[6];
+  char     Genre[12];
+}SONG_IndexRecord_TypeDef;
+
+/* First record of SONG_INDEX_FILE, of the size of a record */
+typedef struct {
+  uint32_t Magic;      /* SONG_INDEX_MAGIC */
+  uint32_t Count;      /* Records following */
+  uint32_t Reserved[30];
+}SONG_IndexHeader_TypeDef;
+
 /**
   * @}
   */
@@ -64,9 +88,37 @@ typedef struct {
  #define MAX_TAG_STRING_LENGTH          40
 #endif /* MAX_TAG_STRING_LENGTH */
 
-/* #define USE_DYNAMIC_MEMORY */ /* uncomment this define to use dynamic memory allocation
-                                 in SongUtilities_parseExtendedContentDescriptors(); this 
-                                 function extracts WMA song description from extended content descriptor object */
+/* Media index kept in each folder browsed: the records are checked against
+   the folder when it is opened, the tags of a new or modified song are only
+   parsed when its record is first read. These defines may be set in
+   audio_app_conf.h */
+#define SONG_INDEX_FILE                "SONGS.IDX"
+#define SONG_INDEX_TEMP_FILE           "SONGS.TMP"  /* Index being rebuilt */
+#define SONG_INDEX_MAGIC               0x58444E53   /* "SNDX" */
+
+#define SONG_FLAG_PARSED               0x01  /* Tags of the record are valid */
+
+/* Records of the previous index searched for each song of the folder: the
+   songs added or removed in between are not parsed again. They are kept in
+   RAM while the index is rebuilt, 128 bytes each */
+#ifndef SONG_INDEX_LOOKAHEAD
+ #define SONG_INDEX_LOOKAHEAD          8
+#endif /* SONG_INDEX_LOOKAHEAD */
+
+/* Buffer the tags of the indexed songs are parsed in: the ID3 parser needs
+   256 bytes, the WMA descriptors past the buffer are skipped */
+#ifndef SONG_INDEX_BUFFER_SIZE
+ #define SONG_INDEX_BUFFER_SIZE        512
+#endif /* SONG_INDEX_BUFFER_SIZE */
+
+/* Longest folder path + 8.3 name */
+#ifndef SONG_INDEX_PATH_LENGTH
+ #define SONG_INDEX_PATH_LENGTH        64
+#endif /* SONG_INDEX_PATH_LENGTH */
+
+#if (SONG_INDEX_BUFFER_SIZE < 256)
+ #error "SONG_INDEX_BUFFER_SIZE: the ID3 parser needs at least 256 bytes"
+#endif
 
 /**
   * @}
@@ -108,8 +160,15 @@ typedef struct {
  int8_t SongUtilities_MP3TagParser(uint8_t * buffer,  TAGS_TypeDef * pIDTAGS ,FIL * file);
 #endif /* __MP3_DECODER__ */
 #ifdef __WMA_DECODER__
- void SongUtilities_WMATagParser( TAGS_TypeDef *pIDTAG,FIL * file, uint8_t * pBuf );
+ void SongUtilities_WMATagParser( TAGS_TypeDef *pIDTAG,FIL * file, uint8_t * pBuf, uint32_t BufSize );
 #endif /* __WMA_DECODER__ */
+#if defined(__MP3_DECODER__) || defined(__WMA_DECODER__)
+ uint32_t SongUtilities_IndexOpen(const char *Path);
+ uint32_t SongUtilities_IndexCount(void);
+ uint8_t  SongUtilities_IndexGet(uint32_t Index, SONG_IndexRecord_TypeDef *pRecord);
+ char    *SongUtilities_IndexPath(const SONG_IndexRecord_TypeDef *pRecord);
+ void     SongUtilities_IndexClose(void);
+#endif /* __MP3_DECODER__ || __WMA_DECODER__ */
 void StrCtrlLength(void* Dst, void* Src, uint32_t MaxLen);
 
 #endif /* __SONG_UTILITIES_H */
@@ -58,6 +58,7 @@
 /** @defgroup STM32_AUDIO_PLAYER_Private_Macros
   * @{
   */ 
+#define PLAYER_NEXT(Idx)        (((Idx) >= (AUDIO_PLAYER_BUFFER_NBR - 1))? 0:((Idx) + 1))
 /**
   * @}
   */ 
@@ -71,15 +72,27 @@ typedef struct
 {
   uint16_t* pBuf;
   uint32_t  Size;
-  uint32_t  isReady;
+  __IO uint32_t isReady;  /* Set by the decode task, cleared by the transfer complete */
+  uint32_t  Released;     /* AUDIO_PLAYER_GET_TICK() when handed to the decode task */
 }AUDIO_Buffer_TypeDef;
 
-AUDIO_Buffer_TypeDef AudioBuffers[3];
+AUDIO_Buffer_TypeDef AudioBuffers[AUDIO_PLAYER_BUFFER_NBR];
 
 uint32_t OutPacketSize = MAX_OUT_PACKET_SZE;
-uint16_t *OutBuff1 = NULL, *OutBuff2 = NULL, *OutBuff3 = NULL;
+uint16_t OutBuff[AUDIO_PLAYER_BUFFER_NBR][MAX_OUT_PACKET_SZE / 2];
 uint32_t WrBuffIdx = 0, RdBuffIdx = 0;
 
+/* Transfers completed, the default time base of the statistics */
+__IO uint32_t AudioPlayerXferCount = 0;
+AudioPlayer_Stats_TypeDef AudioPlayerStats;
+
+#if (AUDIO_PLAYER_CHUNK_SIZE != 0)
+/* Chunk of the file being handed to the decoder: ChunkLen bytes read, of
+   which ChunkOff already consumed */
+uint8_t  ChunkBuff[AUDIO_PLAYER_CHUNK_SIZE];
+uint32_t ChunkLen = 0, ChunkOff = 0;
+#endif /* AUDIO_PLAYER_CHUNK_SIZE */
+
 
 /* Current decoded buffer size */
 uint32_t      tsize = 0;
@@ -111,6 +124,9 @@ Decoder_TypeDef sDecoderStruct;
 void  AudioPlayer_XferCplt (uint8_t** pbuf, uint32_t* pSize);
 static uint32_t Player_FRead (void* pfile, uint8_t* pbuf, uint32_t size);
 static uint32_t AudioPlayer_PlayUpdate(void);
+static uint32_t Player_FileRead(uint8_t* pbuf, uint32_t size, uint32_t* pRead);
+static uint32_t Player_FileTell(void);
+static uint32_t Player_Depth(void);
 /* static uint32_t AudioPlayer_MonoToStereo(int16_t* BIn, int16_t* BOut, uint32_t Size); */
 
 /**
@@ -140,17 +156,7 @@ uint32_t AudioPlayer_Init(void)
   /* Set packet size to the default value */
   OutPacketSize = MAX_OUT_PACKET_SZE;
 
-  /* Allocate max packet size to avoid fragmentation */
-  OutBuff1 =(uint16_t*) malloc(MAX_OUT_PACKET_SZE);
-  OutBuff2 =(uint16_t*) malloc(MAX_OUT_PACKET_SZE);
-  OutBuff3 =(uint16_t*) malloc(MAX_OUT_PACKET_SZE);
-  if ((OutBuff1 == NULL) || (OutBuff2 == NULL) || (OutBuff3 == NULL))
-  {
-    free (OutBuff1);
-    free (OutBuff2);
-    free (OutBuff3);
-    return 1;
-  }
+  AudioPlayer_ResetStats();
     
   return 0;
 }
@@ -166,24 +172,7 @@ uint32_t AudioPlayer_DeInit(void)
   AudioPlayerState = PLAYER_IDLE;
   
   /* Stop and free resources used by main audio player task */
-  AudioPlayer_TaskInit();  
-  
-  /* Free the audio buffer */
-  if (OutBuff1 != NULL)
-  {
-    free(OutBuff1);
-    OutBuff1 = NULL;
-  }
-  if (OutBuff2 != NULL)
-  {
-    free(OutBuff2);
-    OutBuff2 = NULL;
-  }
-  if (OutBuff3 != NULL)
-  {
-    free(OutBuff3);
-    OutBuff3 = NULL;
-  }
+  AudioPlayer_TaskDeInit();  
   
   WrBuffIdx = RdBuffIdx = 0;
   
@@ -211,6 +200,10 @@ uint32_t AudioPlayer_Open(uint8_t  *FilePath)
     return 1;
   }
   
+#if (AUDIO_PLAYER_CHUNK_SIZE != 0)
+  ChunkLen = ChunkOff = 0;
+#endif /* AUDIO_PLAYER_CHUNK_SIZE */
+  
   /* Get the header buffer from the audio File */
   f_read(&AudioFile, tHeaderTmp, MAX_AUDIO_HEADER_SIZE, (uint32_t*)(&NumberOfData));
   
@@ -292,6 +285,8 @@ uint32_t AudioPlayer_Close(void)
   */
 uint32_t AudioPlayer_PlayUpdate(void)
 {
+  uint32_t latency = 0;
+  
   /* Check if the buffer has already been used */
   if ((AudioBuffers[WrBuffIdx].isReady == 0))
   {
@@ -302,8 +297,17 @@ uint32_t AudioPlayer_PlayUpdate(void)
   
     AudioBuffers[WrBuffIdx].isReady = 1;
     
+    /* Time the buffer waited for its data */
+    latency = AUDIO_PLAYER_GET_TICK() - AudioBuffers[WrBuffIdx].Released;
+    AudioPlayerStats.RefillLatency = latency;
+    if (latency > AudioPlayerStats.RefillLatencyMax)
+    {
+      AudioPlayerStats.RefillLatencyMax = latency;
+    }
+    AudioPlayerStats.Refills++;
+    
     /* Update index */
-    WrBuffIdx = (WrBuffIdx >= 2)? 0:(WrBuffIdx+1);
+    WrBuffIdx = PLAYER_NEXT(WrBuffIdx);
   }
   
   return 0;
@@ -316,22 +320,10 @@ uint32_t AudioPlayer_PlayUpdate(void)
   */
 void AudioPlayer_TaskInit()
 {   
-  NVIC_InitTypeDef  NVIC_InitStructure;
-  EXTI_InitTypeDef EXTI_InitStructure;
- 
-  /* Initialize the EXTI line used to trigger the software interrupt */
-  EXTI_InitStructure.EXTI_Line = EXTI_Line4;
-  EXTI_InitStructure.EXTI_Mode = EXTI_Mode_Interrupt;
-  EXTI_InitStructure.EXTI_Trigger = EXTI_Trigger_Rising;
-  EXTI_InitStructure.EXTI_LineCmd = ENABLE;
-  EXTI_Init(&EXTI_InitStructure);
- 
-  /* Set the IRQ channel for the software triggered interrupt */
-  NVIC_InitStructure.NVIC_IRQChannel = EXTI4_IRQn;
-  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0x2;
-  NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0x0;
-  NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
-  NVIC_Init(&NVIC_InitStructure); 
+  /* Software interrupt of the decode task */
+  NVIC_SetPriority(AUDIO_PLAYER_IRQn, AUDIO_PLAYER_TASK_PRIO);
+  NVIC_ClearPendingIRQ(AUDIO_PLAYER_IRQn);
+  NVIC_EnableIRQ(AUDIO_PLAYER_IRQn);
 }
 
 /**
@@ -341,22 +333,8 @@ void AudioPlayer_TaskInit()
   */
 void AudioPlayer_TaskDeInit()
 {   
-  NVIC_InitTypeDef  NVIC_InitStructure;
-  EXTI_InitTypeDef EXTI_InitStructure;
- 
-  /* Initialize the EXTI line used to trigger the software interrupt */
-  EXTI_InitStructure.EXTI_Line = EXTI_Line4;
-  EXTI_InitStructure.EXTI_Mode = EXTI_Mode_Interrupt;
-  EXTI_InitStructure.EXTI_Trigger = EXTI_Trigger_Rising;
-  EXTI_InitStructure.EXTI_LineCmd = DISABLE;
-  EXTI_Init(&EXTI_InitStructure);
- 
-  /* Set the IRQ channel for the software triggered interrupt */
-  NVIC_InitStructure.NVIC_IRQChannel = EXTI4_IRQn;
-  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0x2;
-  NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0x0;
-  NVIC_InitStructure.NVIC_IRQChannelCmd = DISABLE;
-  NVIC_Init(&NVIC_InitStructure); 
+  NVIC_DisableIRQ(AUDIO_PLAYER_IRQn);
+  NVIC_ClearPendingIRQ(AUDIO_PLAYER_IRQn);
 }
 
 /**
@@ -366,8 +344,10 @@ void AudioPlayer_TaskDeInit()
   */
 void AudioPlayer_Task(void * Param)
 {   
-  /* Check if a buffer need to be prepared */    
-  if (AudioPlayerState == PLAYER_PLAYING)
+  /* Decode until the ring is full: the buffer playing is the only one not
+     released, and the end of the file stops the player */
+  while ((AudioPlayerState == PLAYER_PLAYING) && 
+         (AudioBuffers[WrBuffIdx].isReady == 0))
   {
     /* Get next buffer from mass storage device and decode it */
     AudioPlayer_PlayUpdate();
@@ -375,14 +355,12 @@ void AudioPlayer_Task(void * Param)
 }
 
 /**
-  * @brief  This function handles EXTI4 global interrupt request.
+  * @brief  This function handles the decode task software interrupt.
   * @param  None
   * @retval None
   */
-void EXTI4_IRQHandler(void)
+void AUDIO_PLAYER_IRQHandler(void)
 {
-  EXTI_ClearITPendingBit(EXTI_Line4);
-
   /* Call the main player task */
   AudioPlayer_Task(NULL);
 }
@@ -403,21 +381,21 @@ uint32_t AudioPlayer_Play(uint8_t *FilePath)
       return 1;
     }
     
-    AudioBuffers[0].pBuf = OutBuff1;
-    AudioBuffers[1].pBuf = OutBuff2;
-    AudioBuffers[2].pBuf = OutBuff3;
-    for (int i = 0; i<3; i++)
+    for (int i = 0; i<AUDIO_PLAYER_BUFFER_NBR; i++)
     {
+      AudioBuffers[i].pBuf = OutBuff[i];
       AudioBuffers[i].Size = MAX_OUT_PACKET_SZE;
       AudioBuffers[i].isReady = 0;
+      AudioBuffers[i].Released = AUDIO_PLAYER_GET_TICK();
     }
     WrBuffIdx = RdBuffIdx = 0;
     
     /* Fill all buffers with data */
-    for (int i = 0; i<3; i++)
+    for (int i = 0; i<AUDIO_PLAYER_BUFFER_NBR; i++)
     {
       AudioPlayer_PlayUpdate();
     }
+    AudioPlayerStats.Depth = AUDIO_PLAYER_BUFFER_NBR - 1;
 
     /* Set the current state */
     AudioPlayerState = PLAYER_PLAYING;
@@ -541,6 +519,51 @@ uint32_t AudioPlayer_VolumeCtrl(uint8_t Volume)
    return AUDIO_OUT_fops.VolumeCtl(Volume);
 }
 
+#if defined(__MP3_DECODER__) || defined(__WMA_DECODER__)
+/**
+  * @brief  Opens a folder to browse: its songs are listed from the media
+  *         index of the folder, see SongUtilities_IndexOpen.
+  * @param  Path: folder of the songs, "0:" for the root.
+  * @retval Number of songs of the folder.
+  */
+uint32_t AudioPlayer_OpenFolder(uint8_t *Path)
+{
+  return SongUtilities_IndexOpen((const char *)Path);
+}
+
+/**
+  * @brief  Gets a song of the folder opened, with its tags.
+  * @param  Index: song number, from 0.
+  * @param  pRecord: index record of the song.
+  * @retval 1 if the song was read, 0 else.
+  */
+uint8_t AudioPlayer_GetSong(uint32_t Index, SONG_IndexRecord_TypeDef *pRecord)
+{
+  return SongUtilities_IndexGet(Index, pRecord);
+}
+
+/**
+  * @brief  Plays a song of the folder opened, in place of the current one.
+  * @param  Index: song number, from 0.
+  * @retval 0 if Passed, !0 else.
+  */
+uint32_t AudioPlayer_PlaySong(uint32_t Index)
+{
+  SONG_IndexRecord_TypeDef record;
+
+  if (!SongUtilities_IndexGet(Index, &record))
+  {
+    return 1;
+  }
+
+  /* The current song, if any, is closed first */
+  AudioPlayer_Stop();
+  AudioPlayer_Close();
+
+  return AudioPlayer_Play((uint8_t *)SongUtilities_IndexPath(&record));
+}
+#endif /* __MP3_DECODER__ || __WMA_DECODER__ */
+
 /**
   * @brief  Updates the current track information.
   * @param  None.
@@ -565,7 +588,7 @@ uint32_t AudioPlayer_GetTimeInfo(uint32_t* Length, uint32_t* Elapsed)
   }
   if (sDecoderStruct.Decoder_GetElapsedTime != NULL)
   {
-    *Elapsed = sDecoderStruct.Decoder_GetElapsedTime(AudioFile.fptr);
+    *Elapsed = sDecoderStruct.Decoder_GetElapsedTime(Player_FileTell());
   }
   
   return 0;
@@ -619,17 +642,28 @@ static uint32_t  Player_FRead (void* pfile, uint8_t* pbuf, uint32_t size)
   */
 void  AudioPlayer_XferCplt (uint8_t** pbuf, uint32_t* pSize)
 {
+  uint32_t next = 0, depth = 0;
+  
+  AudioPlayerXferCount++;
+  
   if (AudioPlayerState == PLAYER_PLAYING)
   {
-    /* Release previous buffer for write operation */
-    AudioBuffers[RdBuffIdx].isReady = 0;
-    
-    /* Increment the buffer index */
-    RdBuffIdx = (RdBuffIdx >= 2)? 0:(RdBuffIdx+1);
+    next = PLAYER_NEXT(RdBuffIdx);
     
-    if (!(AudioBuffers[RdBuffIdx].isReady))
+    if (AudioBuffers[next].isReady)
+    {
+      /* Release previous buffer for write operation */
+      AudioBuffers[RdBuffIdx].Released = AUDIO_PLAYER_GET_TICK();
+      AudioBuffers[RdBuffIdx].isReady = 0;
+      
+      /* Increment the buffer index */
+      RdBuffIdx = next;
+    }
+    else
     {
-      RdBuffIdx = (RdBuffIdx > 0)? (RdBuffIdx-1):2;
+      /* Underrun: the previous buffer is played again, and kept from the
+         decode task meanwhile */
+      AudioPlayerStats.Underruns++;
     }
     
     /* Resume the audio stream */
@@ -637,8 +671,18 @@ void  AudioPlayer_XferCplt (uint8_t** pbuf, uint32_t* pSize)
                             AudioBuffers[RdBuffIdx].Size,  /* Number of samples in Bytes */
                             AUDIO_CMD_PLAY);               /* Command to be processed */
     
+    depth = Player_Depth();
+    AudioPlayerStats.Depth = depth;
+    if (depth < AudioPlayerStats.DepthMin)
+    {
+      AudioPlayerStats.DepthMin = depth;
+    }
+    
     /* Trigger the Main audio player task to update the next buffers */
-    EXTI_GenerateSWInterrupt(EXTI_Line4);
+    if (depth <= AUDIO_PLAYER_LOW_WATERMARK)
+    {
+      NVIC_SetPendingIRQ(AUDIO_PLAYER_IRQn);
+    }
   }
 }
 
@@ -649,6 +693,11 @@ void  AudioPlayer_XferCplt (uint8_t** pbuf, uint32_t* pSize)
   */
 uint32_t AudioPlayer_SetPosition(uint32_t Pos)
 {
+#if (AUDIO_PLAYER_CHUNK_SIZE != 0)
+  /* Drop the chunk read ahead */
+  ChunkLen = ChunkOff = 0;
+#endif /* AUDIO_PLAYER_CHUNK_SIZE */
+  
   /* Call the Fat FS seek function */
   return f_lseek(&AudioFile, Pos);
 }
@@ -675,6 +724,50 @@ AudioPlayerState_TypeDef AudioPlayer_GetState(void)
   return AudioPlayerState;
 }
 
+/**
+  * @brief  Returns the statistics of the decode ring.
+  * @param  pStats: pointer to the structure to be filled.
+  * @retval None.
+  */
+void AudioPlayer_GetStats(AudioPlayer_Stats_TypeDef *pStats)
+{
+  /* Copied with the transfer complete masked, for a consistent snapshot */
+  __disable_irq();
+  *pStats = AudioPlayerStats;
+  __enable_irq();
+}
+
+/**
+  * @brief  Clears the statistics of the decode ring.
+  * @param  None.
+  * @retval None.
+  */
+void AudioPlayer_ResetStats(void)
+{
+  __disable_irq();
+  memset(&AudioPlayerStats, 0, sizeof(AudioPlayerStats));
+  AudioPlayerStats.DepthMin = AUDIO_PLAYER_BUFFER_NBR;
+  __enable_irq();
+}
+
+/**
+  * @brief  Counts the buffers decoded ahead of the one playing.
+  * @param  None.
+  * @retval Number of buffers.
+  */
+static uint32_t Player_Depth(void)
+{
+  uint32_t i = 0, depth = 0;
+  
+  for (i = 0; i < AUDIO_PLAYER_BUFFER_NBR; i++)
+  {
+    depth += (AudioBuffers[i].isReady != 0);
+  }
+  
+  /* The buffer playing stays ready until the next one starts */
+  return (depth > 0)? (depth - 1):0;
+}
+
 /**
   * @brief  Callback function to supply the decoder with input MP3 bitsteram.
   * @param  pMP3CompressedData: pointer to the target buffer to be filled.
@@ -689,7 +782,7 @@ unsigned int Dec_ReadDataCallback(void *    pCompressedData,        /* [OUT] Bit
 {
   uint32_t tmp = 0x00;
   
-  tmp = f_read(&AudioFile, pCompressedData, nDataSizeInChars, (uint32_t*)(&NumberOfData));
+  tmp = Player_FileRead(pCompressedData, nDataSizeInChars, (uint32_t*)(&NumberOfData));
   
   if (tmp != FR_OK)
   {
@@ -705,7 +798,7 @@ unsigned int Dec_ReadDataCallback(void *    pCompressedData,        /* [OUT] Bit
   }
 
   /* Check on the end of file */
-  if (AudioFile.fptr >= AudioFile.fsize)
+  if (Player_FileTell() >= AudioFile.fsize)
   {
     /* AudioPlayer_SetPosition(DataStartOffset); *//* Fast replay without GUI update */
     /* return  NumberOfData; */
@@ -715,6 +808,89 @@ unsigned int Dec_ReadDataCallback(void *    pCompressedData,        /* [OUT] Bit
   return  NumberOfData;
 }
 
+/**
+  * @brief  Reads the audio file for the decoder, in chunks of
+  *         AUDIO_PLAYER_CHUNK_SIZE aligned in the file: FatFs then reads
+  *         whole sectors in one multi-sector access to the storage. Decoder
+  *         reads of whole aligned chunks go straight to their buffer.
+  * @param  pbuf: buffer to be filled.
+  * @param  size: number of data to be read in bytes.
+  * @param  pRead: number of data actually read.
+  * @retval FR_OK or the FatFs error.
+  */
+static uint32_t Player_FileRead(uint8_t* pbuf, uint32_t size, uint32_t* pRead)
+{
+#if (AUDIO_PLAYER_CHUNK_SIZE != 0)
+  uint32_t len = 0, rd = 0;
+  FRESULT res = FR_OK;
+  
+  *pRead = 0;
+  
+  while (size != 0)
+  {
+    if (ChunkOff == ChunkLen)
+    {
+      if (((AudioFile.fptr % AUDIO_PLAYER_CHUNK_SIZE) == 0) && 
+          (size >= AUDIO_PLAYER_CHUNK_SIZE))
+      {
+        /* Whole chunks: no copy */
+        len = size - (size % AUDIO_PLAYER_CHUNK_SIZE);
+        AudioPlayerStats.Reads++;
+        res = f_read(&AudioFile, pbuf, len, (UINT*)&rd);
+        *pRead += rd;
+        if ((res != FR_OK) || (rd < len))
+        {
+          return res;
+        }
+        pbuf += rd;
+        size -= rd;
+        continue;
+      }
+      
+      /* Up to the next chunk boundary of the file */
+      len = AUDIO_PLAYER_CHUNK_SIZE - (AudioFile.fptr % AUDIO_PLAYER_CHUNK_SIZE);
+      AudioPlayerStats.Reads++;
+      res = f_read(&AudioFile, ChunkBuff, len, (UINT*)&ChunkLen);
+      ChunkOff = 0;
+      if ((res != FR_OK) || (ChunkLen == 0))
+      {
+        return res;
+      }
+    }
+    
+    len = ChunkLen - ChunkOff;
+    if (len > size)
+    {
+      len = size;
+    }
+    memcpy(pbuf, ChunkBuff + ChunkOff, len);
+    ChunkOff += len;
+    *pRead += len;
+    pbuf += len;
+    size -= len;
+  }
+  
+  return FR_OK;
+#else
+  AudioPlayerStats.Reads++;
+  return f_read(&AudioFile, pbuf, size, (UINT*)pRead);
+#endif /* AUDIO_PLAYER_CHUNK_SIZE */
+}
+
+/**
+  * @brief  Returns the position of the decoder in the audio file.
+  * @param  None.
+  * @retval Position in bytes, behind the file pointer by the chunk left.
+  */
+static uint32_t Player_FileTell(void)
+{
+#if (AUDIO_PLAYER_CHUNK_SIZE != 0)
+  return AudioFile.fptr - (ChunkLen - ChunkOff);
+#else
+  return AudioFile.fptr;
+#endif /* AUDIO_PLAYER_CHUNK_SIZE */
+}
+
 /**
 * @brief  Transforms a 16-bit mono buffer to a 16-bit stereo buffer by duplicating all values
 * @param  BIn    : pointer to the input frame
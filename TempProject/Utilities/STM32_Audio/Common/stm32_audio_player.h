@@ -61,6 +61,54 @@
   */   
    
 #define AUDIO_FWD_RWD_STEP                        5
+
+/* Decoded buffers of the ring played by the DMA. These defines may be set in
+   audio_app_conf.h */
+#ifndef AUDIO_PLAYER_BUFFER_NBR
+ #define AUDIO_PLAYER_BUFFER_NBR                  3
+#endif /* AUDIO_PLAYER_BUFFER_NBR */
+
+/* Number of buffers decoded ahead of the one playing at or below which the
+   decode task is triggered: it then decodes until the ring is full */
+#ifndef AUDIO_PLAYER_LOW_WATERMARK
+ #define AUDIO_PLAYER_LOW_WATERMARK               (AUDIO_PLAYER_BUFFER_NBR - 1)
+#endif /* AUDIO_PLAYER_LOW_WATERMARK */
+
+/* The file is read in chunks of this size, aligned on it in the file, so that
+   FatFs reads whole sectors straight from the storage. 0 passes the decoder
+   reads to FatFs as they are */
+#ifndef AUDIO_PLAYER_CHUNK_SIZE
+ #define AUDIO_PLAYER_CHUNK_SIZE                  1024
+#endif /* AUDIO_PLAYER_CHUNK_SIZE */
+
+/* Software interrupt of the decode task, pended by the transfer complete: the
+   touch sensing one by default, the EXTI ones serving the buttons of the
+   board and the recorder. It must not be used by the application. */
+#ifndef AUDIO_PLAYER_IRQn
+ #define AUDIO_PLAYER_IRQn                        TSC_IRQn
+ #define AUDIO_PLAYER_IRQHandler                  TSC_IRQHandler
+#endif /* AUDIO_PLAYER_IRQn */
+
+/* Priority of the decode task, below the DMA and the storage */
+#ifndef AUDIO_PLAYER_TASK_PRIO
+ #define AUDIO_PLAYER_TASK_PRIO                   0x2
+#endif /* AUDIO_PLAYER_TASK_PRIO */
+
+/* Time base of the refill latency, in buffer transfers by default. May be
+   set to a millisecond counter of the application */
+#ifndef AUDIO_PLAYER_GET_TICK
+ #define AUDIO_PLAYER_GET_TICK()                  AudioPlayerXferCount
+#endif /* AUDIO_PLAYER_GET_TICK */
+
+#if (AUDIO_PLAYER_BUFFER_NBR < 2)
+ #error "AUDIO_PLAYER_BUFFER_NBR: the ring needs at least 2 buffers"
+#endif
+#if (AUDIO_PLAYER_LOW_WATERMARK >= AUDIO_PLAYER_BUFFER_NBR)
+ #error "AUDIO_PLAYER_LOW_WATERMARK: at most AUDIO_PLAYER_BUFFER_NBR - 1 buffers are decoded ahead"
+#endif
+#if ((AUDIO_PLAYER_CHUNK_SIZE % 512) != 0)
+ #error "AUDIO_PLAYER_CHUNK_SIZE: must be a multiple of the sector size"
+#endif
 /**
   * @}
   */ 
@@ -76,6 +124,19 @@ typedef enum
   PLAYER_ERROR,
 }AudioPlayerState_TypeDef;
 
+/* Decode ring statistics, see AudioPlayer_GetStats */
+typedef struct
+{
+  uint32_t Underruns;       /* Transfers that found no decoded buffer: the
+                               last one is played again */
+  uint32_t Refills;         /* Buffers decoded */
+  uint32_t RefillLatency;   /* Last time between the release of a buffer to */
+  uint32_t RefillLatencyMax;/* the decode task and its refill, and the max */
+  uint32_t Depth;           /* Buffers decoded ahead of the one playing */
+  uint32_t DepthMin;        /* Lowest depth seen at a transfer complete */
+  uint32_t Reads;           /* Reads handed to FatFs */
+}AudioPlayer_Stats_TypeDef;
+
 /**
   * @}
   */ 
@@ -91,6 +152,7 @@ typedef enum
 /** @defgroup STM32_AUDIO_PLAYER_Exported_Variables
   * @{
   */ 
+extern __IO uint32_t AudioPlayerXferCount;
 /**
   * @}
   */ 
@@ -108,16 +170,23 @@ uint32_t AudioPlayer_Stop(void);
 uint32_t AudioPlayer_Forward(void);
 uint32_t AudioPlayer_Rewind(void);
 uint32_t AudioPlayer_VolumeCtrl(uint8_t Volume);
+#if defined(__MP3_DECODER__) || defined(__WMA_DECODER__)
+uint32_t AudioPlayer_OpenFolder(uint8_t *Path);
+uint8_t  AudioPlayer_GetSong(uint32_t Index, SONG_IndexRecord_TypeDef *pRecord);
+uint32_t AudioPlayer_PlaySong(uint32_t Index);
+#endif /* __MP3_DECODER__ || __WMA_DECODER__ */
 
 TAGS_TypeDef* AudioPlayer_GetFileInfo(void);
 uint32_t AudioPlayer_GetTimeInfo(uint32_t* Length, uint32_t* Elapsed);
 uint32_t AudioPlayer_SetPosition(uint32_t pos);
 uint32_t AudioPlayer_GetFileLength(void);
 AudioPlayerState_TypeDef AudioPlayer_GetState(void);
+void     AudioPlayer_GetStats(AudioPlayer_Stats_TypeDef *pStats);
+void     AudioPlayer_ResetStats(void);
 
 void AudioPlayer_TaskInit(void);
 void AudioPlayer_TaskDeInit(void);
-void EXTI4_IRQHandler(void);
+void AUDIO_PLAYER_IRQHandler(void);
 
 unsigned int Dec_ReadDataCallback(
                       void * pCompressedData,        /* [OUT] Bitbuffer */
@@ -0,0 +1,537 @@
+/**
+  ******************************************************************************
+  * @file    stm32_audio_recorder.c
+  * @author  MCD Application Team
+  * @version V2.0.2
+  * @date    31-January-2014
+  * @brief   This file provides the audio recorder: the captured audio is
+  *          streamed to a WAV file on a FatFs volume.
+  *
+  *          The capture low layer fills the blocks of a ring, and the transfer
+  *          complete hands each block to the AUDIO_RECORDER_IRQn software
+  *          interrupt, which writes it to the file:
+  *           - the file is preallocated when the recording starts, so that its
+  *             clusters follow each other on an unfragmented volume and no
+  *             FAT update is needed while recording,
+  *           - the header is padded to one block, so that every write is a
+  *             whole block aligned in the file, sent to the storage as a
+  *             multi-sector write without going through the FatFs window,
+  *           - the RIFF and data sizes are updated every
+  *             AUDIO_RECORDER_SYNC_BLOCKS blocks and at the stop: after a power
+  *             cut the file is a valid WAV file ending at the last update,
+  *           - a block captured while the ring is full is dropped and counted.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include  "stm32_audio_recorder.h"
+
+#if defined(__WAV_ENCODER__)  /* Don't build if not configured for use in audio_app_conf.h */
+
+/** @addtogroup STM32_Audio_Utilities
+  * @{
+  */
+
+
+/** @defgroup STM32_AUDIO_RECORDER
+  * @brief STM32 Audio Recorder module
+  * @{
+  */
+
+/** @defgroup STM32_AUDIO_RECORDER_Private_TypesDefinitions
+  * @{
+  */
+/**
+  * @}
+  */
+
+
+/** @defgroup STM32_AUDIO_RECORDER_Private_Defines
+  * @{
+  */
+/* Bytes of one sample of all channels */
+#define RECORDER_FRAME_SIZE     ((DEFAULT_IN_BIT_RESOLUTION / 8) * DEFAULT_IN_CHANNEL_NBR)
+/**
+  * @}
+  */
+
+
+/** @defgroup STM32_AUDIO_RECORDER_Private_Macros
+  * @{
+  */
+#define RECORDER_BLOCK(Idx)     (RecRing + ((Idx) * AUDIO_RECORDER_BLOCK_SIZE))
+#define RECORDER_NEXT(Idx)      (((Idx) >= (AUDIO_RECORDER_BLOCK_NBR - 1))? 0:((Idx) + 1))
+/**
+  * @}
+  */
+
+
+/** @defgroup STM32_AUDIO_RECORDER_Private_Variables
+  * @{
+  */
+/* Capture ring: the low layer fills the block RecCapIdx, RecFilled blocks
+   from RecWrIdx wait to be written */
+static uint8_t RecRing[AUDIO_RECORDER_BLOCK_SIZE * AUDIO_RECORDER_BLOCK_NBR];
+uint32_t RecCapIdx = 0, RecWrIdx = 0;
+__IO uint32_t RecFilled = 0;
+
+/* Audio bytes written to the file, and blocks since the last header update */
+uint32_t RecDataSize = 0;
+uint32_t RecSyncCount = 0;
+uint32_t RecByteRate = 0;
+
+FIL RecFile;
+
+static AudioRecorderState_TypeDef AudioRecorderState = RECORDER_IDLE;
+
+AudioRecorder_Stats_TypeDef AudioRecorderStats;
+/**
+  * @}
+  */
+
+
+/** @defgroup STM32_AUDIO_RECORDER_Private_FunctionPrototypes
+  * @{
+  */
+void  AudioRecorder_XferCplt (uint8_t** pbuf, uint32_t* pSize);
+static void     Recorder_Process(void);
+static void     Recorder_HeaderInit(uint8_t* pHeader, uint32_t Freq);
+static uint32_t Recorder_Sync(void);
+static void     Recorder_PutLE32(uint8_t* p, uint32_t Val);
+/**
+  * @}
+  */
+
+/** @defgroup STM32_AUDIO_RECORDER_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  Initialize all resources used by the Audio Recorder
+  * @param  None
+  * @retval 0 if passed, !0 else.
+  */
+uint32_t AudioRecorder_Init(void)
+{
+  /* Set the default state of the recorder to idle */
+  AudioRecorderState = RECORDER_IDLE;
+
+  /* Software interrupt writing the blocks captured */
+  NVIC_SetPriority(AUDIO_RECORDER_IRQn, AUDIO_RECORDER_IRQ_PRIORITY);
+  NVIC_ClearPendingIRQ(AUDIO_RECORDER_IRQn);
+  NVIC_EnableIRQ(AUDIO_RECORDER_IRQn);
+
+  return 0;
+}
+
+/**
+  * @brief  Free all resources used by the Audio Recorder
+  * @param  None
+  * @retval 0 if passed, !0 else.
+  */
+uint32_t AudioRecorder_DeInit(void)
+{
+  /* Close the current recording, if any */
+  AudioRecorder_Stop();
+
+  NVIC_DisableIRQ(AUDIO_RECORDER_IRQn);
+
+  return 0;
+}
+
+/**
+  * @brief  Starts recording to a new WAV file.
+  * @param  FilePath: path of the file, overwritten if it exists.
+  * @param  Freq: sampling frequency.
+  * @param  Seconds: length of audio preallocated in the file, 0 for none.
+  * @retval 0 if passed, !0 else.
+  */
+uint32_t AudioRecorder_Start(uint8_t *FilePath, uint32_t Freq, uint32_t Seconds)
+{
+  uint32_t size = 0, bw = 0;
+
+  /* Check recorder state */
+  if (AudioRecorderState != RECORDER_IDLE)
+  {
+    return 1;
+  }
+
+  if (f_open(&RecFile, (char *)FilePath, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+  {
+    return 1;
+  }
+
+  /* Build the header in the first block, free until the capture starts */
+  if (WavProcess_EncInit(Freq, RECORDER_BLOCK(0)) != 0)
+  {
+    f_close(&RecFile);
+    return 2;
+  }
+  Recorder_HeaderInit(RECORDER_BLOCK(0), Freq);
+
+  /* Allocate the clusters of the whole recording at once: a seek past the
+     end of a file open for write stretches its cluster chain */
+  if (Seconds != 0)
+  {
+    size = AUDIO_RECORDER_HEADER_SIZE + (Seconds * RecByteRate);
+    size += AUDIO_RECORDER_BLOCK_SIZE - 1;
+    size -= size % AUDIO_RECORDER_BLOCK_SIZE;
+    if ((f_lseek(&RecFile, size) != FR_OK) || (f_lseek(&RecFile, 0) != FR_OK))
+    {
+      WavProcess_EncDeInit();
+      f_close(&RecFile);
+      return 3;
+    }
+  }
+
+  /* The header and the file size are on the volume before the first sample */
+  if ((f_write(&RecFile, RECORDER_BLOCK(0), AUDIO_RECORDER_HEADER_SIZE, (UINT*)&bw) != FR_OK) ||
+      (bw != AUDIO_RECORDER_HEADER_SIZE) || (f_sync(&RecFile) != FR_OK))
+  {
+    WavProcess_EncDeInit();
+    f_close(&RecFile);
+    return 3;
+  }
+
+  RecCapIdx = RecWrIdx = 0;
+  RecFilled = 0;
+  RecDataSize = 0;
+  RecSyncCount = 0;
+  memset(&AudioRecorderStats, 0, sizeof(AudioRecorderStats));
+
+  /* Initialize the Audio input Hardware layer */
+  if (AUDIO_IN_fops.Init(Freq, DEFAULT_VOLUME, 0) != AUDIO_OK)
+  {
+    WavProcess_EncDeInit();
+    f_close(&RecFile);
+    return 4;
+  }
+
+  /* Set the callback to be called when a block has been captured */
+  AUDIO_IN_fops.SetXferCpltCallback(AudioRecorder_XferCplt);
+
+  AudioRecorderState = RECORDER_RECORDING;
+
+  /* Start the capture in the first block */
+  if (AUDIO_IN_fops.AudioCmd(RECORDER_BLOCK(0),
+                             AUDIO_RECORDER_BLOCK_SIZE,
+                             AUDIO_IN_CMD_START) != AUDIO_OK)
+  {
+    AudioRecorderState = RECORDER_IDLE;
+    AUDIO_IN_fops.DeInit();
+    WavProcess_EncDeInit();
+    f_close(&RecFile);
+    return 4;
+  }
+
+  return 0;
+}
+
+/**
+  * @brief  Stops the recording: the blocks captured are written, the header
+  *         updated and the preallocated space past the audio released.
+  * @param  None
+  * @retval 0 if passed, !0 else.
+  */
+uint32_t AudioRecorder_Stop(void)
+{
+  FRESULT res = FR_OK;
+
+  if (AudioRecorderState == RECORDER_IDLE)
+  {
+    return 0;
+  }
+
+  /* Stop the capture, the block being captured is dropped */
+  AUDIO_IN_fops.AudioCmd(NULL, 0, AUDIO_IN_CMD_STOP);
+
+  /* Write the blocks waiting in the ring, the interrupt masked */
+  NVIC_DisableIRQ(AUDIO_RECORDER_IRQn);
+  Recorder_Process();
+
+  if (AudioRecorderState == RECORDER_RECORDING)
+  {
+    res = (FRESULT)Recorder_Sync();
+
+    /* Cut the file after the audio */
+    if (res == FR_OK)
+    {
+      res = f_lseek(&RecFile, AUDIO_RECORDER_HEADER_SIZE + RecDataSize);
+    }
+    if (res == FR_OK)
+    {
+      res = f_truncate(&RecFile);
+    }
+  }
+
+  if (f_close(&RecFile) != FR_OK)
+  {
+    res = FR_DISK_ERR;
+  }
+
+  WavProcess_EncDeInit();
+  AUDIO_IN_fops.DeInit();
+
+  AudioRecorderState = RECORDER_IDLE;
+  NVIC_ClearPendingIRQ(AUDIO_RECORDER_IRQn);
+  NVIC_EnableIRQ(AUDIO_RECORDER_IRQn);
+
+  return (res != FR_OK);
+}
+
+/**
+  * @brief  This function handles the recorder software interrupt.
+  * @param  None
+  * @retval None
+  */
+void AUDIO_RECORDER_IRQHandler(void)
+{
+  Recorder_Process();
+}
+
+/**
+  * @brief  Writes the blocks captured to the file.
+  * @param  None
+  * @retval None
+  */
+static void Recorder_Process(void)
+{
+  uint8_t* pOut = NULL;
+  uint32_t len = 0, bw = 0;
+
+  while ((AudioRecorderState == RECORDER_RECORDING) && (RecFilled != 0))
+  {
+    len = AUDIO_RECORDER_BLOCK_SIZE;
+    WavProcess_EncodeData((int8_t*)RECORDER_BLOCK(RecWrIdx), (int8_t*)&pOut, &len, NULL);
+
+    if ((f_write(&RecFile, pOut, len, (UINT*)&bw) != FR_OK) || (bw != len))
+    {
+      /* Volume full or storage error: the file keeps the audio up to the
+         last header update */
+      AUDIO_IN_fops.AudioCmd(NULL, 0, AUDIO_IN_CMD_STOP);
+      AudioRecorderState = RECORDER_ERROR;
+      return;
+    }
+    RecDataSize += len;
+    AudioRecorderStats.Blocks++;
+
+    /* Hand the block back to the capture */
+    RecWrIdx = RECORDER_NEXT(RecWrIdx);
+    __disable_irq();
+    RecFilled--;
+    __enable_irq();
+
+    if (++RecSyncCount >= AUDIO_RECORDER_SYNC_BLOCKS)
+    {
+      RecSyncCount = 0;
+      if (Recorder_Sync() != FR_OK)
+      {
+        AUDIO_IN_fops.AudioCmd(NULL, 0, AUDIO_IN_CMD_STOP);
+        AudioRecorderState = RECORDER_ERROR;
+        return;
+      }
+    }
+  }
+}
+
+/**
+  * @brief  Returns the length of the audio written, in seconds.
+  * @param  None
+  * @retval Elapsed time in seconds.
+  */
+uint32_t AudioRecorder_GetElapsedTime(void)
+{
+  return (RecByteRate != 0)? (RecDataSize / RecByteRate):0;
+}
+
+/**
+  * @brief  Returns the current state of the audio recorder.
+  * @param  None
+  * @retval RECORDER_IDLE, RECORDER_RECORDING or RECORDER_ERROR.
+  */
+AudioRecorderState_TypeDef AudioRecorder_GetState(void)
+{
+  return AudioRecorderState;
+}
+
+/**
+  * @brief  Returns the statistics of the recorder.
+  * @param  pStats: pointer to the structure to be filled.
+  * @retval None.
+  */
+void AudioRecorder_GetStats(AudioRecorder_Stats_TypeDef *pStats)
+{
+  /* Copied with the transfer complete masked, for a consistent snapshot */
+  __disable_irq();
+  *pStats = AudioRecorderStats;
+  __enable_irq();
+}
+
+/**
+  * @brief  Manage the end of capture of a block. The low layer passes the
+  *         block captured and captures next into the block returned.
+  * @param  pbuf: Pointer to the address of the current buffer
+  * @param  pSize: pointer to the variable which holds current buffer size
+  * @retval None
+  */
+void  AudioRecorder_XferCplt (uint8_t** pbuf, uint32_t* pSize)
+{
+  if (AudioRecorderState != RECORDER_RECORDING)
+  {
+    return;
+  }
+
+  /* One block stays free for the capture */
+  if (RecFilled < (AUDIO_RECORDER_BLOCK_NBR - 1))
+  {
+    RecFilled++;
+    if (RecFilled > AudioRecorderStats.FillMax)
+    {
+      AudioRecorderStats.FillMax = RecFilled;
+    }
+    RecCapIdx = RECORDER_NEXT(RecCapIdx);
+    NVIC_SetPendingIRQ(AUDIO_RECORDER_IRQn);
+  }
+  else
+  {
+    /* Ring full: the block is captured again */
+    AudioRecorderStats.Overruns++;
+    AudioRecorderStats.Dropped += AUDIO_RECORDER_BLOCK_SIZE / RECORDER_FRAME_SIZE;
+  }
+
+  *pbuf = RECORDER_BLOCK(RecCapIdx);
+  *pSize = AUDIO_RECORDER_BLOCK_SIZE;
+}
+
+/**
+  * @brief  Completes the header built by the WAV encoder: format of the
+  *         capture, and a 'JUNK' chunk up to the end of the first block.
+  * @param  pHeader: header built by WavProcess_EncInit, of
+  *         AUDIO_RECORDER_HEADER_SIZE bytes.
+  * @param  Freq: sampling frequency.
+  * @retval None
+  */
+static void Recorder_HeaderInit(uint8_t* pHeader, uint32_t Freq)
+{
+  RecByteRate = Freq * RECORDER_FRAME_SIZE;
+
+  /* RIFF size, updated by Recorder_Sync */
+  Recorder_PutLE32(&pHeader[4], AUDIO_RECORDER_HEADER_SIZE - 8);
+
+  /* Format of the capture */
+  pHeader[22] = DEFAULT_IN_CHANNEL_NBR;
+  pHeader[23] = 0x00;
+  Recorder_PutLE32(&pHeader[28], RecByteRate);
+  pHeader[32] = RECORDER_FRAME_SIZE;
+  pHeader[33] = 0x00;
+  pHeader[34] = DEFAULT_IN_BIT_RESOLUTION;
+  pHeader[35] = 0x00;
+
+  /* Padding chunk in place of the data chunk of the encoder */
+  pHeader[36] = 'J';
+  pHeader[37] = 'U';
+  pHeader[38] = 'N';
+  pHeader[39] = 'K';
+  Recorder_PutLE32(&pHeader[40], AUDIO_RECORDER_HEADER_SIZE - 52);
+  memset(&pHeader[44], 0, AUDIO_RECORDER_HEADER_SIZE - 52);
+
+  /* Data chunk, its size updated by Recorder_Sync */
+  pHeader[AUDIO_RECORDER_HEADER_SIZE - 8] = 'd';
+  pHeader[AUDIO_RECORDER_HEADER_SIZE - 7] = 'a';
+  pHeader[AUDIO_RECORDER_HEADER_SIZE - 6] = 't';
+  pHeader[AUDIO_RECORDER_HEADER_SIZE - 5] = 'a';
+  Recorder_PutLE32(&pHeader[AUDIO_RECORDER_HEADER_SIZE - 4], 0);
+}
+
+/**
+  * @brief  Writes the sizes of the audio written in the header, then flushes
+  *         the file. The audio blocks are on the volume before the sizes
+  *         counting them.
+  * @param  None
+  * @retval FR_OK or the FatFs error.
+  */
+static uint32_t Recorder_Sync(void)
+{
+  FRESULT res = FR_OK;
+  uint32_t pos = RecFile.fptr, bw = 0;
+  uint8_t size[4];
+
+  Recorder_PutLE32(size, AUDIO_RECORDER_HEADER_SIZE - 8 + RecDataSize);
+  res = f_lseek(&RecFile, 4);
+  if (res == FR_OK)
+  {
+    res = f_write(&RecFile, size, 4, (UINT*)&bw);
+  }
+
+  Recorder_PutLE32(size, RecDataSize);
+  if (res == FR_OK)
+  {
+    res = f_lseek(&RecFile, AUDIO_RECORDER_HEADER_SIZE - 4);
+  }
+  if (res == FR_OK)
+  {
+    res = f_write(&RecFile, size, 4, (UINT*)&bw);
+  }
+
+  if (res == FR_OK)
+  {
+    res = f_lseek(&RecFile, pos);
+  }
+  if (res == FR_OK)
+  {
+    res = f_sync(&RecFile);
+  }
+
+  AudioRecorderStats.Syncs++;
+
+  return res;
+}
+
+/**
+  * @brief  Writes a 32-bit value in little endian.
+  * @param  p: destination.
+  * @param  Val: value to be written.
+  * @retval None
+  */
+static void Recorder_PutLE32(uint8_t* p, uint32_t Val)
+{
+  p[0] = BYTE_0(Val);
+  p[1] = BYTE_1(Val);
+  p[2] = BYTE_2(Val);
+  p[3] = BYTE_3(Val);
+}
+/**
+  * @}
+  */
+
+
+/**
+  * @}
+  */
+
+
+/**
+  * @}
+  */
+
+#endif /* __WAV_ENCODER__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,176 @@
+/**
+  ******************************************************************************
+  * @file    stm32_audio_recorder.h
+  * @author  MCD Application Team
+  * @version V2.0.2
+  * @date    31-January-2014
+  * @brief   This file contains all the functions prototypes for the audio
+  *          recorder module.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; COPYRIGHT 2014 STMicroelectronics</center></h2>
+  *
+  * Licensed under MCD-ST Liberty SW License Agreement V2, (the "License");
+  * You may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at:
+  *
+  *        http://www.st.com/software_license_agreement_liberty_v2
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef  __STM32_AUDIO_RECORDER_H__
+#define  __STM32_AUDIO_RECORDER_H__
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+
+#include "audio_app_conf.h"
+#include "stm32_audio.h"
+#include "stm32_audio_in_if.h"
+#include "wavprocess.h"
+
+#include "ff.h" /* File System */
+
+#if defined(__WAV_ENCODER__)  /* Don't build if not configured for use in audio_app_conf.h */
+
+/** @addtogroup STM32_Audio_Utilities
+  * @{
+  */
+
+/** @defgroup STM32_AUDIO_RECORDER
+  * @brief This file is the header file for the stm32 audio recorder module
+  * @{
+  */
+
+
+/** @defgroup STM32_AUDIO_RECORDER_Exported_Defines
+  * @{
+  */
+/* Size of the blocks captured and written to the file: a multiple of the
+   largest sector size of the volumes, _MAX_SS (ffconf.h). These defines may
+   be set in audio_app_conf.h */
+#ifndef AUDIO_RECORDER_BLOCK_SIZE
+ #define AUDIO_RECORDER_BLOCK_SIZE                _MAX_SS
+#endif /* AUDIO_RECORDER_BLOCK_SIZE */
+
+/* Blocks of the capture ring: one is being captured, the others wait for
+   the recorder interrupt to write them */
+#ifndef AUDIO_RECORDER_BLOCK_NBR
+ #define AUDIO_RECORDER_BLOCK_NBR                 4
+#endif /* AUDIO_RECORDER_BLOCK_NBR */
+
+/* Blocks written between two updates of the header sizes: a power cut
+   loses at most the audio recorded since the last one */
+#ifndef AUDIO_RECORDER_SYNC_BLOCKS
+ #define AUDIO_RECORDER_SYNC_BLOCKS               64
+#endif /* AUDIO_RECORDER_SYNC_BLOCKS */
+
+/* Software interrupt writing the captured blocks to the file, pended by the
+   end of capture of a block. Its priority must be lower than the one of the
+   capture, and the volume recorded to must not be used by the application
+   while recording. */
+#ifndef AUDIO_RECORDER_IRQn
+ #define AUDIO_RECORDER_IRQn                      EXTI4_15_IRQn
+ #define AUDIO_RECORDER_IRQHandler                EXTI4_15_IRQHandler
+#endif /* AUDIO_RECORDER_IRQn */
+#ifndef AUDIO_RECORDER_IRQ_PRIORITY
+ #define AUDIO_RECORDER_IRQ_PRIORITY              3
+#endif /* AUDIO_RECORDER_IRQ_PRIORITY */
+
+/* The header is padded with a 'JUNK' chunk to one block, so that the audio
+   data starts on a block of the file */
+#define AUDIO_RECORDER_HEADER_SIZE                AUDIO_RECORDER_BLOCK_SIZE
+
+#if (AUDIO_RECORDER_BLOCK_NBR < 2)
+ #error "AUDIO_RECORDER_BLOCK_NBR: the capture ring needs at least 2 blocks"
+#endif
+#if ((AUDIO_RECORDER_BLOCK_SIZE % _MAX_SS) != 0)
+ #error "AUDIO_RECORDER_BLOCK_SIZE: must be a multiple of _MAX_SS"
+#endif
+/**
+  * @}
+  */
+
+/** @defgroup STM32_AUDIO_RECORDER_Exported_TypesDefinitions
+  * @{
+  */
+typedef enum
+{
+  RECORDER_IDLE = 0,
+  RECORDER_RECORDING,
+  RECORDER_ERROR,
+}AudioRecorderState_TypeDef;
+
+/* Recorder statistics, see AudioRecorder_GetStats */
+typedef struct
+{
+  uint32_t Blocks;          /* Blocks written to the file */
+  uint32_t Overruns;        /* Blocks captured while the ring was full */
+  uint32_t Dropped;         /* Samples of those blocks, lost */
+  uint32_t FillMax;         /* Most blocks waiting to be written */
+  uint32_t Syncs;           /* Updates of the header sizes */
+}AudioRecorder_Stats_TypeDef;
+/**
+  * @}
+  */
+
+
+/** @defgroup STM32_AUDIO_RECORDER_Exported_Macros
+  * @{
+  */
+/**
+  * @}
+  */
+
+/** @defgroup STM32_AUDIO_RECORDER_Exported_Variables
+  * @{
+  */
+/**
+  * @}
+  */
+
+/** @defgroup STM32_AUDIO_RECORDER_Exported_FunctionsPrototype
+  * @{
+  */
+uint32_t AudioRecorder_Init(void);
+uint32_t AudioRecorder_DeInit(void);
+uint32_t AudioRecorder_Start(uint8_t *FilePath, uint32_t Freq, uint32_t Seconds);
+uint32_t AudioRecorder_Stop(void);
+uint32_t AudioRecorder_GetElapsedTime(void);
+AudioRecorderState_TypeDef AudioRecorder_GetState(void);
+void     AudioRecorder_GetStats(AudioRecorder_Stats_TypeDef *pStats);
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* __WAV_ENCODER__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32_AUDIO_RECORDER_H__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -50,6 +50,8 @@ static TSpiritWMADec_Prms objWmaPrms;
 /** @defgroup WmaProcess_Private_Defines
   * @{
   */
+/* Input buffer of the demuxer, also used to parse the tags */
+#define WMA_BUFIN_SIZE            (4 * 1024)
 
 /**
   * @}
@@ -137,7 +139,7 @@ uint32_t WmaProcess_DecoderInit(uint8_t* pHeader,
   }
   
   /* Allocate temporary buffer for ASF decoding */
-  acBufIn = (uint8_t*) WMA_DEC_MALLOC(4 * 1024 * sizeof(uint8_t));
+  acBufIn = (uint8_t*) WMA_DEC_MALLOC(WMA_BUFIN_SIZE * sizeof(uint8_t));
   if (acBufIn == NULL)
   {
     WMA_DEC_FREE(aiScratch);
@@ -395,7 +397,7 @@ uint32_t WmaProcess_RetrieveIDTAGS(TAGS_TypeDef * pIDTAG, FIL* pFile)
   /* Call the ASF layer function */
   if (pIDTAG != NULL)
   {
-    SongUtilities_WMATagParser(pIDTAG, pFile, acBufIn);
+    SongUtilities_WMATagParser(pIDTAG, pFile, acBufIn, WMA_BUFIN_SIZE);
   }
   return 0;
 }
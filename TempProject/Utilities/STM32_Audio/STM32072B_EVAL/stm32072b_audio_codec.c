@@ -848,6 +848,17 @@ uint32_t Audio_MAL_GetRemCount(void)
   return (uint32_t)(DMA_GetCurrDataCounter(AUDIO_MAL_DMA_CHANNEL));
 }
 
+/**
+  * @brief  Returns the remaining bytes to be processed by MAL layer.
+  * @note   Each DMA transfer moves DataSize bytes, as set by Audio_MAL_Play().
+  * @param  None.
+  * @retval Number of bytes not yet sent to the DAC.
+  */
+uint32_t Audio_MAL_GetRemBytes(void)
+{
+  return (uint32_t)(DMA_GetCurrDataCounter(AUDIO_MAL_DMA_CHANNEL)) * DataSize;
+}
+
 /*==============================================================================
                         Trigger Timer Functions
 ==============================================================================*/
@@ -201,6 +201,7 @@ void     Audio_MAL_Play(uint32_t Addr, uint32_t Size);
 void     Audio_MAL_PauseResume(uint32_t Cmd, uint32_t Addr, uint32_t Size);
 void     Audio_MAL_Stop(void);
 uint32_t Audio_MAL_GetRemCount(void);
+uint32_t Audio_MAL_GetRemBytes(void);
 
 /* User Callbacks: user has to implement these functions in his code if
   they are needed. -----------------------------------------------------------*/
@@ -378,6 +378,9 @@ void SD_LowLevel_Init(void)
   /* SD_SPI Periph clock enable */
   RCC_APB2PeriphClockCmd(SD_SPI_CLK, ENABLE); 
 
+  /* DMA clock enable, for the data blocks */
+  RCC_AHBPeriphClockCmd(SD_SPI_DMA_CLK, ENABLE);
+
   /* Configure SD_SPI pins: SCK */
   GPIO_InitStructure.GPIO_Pin = SD_SPI_SCK_PIN;
   GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF;
@@ -289,6 +289,25 @@ typedef enum
 #define SD_DETECT_EXTI_PORT_SOURCE       EXTI_PortSourceGPIOB
 #define SD_DETECT_EXTI_IRQn              EXTI4_15_IRQn
 
+/**
+  * @brief  SD SPI clock: PCLK/128 (375 KHz) while the card is identified,
+  *         PCLK/2 (24 MHz) for the data transfers
+  */
+#define SD_SPI_INIT_PRESCALER            SPI_BaudRatePrescaler_128
+#define SD_SPI_TRANSFER_PRESCALER        SPI_BaudRatePrescaler_2
+
+/**
+  * @brief  SD SPI DMA channels. Channel 3 is also used by the DAC audio codec,
+  *         SD transfers and audio playback cannot run at the same time
+  */
+#define SD_SPI_DR_ADDRESS                ((uint32_t)&(SD_SPI->DR))
+#define SD_SPI_DMA_CLK                   RCC_AHBPeriph_DMA1
+#define SD_SPI_DMA_RX_CHANNEL            DMA1_Channel2
+#define SD_SPI_DMA_RX_FLAG_TC            DMA1_FLAG_TC2
+#define SD_SPI_DMA_RX_FLAG_GL            DMA1_FLAG_GL2
+#define SD_SPI_DMA_TX_CHANNEL            DMA1_Channel3
+#define SD_SPI_DMA_TX_FLAG_GL            DMA1_FLAG_GL3
+
 /**
   * @}
   */
@@ -18,7 +18,8 @@
   *          ===================================================================
   *          Notes: 
   *           - This driver is intended for STM32F0xx families devices only.
-  *           - This driver doesn't support SD High Capacity cards.
+  *           - Standard and High Capacity cards are supported. The data
+  *             blocks are moved by DMA, with CMD18/CMD25 for several blocks.
   *          ===================================================================
   *
   *          +-------------------------------------------------------+
@@ -76,9 +77,73 @@
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+/* Card types found by SD_GoIdleState */
+#define SD_TYPE_V1            0x01  /* Version 1.x, byte addressed */
+#define SD_TYPE_V2            0x02  /* Version 2.0, byte addressed */
+#define SD_TYPE_HC            0x04  /* High capacity, block addressed */
+
+#define SD_INIT_TIMEOUT       ((uint32_t)0x2000)   /* ACMD41 tries, about 1 s */
+#define SD_BUSY_TIMEOUT       ((uint32_t)0x80000)  /* Bytes polled, about 500 ms */
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
+static uint8_t SD_CardType = 0;
+
+/* Sent by DMA while blocks are read, received into while blocks are written */
+static const uint8_t SD_DummyTx = SD_DUMMY_BYTE;
+static uint8_t SD_DummyRx;
+
+#ifdef SD_USE_CRC
+/* CRC16-CCITT (polynomial 0x1021, initial value 0) of the data blocks */
+static const uint16_t SD_CRC16_Table[256] =
+{
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+  0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+  0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+  0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+  0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+  0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+  0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+  0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+  0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+  0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+  0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+  0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+  0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+  0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+  0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+  0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+  0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+  0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+  0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+  0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+  0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+  0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+  0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+  0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+  0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+  0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+  0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+  0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+  0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+  0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+  0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+#endif /* SD_USE_CRC */
+
 /* Private function prototypes -----------------------------------------------*/
+static void SD_SetSpeed(uint16_t Prescaler);
+static uint8_t SD_SendCommand(uint8_t Cmd, uint32_t Arg);
+static SD_Error SD_WaitReady(void);
+static uint8_t SD_GetDataToken(void);
+static void SD_DMA_Start(uint8_t* RxBuffer, const uint8_t* TxBuffer, uint16_t Size);
+static void SD_DMA_Wait(void);
+static uint8_t SD_CRC7(const uint8_t* pBuffer, uint32_t Length);
+#ifdef SD_USE_CRC
+static uint16_t SD_CRC16(const uint8_t* pBuffer, uint32_t Length);
+#endif
+
 /* Private functions ---------------------------------------------------------*/
 
 /**
@@ -105,6 +170,9 @@ SD_Error SD_Init(void)
   /* Initialize SD_SPI */
   SD_LowLevel_Init(); 
 
+  /* The card is identified at 400 KHz at most */
+  SD_SetSpeed(SD_SPI_INIT_PRESCALER);
+
   /* SD chip select high */
   SD_CS_HIGH();
 
@@ -117,8 +185,15 @@ SD_Error SD_Init(void)
   }
   
   /*------------ Put SD in SPI mode --------------*/
-  /* SD initialized and set to SPI mode properly */
-  return (SD_GoIdleState());
+  if (SD_GoIdleState() != SD_RESPONSE_NO_ERROR)
+  {
+    return SD_RESPONSE_FAILURE;
+  }
+
+  /* SD initialized and set to SPI mode properly: full speed */
+  SD_SetSpeed(SD_SPI_TRANSFER_PRESCALER);
+
+  return SD_RESPONSE_NO_ERROR;
 }
 
 /**
@@ -152,10 +227,23 @@ SD_Error SD_GetCardInfo(SD_CardInfo *cardinfo)
 
   SD_GetCSDRegister(&(cardinfo->SD_csd));
   status = SD_GetCIDRegister(&(cardinfo->SD_cid));
-  cardinfo->CardCapacity = (cardinfo->SD_csd.DeviceSize + 1) ;
-  cardinfo->CardCapacity *= (1 << (cardinfo->SD_csd.DeviceSizeMul + 2));
-  cardinfo->CardBlockSize = 1 << (cardinfo->SD_csd.RdBlockLen);
-  cardinfo->CardCapacity *= cardinfo->CardBlockSize;
+
+  if (cardinfo->SD_csd.CSDStruct == 1)
+  {
+    /* CSD version 2.0: (C_SIZE + 1) * 512 KBytes */
+    cardinfo->CardBlockSize = SD_BLOCK_SIZE;
+    cardinfo->CardBlockNbr = (cardinfo->SD_csd.DeviceSize + 1) * 1024;
+    cardinfo->CardCapacity = (cardinfo->CardBlockNbr >= 0x800000) ? 0xFFFFFFFF :
+                             (cardinfo->CardBlockNbr * SD_BLOCK_SIZE);
+  }
+  else
+  {
+    cardinfo->CardCapacity = (cardinfo->SD_csd.DeviceSize + 1) ;
+    cardinfo->CardCapacity *= (1 << (cardinfo->SD_csd.DeviceSizeMul + 2));
+    cardinfo->CardBlockSize = 1 << (cardinfo->SD_csd.RdBlockLen);
+    cardinfo->CardCapacity *= cardinfo->CardBlockSize;
+    cardinfo->CardBlockNbr = cardinfo->CardCapacity / SD_BLOCK_SIZE;
+  }
 
   /* Returns the response */
   return status;
@@ -164,60 +252,22 @@ SD_Error SD_GetCardInfo(SD_CardInfo *cardinfo)
 /**
   * @brief  Reads a block of data from the SD.
   * @param  pBuffer: pointer to the buffer that receives the data read from the SD card.
-  * @param  ReadAddr: SD's internal address to read from.
-  * @param  BlockSize: the SD card Data block size.
+  * @param  ReadAddr: SD's internal address to read from, in bytes.
+  * @param  BlockSize: the SD card Data block size, SD_BLOCK_SIZE.
   * @retval The SD Response:
   *         - SD_RESPONSE_FAILURE: Sequence failed
   *         - SD_RESPONSE_NO_ERROR: Sequence succeed
   */
 SD_Error SD_ReadBlock(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockSize)
 {
-  uint32_t i = 0;
-  SD_Error rvalue = SD_RESPONSE_FAILURE;
-  
-  /* SD chip select low */
-  SD_CS_LOW();
-  
-  /* Send CMD17 (SD_CMD_READ_SINGLE_BLOCK) to read one block */
-  SD_SendCmd(SD_CMD_READ_SINGLE_BLOCK, ReadAddr, 0xFF);
-  
-  /* Check if the SD acknowledged the read block command: R1 response (0x00: no errors) */
-  if (!SD_GetResponse(SD_RESPONSE_NO_ERROR))
-  {
-    /* Now look for the data token to signify the start of the data */
-    if (!SD_GetResponse(SD_START_DATA_SINGLE_BLOCK_READ))
-    {
-      /* Read the SD block data : read NumByteToRead data */
-      for (i = 0; i < BlockSize; i++)
-      {
-        /* Save the received data */
-        *pBuffer = SD_ReadByte();
-       
-        /* Point to the next location where the byte read will be saved */
-        pBuffer++;
-      }
-      /* Get CRC bytes (not really needed by us, but required by SD) */
-      SD_ReadByte();
-      SD_ReadByte();
-      /* Set response value to success */
-      rvalue = SD_RESPONSE_NO_ERROR;
-    }
-  }
-  /* SD chip select high */
-  SD_CS_HIGH();
-  
-  /* Send dummy byte: 8 Clock pulses of delay */
-  SD_WriteByte(SD_DUMMY_BYTE);
-  
-  /* Returns the response */
-  return rvalue;
+  return SD_ReadMultiBlocks(pBuffer, ReadAddr, BlockSize, 1);
 }
 
 /**
   * @brief  Reads multiple block of data from the SD.
   * @param  pBuffer: pointer to the buffer that receives the data read from the SD card.
-  * @param  ReadAddr: SD's internal address to read from.
-  * @param  BlockSize: the SD card Data block size.
+  * @param  ReadAddr: SD's internal address to read from, in bytes.
+  * @param  BlockSize: the SD card Data block size, SD_BLOCK_SIZE.
   * @param  NumberOfBlocks: number of blocks to be read.
   * @retval The SD Response:
   *         - SD_RESPONSE_FAILURE: Sequence failed
@@ -225,101 +275,142 @@ SD_Error SD_ReadBlock(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockSize)
   */
 SD_Error SD_ReadMultiBlocks(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockSize, uint32_t NumberOfBlocks)
 {
-  uint32_t i = 0, Offset = 0;
-  SD_Error rvalue = SD_RESPONSE_FAILURE;
-  
-  /* SD chip select low */
-  SD_CS_LOW();
-  /* Data transfer */
-  while (NumberOfBlocks--)
+  if (BlockSize != SD_BLOCK_SIZE)
   {
-    /* Send CMD17 (SD_CMD_READ_SINGLE_BLOCK) to read one block */
-    SD_SendCmd (SD_CMD_READ_SINGLE_BLOCK, ReadAddr + Offset, 0xFF);
-    /* Check if the SD acknowledged the read block command: R1 response (0x00: no errors) */
-    if (SD_GetResponse(SD_RESPONSE_NO_ERROR))
-    {
-      return  SD_RESPONSE_FAILURE;
-    }
-    /* Now look for the data token to signify the start of the data */
-    if (!SD_GetResponse(SD_START_DATA_SINGLE_BLOCK_READ))
-    {
-      /* Read the SD block data : read NumByteToRead data */
-      for (i = 0; i < BlockSize; i++)
-      {
-        /* Read the pointed data */
-        *pBuffer = SD_ReadByte();
-        /* Point to the next location where the byte read will be saved */
-        pBuffer++;
-      }
-      /* Set next read address*/
-      Offset += 512;
-      /* get CRC bytes (not really needed by us, but required by SD) */
-      SD_ReadByte();
-      SD_ReadByte();
-      /* Set response value to success */
-      rvalue = SD_RESPONSE_NO_ERROR;
-    }
-    else
-    {
-      /* Set response value to failure */
-      rvalue = SD_RESPONSE_FAILURE;
-    }
+    return SD_RESPONSE_FAILURE;
   }
-  /* SD chip select high */
-  SD_CS_HIGH();
-  /* Send dummy byte: 8 Clock pulses of delay */
-  SD_WriteByte(SD_DUMMY_BYTE);
-  /* Returns the response */
-  return rvalue;
+  return SD_ReadSectors(pBuffer, ReadAddr / SD_BLOCK_SIZE, NumberOfBlocks);
 }
 
 /**
   * @brief  Writes a block on the SD
   * @param  pBuffer: pointer to the buffer containing the data to be written on
   *         the SD card.
-  * @param  WriteAddr: address to write on.
-  * @param  BlockSize: the SD card Data block size.
+  * @param  WriteAddr: address to write on, in bytes.
+  * @param  BlockSize: the SD card Data block size, SD_BLOCK_SIZE.
   * @retval The SD Response: 
   *         - SD_RESPONSE_FAILURE: Sequence failed
   *         - SD_RESPONSE_NO_ERROR: Sequence succeed
   */
 SD_Error SD_WriteBlock(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize)
 {
-  uint32_t i = 0;
+  return SD_WriteMultiBlocks(pBuffer, WriteAddr, BlockSize, 1);
+}
+
+/**
+  * @brief  Writes many blocks on the SD
+  * @param  pBuffer: pointer to the buffer containing the data to be written on 
+  *         the SD card.
+  * @param  WriteAddr: address to write on, in bytes.
+  * @param  BlockSize: the SD card Data block size, SD_BLOCK_SIZE.
+  * @param  NumberOfBlocks: number of blocks to be written.
+  * @retval The SD Response: 
+  *         - SD_RESPONSE_FAILURE: Sequence failed
+  *         - SD_RESPONSE_NO_ERROR: Sequence succeed
+  */
+SD_Error SD_WriteMultiBlocks(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize, uint32_t NumberOfBlocks)
+{
+  if (BlockSize != SD_BLOCK_SIZE)
+  {
+    return SD_RESPONSE_FAILURE;
+  }
+  return SD_WriteSectors(pBuffer, WriteAddr / SD_BLOCK_SIZE, NumberOfBlocks);
+}
+
+/**
+  * @brief  Reads SD_BLOCK_SIZE bytes sectors from the SD: one CMD17, or one
+  *         CMD18 for several sectors. The data is received by DMA, the CRC of
+  *         a sector is checked while the next one is received.
+  * @param  pBuffer: pointer to the buffer that receives the data read from the SD card.
+  * @param  Sector: number of the first sector.
+  * @param  NumberOfSectors: number of sectors to be read.
+  * @retval The SD Response:
+  *         - SD_RESPONSE_FAILURE: Sequence failed
+  *         - SD_DATA_CRC_ERROR: Data received with a wrong CRC
+  *         - SD_RESPONSE_NO_ERROR: Sequence succeed
+  */
+SD_Error SD_ReadSectors(uint8_t* pBuffer, uint32_t Sector, uint32_t NumberOfSectors)
+{
   SD_Error rvalue = SD_RESPONSE_FAILURE;
+  uint8_t cmd = (NumberOfSectors > 1) ? SD_CMD_READ_MULT_BLOCK : SD_CMD_READ_SINGLE_BLOCK;
+#ifdef SD_USE_CRC
+  uint8_t* pPrevious = 0;
+  uint16_t crc = 0;
+#endif
+
+  if (NumberOfSectors == 0)
+  {
+    return SD_RESPONSE_NO_ERROR;
+  }
+
+  /* Standard capacity cards are byte addressed */
+  if (!(SD_CardType & SD_TYPE_HC))
+  {
+    Sector *= SD_BLOCK_SIZE;
+  }
 
   /* SD chip select low */
   SD_CS_LOW();
 
-  /* Send CMD24 (SD_CMD_WRITE_SINGLE_BLOCK) to write multiple block */
-  SD_SendCmd(SD_CMD_WRITE_SINGLE_BLOCK, WriteAddr, 0xFF);
-  
-  /* Check if the SD acknowledged the write block command: R1 response (0x00: no errors) */
-  if (!SD_GetResponse(SD_RESPONSE_NO_ERROR))
+  /* Check if the SD acknowledged the read command: R1 response (0x00: no errors) */
+  if (SD_SendCommand(cmd, Sector) == SD_RESPONSE_NO_ERROR)
   {
-    /* Send a dummy byte */
-    SD_WriteByte(SD_DUMMY_BYTE);
+    rvalue = SD_RESPONSE_NO_ERROR;
 
-    /* Send the data token to signify the start of the data */
-    SD_WriteByte(0xFE);
+    while (NumberOfSectors--)
+    {
+      /* Now look for the data token to signify the start of the data */
+      if (SD_GetDataToken() != SD_START_DATA_MULTIPLE_BLOCK_READ)
+      {
+        rvalue = SD_RESPONSE_FAILURE;
+        break;
+      }
+
+      SD_DMA_Start(pBuffer, 0, SD_BLOCK_SIZE);
+
+#ifdef SD_USE_CRC
+      /* Check the previous sector while this one is received */
+      if ((pPrevious != 0) && (SD_CRC16(pPrevious, SD_BLOCK_SIZE) != crc))
+      {
+        rvalue = SD_DATA_CRC_ERROR;
+      }
+      pPrevious = pBuffer;
+#endif
 
-    /* Write the block data to SD : write count data by block */
-    for (i = 0; i < BlockSize; i++)
+      SD_DMA_Wait();
+
+      /* Get CRC bytes */
+#ifdef SD_USE_CRC
+      crc = (uint16_t)SD_ReadByte() << 8;
+      crc |= SD_ReadByte();
+#else
+      SD_ReadByte();
+      SD_ReadByte();
+#endif
+
+      pBuffer += SD_BLOCK_SIZE;
+
+      if (rvalue != SD_RESPONSE_NO_ERROR)
+      {
+        break;
+      }
+    }
+
+#ifdef SD_USE_CRC
+    if ((rvalue == SD_RESPONSE_NO_ERROR) && (SD_CRC16(pPrevious, SD_BLOCK_SIZE) != crc))
     {
-      /* Send the pointed byte */
-      SD_WriteByte(*pBuffer);
-      /* Point to the next location where the byte read will be saved */
-      pBuffer++;
+      rvalue = SD_DATA_CRC_ERROR;
     }
-    /* Put CRC bytes (not really needed by us, but required by SD) */
-    SD_ReadByte();
-    SD_ReadByte();
-    /* Read data response */
-    if (SD_GetDataResponse() == SD_DATA_OK)
+#endif
+
+    if (cmd == SD_CMD_READ_MULT_BLOCK)
     {
-      rvalue = SD_RESPONSE_NO_ERROR;
+      /* Send CMD12 (SD_CMD_STOP_TRANSMISSION) to end the read */
+      SD_SendCommand(SD_CMD_STOP_TRANSMISSION, 0);
+      SD_WaitReady();
     }
   }
+
   /* SD chip select high */
   SD_CS_HIGH();
   /* Send dummy byte: 8 Clock pulses of delay */
@@ -330,66 +421,105 @@ SD_Error SD_WriteBlock(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize)
 }
 
 /**
-  * @brief  Writes many blocks on the SD
+  * @brief  Writes SD_BLOCK_SIZE bytes sectors on the SD: one CMD24, or one
+  *         CMD25 preceded by ACMD23 so that the card can pre-erase the 
+  *         sectors. The data is sent by DMA, the CRC of the next sector is 
+  *         computed meanwhile.
   * @param  pBuffer: pointer to the buffer containing the data to be written on 
   *         the SD card.
-  * @param  WriteAddr: address to write on.
-  * @param  BlockSize: the SD card Data block size.
-  * @param  NumberOfBlocks: number of blocks to be written.
+  * @param  Sector: number of the first sector.
+  * @param  NumberOfSectors: number of sectors to be written.
   * @retval The SD Response: 
   *         - SD_RESPONSE_FAILURE: Sequence failed
   *         - SD_RESPONSE_NO_ERROR: Sequence succeed
   */
-SD_Error SD_WriteMultiBlocks(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize, uint32_t NumberOfBlocks)
+SD_Error SD_WriteSectors(const uint8_t* pBuffer, uint32_t Sector, uint32_t NumberOfSectors)
 {
-  uint32_t i = 0, Offset = 0;
   SD_Error rvalue = SD_RESPONSE_FAILURE;
+  uint8_t cmd = (NumberOfSectors > 1) ? SD_CMD_WRITE_MULT_BLOCK : SD_CMD_WRITE_SINGLE_BLOCK;
+  uint16_t crc = 0xFFFF, nextcrc = 0xFFFF;
+
+  if (NumberOfSectors == 0)
+  {
+    return SD_RESPONSE_NO_ERROR;
+  }
+
+  /* Standard capacity cards are byte addressed */
+  if (!(SD_CardType & SD_TYPE_HC))
+  {
+    Sector *= SD_BLOCK_SIZE;
+  }
 
   /* SD chip select low */
   SD_CS_LOW();
-  /* Data transfer */
-  while (NumberOfBlocks--)
+
+  if (cmd == SD_CMD_WRITE_MULT_BLOCK)
   {
-    /* Send CMD24 (SD_CMD_WRITE_SINGLE_BLOCK) to write blocks */
-    SD_SendCmd(SD_CMD_WRITE_SINGLE_BLOCK, WriteAddr + Offset, 0xFF);
-    /* Check if the SD acknowledged the write block command: R1 response (0x00: no errors) */
-    if (SD_GetResponse(SD_RESPONSE_NO_ERROR))
-    {
-      return SD_RESPONSE_FAILURE;
-    }
-    /* Send dummy byte */
-    SD_WriteByte(SD_DUMMY_BYTE);
-    /* Send the data token to signify the start of the data */
-    SD_WriteByte(SD_START_DATA_SINGLE_BLOCK_WRITE);
-    /* Write the block data to SD : write count data by block */
-    for (i = 0; i < BlockSize; i++)
-    {
-      /* Send the pointed byte */
-      SD_WriteByte(*pBuffer);
-      /* Point to the next location where the byte read will be saved */
-      pBuffer++;
-    }
-    /* Set next write address */
-    Offset += 512;
-    /* Put CRC bytes (not really needed by us, but required by SD) */
-    SD_ReadByte();
-    SD_ReadByte();
-    /* Read data response */
-    if (SD_GetDataResponse() == SD_DATA_OK)
+    /* Number of sectors to pre-erase, only a hint for the card */
+    SD_SendCommand(SD_CMD_APP_CMD, 0);
+    SD_SendCommand(SD_ACMD_SET_WR_BLK_ERASE_COUNT, NumberOfSectors);
+  }
+
+  /* Check if the SD acknowledged the write command: R1 response (0x00: no errors) */
+  if (SD_SendCommand(cmd, Sector) == SD_RESPONSE_NO_ERROR)
+  {
+    rvalue = SD_RESPONSE_NO_ERROR;
+
+#ifdef SD_USE_CRC
+    crc = SD_CRC16(pBuffer, SD_BLOCK_SIZE);
+#endif
+
+    while (NumberOfSectors--)
     {
-      /* Set response value to success */
-      rvalue = SD_RESPONSE_NO_ERROR;
+      /* Send a dummy byte, then the data token to signify the start of the data */
+      SD_WriteByte(SD_DUMMY_BYTE);
+      SD_WriteByte((cmd == SD_CMD_WRITE_MULT_BLOCK) ? SD_START_DATA_MULTIPLE_BLOCK_WRITE :
+                                                      SD_START_DATA_SINGLE_BLOCK_WRITE);
+
+      SD_DMA_Start(0, pBuffer, SD_BLOCK_SIZE);
+
+#ifdef SD_USE_CRC
+      /* CRC of the next sector while this one is sent */
+      if (NumberOfSectors != 0)
+      {
+        nextcrc = SD_CRC16(pBuffer + SD_BLOCK_SIZE, SD_BLOCK_SIZE);
+      }
+#endif
+
+      SD_DMA_Wait();
+
+      /* Put CRC bytes */
+      SD_WriteByte((uint8_t)(crc >> 8));
+      SD_WriteByte((uint8_t)crc);
+      crc = nextcrc;
+
+      /* Read data response, the card is then busy while it programs */
+      if (SD_GetDataResponse() != SD_DATA_OK)
+      {
+        rvalue = SD_RESPONSE_FAILURE;
+        break;
+      }
+
+      pBuffer += SD_BLOCK_SIZE;
     }
-    else
+
+    if (cmd == SD_CMD_WRITE_MULT_BLOCK)
     {
-      /* Set response value to failure */
-      rvalue = SD_RESPONSE_FAILURE;
+      /* Stop token, then wait for the end of programming */
+      SD_WriteByte(SD_STOP_DATA_MULTIPLE_BLOCK_WRITE);
+      SD_ReadByte();
+      if (SD_WaitReady() != SD_RESPONSE_NO_ERROR)
+      {
+        rvalue = SD_RESPONSE_FAILURE;
+      }
     }
   }
+
   /* SD chip select high */
   SD_CS_HIGH();
   /* Send dummy byte: 8 Clock pulses of delay */
   SD_WriteByte(SD_DUMMY_BYTE);
+
   /* Returns the response */
   return rvalue;
 }
@@ -512,6 +642,13 @@ SD_Error SD_GetCSDRegister(SD_CSD* SD_csd)
   SD_csd->CSD_CRC = (CSD_Tab[15] & 0xFE) >> 1;
   SD_csd->Reserved4 = 1;
 
+  if (SD_csd->CSDStruct == 1)
+  {
+    /* CSD version 2.0 (High Capacity): 22 bits C_SIZE in bytes 7 to 9 */
+    SD_csd->DeviceSize = ((CSD_Tab[7] & 0x3F) << 16) | (CSD_Tab[8] << 8) | CSD_Tab[9];
+    SD_csd->DeviceSizeMul = 0;
+  }
+
   /* Return the response */
   return rvalue;
 }
@@ -617,7 +754,7 @@ SD_Error SD_GetCIDRegister(SD_CID* SD_cid)
   * @brief  Send 5 bytes command to the SD card.
   * @param  Cmd: The user expected command to send to SD card.
   * @param  Arg: The command argument.
-  * @param  Crc: The CRC.
+  * @param  Crc: The CRC, SD_DUMMY_BYTE to have it computed.
   * @retval None
   */
 void SD_SendCmd(uint8_t Cmd, uint32_t Arg, uint8_t Crc)
@@ -636,7 +773,7 @@ void SD_SendCmd(uint8_t Cmd, uint32_t Arg, uint8_t Crc)
   
   Frame[4] = (uint8_t)(Arg); /* Construct byte 5 */
   
-  Frame[5] = (Crc); /* Construct CRC: byte 6 */
+  Frame[5] = (Crc == SD_DUMMY_BYTE) ? SD_CRC7(Frame, 5) : Crc; /* Construct CRC: byte 6 */
   
   for (i = 0; i < 6; i++)
   {
@@ -752,7 +889,9 @@ uint16_t SD_GetStatus(void)
 }
 
 /**
-  * @brief  Put SD in Idle state.
+  * @brief  Put SD in Idle state and initialize it: CMD0, then CMD8 and ACMD41
+  *         for SD cards (CMD1 for the others), CMD58 to find out High 
+  *         Capacity cards.
   * @param  None
   * @retval The SD Response: 
   *         - SD_RESPONSE_FAILURE: Sequence failed
@@ -760,35 +899,96 @@ uint16_t SD_GetStatus(void)
   */
 SD_Error SD_GoIdleState(void)
 {
+  SD_Error rvalue = SD_RESPONSE_FAILURE;
+  uint32_t timeout = SD_INIT_TIMEOUT;
+  uint8_t response[4];
+  uint8_t r1 = SD_RESPONSE_FAILURE;
+  uint32_t i = 0;
+
+  SD_CardType = 0;
+
   /* SD chip select low */
   SD_CS_LOW();
   
   /* Send CMD0 (SD_CMD_GO_IDLE_STATE) to put SD in SPI mode */
-  SD_SendCmd(SD_CMD_GO_IDLE_STATE, 0, 0x95);
-  
   /* Wait for In Idle State Response (R1 Format) equal to 0x01 */
-  if (SD_GetResponse(SD_IN_IDLE_STATE))
+  if (SD_SendCommand(SD_CMD_GO_IDLE_STATE, 0) == SD_IN_IDLE_STATE)
   {
-    /* No Idle State Response: return response failure */
-    return SD_RESPONSE_FAILURE;
+    /* Send CMD8 (SD_CMD_SEND_IF_COND): only version 2.0 cards know it, they
+       echo the voltage range and the check pattern */
+    if (SD_SendCommand(SD_CMD_SEND_IF_COND, 0x1AA) == SD_IN_IDLE_STATE)
+    {
+      for (i = 0; i < 4; i++)
+      {
+        response[i] = SD_ReadByte();
+      }
+      if ((response[2] == 0x01) && (response[3] == 0xAA))
+      {
+        SD_CardType = SD_TYPE_V2;
+      }
+    }
+    else
+    {
+      SD_CardType = SD_TYPE_V1;
+    }
   }
+
   /*---------- Activates the card initialization process -----------*/
-  do
+  if (SD_CardType != 0)
   {
-    /* SD chip select high */
-    SD_CS_HIGH();
-    
-    /* Send Dummy byte 0xFF */
-    SD_WriteByte(SD_DUMMY_BYTE);
-    
-    /* SD chip select low */
-    SD_CS_LOW();
-    
-    /* Send CMD1 (Activates the card process) until response equal to 0x0 */
-    SD_SendCmd(SD_CMD_SEND_OP_COND, 0, 0xFF);
-    /* Wait for no error Response (R1 Format) equal to 0x00 */
+    /* Send ACMD41 until the card leaves the idle state, with the High 
+       Capacity Support bit for version 2.0 cards */
+    do
+    {
+      SD_SendCommand(SD_CMD_APP_CMD, 0);
+      r1 = SD_SendCommand(SD_ACMD_SD_SEND_OP_COND, (SD_CardType == SD_TYPE_V2) ? 0x40000000 : 0);
+    }
+    while ((r1 == SD_IN_IDLE_STATE) && --timeout);
+
+    /* Not an SD card: send CMD1 (Activates the card process) instead */
+    if ((SD_CardType == SD_TYPE_V1) && (r1 & SD_ILLEGAL_COMMAND))
+    {
+      timeout = SD_INIT_TIMEOUT;
+      do
+      {
+        r1 = SD_SendCommand(SD_CMD_SEND_OP_COND, 0);
+      }
+      while ((r1 == SD_IN_IDLE_STATE) && --timeout);
+    }
+  }
+
+  if (r1 == SD_RESPONSE_NO_ERROR)
+  {
+    rvalue = SD_RESPONSE_NO_ERROR;
+
+    /* Send CMD58 (SD_CMD_READ_OCR): the CCS bit is set for High Capacity cards */
+    if ((SD_CardType == SD_TYPE_V2) && (SD_SendCommand(SD_CMD_READ_OCR, 0) == SD_RESPONSE_NO_ERROR))
+    {
+      for (i = 0; i < 4; i++)
+      {
+        response[i] = SD_ReadByte();
+      }
+      if (response[0] & 0x40)
+      {
+        SD_CardType |= SD_TYPE_HC;
+      }
+    }
+
+    /* Standard Capacity cards: SD_BLOCK_SIZE bytes blocks */
+    if (!(SD_CardType & SD_TYPE_HC) &&
+        (SD_SendCommand(SD_CMD_SET_BLOCKLEN, SD_BLOCK_SIZE) != SD_RESPONSE_NO_ERROR))
+    {
+      rvalue = SD_RESPONSE_FAILURE;
+    }
+
+#ifdef SD_USE_CRC
+    /* Send CMD59 (SD_CMD_CRC_ON_OFF): the card checks the CRC from now on */
+    if (SD_SendCommand(SD_CMD_CRC_ON_OFF, 1) != SD_RESPONSE_NO_ERROR)
+    {
+      rvalue = SD_RESPONSE_FAILURE;
+    }
+#endif
   }
-  while (SD_GetResponse(SD_RESPONSE_NO_ERROR));
   
   /* SD chip select high */
   SD_CS_HIGH();
@@ -796,7 +996,7 @@ SD_Error SD_GoIdleState(void)
   /* Send dummy byte 0xFF */
   SD_WriteByte(SD_DUMMY_BYTE);
   
-  return SD_RESPONSE_NO_ERROR;
+  return rvalue;
 }
 
 /**
@@ -823,6 +1023,188 @@ uint8_t SD_ReadByte(void)
  return STM_SPI_WriteRead(SD_DUMMY_BYTE);
 }
 
+/**
+  * @brief  Changes the SD_SPI clock prescaler.
+  * @param  Prescaler: SPI_BaudRatePrescaler_2 to SPI_BaudRatePrescaler_256.
+  * @retval None
+  */
+static void SD_SetSpeed(uint16_t Prescaler)
+{
+  SPI_Cmd(SD_SPI, DISABLE);
+  SD_SPI->CR1 = (SD_SPI->CR1 & ~SPI_CR1_BR) | Prescaler;
+  SPI_Cmd(SD_SPI, ENABLE);
+}
+
+/**
+  * @brief  Sends a command, CRC computed, and returns its R1 response. The
+  *         chip select must be low.
+  * @param  Cmd: The user expected command to send to SD card.
+  * @param  Arg: The command argument.
+  * @retval The R1 response, SD_RESPONSE_FAILURE if the card did not answer.
+  */
+static uint8_t SD_SendCommand(uint8_t Cmd, uint32_t Arg)
+{
+  uint32_t i = 0;
+  uint8_t r1 = SD_RESPONSE_FAILURE;
+
+  SD_SendCmd(Cmd, Arg, SD_DUMMY_BYTE);
+
+  /* Skip the stuff byte sent after CMD12 */
+  if (Cmd == SD_CMD_STOP_TRANSMISSION)
+  {
+    SD_ReadByte();
+  }
+
+  /* The response is the first byte with the MSB cleared, within 8 bytes */
+  for (i = 0; i < 10; i++)
+  {
+    r1 = SD_ReadByte();
+    if (!(r1 & 0x80))
+    {
+      break;
+    }
+  }
+  return r1;
+}
+
+/**
+  * @brief  Waits until the card releases its busy signal.
+  * @param  None
+  * @retval The SD Response: 
+  *         - SD_RESPONSE_FAILURE: Still busy after SD_BUSY_TIMEOUT bytes
+  *         - SD_RESPONSE_NO_ERROR: Card ready
+  */
+static SD_Error SD_WaitReady(void)
+{
+  uint32_t timeout = SD_BUSY_TIMEOUT;
+
+  while ((SD_ReadByte() != SD_DUMMY_BYTE) && --timeout)
+  {
+  }
+  return (timeout != 0) ? SD_RESPONSE_NO_ERROR : SD_RESPONSE_FAILURE;
+}
+
+/**
+  * @brief  Waits for the token starting a data block read. The card may take
+  *         up to 100 ms, longer than SD_GetResponse waits.
+  * @param  None
+  * @retval The token, or an error token, SD_DUMMY_BYTE after the timeout.
+  */
+static uint8_t SD_GetDataToken(void)
+{
+  uint32_t timeout = SD_BUSY_TIMEOUT;
+  uint8_t token = SD_DUMMY_BYTE;
+
+  while (((token = SD_ReadByte()) == SD_DUMMY_BYTE) && --timeout)
+  {
+  }
+  return token;
+}
+
+/**
+  * @brief  Starts a full duplex DMA transfer on SD_SPI.
+  * @param  RxBuffer: buffer receiving the data, 0 to drop it.
+  * @param  TxBuffer: data to send, 0 to send SD_DUMMY_BYTE.
+  * @param  Size: number of bytes.
+  * @retval None
+  */
+static void SD_DMA_Start(uint8_t* RxBuffer, const uint8_t* TxBuffer, uint16_t Size)
+{
+  DMA_InitTypeDef DMA_InitStructure;
+
+  DMA_ClearFlag(SD_SPI_DMA_RX_FLAG_GL | SD_SPI_DMA_TX_FLAG_GL);
+
+  DMA_InitStructure.DMA_PeripheralBaseAddr = SD_SPI_DR_ADDRESS;
+  DMA_InitStructure.DMA_BufferSize = Size;
+  DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+  DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+  DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+  DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+  DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+
+  /* Rx first and with the highest priority: no overrun */
+  DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)((RxBuffer != 0) ? RxBuffer : &SD_DummyRx);
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+  DMA_InitStructure.DMA_MemoryInc = (RxBuffer != 0) ? DMA_MemoryInc_Enable : DMA_MemoryInc_Disable;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+  DMA_Init(SD_SPI_DMA_RX_CHANNEL, &DMA_InitStructure);
+
+  DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)((TxBuffer != 0) ? TxBuffer : &SD_DummyTx);
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+  DMA_InitStructure.DMA_MemoryInc = (TxBuffer != 0) ? DMA_MemoryInc_Enable : DMA_MemoryInc_Disable;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+  DMA_Init(SD_SPI_DMA_TX_CHANNEL, &DMA_InitStructure);
+
+  DMA_Cmd(SD_SPI_DMA_RX_CHANNEL, ENABLE);
+  DMA_Cmd(SD_SPI_DMA_TX_CHANNEL, ENABLE);
+
+  SPI_I2S_DMACmd(SD_SPI, SPI_I2S_DMAReq_Rx, ENABLE);
+  SPI_I2S_DMACmd(SD_SPI, SPI_I2S_DMAReq_Tx, ENABLE);
+}
+
+/**
+  * @brief  Waits for the end of the transfer started by SD_DMA_Start.
+  * @param  None
+  * @retval None
+  */
+static void SD_DMA_Wait(void)
+{
+  /* The last byte is received once the Rx channel is done */
+  while (DMA_GetFlagStatus(SD_SPI_DMA_RX_FLAG_TC) == RESET)
+  {
+  }
+
+  SPI_I2S_DMACmd(SD_SPI, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, DISABLE);
+  DMA_Cmd(SD_SPI_DMA_RX_CHANNEL, DISABLE);
+  DMA_Cmd(SD_SPI_DMA_TX_CHANNEL, DISABLE);
+}
+
+/**
+  * @brief  Computes the CRC7 of a command.
+  * @param  pBuffer: command bytes.
+  * @param  Length: number of bytes.
+  * @retval The CRC7 with the end bit, as sent in the last command byte.
+  */
+static uint8_t SD_CRC7(const uint8_t* pBuffer, uint32_t Length)
+{
+  uint8_t crc = 0, data;
+  uint32_t i = 0, j = 0;
+
+  for (i = 0; i < Length; i++)
+  {
+    data = pBuffer[i];
+    for (j = 0; j < 8; j++)
+    {
+      crc <<= 1;
+      if ((data ^ crc) & 0x80)
+      {
+        crc ^= 0x09;
+      }
+      data <<= 1;
+    }
+  }
+  return (uint8_t)((crc << 1) | 1);
+}
+
+#ifdef SD_USE_CRC
+/**
+  * @brief  Computes the CRC16 of a data block, one table lookup per byte.
+  * @param  pBuffer: data.
+  * @param  Length: number of bytes.
+  * @retval The CRC16.
+  */
+static uint16_t SD_CRC16(const uint8_t* pBuffer, uint32_t Length)
+{
+  uint16_t crc = 0;
+
+  while (Length--)
+  {
+    crc = (crc << 8) ^ SD_CRC16_Table[(uint8_t)(crc >> 8) ^ *pBuffer++];
+  }
+  return crc;
+}
+#endif /* SD_USE_CRC */
+
 /**
   * @}
   */
@@ -146,8 +146,9 @@ typedef struct
 {
   SD_CSD SD_csd;
   SD_CID SD_cid;
-  uint32_t CardCapacity;  /*!< Card Capacity */
+  uint32_t CardCapacity;  /*!< Card Capacity, 0xFFFFFFFF from 4 GB */
   uint32_t CardBlockSize; /*!< Card Block Size */
+  uint32_t CardBlockNbr;  /*!< Card Capacity in SD_BLOCK_SIZE blocks */
 } SD_CardInfo;
 
 /* Exported constants --------------------------------------------------------*/
@@ -162,6 +163,13 @@ typedef struct
   */
 #define SD_DUMMY_BYTE   0xFF
 
+/**
+  * @brief  Comment to leave the data blocks unprotected: with SD_USE_CRC the
+  *         card checks the CRC7 of the commands and the CRC16 of the written
+  *         blocks, and the driver checks the CRC16 of the read blocks
+  */
+#define SD_USE_CRC
+
 /**
   * @brief  Start Data tokens:
   *         Tokens (necessary because at nop/idle (and CS active) only 0xff is 
@@ -170,7 +178,7 @@ typedef struct
 #define SD_START_DATA_SINGLE_BLOCK_READ    0xFE  /*!< Data token start byte, Start Single Block Read */
 #define SD_START_DATA_MULTIPLE_BLOCK_READ  0xFE  /*!< Data token start byte, Start Multiple Block Read */
 #define SD_START_DATA_SINGLE_BLOCK_WRITE   0xFE  /*!< Data token start byte, Start Single Block Write */
-#define SD_START_DATA_MULTIPLE_BLOCK_WRITE 0xFD  /*!< Data token start byte, Start Multiple Block Write */
+#define SD_START_DATA_MULTIPLE_BLOCK_WRITE 0xFC  /*!< Data token start byte, Start Multiple Block Write */
 #define SD_STOP_DATA_MULTIPLE_BLOCK_WRITE  0xFD  /*!< Data toke stop byte, Stop Multiple Block Write */
 
 /**
@@ -185,6 +193,7 @@ typedef struct
   */
 #define SD_CMD_GO_IDLE_STATE          0   /*!< CMD0 = 0x40 */
 #define SD_CMD_SEND_OP_COND           1   /*!< CMD1 = 0x41 */
+#define SD_CMD_SEND_IF_COND           8   /*!< CMD8 = 0x48 */
 #define SD_CMD_SEND_CSD               9   /*!< CMD9 = 0x49 */
 #define SD_CMD_SEND_CID               10  /*!< CMD10 = 0x4A */
 #define SD_CMD_STOP_TRANSMISSION      12  /*!< CMD12 = 0x4C */
@@ -206,6 +215,15 @@ typedef struct
 #define SD_CMD_ERASE_GRP_END          36  /*!< CMD36 = 0x64 */
 #define SD_CMD_UNTAG_ERASE_GROUP      37  /*!< CMD37 = 0x65 */
 #define SD_CMD_ERASE                  38  /*!< CMD38 = 0x66 */
+#define SD_CMD_APP_CMD                55  /*!< CMD55 = 0x77 */
+#define SD_CMD_READ_OCR               58  /*!< CMD58 = 0x7A */
+#define SD_CMD_CRC_ON_OFF             59  /*!< CMD59 = 0x7B */
+
+/**
+  * @brief  Application commands, sent after SD_CMD_APP_CMD
+  */
+#define SD_ACMD_SET_WR_BLK_ERASE_COUNT 23 /*!< ACMD23 = 0x57 */
+#define SD_ACMD_SD_SEND_OP_COND       41  /*!< ACMD41 = 0x69 */
   
 /* Exported macro ------------------------------------------------------------*/
 /** 
@@ -226,6 +244,8 @@ SD_Error SD_ReadBlock(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockSize);
 SD_Error SD_ReadMultiBlocks(uint8_t* pBuffer, uint32_t ReadAddr, uint16_t BlockSize, uint32_t NumberOfBlocks);
 SD_Error SD_WriteBlock(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize);
 SD_Error SD_WriteMultiBlocks(uint8_t* pBuffer, uint32_t WriteAddr, uint16_t BlockSize, uint32_t NumberOfBlocks);
+SD_Error SD_ReadSectors(uint8_t* pBuffer, uint32_t Sector, uint32_t NumberOfSectors);
+SD_Error SD_WriteSectors(const uint8_t* pBuffer, uint32_t Sector, uint32_t NumberOfSectors);
 SD_Error SD_GetCSDRegister(SD_CSD* SD_csd);
 SD_Error SD_GetCIDRegister(SD_CID* SD_cid);
 